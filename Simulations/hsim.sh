@@ -1,11 +1,11 @@
 #! /bin/sh
 HSD=~/HSIM/hybrid
+OUT=$1.output
+case $OUT in
+/*)	;;
+*)	OUT=`pwd`/$OUT ;;
+esac
 (
 	cd $HSD
-	./hsim -N system
-) < $1 > $1.output
-
-(
-	cd $HSD
-	./report
-) < $1.output
+	./hsim -N system --report --raw $OUT
+) < $1
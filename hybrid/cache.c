@@ -0,0 +1,276 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+
+/*
+ * Result Cache
+ *
+ * With hsim -k <dir> the output of every run that finishes is kept in
+ * the directory, and a later run of the same design is copied from
+ * there instead of simulated again.
+ *
+ * A run is known by its key: the parsed design as design_canonical()
+ * writes it, the options that change the results, and the size and
+ * modification time of the program, the fuel and n2o tables and the
+ * fuel's Nzr files.  Decks that differ only in layout, order or units
+ * have the same key; new data or a new hsim do not.  The file is named
+ * by a 64 bit FNV-1a hash of the key, and starts with the key itself so
+ * that a hash collision is a miss.
+ *
+ * A file holds the raw sections of the run (parameters, timeseries and
+ * errors) and a summary section, so it answers either kind of request.
+ * Files are written under a temporary name and renamed into place, so
+ * a reader never sees a partial one.  Only runs that succeed are kept.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "state.h"
+#include "linkage.h"
+#include "design.h"
+#include "hsim.h"
+
+extern char *myname;
+
+#define	CACHE_MAGIC	"hsim result cache 1\n"
+
+static char *data_files[] = {
+	"fuel.csv", "liquidfuel.csv", "n2osaturation.csv", "n2oliquid.csv",
+};
+
+#define	N_DATA_FILES	(sizeof (data_files) / sizeof (data_files[0]))
+
+static void
+stamp(FILE *output, char *path)
+{
+	struct stat st;
+
+	if (stat(path, &st) < 0)
+		fprintf(output, "%s,missing\n", path);
+	else
+		fprintf(output, "%s,%ld,%ld.%09ld\n", path, (long)st.st_size,
+			(long)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+}
+
+/*
+ * The Nzr files for the fuel, in name order.  The nozzle ratio picks
+ * one, but stamping them all keeps this independent of the design
+ * setup.
+ */
+static void
+stamp_nzr(FILE *output)
+{
+	struct dirent **list;
+	char path[1024];
+	int i, n, length;
+
+	length = strlen(fuel);
+	if ((n = scandir(cpropep_directory(), &list, NULL, alphasort)) < 0)
+		return;
+	for (i = 0; i < n; i++) {
+		if (strncmp(list[i]->d_name, fuel, length) == 0 &&
+		    strncmp(list[i]->d_name + length, ".Nzr.", 5) == 0) {
+			snprintf(path, sizeof path, "%s/%s",
+				cpropep_directory(), list[i]->d_name);
+			stamp(output, path);
+		}
+		free(list[i]);
+	}
+	free(list);
+}
+
+/*
+ * Build the key for the parsed design.  Returns its length.
+ */
+static size_t
+make_key(char **keyp)
+{
+	FILE *output;
+	size_t length;
+	int i;
+
+	output = open_memstream(keyp, &length);
+	if (!output)
+		return 0;
+	fprintf(output, CACHE_MAGIC);
+	fprintf(output, "options,%d,%d,%d,%d,%d,%d,%.17g,%.17g,%d\n", dry_fire,
+		use_engine_map, use_enthalpy, timeseries_format, csv_precision,
+		record_mode, record_interval, record_deadband, hard_constraints);
+	stamp(output, "/proc/self/exe");
+	for (i = 0; i < N_DATA_FILES; i++)
+		stamp(output, data_files[i]);
+	stamp_nzr(output);
+	design_canonical(output);
+	fclose(output);
+	return length;
+}
+
+static unsigned long long
+fnv1a(char *p, size_t n)
+{
+	unsigned long long h;
+
+	h = 14695981039346656037ULL;
+	while (n--) {
+		h ^= (unsigned char)*p++;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/*
+ * Open the file for the key, if it is there and really is for the key.
+ * Leaves it positioned after the key.
+ */
+static FILE *
+lookup(char *path, char *key, size_t length)
+{
+	FILE *input;
+	char *buffer;
+	int hit;
+
+	input = fopen(path, "r");
+	if (!input)
+		return NULL;
+	buffer = malloc(length + 1);
+	hit = buffer && fread(buffer, 1, length + 1, input) == length + 1 &&
+		memcmp(buffer, key, length) == 0 && buffer[length] == '\n';
+	free(buffer);
+	if (!hit) {
+		fclose(input);
+		return NULL;
+	}
+	return input;
+}
+
+/*
+ * Copy the sections of a run, the raw ones and/or the summary.
+ * The summary is also read back into sp, if it is not NULL, and the
+ * lines of the errors section written to errors, if it is not NULL.
+ */
+static void
+copy(FILE *input, FILE *output, int raw, int summary,
+	struct hsim_summary_s *sp, FILE *errors)
+{
+	char *line;
+	size_t size;
+	int copying, in_summary, in_errors;
+
+	line = NULL;
+	size = 0;
+	copying = raw;
+	in_summary = in_errors = 0;
+	if (sp)
+		memset(sp, 0, sizeof *sp);
+	while (getline(&line, &size, input) > 0) {
+		if (strncmp(line, "SECTION,", 8) == 0) {
+			in_summary = strcmp(line + 8, "summary\n") == 0;
+			in_errors = strcmp(line + 8, "errors\n") == 0;
+			copying = in_summary? summary: raw;
+		} else if (in_errors && errors && line[0] != '\n')
+			fputs(line, errors);
+		if (copying)
+			fputs(line, output);
+		if (in_summary && sp)
+			hsim_summary_line(sp, line);
+	}
+	free(line);
+}
+
+/*
+ * Run the parsed design, writing the raw sections and/or the summary
+ * to output, and the summary into sp if it is not NULL.  The errors
+ * and warnings of a run that ends ok, whether it was run or found in
+ * the cache, are also written to errors if it is not NULL.  Uses the
+ * cache if there is one.
+ * Returns a SIM_E code, with the reason in message if it is not SIM_OK.
+ */
+int
+cache_run(FILE *output, int raw, int summary, char *message,
+	struct hsim_summary_s *sp, FILE *errors)
+{
+	struct hsim_options_s options;
+	struct hsim_result_s result;
+	FILE *entry;
+	char *key;
+	size_t length;
+	char path[1024], temp[1024];
+	int status;
+
+	entry = NULL;
+	key = NULL;
+	if (result_cache && (length = make_key(&key)) > 0) {
+		snprintf(path, sizeof path, "%s/%016llx", result_cache,
+			fnv1a(key, length));
+		if ((entry = lookup(path, key, length)) != NULL) {
+			copy(entry, output, raw, summary, sp, errors);
+			fclose(entry);
+			free(key);
+			return SIM_OK;
+		}
+		snprintf(temp, sizeof temp, "%s/.%016llx.%ld", result_cache,
+			fnv1a(key, length), (long)getpid());
+		entry = fopen(temp, "w+");
+		if (!entry)
+			fprintf(stderr, "%s: cannot create %s: %s\n",
+				myname, temp, strerror(errno));
+		else
+			fprintf(entry, "%s\n", key);
+	}
+
+	hsim_options_init(&options);
+	options.engine_map = use_engine_map;
+	options.internal_energy = !use_enthalpy;
+	options.dry_fire = dry_fire;
+	options.constraints = hard_constraints;
+	options.keep_rows = 0;
+	status = hsim_run_parsed(&options, &result,
+		entry? entry: raw? output: NULL);
+	if (entry || raw) {
+		fprintf(entry? entry: output, "SECTION,errors\n");
+		print_errors(entry? entry: output);
+		fprintf(entry? entry: output, "\n");
+	}
+	if (entry || summary)
+		hsim_print_summary(entry? entry: output, &result.summary);
+	if (status != SIM_OK)
+		strcpy(message, result.message);
+	else if (errors)
+		print_errors(errors);
+	if (sp)
+		*sp = result.summary;
+	hsim_result_free(&result);
+
+	if (entry) {
+		fflush(entry);
+		if (status != SIM_OK || ferror(entry) ||
+		    fsync(fileno(entry)) < 0 || rename(temp, path) < 0)
+			unlink(temp);
+		fseek(entry, (long)length + 1, SEEK_SET);
+		copy(entry, output, raw, summary, NULL, NULL);
+		fclose(entry);
+	}
+	free(key);
+	return status;
+}
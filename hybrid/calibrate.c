@@ -0,0 +1,728 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Calibration
+ *
+ * Fits model coefficients to a measured static fire trace by
+ * Levenberg-Marquardt least squares.
+ *
+ * The calibration is described by a spec file:
+ *
+ *	trace		firing.csv
+ *	measure		"chamber pressure"	psi
+ *	measure		thrust			lbf	2
+ *	fit		injectorcd
+ *	fit		cstaradj
+ *	fit		fuel_a
+ *	iterations	30
+ *	workers		4
+ *
+ * The trace is a CSV file with a header line.  One column is "time",
+ * in seconds, and the others are named as in the hsim timeseries.
+ * Each measure line names a column, its unit and an optional weight.
+ * Pressures are absolute.  After the simulated burn ends the model is
+ * taken to be at zero thrust and ambient pressure.
+ *
+ * Each fit line names a numeric design parameter, or fuel_a or fuel_n
+ * to fit the regression coefficients of a hybrid fuel.  The fit starts
+ * from the design's values.
+ *
+ * The residuals are the differences between the model and the measured
+ * values at the measured times, scaled by the largest measured value of
+ * the column and by the weight.  The Jacobian is taken by forward
+ * differences.  The difference runs, and then the trial steps for three
+ * damping factors, run in parallel in forked children.  The tables are
+ * loaded before the first fork and shared by every run.
+ *
+ * The confidence intervals come from the covariance s^2 (J'J)^-1 at
+ * the fit, using the normal approximation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include "scio.h"
+#include "rsim.h"
+#include "linkage.h"
+#include "state.h"
+#include "design.h"
+
+extern char *myname;
+
+#define	MAX_FIT		8
+#define	MAX_CHANNELS	3
+#define	MAX_SAMPLES	20000
+#define	MAX_BATCH	(MAX_FIT + 1)
+
+#define	DIFF_STEP	1e-3	/* relative forward difference step */
+#define	LAMBDA_START	1e-3
+#define	LAMBDA_MAX	1e6
+#define	N_LAMBDA	3	/* trial steps per iteration */
+#define	CONVERGED	1e-8	/* relative reduction in sum of squares */
+#define	Z_95		1.959964
+
+/*
+ * The quantities that can be measured.
+ */
+struct channel_s {
+	char *name;
+	int unit;
+	double *vp;
+};
+
+static struct channel_s channels[] = {
+	{ "thrust",		FORCE,		&thrust, },
+	{ "chamber pressure",	PRESSURE,	&chamber_pressure, },
+	{ "tank pressure",	PRESSURE,	&tank_pressure, },
+};
+
+#define	N_CHANNELS	(sizeof (channels) / sizeof (channels[0]))
+
+struct measure_s {
+	struct channel_s *cp;
+	char *unit;
+	double weight;
+	double scale;			/* largest measured value */
+	int column;			/* in the trace file */
+	double value[MAX_SAMPLES];
+};
+
+struct fit_s {
+	char *name;
+	struct scio_input_parameter_s *ip;	/* or NULL for ... */
+	double *vp;				/* ... set after sim_init */
+	double initial;
+	double value;
+};
+
+/*
+ * The spec.
+ */
+static char *trace_file;
+static int n_measures;
+static struct measure_s measures[MAX_CHANNELS];
+static int n_fit;
+static struct fit_s fit[MAX_FIT];
+static int max_iterations;
+static int n_workers;
+
+static int n_samples;
+static double sample_time[MAX_SAMPLES];
+static int n_residuals;
+static double *shared;		/* MAX_BATCH of status, residuals */
+static int n_evaluations;
+
+#define	RESULT(c)	(shared + (size_t)(c) * (n_residuals + 1))
+
+/*
+ * The model at the sample times, filled in by the record hook.
+ */
+static double model[MAX_CHANNELS][MAX_SAMPLES];
+static int next_sample;
+static double last_time;
+static double last_value[MAX_CHANNELS];
+
+static void
+spec_measure(char **words, int n, int line, int *errors)
+{
+	int i;
+	struct measure_s *mp;
+
+	for (i = 0; i < N_CHANNELS; i++)
+		if (strcasecmp(words[1], channels[i].name) == 0)
+			break;
+	if (i == N_CHANNELS) {
+		fprintf(stderr, "%s: calibrate line %d: cannot measure %s\n",
+			myname, line, words[1]);
+		(*errors)++;
+		return;
+	}
+	if (n_measures >= MAX_CHANNELS) {
+		fprintf(stderr, "%s: calibrate line %d: too many measure "
+				"lines\n", myname, line);
+		(*errors)++;
+		return;
+	}
+
+	mp = measures + n_measures++;
+	mp->cp = channels + i;
+	mp->unit = ds_copy(words[2]);
+	mp->weight = n == 4? design_spec_number("calibrate", words[3],
+		line, errors): 1.;
+	(void)scio_f_convert(0., mp->cp->unit, mp->unit); /* checks unit */
+}
+
+static void
+spec_fit(char *name, int line, int *errors)
+{
+	struct fit_s *fp;
+
+	if (n_fit >= MAX_FIT) {
+		fprintf(stderr, "%s: calibrate line %d: more than %d "
+				"fit parameters\n", myname, line, MAX_FIT);
+		(*errors)++;
+		return;
+	}
+	fp = fit + n_fit;
+	fp->name = ds_copy(name);
+	fp->ip = NULL;
+	fp->vp = NULL;
+	if (strcasecmp(name, "fuel_a") == 0)
+		fp->vp = &fuel_a;
+	else if (strcasecmp(name, "fuel_n") == 0)
+		fp->vp = &fuel_n;
+	else {
+		fp->ip = design_parameter(name);
+		if (!fp->ip || fp->ip->unit == STRING) {
+			fprintf(stderr, "%s: calibrate line %d: cannot fit "
+					"%s\n", myname, line, name);
+			(*errors)++;
+			return;
+		}
+	}
+	n_fit++;
+}
+
+/*
+ * A line of the calibrate file.
+ */
+static void
+spec_line(char **words, int n, int line, int *errors)
+{
+	if (strcasecmp(words[0], "trace") == 0 && n == 2)
+		trace_file = ds_copy(words[1]);
+	else if (strcasecmp(words[0], "measure") == 0 &&
+		 (n == 3 || n == 4))
+		spec_measure(words, n, line, errors);
+	else if (strcasecmp(words[0], "fit") == 0 && n == 2)
+		spec_fit(words[1], line, errors);
+	else if (strcasecmp(words[0], "iterations") == 0 && n == 2)
+		max_iterations = design_spec_number("calibrate", words[1],
+			line, errors);
+	else if (strcasecmp(words[0], "workers") == 0 && n == 2)
+		n_workers = design_spec_number("calibrate", words[1],
+			line, errors);
+	else {
+		fprintf(stderr, "%s: calibrate line %d: cannot "
+				"understand %s\n",
+			myname, line, words[0]);
+		(*errors)++;
+	}
+}
+
+static void
+spec_read(char *specfile)
+{
+	int errors;
+
+	trace_file = NULL;
+	n_measures = 0;
+	n_fit = 0;
+	max_iterations = 30;
+	n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+	errors = design_spec_read("calibrate", specfile, spec_line);
+
+	if (!trace_file || n_measures == 0 || n_fit == 0) {
+		fprintf(stderr, "%s: calibrate needs a trace, and at least "
+				"one measure and one fit line\n", myname);
+		errors++;
+	}
+	if (max_iterations < 1 || n_workers < 1) {
+		fprintf(stderr, "%s: calibrate iterations and workers "
+				"must be positive\n", myname);
+		errors++;
+	}
+	if (errors) {
+		fprintf(stderr, "%s: exiting on calibrate errors.\n", myname);
+		error_exit(1);
+	}
+}
+
+/*
+ * Skip the leading blanks that hsim puts on its timeseries lines.
+ */
+static char *
+trim(char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+static void
+trace_read()
+{
+	FILE *input;
+	char buffer[1024];
+	char *ptrs[64];
+	int i, j, n, n_columns, time_column;
+	struct measure_s *mp;
+
+	input = fopen(trace_file, "r");
+	if (input == NULL) {
+		fprintf(stderr, "%s: cannot open trace file %s\n",
+			myname, trace_file);
+		error_exit(1);
+	}
+
+	n_columns = csv_read(input, buffer, sizeof buffer, ptrs, 64);
+	if (n_columns <= 0) {
+		fprintf(stderr, "%s: no header in trace file %s\n",
+			myname, trace_file);
+		error_exit(1);
+	}
+	time_column = -1;
+	for (j = 0, mp = measures; j < n_measures; j++, mp++)
+		mp->column = -1;
+	for (i = 0; i < n_columns; i++) {
+		if (strcasecmp(trim(ptrs[i]), "time") == 0)
+			time_column = i;
+		for (j = 0, mp = measures; j < n_measures; j++, mp++)
+			if (strcasecmp(trim(ptrs[i]), mp->cp->name) == 0)
+				mp->column = i;
+	}
+	if (time_column < 0) {
+		fprintf(stderr, "%s: no time column in %s\n",
+			myname, trace_file);
+		error_exit(1);
+	}
+	for (j = 0, mp = measures; j < n_measures; j++, mp++)
+		if (mp->column < 0) {
+			fprintf(stderr, "%s: no %s column in %s\n",
+				myname, mp->cp->name, trace_file);
+			error_exit(1);
+		}
+
+	for (i = 0; (n = csv_read(input, buffer, sizeof buffer,
+				ptrs, 64)) > 0; i++) {
+		if (i >= MAX_SAMPLES) {
+			fprintf(stderr, "%s: more than %d samples in %s\n",
+				myname, MAX_SAMPLES, trace_file);
+			error_exit(1);
+		}
+		if (n < n_columns)
+			break;		/* END-OF-DATA, or a short line */
+		sample_time[i] = atof(ptrs[time_column]);
+		if (i > 0 && sample_time[i] <= sample_time[i - 1]) {
+			fprintf(stderr, "%s: trace times must increase\n",
+				myname);
+			error_exit(1);
+		}
+		for (j = 0, mp = measures; j < n_measures; j++, mp++)
+			mp->value[i] = scio_f_convert(atof(ptrs[mp->column]),
+				mp->cp->unit, mp->unit);
+	}
+	fclose(input);
+	n_samples = i;
+	if (n_samples == 0) {
+		fprintf(stderr, "%s: no samples in %s\n", myname, trace_file);
+		error_exit(1);
+	}
+
+	for (j = 0, mp = measures; j < n_measures; j++, mp++) {
+		mp->scale = 0.;
+		for (i = 0; i < n_samples; i++)
+			if (fabs(mp->value[i]) > mp->scale)
+				mp->scale = fabs(mp->value[i]);
+		if (mp->scale == 0.)
+			mp->scale = 1.;
+	}
+	n_residuals = n_samples * n_measures;
+}
+
+/*
+ * Sample the model at the trace times, interpolating between steps.
+ */
+static void
+calibrate_record()
+{
+	int j;
+	double f;
+
+	for (; next_sample < n_samples &&
+	       sample_time[next_sample] <= sim_time; next_sample++) {
+		f = sim_time > last_time?
+			(sample_time[next_sample] - last_time) /
+				(sim_time - last_time): 1.;
+		if (f < 0.)
+			f = 1.;		/* before the first step */
+		for (j = 0; j < n_measures; j++)
+			model[j][next_sample] = last_value[j] +
+				f * (*measures[j].cp->vp - last_value[j]);
+	}
+	last_time = sim_time;
+	for (j = 0; j < n_measures; j++)
+		last_value[j] = *measures[j].cp->vp;
+}
+
+static void
+set_fit(double *p)
+{
+	int i;
+
+	design_restore();
+	for (i = 0; i < n_fit; i++)
+		if (fit[i].ip) {
+			*(double *)(fit[i].ip->vp) = p[i];
+			*(fit[i].ip->nvp) = 1;
+		}
+	design_setup();
+	sim_init();
+	for (i = 0; i < n_fit; i++)
+		if (fit[i].vp)
+			*fit[i].vp = p[i];
+}
+
+/*
+ * Run the model with parameters p, and leave the residuals in r.
+ */
+static void
+run_fit(double *p, double *r)
+{
+	int i, j;
+	struct measure_s *mp;
+
+	set_fit(p);
+	design_fill();
+
+	next_sample = 0;
+	last_time = -1.;
+	record_data_hook(calibrate_record);
+	record_data_init(0., NULL);
+	if (sim_loop() != SIM_OK)
+		error_exit(1);
+	record_data_term();
+	record_data_hook(NULL);
+
+	for (j = 0, mp = measures; j < n_measures; j++, mp++) {
+		for (i = next_sample; i < n_samples; i++)
+			model[j][i] = mp->cp->unit == FORCE? 0.:
+				ambient_air_pressure;
+		for (i = 0; i < n_samples; i++)
+			r[j * n_samples + i] = mp->weight *
+				(model[j][i] - mp->value[i]) / mp->scale;
+	}
+}
+
+/*
+ * Run n parameter sets at once.  Returns the sums of squares;
+ * HUGE_VAL for a run that failed.
+ */
+static void
+evaluate(double p[][MAX_FIT], double *ssr, int n)
+{
+	int i, k, running;
+	double *rp;
+
+	for (i = 0; i < n; i++)
+		RESULT(i)[0] = 0.;
+	fflush(stdout);
+	fflush(stderr);
+	running = 0;
+	for (i = 0; i < n || running > 0; ) {
+		if (i < n && running < n_workers) {
+			switch (fork()) {
+			    case -1:
+				perror("fork");
+				if (running == 0)
+					error_exit(1);
+				break;
+			    case 0:
+				for (k = 0; k < n_fit; k++)
+					if (p[i][k] <= 0.)
+						_exit(1);
+				run_fit(p[i], RESULT(i) + 1);
+				RESULT(i)[0] = 1.;
+				_exit(0);
+			    default:
+				running++;
+				i++;
+				continue;
+			}
+		}
+		if (wait(NULL) > 0)
+			running--;
+	}
+
+	n_evaluations += n;
+	for (i = 0; i < n; i++) {
+		rp = RESULT(i);
+		ssr[i] = 0.;
+		if (rp[0] != 1.)
+			ssr[i] = HUGE_VAL;
+		else
+			for (k = 1; k <= n_residuals; k++)
+				ssr[i] += rp[k] * rp[k];
+	}
+}
+
+/*
+ * Invert the n by n matrix a into b, by Gauss-Jordan elimination with
+ * partial pivoting.  Returns 0 if a is singular.  a is destroyed.
+ */
+static int
+invert(double a[MAX_FIT][MAX_FIT], double b[MAX_FIT][MAX_FIT], int n)
+{
+	int i, j, k, pivot;
+	double t;
+
+	for (i = 0; i < n; i++)
+		for (j = 0; j < n; j++)
+			b[i][j] = i == j? 1.: 0.;
+
+	for (k = 0; k < n; k++) {
+		pivot = k;
+		for (i = k + 1; i < n; i++)
+			if (fabs(a[i][k]) > fabs(a[pivot][k]))
+				pivot = i;
+		if (a[pivot][k] == 0.)
+			return 0;
+		for (j = 0; j < n; j++) {
+			t = a[k][j];
+			a[k][j] = a[pivot][j];
+			a[pivot][j] = t;
+			t = b[k][j];
+			b[k][j] = b[pivot][j];
+			b[pivot][j] = t;
+		}
+		t = 1. / a[k][k];
+		for (j = 0; j < n; j++) {
+			a[k][j] *= t;
+			b[k][j] *= t;
+		}
+		for (i = 0; i < n; i++) {
+			if (i == k)
+				continue;
+			t = a[i][k];
+			for (j = 0; j < n; j++) {
+				a[i][j] -= t * a[k][j];
+				b[i][j] -= t * b[k][j];
+			}
+		}
+	}
+	return 1;
+}
+
+/*
+ * Forward difference Jacobian at p.  Leaves J'J in a, J'r in g and
+ * the residuals at p in RESULT(0).  Returns the sum of squares at p.
+ */
+static double
+jacobian(double *p, double a[MAX_FIT][MAX_FIT], double *g)
+{
+	double trial[MAX_BATCH][MAX_FIT], ssr[MAX_BATCH];
+	double h[MAX_FIT];
+	double *jac;
+	int i, j, k;
+
+	for (j = 0; j < n_fit; j++) {
+		memcpy(trial[j + 1], p, sizeof trial[0]);
+		h[j] = DIFF_STEP * (fabs(p[j]) > 0.? fabs(p[j]): 1.);
+		trial[j + 1][j] += h[j];
+	}
+	memcpy(trial[0], p, sizeof trial[0]);
+	evaluate(trial, ssr, n_fit + 1);
+
+	jac = (double *)malloc((size_t)n_fit * n_residuals * sizeof (double));
+	if (!jac) {
+		fprintf(stderr, "%s: cannot malloc the Jacobian\n", myname);
+		error_exit(1);
+	}
+	for (j = 0; j < n_fit; j++)
+		for (k = 0; k < n_residuals; k++)
+			jac[j * n_residuals + k] = ssr[j + 1] == HUGE_VAL? 0.:
+				(RESULT(j + 1)[k + 1] - RESULT(0)[k + 1]) / h[j];
+	if (ssr[0] == HUGE_VAL) {
+		fprintf(stderr, "%s: the design does not run with the "
+				"calibrated parameters\n", myname);
+		error_exit(1);
+	}
+
+	for (i = 0; i < n_fit; i++) {
+		g[i] = 0.;
+		for (k = 0; k < n_residuals; k++)
+			g[i] += jac[i * n_residuals + k] * RESULT(0)[k + 1];
+		for (j = 0; j <= i; j++) {
+			a[i][j] = 0.;
+			for (k = 0; k < n_residuals; k++)
+				a[i][j] += jac[i * n_residuals + k] *
+					jac[j * n_residuals + k];
+			a[j][i] = a[i][j];
+		}
+	}
+	free(jac);
+	return ssr[0];
+}
+
+/*
+ * Calibrate the design.  The design must have been parsed.
+ */
+void
+calibrate(char *specfile, FILE *output)
+{
+	double p[MAX_FIT];
+	double a[MAX_FIT][MAX_FIT], m[MAX_FIT][MAX_FIT], inv[MAX_FIT][MAX_FIT];
+	double g[MAX_FIT];
+	double trial[MAX_BATCH][MAX_FIT], ssr[MAX_BATCH];
+	double lambda, best_ssr, s2, se, rms;
+	int i, j, k, l, best, iteration, moved;
+	size_t size;
+	struct measure_s *mp;
+
+	spec_read(specfile);
+	trace_read();
+	design_save();
+
+	size = MAX_BATCH * (size_t)(n_residuals + 1) * sizeof (double);
+	shared = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		perror("mmap");
+		error_exit(1);
+	}
+
+	/*
+	 * Load the tables here, so the children share them,
+	 * and pick up the starting values.
+	 */
+	for (i = 0; i < n_fit; i++)
+		if (fit[i].ip)
+			p[i] = *(double *)(fit[i].ip->vp);
+	design_setup();
+	for (i = 0; i < n_fit; i++)
+		if (fit[i].vp && sim_type != HYBRID) {
+			fprintf(stderr, "%s: %s only applies to hybrid "
+					"fuels\n", myname, fit[i].name);
+			error_exit(1);
+		}
+	sim_init();
+	for (i = 0; i < n_fit; i++) {
+		if (fit[i].vp)
+			p[i] = *fit[i].vp;
+		fit[i].initial = p[i];
+	}
+
+	fprintf(output, "SECTION,calibration history\n");
+	fprintf(output, "iteration,evaluations,lambda,sum of squares\n");
+	lambda = LAMBDA_START;
+	moved = 1;
+	for (iteration = 0; iteration < max_iterations; iteration++) {
+		if (moved)
+			best_ssr = jacobian(p, a, g);
+		moved = 0;
+		fprintf(output, "%d,%d,%e,%e\n",
+			iteration, n_evaluations, lambda, best_ssr);
+
+		/*
+		 * Try three damping factors at once, and keep the best.
+		 */
+		for (l = 0; l < N_LAMBDA; l++) {
+			for (i = 0; i < n_fit; i++)
+				for (j = 0; j < n_fit; j++)
+					m[i][j] = a[i][j] * (i == j?
+						1. + lambda * pow(10., l - 1): 1.);
+			if (!invert(m, inv, n_fit)) {
+				ssr[l] = HUGE_VAL;
+				memcpy(trial[l], p, sizeof trial[l]);
+				continue;
+			}
+			for (i = 0; i < n_fit; i++) {
+				trial[l][i] = p[i];
+				for (j = 0; j < n_fit; j++)
+					trial[l][i] -= inv[i][j] * g[j];
+			}
+		}
+		evaluate(trial, ssr, N_LAMBDA);
+		best = 0;
+		for (l = 1; l < N_LAMBDA; l++)
+			if (ssr[l] < ssr[best])
+				best = l;
+
+		if (ssr[best] >= best_ssr) {
+			lambda *= 100.;
+			if (lambda > LAMBDA_MAX)
+				break;
+			continue;
+		}
+		lambda *= pow(10., best - 1) / 10.;
+		memcpy(p, trial[best], sizeof p);
+		moved = 1;
+		if (best_ssr - ssr[best] < CONVERGED * best_ssr)
+			break;
+	}
+	fprintf(output, "END-OF-DATA\n\n");
+
+	/*
+	 * Covariance at the fit.
+	 */
+	best_ssr = jacobian(p, a, g);
+	s2 = n_residuals > n_fit? best_ssr / (n_residuals - n_fit): 0.;
+	if (!invert(a, inv, n_fit)) {
+		fprintf(stderr, "%s: Warning: the fit parameters are not "
+				"independent; no confidence intervals\n",
+			myname);
+		for (i = 0; i < n_fit; i++)
+			inv[i][i] = NAN;
+	}
+
+	fprintf(output, "SECTION,calibration\n");
+	fprintf(output, "samples,residuals,iterations,evaluations,"
+			"sum of squares\n");
+	fprintf(output, "%d,%d,%d,%d,%e\n\n", n_samples, n_residuals,
+		iteration, n_evaluations, best_ssr);
+
+	fprintf(output, "SECTION,fit\n");
+	fprintf(output, "Parameter,Initial,Value,Standard Error,"
+			"95%% Low,95%% High\n");
+	for (i = 0; i < n_fit; i++) {
+		se = sqrt(s2 * inv[i][i]);
+		fprintf(output, "%s,%e,%e,%e,%e,%e\n", fit[i].name,
+			fit[i].initial, p[i], se,
+			p[i] - Z_95 * se, p[i] + Z_95 * se);
+	}
+	fprintf(output, "\n");
+
+	/*
+	 * RMS error of each measured column, in its own unit.
+	 * RESULT(0) holds the residuals at the fit.
+	 */
+	fprintf(output, "SECTION,fit residuals\n");
+	fprintf(output, "Column,RMS Error,Unit\n");
+	for (j = 0, mp = measures; j < n_measures; j++, mp++) {
+		rms = 0.;
+		for (k = 0; k < n_samples; k++)
+			rms += RESULT(0)[1 + j * n_samples + k] *
+				RESULT(0)[1 + j * n_samples + k];
+		rms = sqrt(rms / n_samples) * mp->scale / mp->weight;
+		fprintf(output, "%s,%e,%s\n", mp->cp->name,
+			scio_convert(rms, mp->cp->unit, mp->unit) -
+				scio_convert(0., mp->cp->unit, mp->unit),
+			mp->unit);
+	}
+	fprintf(output, "\n");
+	fflush(output);
+	munmap(shared, size);
+}
@@ -37,12 +37,16 @@
  * STATIC INPUTS:
  *	nozzle_throat_area
  *	nozzle_exit_area
+ *	chamber_guess		(a warm start for the first step, or 0)
+ *	hard_constraints	(warnings that stop the run)
  *
  * OUTPUTS:
  *	c_star
  *	chamber_pressure	(for this iteration)
  *	thrust
  *	isp
+ *	chamber_first		(the first step's chamber_pressure)
+ *	chamber_iterations	(and chamber_first_iterations)
  */
 
 #include <stdio.h>
@@ -50,6 +54,7 @@
 #include <math.h>
 #include "state.h"
 #include "linkage.h"
+#include "scio.h"
 
 extern char *myname;
 
@@ -70,42 +75,36 @@ void
 chamber_init()
 {
 	chamber_pressure = atmosphere_pressure;
+	chamber_first = 0.;
+	chamber_iterations = 0;
+	chamber_first_iterations = 0;
 }
 
-void
-chamber()
+/*
+ * Iterate to steady-state on the cpropep solution, starting from
+ * the current chamber_pressure.
+ *
+ * Returns the number of iterations used, or -1 on failure to converge.
+ * Also used by the engine map to sample the chamber state.
+ */
+int
+chamber_converge()
 {
 	double adjusted_c_star;
-	double adjusted_nozzle_cf;
 	double old_cp;
-	double injector_pressure_drop;
-	double core_throat_ratio;
 	int counter;
 	int hi_set;
 	int lo_set;
 	double hi_cp;
 	double lo_cp;
 
-	if (dry_fire) {
-		c_star = 0.;
-		chamber_pressure = 0.;
-		thrust = 0.;
-		isp = 0.;
-		return;
-	}
-
-	/* iterate to steady-state on cpropep solution */
 	counter = 0;
 	hi_set = 0;
 	lo_set = 0;
 	hi_cp = lo_cp = chamber_pressure;
 	do {
-		if (counter++ >= MAX_ITERATIONS) {
-			fprintf(stderr, "%s: failed to converge "
-				"CPROPEP solution after %d iterations\n",
-				myname, counter-1);
-			error_exit(1);
-		}
+		if (counter++ >= MAX_ITERATIONS)
+			return -1;
 
 		/* set n2o_flow_rate */
 		injector();
@@ -119,8 +118,7 @@ chamber()
 			liquid_injector();
 			break;
 		    default:
-		    	fprintf(stderr, " SIM TYPE ERROR IN CHAMBER\n");
-			exit(1);
+			sim_fail(SIM_E_INTERNAL, "SIM TYPE ERROR IN CHAMBER");
 		}
 
 		/* get the new c-star */
@@ -170,6 +168,50 @@ chamber()
 
 	} while (!converged(old_cp, chamber_pressure));
 
+	return counter;
+}
+
+void
+chamber()
+{
+	double adjusted_nozzle_cf;
+	double injector_pressure_drop;
+	double core_throat_ratio;
+	int n;
+
+	if (dry_fire) {
+		c_star = 0.;
+		chamber_pressure = 0.;
+		thrust = 0.;
+		isp = 0.;
+		return;
+	}
+
+	/*
+	 * Use the engine map if there is one and it covers this state,
+	 * otherwise iterate to steady-state.
+	 */
+	if (!(use_engine_map && engine_map_lookup())) {
+		/*
+		 * The first step starts from atmospheric pressure and
+		 * climbs an atmosphere at a time, unless a sweep knows
+		 * the answer for a design close to this one.
+		 */
+		if (chamber_first == 0. &&
+		    chamber_guess > atmosphere_pressure &&
+		    chamber_guess < tank_pressure)
+			chamber_pressure = chamber_guess;
+		if ((n = chamber_converge()) < 0)
+			sim_fail(SIM_E_CHAMBER_CONVERGE, "failed to converge "
+				"CPROPEP solution after %d iterations",
+				MAX_ITERATIONS);
+		chamber_iterations += n;
+		if (chamber_first == 0.)
+			chamber_first_iterations = n;
+	}
+	if (chamber_first == 0.)
+		chamber_first = chamber_pressure;
+
 	/*
 	 * Hokey formula to deal with assumption of bad nozzles.
 	 */
@@ -190,9 +232,7 @@ chamber()
 
 
 	if (chamber_pressure < 2 * atmosphere_pressure) {
-		fprintf(stderr, "%s: Chamber pressure < 2 ATM\n",
-			myname);
-		error_exit(1);
+		sim_fail(SIM_E_CHAMBER_PRESSURE, "Chamber pressure < 2 ATM");
 	}
 
 	/* 
@@ -203,10 +243,8 @@ chamber()
 	injector_pressure_drop = tank_pressure - chamber_pressure;
 
 	if (injector_pressure_drop <= atmosphere_pressure) {
-		fprintf(stderr, "%s: Chamber pressure exceeds"
-				" tank pressure\n",
-				myname);
-		error_exit(1);
+		sim_fail(SIM_E_CHAMBER_PRESSURE, "Chamber pressure exceeds"
+				" tank pressure");
 	}
 
 	if (injector_pressure_drop < WARN_INJECTOR_RATIO * chamber_pressure) {
@@ -218,15 +256,39 @@ chamber()
 				chamber_pressure;
 		}
 		warn_injector_pressure = 1;
+		if (hard_constraints & HARD_INJECTOR_PRESSURE)
+			hard_fail(HARD_INJECTOR_PRESSURE, "injector pressure "
+				"drop %.1f psi, less than %.1f times chamber "
+				"pressure %.1f psi",
+				scio_convert(injector_pressure_drop,
+					PRESSURE, "psi"),
+				(double)WARN_INJECTOR_RATIO,
+				scio_convert(chamber_pressure,
+					PRESSURE, "psi"));
 	}
 
-	if (exit_pressure < WARN_EXIT_PRESSURE)
+	if (exit_pressure < WARN_EXIT_PRESSURE) {
+		if (exit_pressure < warn_exit_pressure_value)
+			warn_exit_pressure_value = exit_pressure;
 		warn_exit_pressure = 1;
+		if (hard_constraints & HARD_EXIT_PRESSURE)
+			hard_fail(HARD_EXIT_PRESSURE, "exit pressure %.1f psi, "
+				"less than %.1f psi",
+				scio_convert(exit_pressure, PRESSURE, "psi"),
+				scio_convert(WARN_EXIT_PRESSURE,
+					PRESSURE, "psi"));
+	}
 
 	if (n2o_flux > WARN_N2O_FLUX_LIMIT) {
 		if (n2o_flux > warn_n2o_flux_value)
 			warn_n2o_flux_value = n2o_flux;
 		warn_n2o_flux = 1;
+		if (hard_constraints & HARD_N2O_FLUX)
+			hard_fail(HARD_N2O_FLUX, "N2O flux %.1f lb/sec/in/in, "
+				"more than %.1f",
+				scio_convert(n2o_flux, MASSFLUX, "lb/sec/in/in"),
+				scio_convert(WARN_N2O_FLUX_LIMIT,
+					MASSFLUX, "lb/sec/in/in"));
 	}
 	
 	if (sim_type == HYBRID) {
@@ -234,16 +296,20 @@ chamber()
 			nozzle_throat_area;
 
 		if (core_throat_ratio < 1.) {
-			fprintf(stderr, "%s: core throat ratio < 1\n",
-				myname);
-			error_exit(1);
+			sim_fail(SIM_E_CORE_THROAT, "core throat ratio < 1");
 		}
 
 		if (core_throat_ratio < warn_core_throat_ratio_value)
 			warn_core_throat_ratio_value = core_throat_ratio;
 
-		if (core_throat_ratio < WARN_CORE_THROAT_RATIO_1)
+		if (core_throat_ratio < WARN_CORE_THROAT_RATIO_1) {
 			warn_core_throat_ratio = 1;
+			if (hard_constraints & HARD_CORE_THROAT)
+				hard_fail(HARD_CORE_THROAT, "core to throat "
+					"area ratio %.2f, less than %.1f",
+					core_throat_ratio,
+					WARN_CORE_THROAT_RATIO_1);
+		}
 		else if (core_throat_ratio < WARN_CORE_THROAT_RATIO_2 &&
 				warn_core_throat_ratio == 0)
 			warn_core_throat_ratio = 2;
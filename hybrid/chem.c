@@ -44,6 +44,8 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
+#include <dirent.h>
 
 #include "state.h"
 #include "linkage.h"
@@ -54,6 +56,139 @@
 extern char *myname;
 
 static int Nzrx = -1;
+static char Nzr_fuel[32];
+
+/*
+ * The tables already read, so that going back to a nozzle ratio or
+ * fuel, or a long running process, does not read the files again.
+ */
+#define	NZR_CACHE	32
+
+static struct nzr_cache_s {
+	char fuel[32];
+	int nzrx;
+	struct cpp_s data[N_OF][N_CP];
+} *cache;
+static int n_cached;
+static int next_victim;
+
+static void
+remember(char *f, int nzrx)
+{
+	struct nzr_cache_s *cp;
+
+	if (!cache) {
+		cache = malloc(NZR_CACHE * sizeof (struct nzr_cache_s));
+		if (!cache)
+			return;
+	}
+	if (n_cached < NZR_CACHE)
+		cp = cache + n_cached++;
+	else
+		cp = cache + next_victim++ % NZR_CACHE;
+	strncpy(cp->fuel, f, sizeof cp->fuel - 1);
+	cp->fuel[sizeof cp->fuel - 1] = '\0';
+	cp->nzrx = nzrx;
+	memcpy(cp->data, data, sizeof data);
+}
+
+static int
+recall(char *f, int nzrx)
+{
+	int i;
+
+	for (i = 0; i < n_cached; i++)
+		if (cache[i].nzrx == nzrx &&
+		    strncmp(cache[i].fuel, f, sizeof cache[i].fuel) == 0) {
+			memcpy(data, cache[i].data, sizeof data);
+			return 1;
+		}
+	return 0;
+}
+
+static void
+loaded(char *f, int nzrx)
+{
+	Nzrx = nzrx;
+	strncpy(Nzr_fuel, f, sizeof Nzr_fuel - 1);
+}
+
+/*
+ * Where the tables are.
+ */
+char *
+cpropep_directory()
+{
+	return CPROPEPDATA;
+}
+
+/*
+ * Read every table in the data directory, as many as fit.
+ */
+void
+cpropep_preload()
+{
+	DIR *dp;
+	struct dirent *ep;
+	char f[32];
+	char filename[512];
+	int nzrx, input, ok;
+	char *p;
+
+	if ((dp = opendir(CPROPEPDATA)) == NULL)
+		return;
+	while ((ep = readdir(dp)) != NULL && n_cached < NZR_CACHE) {
+		p = strstr(ep->d_name, ".Nzr.");
+		if (!p || p == ep->d_name || p - ep->d_name >= sizeof f)
+			continue;
+		memcpy(f, ep->d_name, p - ep->d_name);
+		f[p - ep->d_name] = '\0';
+		nzrx = atoi(p + 5);
+		snprintf(filename, sizeof filename, "%s/%s",
+			CPROPEPDATA, ep->d_name);
+		if ((input = open(filename, O_RDONLY)) < 0)
+			continue;
+		ok = read(input, &data, sizeof data) == sizeof data;
+		close(input);
+		if (ok) {
+			remember(f, nzrx);
+			cpropep_loads++;
+		}
+	}
+	closedir(dp);
+	Nzrx = -1;
+}
+
+/*
+ * Read the table for a fuel and nozzle ratio into the cache, unless it
+ * is there already, so that processes forked later have it.  Nothing
+ * is created.  Returns 0, or -1 if there is no such table.
+ */
+int
+cpropep_load(char *f, double Nzr)
+{
+	struct nzr_cache_s *cp;
+	char filename[512];
+	int nzrx, input, ok;
+
+	nzrx = Nzr * 1000. + .5;
+	for (cp = cache; cp && cp < cache + n_cached; cp++)
+		if (cp->nzrx == nzrx &&
+		    strncmp(cp->fuel, f, sizeof cp->fuel) == 0)
+			return 0;
+	snprintf(filename, sizeof filename, "%s/%s.Nzr.%d",
+		CPROPEPDATA, f, nzrx);
+	if ((input = open(filename, O_RDONLY)) < 0)
+		return -1;
+	ok = read(input, &data, sizeof data) == sizeof data;
+	close(input);
+	Nzrx = -1;
+	if (!ok)
+		return -1;
+	cpropep_loads++;
+	remember(f, nzrx);
+	return 0;
+}
 
 static void
 init(double Nzr)
@@ -72,17 +207,15 @@ init(double Nzr)
 	/*
 	 * If the data is already loaded, then we are done.
 	 */
-	if (lNzrx == Nzrx)
+	if (lNzrx == Nzrx && strcmp(fuel, Nzr_fuel) == 0)
 		return;
 
 	/*
 	 * Validate input parameter within legal range.
 	 */
 	if (Nzr < 1. || Nzr > 8.) {
-		fprintf(stderr, "%s: Nozzle Ratio %.3f is "
-				"smaller than 1. or greater than 8.\n",
-			myname, Nzr);
-		error_exit(1);
+		sim_fail(SIM_E_INPUT, "Nozzle Ratio %.3f is "
+				"smaller than 1. or greater than 8.", Nzr);
 	}
 
 	if (0 && Nzrx > 0) {
@@ -90,12 +223,16 @@ init(double Nzr)
 			myname, Nzr);
 	}
 
-	Nzrx = lNzrx;
-	
+	Nzrx = -1;
+	if (recall(fuel, lNzrx)) {
+		loaded(fuel, lNzrx);
+		return;
+	}
+
 	/*
 	 * Find the data, creating it if necessary.
 	 */
-	sprintf(filename, "%s/%s.Nzr.%d", CPROPEPDATA, fuel, Nzrx);
+	sprintf(filename, "%s/%s.Nzr.%d", CPROPEPDATA, fuel, lNzrx);
 	if ((input = open(filename, O_RDONLY)) < 0) {
 
 		/*
@@ -120,10 +257,8 @@ init(double Nzr)
 			sprintf(Nzrbuf, "%f", Nzr);
 
 			pid = vfork();
-			if (pid == -1) {
-				fprintf(stderr, "%s: cannot vfork\n", myname);
-				error_exit(1);
-			}
+			if (pid == -1)
+				sim_fail(SIM_E_SYSTEM, "cannot vfork");
 			if (pid == 0) {
 				/* child */
 				execl(CREATENZR,
@@ -136,26 +271,23 @@ init(double Nzr)
 				fprintf(stderr, "%s: execl of %s failed\n",
 					myname, CREATENZR);
 				perror("execl");
-				exit(1);
+				_exit(1);
 			}
 
 			/* parent */
 			r = waitpid(pid, &status, 0);
 			if (r == -1) {
-				fprintf(stderr, "%s: waitpid failed\n",
-					myname);
 				perror("waitpid");
-				error_exit(1);
+				sim_fail(SIM_E_SYSTEM, "waitpid failed");
 			}
 
 			if (!WIFEXITED(status) || WEXITSTATUS(status)) {
-				fprintf(stderr,
-					"%s: %s failed to run normally\n",
-					myname, CREATENZR);
 				if (WIFEXITED(status))
 					fprintf(stderr, "\tExit status was %d",
 						WEXITSTATUS(status));
-				error_exit(1);
+				sim_fail(SIM_E_SYSTEM,
+					"%s failed to run normally",
+					CREATENZR);
 			}
 
 			break;
@@ -163,20 +295,16 @@ init(double Nzr)
 
 		    case NZR_CREATE_NONE:
 		    default:
-			fprintf(stderr, "%s: Need Nozzle Ratio data file %s\n",
-					myname, filename);
-			fprintf(stderr, "\tRerun with -N to create.\n");
-			error_exit(1);
+			sim_fail(SIM_E_DATA, "Need Nozzle Ratio data file %s "
+					"(rerun with -N to create)",
+				filename);
 		}
 
 		/* File should be there now, try again. */
 
 		if ((input = open(filename, O_RDONLY)) < 0) {
-			fprintf(stderr,
-				"%s: Nozzle Data create failed\n",
-				myname);
 			perror("open");
-			error_exit(1);
+			sim_fail(SIM_E_DATA, "Nozzle Data create failed");
 		}
 	}
 	
@@ -184,50 +312,88 @@ init(double Nzr)
 	 * Read the data.
 	 */
 	if (read(input, &data, sizeof data) != sizeof data) {
-		fprintf(stderr, "%s: reading data from %s failed.\n",
-			myname, filename);
 		perror("read");
-		error_exit(1);
+		close(input);
+		sim_fail(SIM_E_DATA, "reading data from %s failed.",
+			filename);
 	}
 
 	/*
-	 * Done.
+	 * Done.  Only now is the data good for this ratio.
 	 */
 	close(input);
+	cpropep_loads++;
+	loaded(fuel, lNzrx);
+	remember(fuel, lNzrx);
 }
 
 /*
- * See Nummerical Recipes, page 105.
+ * The first i in 1 .. n-3 with x < v[i], or n-2 if there is none,
+ * searching from *hint if hint is not NULL.
  */
-static double
-interpolate(double of, double cp, double (* value)(int j, int k))
+static int
+search(double x, double v[], int n, int *hint)
+{
+	int i;
+
+	i = hint? *hint: 1;
+	if (i < 1 || i > n - 2)
+		i = 1;
+	while (i > 1 && x < v[i-1])
+		i--;
+	while (i < n - 2 && !(x < v[i]))
+		i++;
+	if (hint)
+		*hint = i;
+	return i;
+}
+
+/*
+ * Find the table cell for of and cp, and the position within it.
+ * Also returns the derivatives of t and u with respect to of and cp,
+ * which are zero where the input is clamped to the table.
+ * hint, if not NULL, is where to start looking.
+ */
+static void
+locate(double of, double cp, int *jp, int *kp, double *tp, double *up,
+	double *dt, double *du, int hint[2])
 {
 	int j, k;
-	double t, u;
-	double y1, y2, y3, y4;
-	
-	if (of < OFvector[0])
+
+	*dt = *du = 1.;
+	if (of < OFvector[0]) {
 		of = OFvector[0];
-	if (of > OFvector[N_OF - 1])
+		*dt = 0.;
+	}
+	if (of > OFvector[N_OF - 1]) {
 		of = OFvector[N_OF - 1];
+		*dt = 0.;
+	}
 
-	if (cp < CPvector[0])
+	if (cp < CPvector[0]) {
 		cp = CPvector[0];
-	if (cp > CPvector[N_CP - 1])
+		*du = 0.;
+	}
+	if (cp > CPvector[N_CP - 1]) {
 		cp = CPvector[N_CP - 1];
+		*du = 0.;
+	}
 
-	for (j = 1; j < N_OF-2; j++)
-		if (of < OFvector[j])
-			break;
-	j--;
+	j = search(of, OFvector, N_OF, hint? &hint[0]: NULL) - 1;
+	k = search(cp, CPvector, N_CP, hint? &hint[1]: NULL) - 1;
 
-	for (k = 1; k < N_CP-2; k++)
-		if (cp < CPvector[k])
-			break;
-	k--;
+	*dt /= OFvector[j+1] - OFvector[j];
+	*du /= CPvector[k+1] - CPvector[k];
+	*tp = (of - OFvector[j]) / (OFvector[j+1] - OFvector[j]);
+	*up = (cp - CPvector[k]) / (CPvector[k+1] - CPvector[k]);
+	*jp = j;
+	*kp = k;
+}
 
-	t = (of - OFvector[j]) / (OFvector[j+1] - OFvector[j]);
-	u = (cp - CPvector[k]) / (CPvector[k+1] - CPvector[k]);
+static double
+bilinear(int j, int k, double t, double u, double (* value)(int j, int k))
+{
+	double y1, y2, y3, y4;
 
 	y1 = (*value)(j, k);
 	y2 = (*value)(j+1, k);
@@ -240,8 +406,44 @@ interpolate(double of, double cp, double (* value)(int j, int k))
 		(1 - t) * u * y4;
 }
 
+/*
+ * See Nummerical Recipes, page 105.
+ * Also returns the partial derivatives with respect to of and cp.
+ */
+static double
+interpolate_slope(double of, double cp, double (* value)(int j, int k),
+	double *d_of, double *d_cp)
+{
+	int j, k;
+	double t, u;
+	double dt, du;
+	double y1, y2, y3, y4;
+
+	locate(of, cp, &j, &k, &t, &u, &dt, &du, NULL);
+
+	y1 = (*value)(j, k);
+	y2 = (*value)(j+1, k);
+	y3 = (*value)(j+1, k+1);
+	y4 = (*value)(j, k+1);
+
+	*d_of = ((1 - u) * (y2 - y1) + u * (y3 - y4)) * dt;
+	*d_cp = ((1 - t) * (y4 - y1) + t * (y3 - y2)) * du;
+
+	return bilinear(j, k, t, u, value);
+}
+
 #ifdef notused
 
+static double
+interpolate(double of, double cp, double (* value)(int j, int k))
+{
+	int j, k;
+	double t, u, dt, du;
+
+	locate(of, cp, &j, &k, &t, &u, &dt, &du, NULL);
+	return bilinear(j, k, t, u, value);
+}
+
 static double
 Isp_value(int i, int j)
 {
@@ -263,56 +465,87 @@ Cs_value(int i, int j)
 	return data[i][j].Cs;
 }
 
-static double
-cpp_Cs(double OF, double Cp, double Nzr)
-{
-	init(Nzr);
-	return interpolate(OF, Cp, &Cs_value);
-}
-
 static double
 Cf_value(int i, int j)
 {
 	return data[i][j].Cf;
 }
 
-static double
-cpp_Cf(double OF, double Cp, double Nzr)
-{
-	init(Nzr);
-	return interpolate(OF, Cp, &Cf_value);
-}
-
 static double
 Ep_value(int i, int j)
 {
 	return data[i][j].Ep;
 }
 
-static double
-cpp_Ep(double OF, double Cp, double Nzr)
+/*
+ * The cpropep outputs, in SI units, for a nozzle ratio, O/F ratio and
+ * chamber pressure in pascal.  The table cell is found once for all
+ * three values, starting from the cell in hint[], which is updated.
+ */
+void
+cpropep_table(double nzr, double of, double pc,
+	double *cs, double *pe, double *cf, int hint[2])
 {
-	init(Nzr);
-	return interpolate(OF, Cp, &Ep_value);
+	int j, k;
+	double cp, t, u, dt, du;
+
+	init(nzr);
+	cp = pc * 0.00014503774;	// convert from pascal to psi.
+	locate(of, cp, &j, &k, &t, &u, &dt, &du, hint);
+
+	*cs = bilinear(j, k, t, u, &Cs_value);
+	*cs *= 0.3048;		/* convert from ft/sec to m/sec */
+
+	*pe = bilinear(j, k, t, u, &Ep_value);
+ 	*pe *= 101325.;		/* convert from ATM to Pascal */
+
+	*cf = bilinear(j, k, t, u, &Cf_value);
+	/* unitless */
 }
 
 void
 cpropep()
 {
-	double cp, of, nzr;
+	double of, nzr;
+	static int hint[2];
 
 	/* inputs */
 	nzr = nozzle_exit_area / nozzle_throat_area;
 	of = n2o_flow_rate / fuel_flow_rate;
-	cp = chamber_pressure * 0.00014503774;	// convert from pascal to psi.
 
 	/* outputs */
-	c_star = cpp_Cs(of, cp, nzr);
-	c_star *= 0.3048;		/* convert from ft/sec to m/sec */
+	cpropep_table(nzr, of, chamber_pressure,
+		&c_star, &exit_pressure, &nozzle_cf, hint);
+}
+
+/*
+ * Partial derivatives of c_star, exit_pressure and nozzle_cf (in that
+ * order, in the units cpropep() returns) with respect to the O/F ratio
+ * and the chamber pressure in pascal, at the current state.
+ *
+ * The data is tabulated for one nozzle ratio, so there is no
+ * derivative with respect to the nozzle ratio.
+ */
+void
+cpropep_slopes(double d_of[3], double d_cp[3])
+{
+	double cp, of, nzr;
+	double to_psi;
+
+	nzr = nozzle_exit_area / nozzle_throat_area;
+	of = n2o_flow_rate / fuel_flow_rate;
+	to_psi = 0.00014503774;
+	cp = chamber_pressure * to_psi;
+	init(nzr);
 
-	exit_pressure = cpp_Ep(of, cp, nzr);
- 	exit_pressure *= 101325.;	/* convert from ATM to Pascal */
+	interpolate_slope(of, cp, &Cs_value, &d_of[0], &d_cp[0]);
+	d_of[0] *= 0.3048;
+	d_cp[0] *= 0.3048 * to_psi;
 
-	nozzle_cf = cpp_Cf(of, cp, nzr);
-	/* unitless */
+	interpolate_slope(of, cp, &Ep_value, &d_of[1], &d_cp[1]);
+	d_of[1] *= 101325.;
+	d_cp[1] *= 101325. * to_psi;
+
+	interpolate_slope(of, cp, &Cf_value, &d_of[2], &d_cp[2]);
+	d_cp[2] *= to_psi;
 }
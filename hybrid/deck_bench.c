@@ -0,0 +1,114 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Times the input deck parser: reads one deck, then parses it over and
+ * over, as batch and server mode parse theirs, and prints the cost of
+ * a deck.  The deck is parsed both through a stdio stream, as hsim
+ * reads stdin, and in place in memory, as hsim -b and -d do.
+ *
+ *	deck_bench [-n <decks>] < deck
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "state.h"
+#include "design.h"
+
+char *myname;
+
+static double
+now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int
+main(int argc, char **argv)
+{
+	char *deck, *copy;
+	size_t length, size, n;
+	long i, count;
+	double start, stream, in_place;
+	FILE *input;
+	int c;
+
+	myname = *argv;
+	count = 100000;
+	while ((c = getopt(argc, argv, "n:")) != EOF)
+		switch (c) {
+		    case 'n':
+			count = atol(optarg);
+			break;
+		    default:
+			fprintf(stderr, "Usage: %s [-n <decks>] < deck\n",
+				myname);
+			exit(1);
+		}
+	if (count < 1)
+		count = 1;
+
+	length = 0;
+	size = 4096;
+	deck = malloc(size + 1);
+	while (deck && (n = fread(deck + length, 1, size - length, stdin)) > 0)
+		if ((length += n) == size)
+			deck = realloc(deck, (size *= 2) + 1);
+	copy = malloc(length + 1);
+	if (!deck || !copy) {
+		fprintf(stderr, "%s: cannot malloc the deck\n", myname);
+		exit(1);
+	}
+	deck[length] = '\0';
+
+	/* input errors exit here, before the clock starts */
+	design_defaults();
+	memcpy(copy, deck, length + 1);
+	design_parse_text(copy);
+
+	start = now();
+	for (i = 0; i < count; i++) {
+		if (!(input = fmemopen(deck, length, "r"))) {
+			fprintf(stderr, "%s: cannot open the deck\n", myname);
+			exit(1);
+		}
+		design_defaults();
+		design_parse(input);
+		fclose(input);
+	}
+	stream = (now() - start) / count;
+
+	start = now();
+	for (i = 0; i < count; i++) {
+		memcpy(copy, deck, length + 1);
+		design_defaults();
+		design_parse_text(copy);
+	}
+	in_place = (now() - start) / count;
+
+	printf("%ld decks of %ld bytes\n", count, (long)length);
+	printf("stream\t%.2f us per deck\n", stream * 1e6);
+	printf("in place\t%.2f us per deck\n", in_place * 1e6);
+	return 0;
+}
@@ -0,0 +1,816 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+
+/*
+ * Design Parameters
+ *
+ * Reads a flat parameter file, calculates the derived parameters,
+ * and fills the tank.
+ *
+ * The parsed values can be saved and restored so that the same design
+ * can be set up and run more than once in one process, perhaps with
+ * some of the parameters changed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+#include "ts_parse.h"
+#include "scio.h"
+#include "linkage.h"
+#include "fuel.h"
+#include "state.h"
+#include "design.h"
+
+extern char *myname;
+
+#define	P_UNIT	"atm"
+
+
+static double tankdia;
+static double injectordia;
+static double noz_t_dia, noz_e_dia;
+static double noz_e_ratio;
+static int noz_e_dia_set, noz_e_ratio_set;
+static double supply_tank_pressure;
+
+static double ventdia;
+
+static int grainlength_set, graindiameter_set, graincore_set;
+static double filltemp, filldrop;
+static double fillpress;
+static double injector_count_d;
+static int filltemp_set, filldrop_set, fillpress_set;
+static int dry_mass_set;
+static int supply_tank_pressure_set;
+static int ambient_air_pressure_set;
+static int nozzle_half_angle_set;
+static int nozzle_cf_correction_set;
+
+/*
+ * The parameters that only change the thrust take a list of values.
+ * The run uses the first, thrust_sweep.c the rest.
+ */
+static double ambient_air_pressures[SWEEP_MAX];
+static double nozzle_half_angles[SWEEP_MAX];
+static double nozzle_cf_corrections[SWEEP_MAX];
+
+static double lfuelinjector_count_d;
+static int lfuelinjectordia_set;
+static int lfuelinjectorid_set, lfuelinjectorod_set;
+static int lfuelinjector_count_set;
+static int lfuelinjectorcd_set;
+static int lfueltankvolume_set;
+static int lfuelmass_set;
+static int lfuelvolume_set;
+static int nitrogen_pressure_initial_set;
+
+static double ullage_height; /* height from vent to top of tank */
+
+/*
+ * The recording policy.  The command line, if it gives one, wins.
+ */
+static char *record_mode_name;
+static double record_interval_d, record_deadband_d;
+static int record_mode_set, record_interval_set, record_deadband_set;
+static int record_mode_bad;
+
+static char *record_modes[] = { "all", "deadband", "summary", };
+
+#define	N_RECORD_MODES	(sizeof (record_modes) / sizeof (record_modes[0]))
+
+static struct scio_input_parameter_s scio_input[] = {
+{ "fuel",          STRING,      0,        &fuel,                  1, 0, },
+{ "tankheight",    LENGTH,      REQUIRED, &tank_height,           1, 0, },
+{ "ullageheight",  LENGTH,      REQUIRED, &ullage_height,         1, 0, },
+{ "tankdia",       LENGTH,      REQUIRED, &tankdia,               1, 0, },
+{ "grainlength",   LENGTH,      0,        &grain_length,          1, &grainlength_set, },
+{ "graindiameter", LENGTH,      0,        &grain_diameter,        1, &graindiameter_set, },
+{ "graincore",     LENGTH,      0,	  &grain_init_core,       1, &graincore_set, },
+{ "nozzlethroat",  LENGTH,      REQUIRED, &noz_t_dia,             1, 0, },
+{ "nozzleexit",    LENGTH,      0,        &noz_e_dia,             1, &noz_e_dia_set, },
+{ "nozzleratio",   NUMBER,      0,        &noz_e_ratio,           1, &noz_e_ratio_set, },
+{ "nozcfadj",      NUMBER,      REQUIRED, nozzle_cf_corrections,  SWEEP_MAX, &nozzle_cf_correction_set, },
+{ "nozhalfangle",  ANGLE,       0,        nozzle_half_angles,     SWEEP_MAX, &nozzle_half_angle_set, },
+{ "cstaradj",      NUMBER,      REQUIRED, &combustion_efficiency, 1, 0, },
+{ "injectordia",   LENGTH,      REQUIRED, &injectordia,           1, 0, },
+{ "injectorcd",    NUMBER,      REQUIRED, &injector_cd,           1, 0, },
+{ "injectorcount", NUMBER,      0,        &injector_count_d,      1, 0, },
+{ "ventdia",       LENGTH,      REQUIRED, &ventdia,               1, 0, },
+{ "ventcd",        NUMBER,      REQUIRED, &vent_cd,               1, 0, },
+{ "timestep",      TIME,        0,        &sim_time_step,         1, 0, },
+{ "filltemp",      TEMPERATURE, 0,        &filltemp,              1, &filltemp_set, },
+{ "filldrop",      PRESSURE,    0,        &filldrop,              1, &filldrop_set, },
+{ "fillpress",     PRESSURE,    0,        &fillpress,             1, &fillpress_set, },
+{ "drymass",       MASS,        0,        &dry_mass,              1, &dry_mass_set,  },
+{ "ambientpressure", PRESSURE,	0,        ambient_air_pressures,  SWEEP_MAX, &ambient_air_pressure_set, },
+{ "fuelinjectorid", LENGTH,	0,        &lfuelinjectorid,       1, &lfuelinjectorid_set, } ,
+{ "fuelinjectorod", LENGTH,	0,        &lfuelinjectorod,       1, &lfuelinjectorod_set, } ,
+{ "fuelinjectordia", LENGTH,	0,        &lfuelinjectordia,      1, &lfuelinjectordia_set, },
+{ "fuelinjectorcount", NUMBER,	0,	  &lfuelinjector_count_d, 1, &lfuelinjector_count_set, },
+{ "fuelinjectorcd", NUMBER,	0,	  &lfuelinjectorcd,       1, &lfuelinjectorcd_set, },
+{ "fueltankvolume", VOLUME,	0,	  &lfueltankvolume,       1, &lfueltankvolume_set, },
+{ "fuelmass",      MASS,	0,	  &lfuelmass,		  1, &lfuelmass_set, },
+{ "fuelvolume",    VOLUME,	0,	  &lfuelvolume,		  1, &lfuelvolume_set, },
+{ "nitrogenpressure",PRESSURE,	0,	  &nitrogen_pressure_initial,1, &nitrogen_pressure_initial_set, },
+{ "recordmode",    STRING,	0,	  &record_mode_name,	  1, &record_mode_set, },
+{ "recordinterval", TIME,	0,	  &record_interval_d,	  1, &record_interval_set, },
+{ "recorddeadband", NUMBER,	0,	  &record_deadband_d,	  1, &record_deadband_set, },
+
+};
+
+#define	N_INPUT	(sizeof (scio_input) / sizeof (scio_input[0]))
+
+/*
+ * Echo the design to the data file.
+ */
+void
+design_report(FILE *datafile)
+{
+	fprintf(datafile, "SECTION,parameters\n");
+	fprintf(datafile, "Parameter,Value,Unit\n");
+	fprintf(datafile, "tankheight,%.6e,meters\n", tank_height);
+	fprintf(datafile, "ullageheight,%.6e,meters\n", ullage_height);
+	fprintf(datafile, "tankvolume,%.6e,meters\n", tank_volume);
+	if (sim_type == HYBRID) {
+		fprintf(datafile, "grainlength,%.6e,meters\n", grain_length);
+		fprintf(datafile, "graindiameter,%.6e,meters\n", grain_diameter);
+		fprintf(datafile, "graincore,%.6e,meters\n", grain_init_core);
+	} else {
+		fprintf(datafile, "fuelinjectordia,%.6e,meters\n", lfuelinjectordia);
+		fprintf(datafile, "fuelinjectorid,%.6e,meters\n", lfuelinjectorid);
+		fprintf(datafile, "fuelinjectorod,%.6e,meters\n", lfuelinjectorod);
+		fprintf(datafile, "fuelinjectorcount,%.6e\n", (double)lfuelinjector_count);
+		fprintf(datafile, "fuelinjectorcd,%.6e\n", lfuelinjectorcd);
+		fprintf(datafile, "fueltankvolume,%.6e,meters**3\n", lfueltankvolume);
+		fprintf(datafile, "fuelmass,%.6e,kg\n", lfuelmass);
+		fprintf(datafile, "fuelvolume,%.6e,meters**3\n", lfuelvolume);
+	}
+	fprintf(datafile, "nozzlethroat,%.6e,meters\n", noz_t_dia);
+	fprintf(datafile, "nozzleexit,%.6e,meters\n", noz_e_dia);
+	fprintf(datafile, "nozcfadj,%.6e\n", nozzle_cf_correction);
+	fprintf(datafile, "nozzlehalfangle,%.6e,radian\n", nozzle_half_angle);
+	fprintf(datafile, "cstaradj,%.6e\n", combustion_efficiency);
+	fprintf(datafile, "injectordia,%.6e,meters\n", injectordia);
+	fprintf(datafile, "injectorcd,%.6e\n", injector_cd);
+	fprintf(datafile, "injectorcount,%.6e\n", (double)injector_count);
+	fprintf(datafile, "ventdia,%.6e,meters\n", ventdia);
+	fprintf(datafile, "ventcd,%.6e\n", vent_cd);
+	fprintf(datafile, "timestep,%.6e,seconds\n", sim_time_step);
+	fprintf(datafile, "filltemp,%.6e,kelvin\n", filltemp);
+	fprintf(datafile, "filldrop,%.6e,pascal\n", filldrop);
+	fprintf(datafile, "ambientpressure,%.6e,pascal\n",
+				ambient_air_pressure);
+	if (supply_tank_pressure_set)
+		fprintf(datafile, "supplypress,%.6e,pascal\n",
+			supply_tank_pressure);
+	if (dry_mass_set)
+		fprintf(datafile, "drymass,%.6e,kg\n",dry_mass);
+	if (filltemp_set)
+		fprintf(datafile, "ventmass,%.6e,kg\n",vent_mass);
+	fprintf(datafile, "fuel,%s,\n", fuel);
+	fprintf(datafile, "\n");
+	fflush(datafile);
+}
+
+/*
+ * Check what scio cannot, once the lines are read.
+ */
+static void
+design_parsed()
+{
+	int i;
+
+	record_mode_bad = 0;
+	if (record_mode < 0 && record_mode_set) {
+		for (i = 0; i < N_RECORD_MODES; i++)
+			if (strcasecmp(record_mode_name, record_modes[i]) == 0)
+				record_mode = i;
+		record_mode_bad = (record_mode < 0);
+	}
+	if (record_interval < 0. && record_interval_set)
+		record_interval = record_interval_d;
+	if (record_deadband < 0. && record_deadband_set)
+		record_deadband = record_deadband_d;
+
+	scio_term();
+}
+
+/*
+ * Read a parameter file.
+ */
+void
+design_parse(FILE *input)
+{
+	struct ts_parsed_s *input_buffer;
+
+	ts_parse_init();
+	scio_init(scio_input, N_INPUT);
+
+	/*
+	 * Read until EOF
+	 */
+	input_buffer = NULL;
+
+	for (;;) {
+		input_buffer = ts_parse(input, input_buffer);
+		if (!input_buffer)
+			break;
+		scio_input_line(input_buffer);
+	}
+
+	design_parsed();
+}
+
+/*
+ * Read a deck already in memory, splitting its lines where they lie.
+ * The text is changed.
+ */
+void
+design_parse_text(char *text)
+{
+	static struct ts_parsed_s *input_buffer;
+	struct ts_parsed_s *bp;
+
+	ts_parse_init();
+	scio_init(scio_input, N_INPUT);
+
+	while ((bp = ts_parse_text(&text, input_buffer)) != NULL) {
+		input_buffer = bp;
+		scio_input_line(input_buffer);
+	}
+
+	design_parsed();
+}
+
+void
+design_defaults()
+{
+	fuel = "PVC";
+	injector_count_d = 1.0;
+	lfuelinjector_count_d = 1.0;
+	lfuelmass = 0.;
+	lfuelvolume = 0.;
+	sim_time_step = 0.001;
+	record_mode_name = "all";
+	record_interval_d = 0.;
+	record_deadband_d = RECORD_DEADBAND_DEFAULT;
+}
+
+/*
+ * A message about the design.  A caller set to recover from the
+ * failure gets the reason in sim_error_message instead.
+ */
+static void
+design_error(char *format, ...)
+{
+	va_list ap;
+
+	if (error_recovering())
+		return;
+	fprintf(stderr, "%s: ", myname);
+	va_start(ap, format);
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+}
+
+/*
+ * Calculate some derived values.
+ * Perform some basic input error checking.
+ */
+void
+design_setup()
+{
+	int i, errors;
+	double d1, d2;
+
+	errors = 0;
+
+	/*
+	 * First figure out if this is a liquid fuel or a hybrid fuel simulation
+	 */
+	if (fuel_data(fuel, 0))
+		sim_type = LIQUID;	// not found in the solid fuel database.
+	else
+		sim_type = HYBRID;
+
+	/*
+	 * Legal tank combinations:
+	 *   Fill pressure only
+	 *	Sets the flight tank to this pressure. No waste calculation.
+	 *   Fill pressure and fill temperature
+	 *	Sets the flight tank to this pressure. Calculates how
+	 *	much nitrous we boiled off to cool to this pressure.
+	 *   Fill pressure drop and fill temperature
+	 *	Sets the flight tank to the indicated drop from fill tank.
+	 *	Calculates how much nitrous boiled off.
+	 */
+	if (fillpress_set && filldrop_set) {
+		design_error("cannot specify both fill pressure "
+			" and fill pressure drop\n");
+		errors++;
+	}
+
+	if (!fillpress_set && (!filldrop_set || !filltemp_set)) {
+		design_error("both fill pressure drop and "
+			"fill temperature required "
+			"to calculate fill pressure.\n");
+		errors++;
+	}
+
+	if ((noz_e_dia_set && noz_e_ratio_set) ||
+	    (!noz_e_dia_set && !noz_e_ratio_set)) {
+	    	design_error("must specify exactly one of "
+			"nozzleexit or nozzleratio\n");
+		errors++;
+	}
+
+	if (!nozzle_half_angle_set)
+		nozzle_half_angles[0] = 15. * pi / 180.;	/* default = 15 */
+	nozzle_half_angle = nozzle_half_angles[0];
+	nozzle_cf_correction = nozzle_cf_corrections[0];
+
+	for (i = 0; i < nozzle_half_angle_set || i == 0; i++)
+		if (nozzle_half_angles[i] < 0. ||
+		    nozzle_half_angles[i] > pi / 2.) {
+			design_error("nozzle half angle (%.1f) must be "
+					"in the range [0., 90.] degrees\n",
+				nozzle_half_angles[i]);
+			errors++;
+		}
+
+	injector_count = injector_count_d + .0125;
+	if (injector_count < 1) {
+		design_error("injector count (%d) must be positive.\n",
+			injector_count);
+		errors++;
+	}
+
+	if (record_mode_bad) {
+		design_error("recordmode (%s) must be all, deadband "
+				"or summary\n", record_mode_name);
+		errors++;
+	}
+	if (record_interval_set && record_interval_d < 0.) {
+		design_error("recordinterval must not be negative\n");
+		errors++;
+	}
+	if (record_deadband_set && record_deadband_d < 0.) {
+		design_error("recorddeadband must not be negative\n");
+		errors++;
+	}
+
+	if (sim_type == LIQUID) {
+		lfuelinjector_count = lfuelinjector_count_d + .0125;
+
+		if (!lfuelmass_set && !lfuelvolume_set) {
+			design_error("must set either fuelmass or "
+					"fuelvolume\n");
+			errors++;
+		}
+		
+		if (!lfuelinjectorcd_set) {
+			design_error("must set fuelinjectorcd\n");
+			errors++;
+		}
+		
+		if (!(lfuelinjectordia_set || (lfuelinjectorid_set && lfuelinjectorod_set))) {
+			design_error("must set fuelinjectordia or\n"
+				"\tboth fuelinjectorid and fuelinjectorod\n");
+			errors++;
+		}
+
+		if (!nitrogen_pressure_initial_set) {
+			design_error("must set nitrogenpressure\n");
+			errors++;
+		}
+		if (lfuelinjectordia_set) {
+			d2 = lfuelinjectordia;
+			d1 = 0.;
+		} else {
+			d2 = lfuelinjectorod;
+			d1 = lfuelinjectorid;
+		}
+		liquid_injector_area = pi/4. * (d2 * d2 - d1 * d1);
+	}
+
+	if (sim_type == HYBRID) {
+		if (!grainlength_set) {
+			design_error("grainlength parameter required "
+				"in hybrid simulations.\n");
+			errors++;
+		}
+
+		if (!graindiameter_set) {
+			design_error("graindiameter parameter required "
+				"in hybrid simulations.\n");
+			errors++;
+		}
+
+		if (!graincore_set) {
+			design_error("graincore parameter required "
+				"in hybrid simulations.\n");
+			errors++;
+		}
+	}
+
+	if (errors)
+		sim_fail(SIM_E_INPUT, "%d errors in the design parameters",
+			errors);
+
+	tank_volume = pi/4. * tankdia * tankdia * tank_height;
+	injector_area = pi/4. * injectordia * injectordia;
+
+	nozzle_throat_area = pi/4. * noz_t_dia * noz_t_dia;
+	if (noz_e_dia_set)
+		nozzle_exit_area = pi/4. * noz_e_dia * noz_e_dia;
+	else {
+		nozzle_exit_area = nozzle_throat_area *
+			noz_e_ratio;
+		noz_e_dia = noz_t_dia * sqrt(noz_e_ratio);
+	}
+
+	vent_area = pi/4. * ventdia * ventdia;
+
+	if (!ambient_air_pressure_set)
+		ambient_air_pressures[0] = atmosphere_pressure;
+	ambient_air_pressure = ambient_air_pressures[0];
+}
+
+/*
+ * Find the energy at which the tank is at the requested tempurature.
+ */
+
+static int
+converged(double temp)
+{
+	double delta;
+
+	delta = tank_temperature - temp;
+	if (delta < 0)
+		delta = -delta;
+
+	return (delta < 0.01);
+}
+
+static void
+tank_set_temp(double temp)
+{
+	int i;
+	int low_set;
+	int high_set;
+	double low_energy;
+	double high_energy;
+
+	low_set = 0;
+	high_set = 0;
+	tank_energy = 32768;
+
+
+	i = 0;
+	while (!low_set || !high_set || !converged(temp)) {
+		tank_temperature = temp;
+		tank();
+
+		if (n2o_thermo_error == TOO_HOT) {
+			high_energy = tank_energy;
+			high_set = 1;
+			if (!low_set)
+				tank_temperature -= 1;
+		} else if (n2o_thermo_error == TOO_COLD) {
+			low_energy = tank_energy;
+			low_set= 1;
+			if (!high_set)
+				tank_temperature += 1;
+		} else if (tank_temperature < temp) {
+			low_energy = tank_energy;
+			low_set= 1;
+		} else {
+			high_energy = tank_energy;
+			high_set = 1;
+		}
+
+		if (!low_set)
+			tank_energy /= 1.125;
+		else if (!high_set)
+			tank_energy *= 1.125;
+		else
+			tank_energy = (low_energy + high_energy) / 2.;
+		if (tank_energy < 1.) {
+			printf("FAILED: energy == 0\n");
+			break;
+		} else if (tank_energy > 1e8) {
+			printf("FAILED: energy > 100,000,000\n");
+			break;
+		}
+		if (i++ > 1000) {
+			printf("FAILED %d iterations\n", i);
+			break;
+		}
+	}
+}
+
+/*
+ * Find the temperature that matches the required pressure.
+ */
+static double
+n2o_temp(double pressure)
+{
+	double lo_temp, hi_temp;
+	double min_press, max_press;
+	double temp, tp;
+
+	lo_temp = 250.;
+	min_press = saturation_pressure(lo_temp);
+
+	if (pressure < min_press) {
+		sim_fail(SIM_E_INPUT, "requested flight tank pressure (%.1f %s) "
+				"is less than minimum (%.1f %s)",
+			    scio_convert(pressure, PRESSURE, P_UNIT), P_UNIT,
+			    scio_convert(min_press, PRESSURE, P_UNIT), P_UNIT);
+	}
+
+	hi_temp = 309.;
+	max_press = saturation_pressure(hi_temp);
+
+	if (pressure > max_press) {
+		sim_fail(SIM_E_INPUT, "requested flight tank pressure (%.1f %s) "
+				"is more than maximum (%.1f %s)",
+			    scio_convert(pressure, PRESSURE, P_UNIT), P_UNIT,
+			    scio_convert(max_press, PRESSURE, P_UNIT), P_UNIT);
+	}
+
+	while (hi_temp - lo_temp > .01) {
+		temp = (lo_temp + hi_temp) / 2.;
+		tp = saturation_pressure(temp);
+		if (tp < pressure)
+			lo_temp = temp;
+		else
+			hi_temp = temp;
+	}
+	return temp;
+}
+
+/*
+ * This tank fill routine uses a very crude model.
+ * Assume we know (from observation) how much pressure drop
+ * we have between the supply tank and the flight tank.
+ * Fill accordingly.
+ *
+ * Yuck.
+ */
+
+void
+design_fill()
+{
+	double flight_tank_pressure;
+	double ullage_volume;
+	double flight_tank_temp;
+
+	supply_tank_pressure_set = 0;
+	if (filltemp_set) {
+		supply_tank_pressure = saturation_pressure(filltemp);
+		supply_tank_pressure_set = 1;
+	}
+
+	if (fillpress_set)
+		flight_tank_pressure = fillpress;
+	else
+		flight_tank_pressure = supply_tank_pressure - filldrop;
+
+	if (supply_tank_pressure_set && fillpress_set &&
+	    supply_tank_pressure - fillpress < WARN_SUPPLY_PRESSURE_DROP) {
+		warn_supply_pressure = 1;
+		warn_supply_pressure_drop_value = supply_tank_pressure -
+			fillpress;
+	}
+
+	flight_tank_temp = n2o_temp(flight_tank_pressure);
+	
+	/* compute the mass of N2O vapor in the tank */
+	ullage_volume = (ullage_height / tank_height) * tank_volume;
+	tank_n2o_mass = ullage_volume * vapor_density(flight_tank_temp);
+
+	/* now N2O liquid */
+	tank_n2o_mass += (tank_volume - ullage_volume) *
+				liquid_density(flight_tank_temp);
+
+
+	/* Lastly, the initial energy state of the tank. */
+	tank_set_temp(flight_tank_temp);
+
+	/* How much nitrous did we boil off cooling the tank? */
+	if (filltemp_set)
+		tank_boil_off(filltemp);
+}
+
+/*
+ * Start a design with no parameters given, for setting them through
+ * design_parameter() instead of reading a file.
+ */
+void
+design_clear()
+{
+	scio_init(scio_input, N_INPUT);
+}
+
+/*
+ * Check that the required parameters have been given, as scio_term()
+ * does after reading a file, but without exiting.
+ * Returns the number missing, each reported on stderr.
+ */
+int
+design_check()
+{
+	int i;
+	int errors;
+
+	errors = 0;
+	for (i = 0; i < N_INPUT; i++)
+		if ((scio_input[i].options & REQUIRED) &&
+		    *(scio_input[i].nvp) == 0) {
+			design_error("required parameter %s "
+					"was not specified\n",
+				scio_input[i].name);
+			errors++;
+		}
+	return errors;
+}
+
+/*
+ * Find a parameter by name.
+ * Returns NULL if there is no such parameter.
+ */
+struct scio_input_parameter_s *
+design_parameter(char *name)
+{
+	int i;
+
+	for (i = 0; i < N_INPUT; i++)
+		if (strcasecmp(scio_input[i].name, name) == 0)
+			return scio_input + i;
+	return (struct scio_input_parameter_s *)0;
+}
+
+/*
+ * The i'th parameter of the table, or NULL past the last.
+ */
+struct scio_input_parameter_s *
+design_parameter_index(int i)
+{
+	if (i < 0 || i >= N_INPUT)
+		return (struct scio_input_parameter_s *)0;
+	return scio_input + i;
+}
+
+/*
+ * Write the parsed values in a canonical form: every parameter, in
+ * table order, with the number of times it was given and its value in
+ * SI units to full precision.  Two decks that differ only in layout,
+ * order or units give the same text.
+ */
+void
+design_canonical(FILE *output)
+{
+	int i, j;
+	struct scio_input_parameter_s *ip;
+
+	for (i = 0, ip = scio_input; i < N_INPUT; i++, ip++) {
+		if (ip->unit == STRING) {
+			fprintf(output, "%s,%d,%s\n", ip->name, *(ip->nvp),
+				*(char **)(ip->vp));
+			continue;
+		}
+		fprintf(output, "%s,%d", ip->name, *(ip->nvp));
+		for (j = 0; (j < *(ip->nvp) && j < ip->nv) || j == 0; j++)
+			fprintf(output, ",%.17g", ((double *)(ip->vp))[j]);
+		fprintf(output, "\n");
+	}
+}
+
+/*
+ * Save and restore the parsed parameter values.
+ * Only the first value of a list is saved; a run never changes the rest.
+ */
+static union {
+	double d;
+	char *s;
+} saved_value[N_INPUT];
+static int saved_count[N_INPUT];
+
+void
+design_save()
+{
+	int i;
+	struct scio_input_parameter_s *ip;
+
+	for (i = 0, ip = scio_input; i < N_INPUT; i++, ip++) {
+		if (ip->unit == STRING)
+			saved_value[i].s = *(char **)(ip->vp);
+		else
+			saved_value[i].d = *(double *)(ip->vp);
+		saved_count[i] = *(ip->nvp);
+	}
+}
+
+void
+design_restore()
+{
+	int i;
+	struct scio_input_parameter_s *ip;
+
+	for (i = 0, ip = scio_input; i < N_INPUT; i++, ip++) {
+		if (ip->unit == STRING)
+			*(char **)(ip->vp) = saved_value[i].s;
+		else
+			*(double *)(ip->vp) = saved_value[i].d;
+		*(ip->nvp) = saved_count[i];
+	}
+}
+
+/*
+ * The spec files of hsim -e, -O, -C and -x: input-file lines, each
+ * handed to fn with its words counted.  kind names the file in
+ * messages.  Returns the errors fn counted; a file that cannot be
+ * opened exits.
+ */
+int
+design_spec_read(char *kind, char *specfile,
+	void (*fn)(char **words, int n, int line, int *errors))
+{
+	FILE *input;
+	struct ts_parsed_s *buffer;
+	char **words;
+	int n, line, errors;
+
+	input = fopen(specfile, "r");
+	if (input == NULL) {
+		fprintf(stderr, "%s: cannot open %s file %s\n",
+			myname, kind, specfile);
+		error_exit(1);
+	}
+
+	errors = 0;
+	buffer = NULL;
+	for (line = 1; (buffer = ts_parse(input, buffer)) != NULL; line++) {
+		words = buffer->words;
+		if (!words[0])
+			continue;
+		for (n = 0; words[n]; n++)
+			;
+		(*fn)(words, n, line, &errors);
+	}
+	fclose(input);
+	return errors;
+}
+
+/*
+ * A number on line of a spec file, counting an error if it is not one.
+ */
+double
+design_spec_number(char *kind, char *word, int line, int *errors)
+{
+	double r;
+	char *tail;
+
+	r = strtod(word, &tail);
+	if (tail == word || *tail != '\0') {
+		fprintf(stderr, "%s: %s line %d: \"%s\" "
+				"is not a number\n", myname, kind, line, word);
+		(*errors)++;
+	}
+	return r;
+}
+
+/*
+ * splitmix64, the random streams of the ensembles and experiments.
+ */
+unsigned long long
+design_random(unsigned long long *state)
+{
+	unsigned long long z;
+
+	z = (*state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
@@ -0,0 +1,82 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * The design parameters, as read from the input file.
+ *
+ * design_defaults() and design_parse() (or design_parse_text(), for
+ * a deck in memory) read the parameters, design_setup() calculates
+ * the derived values and design_fill() fills the tank.  Call
+ * sim_init() between design_setup() and design_fill().
+ *
+ * Requires scio.h.
+ */
+
+/*
+ * Most parameters take one value.  ambientpressure, nozcfadj and
+ * nozhalfangle take up to SWEEP_MAX; see thrust_sweep.c.
+ */
+#define	SWEEP_MAX	16
+
+void design_defaults();
+void design_parse(FILE *input);
+void design_parse_text(char *text);
+void design_setup();
+void design_fill();
+void design_report(FILE *datafile);
+
+/*
+ * Save the parsed values, and put them back before setting up
+ * another run in the same process.
+ */
+void design_save();
+void design_restore();
+
+/*
+ * Set the parameters without an input file: design_clear() marks
+ * them all as not given, design_parameter() finds each one to set,
+ * and design_check() returns the number of required parameters still
+ * missing.
+ */
+void design_clear();
+int design_check();
+
+/*
+ * Write the parsed values in a canonical form, for comparing designs.
+ */
+void design_canonical(FILE *output);
+
+/*
+ * Returns the input parameter of that name, or NULL.
+ * design_parameter_index() goes through the table in order.
+ */
+struct scio_input_parameter_s *design_parameter(char *name);
+struct scio_input_parameter_s *design_parameter_index(int i);
+
+/*
+ * Read a spec file (hsim -e, -O, -C, -x), a line at a time, and the
+ * numbers on its lines.  kind ("ensemble", ...) names it in messages.
+ */
+int design_spec_read(char *kind, char *specfile,
+	void (*fn)(char **words, int n, int line, int *errors));
+double design_spec_number(char *kind, char *word, int line, int *errors);
+
+/*
+ * The next number of a splitmix64 random stream.
+ */
+unsigned long long design_random(unsigned long long *state);
@@ -0,0 +1,651 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Designs of Experiments
+ *
+ * Writes the decks of a sweep for hsim -b: the design read from stdin
+ * with some of its parameters set from samples spread over their
+ * ranges.  A grid needs levels^factors runs; these take as many runs
+ * as the spec asks for, however many factors there are.
+ *
+ * The experiment is described by a spec file:
+ *
+ *	samples		200
+ *	method		lhs
+ *	seed		12345
+ *	prefix		doe
+ *	tankheight	range	20 40 in
+ *	drymass		levels	6 8 10 kg
+ *	fuel		levels	pvc acrylic
+ *	zip nozzle	nozzlethroat	.5 .75 1 in
+ *	zip nozzle	nozzleratio	4 5 6
+ *
+ * A range is sampled anywhere between its limits, levels one of the
+ * values given.  Zip lines of the same group are one factor: they
+ * take the first of their values together, or the second, and so on,
+ * so each group needs the same number of values on every line.  The
+ * unit, if any, is the last word as in the design file.
+ *
+ * The methods are
+ *	lhs	Latin hypercube: each factor's range is cut into as many
+ *		strata as there are samples, and each stratum is used once.
+ *	sobol	the Sobol sequence, which fills the space more evenly than
+ *		random points for any number of samples, up to
+ *		MAX_SOBOL factors.
+ *	random	independent uniform samples.
+ * lhs and random draw from a stream seeded by the seed.
+ *
+ * The grain parameters apply only to hybrids, and the liquid fuel
+ * injector, tank and nitrogen parameters only to liquids.  A sample
+ * sets them only if its fuel, sampled or from the design, is the right
+ * kind; they still take a factor, so the other factors are sampled the
+ * same either way.
+ *
+ * Each deck is named with a run line, <prefix><number>.  The design's
+ * own lines for the parameters a sample sets are left out of its deck.
+ * Every deck is parsed before any is written, so an experiment with a
+ * bad unit or value writes nothing.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "ts_parse.h"
+#include "scio.h"
+#include "fuel.h"
+#include "linkage.h"
+#include "state.h"
+#include "design.h"
+
+extern char *myname;
+
+#define	MAX_FACTORS	64
+#define	MAX_LEVELS	64
+#define	MAX_SOBOL	21
+
+#define	RANGE		1
+#define	LEVELS		2
+#define	ZIP		3
+
+#define	LHS		1
+#define	SOBOL		2
+#define	RANDOM		3
+
+struct factor_s {
+	struct scio_input_parameter_s *ip;
+	int	kind;		/* RANGE, LEVELS or ZIP */
+	double	lo, hi;		/* a range */
+	char	*levels[MAX_LEVELS];
+	int	n_levels;
+	char	*unit;		/* "" if none */
+	char	*group;		/* a zip group */
+	int	dimension;	/* the coordinate of the sample it takes */
+	int	only;		/* HYBRID, LIQUID, or 0 for both */
+};
+
+/*
+ * The parameters of one kind of motor.
+ */
+static struct {
+	char	*prefix;
+	int	only;
+} conditional[] = {
+	{ "grain",		HYBRID, },
+	{ "fuelinjector",	LIQUID, },
+	{ "fueltankvolume",	LIQUID, },
+	{ "fuelmass",		LIQUID, },
+	{ "fuelvolume",		LIQUID, },
+	{ "nitrogenpressure",	LIQUID, },
+};
+
+#define	N_CONDITIONAL	(sizeof (conditional) / sizeof (conditional[0]))
+
+/*
+ * The Sobol sequence's primitive polynomials and initial direction
+ * numbers, from Joe and Kuo.  The first dimension is van der Corput's.
+ */
+static struct {
+	int	s;		/* degree */
+	int	a;		/* the inner coefficients */
+	unsigned m[7];
+} sobol_poly[MAX_SOBOL - 1] = {
+	{ 1, 0,  { 1, }, },
+	{ 2, 1,  { 1, 3, }, },
+	{ 3, 1,  { 1, 3, 1, }, },
+	{ 3, 2,  { 1, 1, 1, }, },
+	{ 4, 1,  { 1, 1, 3, 3, }, },
+	{ 4, 4,  { 1, 3, 5, 13, }, },
+	{ 5, 2,  { 1, 1, 5, 5, 17, }, },
+	{ 5, 4,  { 1, 1, 5, 5, 5, }, },
+	{ 5, 7,  { 1, 1, 7, 11, 19, }, },
+	{ 5, 11, { 1, 1, 5, 1, 1, }, },
+	{ 5, 13, { 1, 1, 1, 3, 11, }, },
+	{ 5, 14, { 1, 3, 5, 5, 31, }, },
+	{ 6, 1,  { 1, 3, 3, 9, 7, 49, }, },
+	{ 6, 13, { 1, 1, 1, 15, 21, 21, }, },
+	{ 6, 16, { 1, 3, 1, 13, 27, 49, }, },
+	{ 6, 19, { 1, 1, 1, 15, 7, 5, }, },
+	{ 6, 22, { 1, 3, 1, 15, 13, 25, }, },
+	{ 6, 25, { 1, 1, 5, 5, 19, 61, }, },
+	{ 7, 1,  { 1, 3, 7, 11, 23, 15, 103, }, },
+	{ 7, 4,  { 1, 3, 7, 13, 13, 15, 69, }, },
+};
+
+/*
+ * The spec.
+ */
+static long n_samples;
+static int method;
+static unsigned long long seed;
+static char *prefix;
+static struct factor_s factors[MAX_FACTORS];
+static int n_factors;
+static int n_dimensions;
+
+/*
+ * The design's lines, and the factor each one sets, -1 for none, or
+ * JOB_LINE for a line for hsim -b.
+ */
+#define	JOB_LINE	(-2)
+
+static char **base_lines;
+static int *base_factor;
+static int n_base_lines;
+
+/* a design_random() stream, uniform on [0, 1) */
+static double
+uniform_random(unsigned long long *state)
+{
+	return (design_random(state) >> 11) * (1. / 9007199254740992.);
+}
+
+static char *
+spec_copy(char *word)
+{
+	char *p;
+
+	if (!(p = strdup(word))) {
+		fprintf(stderr, "%s: cannot malloc the experiment\n", myname);
+		error_exit(1);
+	}
+	return p;
+}
+
+/*
+ * Read a factor line:
+ *	<parameter> range <low> <high> [unit]
+ *	<parameter> levels <value> ... [unit]
+ *	zip <group> <parameter> <value> ... [unit]
+ */
+static void
+spec_factor(char **words, int n, int line, int *errors)
+{
+	struct scio_input_parameter_s *ip;
+	struct factor_s *fp;
+	char *name, *kind;
+	int i, first, has_unit;
+
+	/* the values are words[first] to the unit */
+	if (strcasecmp(words[0], "zip") == 0 && n >= 3) {
+		name = words[2];
+		kind = words[0];
+		first = 3;
+	} else if (n >= 2) {
+		name = words[0];
+		kind = words[1];
+		first = 2;
+	} else {
+		fprintf(stderr, "%s: experiment line %d: unknown keyword "
+				"%s\n", myname, line, words[0]);
+		(*errors)++;
+		return;
+	}
+
+	ip = design_parameter(name);
+	if (!ip) {
+		fprintf(stderr, "%s: experiment line %d: unknown keyword or "
+				"parameter %s\n", myname, line, name);
+		(*errors)++;
+		return;
+	}
+	for (i = 0; i < n_factors; i++)
+		if (factors[i].ip == ip) {
+			fprintf(stderr, "%s: experiment line %d: %s is "
+					"already a factor\n",
+				myname, line, name);
+			(*errors)++;
+			return;
+		}
+	if (n_factors >= MAX_FACTORS) {
+		fprintf(stderr, "%s: experiment line %d: more than %d "
+				"factors\n", myname, line, MAX_FACTORS);
+		(*errors)++;
+		return;
+	}
+
+	fp = factors + n_factors;
+	memset(fp, 0, sizeof *fp);
+	fp->ip = ip;
+	has_unit = ip->unit != NUMBER && ip->unit != STRING;
+	fp->unit = has_unit && n > first? spec_copy(words[n - 1]): "";
+	n -= has_unit;
+	if (strcasecmp(kind, "range") == 0 && ip->unit != STRING &&
+	    n - first == 2) {
+		fp->kind = RANGE;
+		fp->lo = design_spec_number("experiment", words[first],
+			line, errors);
+		fp->hi = design_spec_number("experiment", words[first + 1],
+			line, errors);
+		n_factors++;
+		return;
+	} else if (strcasecmp(kind, "zip") == 0) {
+		fp->kind = ZIP;
+		fp->group = spec_copy(words[1]);
+	} else if (strcasecmp(kind, "levels") == 0) {
+		fp->kind = LEVELS;
+	} else {
+		fprintf(stderr, "%s: experiment line %d: expected "
+				"%s range <low> <high>%s, or levels\n",
+			myname, line, name, has_unit? " <unit>": "");
+		(*errors)++;
+		return;
+	}
+
+	/* the values of levels or a zip */
+	if (n - first < 1 || n - first > MAX_LEVELS) {
+		fprintf(stderr, "%s: experiment line %d: %s needs 1 to %d "
+				"values%s\n", myname, line, name,
+			MAX_LEVELS, has_unit? " and a unit": "");
+		(*errors)++;
+		return;
+	}
+	for (i = first; i < n; i++) {
+		if (ip->unit != STRING)
+			(void)design_spec_number("experiment", words[i],
+				line, errors);
+		fp->levels[fp->n_levels++] = spec_copy(words[i]);
+	}
+	n_factors++;
+}
+
+/*
+ * Give each factor its coordinate, and check the zip groups.
+ */
+static void
+spec_dimensions(int *errors)
+{
+	struct factor_s *fp, *gp;
+	int i;
+
+	n_dimensions = 0;
+	for (fp = factors; fp < factors + n_factors; fp++) {
+		fp->dimension = -1;
+		for (gp = factors; fp->kind == ZIP && gp < fp; gp++)
+			if (gp->kind == ZIP &&
+			    strcmp(gp->group, fp->group) == 0) {
+				if (gp->n_levels != fp->n_levels) {
+					fprintf(stderr, "%s: experiment: zip "
+						"%s has %d values for %s and "
+						"%d for %s\n", myname,
+						fp->group, gp->n_levels,
+						gp->ip->name, fp->n_levels,
+						fp->ip->name);
+					(*errors)++;
+				}
+				fp->dimension = gp->dimension;
+				break;
+			}
+		if (fp->dimension < 0)
+			fp->dimension = n_dimensions++;
+		for (i = 0; i < N_CONDITIONAL; i++)
+			if (strncasecmp(fp->ip->name, conditional[i].prefix,
+			    strlen(conditional[i].prefix)) == 0)
+				fp->only = conditional[i].only;
+	}
+}
+
+/*
+ * A line of the experiment file.
+ */
+static void
+spec_line(char **words, int n, int line, int *errors)
+{
+	if (strcasecmp(words[0], "samples") == 0 && n == 2)
+		n_samples = design_spec_number("experiment", words[1],
+			line, errors);
+	else if (strcasecmp(words[0], "seed") == 0 && n == 2)
+		seed = strtoull(words[1], NULL, 0);
+	else if (strcasecmp(words[0], "prefix") == 0 && n == 2)
+		prefix = spec_copy(words[1]);
+	else if (strcasecmp(words[0], "method") == 0 && n == 2) {
+		if (strcasecmp(words[1], "lhs") == 0)
+			method = LHS;
+		else if (strcasecmp(words[1], "sobol") == 0)
+			method = SOBOL;
+		else if (strcasecmp(words[1], "random") == 0)
+			method = RANDOM;
+		else {
+			fprintf(stderr, "%s: experiment line %d: "
+					"unknown method %s\n",
+				myname, line, words[1]);
+			(*errors)++;
+		}
+	} else
+		spec_factor(words, n, line, errors);
+}
+
+static void
+spec_read(char *specfile)
+{
+	int errors;
+
+	n_samples = 100;
+	method = LHS;
+	seed = 1;
+	prefix = "doe";
+	n_factors = 0;
+
+	errors = design_spec_read("experiment", specfile, spec_line);
+
+	spec_dimensions(&errors);
+	if (n_samples < 1 || n_factors < 1) {
+		fprintf(stderr, "%s: an experiment needs samples and "
+				"factors\n", myname);
+		errors++;
+	}
+	if (method == SOBOL && n_dimensions > MAX_SOBOL) {
+		fprintf(stderr, "%s: sobol takes at most %d factors\n",
+			myname, MAX_SOBOL);
+		errors++;
+	}
+	if (errors) {
+		fprintf(stderr, "%s: exiting on experiment errors.\n", myname);
+		error_exit(1);
+	}
+}
+
+/*
+ * Read the design, and note which lines set a factor.
+ */
+static char *
+base_read(FILE *input)
+{
+	char *text, *p, *end, word[64];
+	size_t size, length, n;
+	int i, size_lines;
+
+	length = 0;
+	size = 4096;
+	text = malloc(size + 1);
+	while (text && (n = fread(text + length, 1, size - length, input)) > 0)
+		if ((length += n) == size)
+			text = realloc(text, (size *= 2) + 1);
+	if (!text) {
+		fprintf(stderr, "%s: cannot malloc the design\n", myname);
+		error_exit(1);
+	}
+	text[length] = '\0';
+
+	size_lines = 64;
+	base_lines = malloc(size_lines * sizeof (char *));
+	base_factor = malloc(size_lines * sizeof (int));
+	n_base_lines = 0;
+	for (p = text; base_lines && base_factor && *p; p = end) {
+		if ((end = strchr(p, '\n')) != NULL)
+			*end++ = '\0';
+		else
+			end = p + strlen(p);
+		if (n_base_lines == size_lines) {
+			size_lines *= 2;
+			base_lines = realloc(base_lines,
+				size_lines * sizeof (char *));
+			base_factor = realloc(base_factor,
+				size_lines * sizeof (int));
+			if (!base_lines || !base_factor)
+				break;
+		}
+		if (sscanf(p, "%63s", word) != 1)
+			word[0] = '\0';
+		if (strcmp(word, "run") == 0)
+			continue;	/* the decks are named here */
+		base_factor[n_base_lines] = -1;
+		if (strcmp(word, "job") == 0)
+			base_factor[n_base_lines] = JOB_LINE;
+		for (i = 0; i < n_factors; i++)
+			if (strcasecmp(word, factors[i].ip->name) == 0)
+				base_factor[n_base_lines] = i;
+		base_lines[n_base_lines++] = p;
+	}
+	if (!base_lines || !base_factor) {
+		fprintf(stderr, "%s: cannot malloc the design\n", myname);
+		error_exit(1);
+	}
+	return text;
+}
+
+/*
+ * The Sobol direction numbers, v[d][k] for bit k.
+ */
+static void
+sobol_init(unsigned v[MAX_SOBOL][32])
+{
+	int d, k, l, s, a;
+
+	for (k = 0; k < 32; k++)
+		v[0][k] = 1u << (31 - k);
+	for (d = 1; d < n_dimensions; d++) {
+		s = sobol_poly[d - 1].s;
+		a = sobol_poly[d - 1].a;
+		for (k = 0; k < s; k++)
+			v[d][k] = sobol_poly[d - 1].m[k] << (31 - k);
+		for (k = s; k < 32; k++) {
+			v[d][k] = v[d][k - s] ^ (v[d][k - s] >> s);
+			for (l = 1; l < s; l++)
+				if ((a >> (s - 1 - l)) & 1)
+					v[d][k] ^= v[d][k - l];
+		}
+	}
+}
+
+/*
+ * The points, n_dimensions coordinates in [0, 1) for each sample.
+ */
+static double *
+sample()
+{
+	double *u;
+	unsigned v[MAX_SOBOL][32], x[MAX_SOBOL];
+	unsigned long long state;
+	long i, j, t, *perm;
+	int d, c;
+
+	u = malloc(n_samples * n_dimensions * sizeof (double));
+	perm = malloc(n_samples * sizeof (long));
+	if (!u || !perm) {
+		fprintf(stderr, "%s: cannot malloc %ld samples\n",
+			myname, n_samples);
+		error_exit(1);
+	}
+	state = seed;
+
+	switch (method) {
+	    case LHS:
+		for (d = 0; d < n_dimensions; d++) {
+			for (i = 0; i < n_samples; i++)
+				perm[i] = i;
+			for (i = n_samples - 1; i > 0; i--) {
+				j = design_random(&state) % (i + 1);
+				t = perm[i];
+				perm[i] = perm[j];
+				perm[j] = t;
+			}
+			for (i = 0; i < n_samples; i++)
+				u[i * n_dimensions + d] = (perm[i] +
+					uniform_random(&state)) / n_samples;
+		}
+		break;
+	    case SOBOL:
+		/* the first point is all zeros, and is skipped */
+		sobol_init(v);
+		memset(x, 0, sizeof x);
+		for (i = 0; i < n_samples; i++) {
+			for (c = 0; (i >> c) & 1; c++)
+				;
+			for (d = 0; d < n_dimensions; d++) {
+				x[d] ^= v[d][c];
+				u[i * n_dimensions + d] =
+					x[d] * (1. / 4294967296.);
+			}
+		}
+		break;
+	    case RANDOM:
+		for (i = 0; i < n_samples * n_dimensions; i++)
+			u[i] = uniform_random(&state);
+		break;
+	}
+	free(perm);
+	return u;
+}
+
+/*
+ * Is the fuel a liquid?  As design_setup() decides.
+ */
+static int
+liquid(char *fuel_name)
+{
+	return fuel_data(fuel_name, 0) != 0;
+}
+
+/*
+ * The design's fuel: the word after "fuel", or the default.
+ */
+static char *
+base_fuel()
+{
+	struct ts_parsed_s *buffer;
+	char *line, *p;
+	int i;
+
+	design_defaults();
+	buffer = NULL;
+	for (i = 0; i < n_base_lines; i++) {
+		line = p = spec_copy(base_lines[i]);
+		buffer = ts_parse_text(&p, buffer);
+		if (buffer && buffer->words[0] && buffer->words[1] &&
+		    strcasecmp(buffer->words[0], "fuel") == 0)
+			return spec_copy(buffer->words[1]);
+		free(line);
+	}
+	return fuel;
+}
+
+/*
+ * Write the deck of sample i, at u.  Unless for the parser, it is
+ * named and ended for hsim -b.
+ */
+static void
+write_deck(FILE *output, long i, double *u, char *fuel_name, int parse)
+{
+	struct factor_s *fp;
+	int set[MAX_FACTORS];
+	int f, k, kind;
+
+	/* the fuel decides which factors apply */
+	for (fp = factors; fp < factors + n_factors; fp++)
+		if (strcasecmp(fp->ip->name, "fuel") == 0) {
+			k = u[fp->dimension] * fp->n_levels;
+			fuel_name = fp->levels[k < fp->n_levels? k:
+				fp->n_levels - 1];
+		}
+	kind = liquid(fuel_name)? LIQUID: HYBRID;
+	for (f = 0; f < n_factors; f++)
+		set[f] = factors[f].only == 0 || factors[f].only == kind;
+
+	if (!parse)
+		fprintf(output, "run %s%ld\n", prefix, i + 1);
+	for (k = 0; k < n_base_lines; k++)
+		if (base_factor[k] == JOB_LINE) {
+			if (!parse)
+				fprintf(output, "%s\n", base_lines[k]);
+		} else if (base_factor[k] < 0 || !set[base_factor[k]])
+			fprintf(output, "%s\n", base_lines[k]);
+	for (f = 0, fp = factors; f < n_factors; f++, fp++) {
+		if (!set[f])
+			continue;
+		fprintf(output, "%s\t", fp->ip->name);
+		if (fp->kind == RANGE)
+			fprintf(output, "%.10g", fp->lo +
+				u[fp->dimension] * (fp->hi - fp->lo));
+		else {
+			k = u[fp->dimension] * fp->n_levels;
+			fprintf(output, "%s",
+				fp->levels[k < fp->n_levels? k:
+				fp->n_levels - 1]);
+		}
+		fprintf(output, "%s%s\n", *fp->unit? " ": "", fp->unit);
+	}
+	if (!parse)
+		fprintf(output, "---\n");
+}
+
+/*
+ * Write the decks of the experiment in specfile, with the design read
+ * from input, on output.
+ */
+void
+doe(char *specfile, FILE *input, FILE *output)
+{
+	FILE *decks, *deck;
+	char *base, *fuel_name, *text, *body;
+	size_t size, body_size;
+	double *u;
+	long i;
+
+	spec_read(specfile);
+	base = base_read(input);
+	fuel_name = base_fuel();
+	u = sample();
+
+	/* parse each deck, so a bad one stops the experiment here */
+	decks = open_memstream(&text, &size);
+	if (!decks) {
+		fprintf(stderr, "%s: cannot malloc the decks\n", myname);
+		error_exit(1);
+	}
+	for (i = 0; i < n_samples; i++) {
+		if (!(deck = open_memstream(&body, &body_size))) {
+			fprintf(stderr, "%s: cannot malloc a deck\n", myname);
+			error_exit(1);
+		}
+		write_deck(deck, i, u + i * n_dimensions, fuel_name, 1);
+		fclose(deck);
+		design_defaults();
+		design_parse_text(body);
+		free(body);
+		write_deck(decks, i, u + i * n_dimensions, fuel_name, 0);
+	}
+	fclose(decks);
+	free(u);
+
+	fwrite(text, 1, size, output);
+	fflush(output);
+	free(text);
+	free(base);
+}
@@ -0,0 +1,160 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Dual number arithmetic.
+ *
+ * See dual.h.
+ */
+
+#include <math.h>
+#include "dual.h"
+
+/*
+ * A constant: all derivatives are zero.
+ */
+struct dual_s
+dual_const(double v)
+{
+	int i;
+	struct dual_s r;
+
+	r.v = v;
+	for (i = 0; i < DUAL_N; i++)
+		r.d[i] = 0.;
+	return r;
+}
+
+/*
+ * Independent variable i.
+ */
+struct dual_s
+dual_var(double v, int i)
+{
+	struct dual_s r;
+
+	r = dual_const(v);
+	r.d[i] = 1.;
+	return r;
+}
+
+/*
+ * f(x), given v = f(x.v) and slope = f'(x.v).
+ * Used for table lookups.
+ */
+struct dual_s
+dual_chain(double v, double slope, struct dual_s x)
+{
+	int i;
+	struct dual_s r;
+
+	r.v = v;
+	for (i = 0; i < DUAL_N; i++)
+		r.d[i] = slope * x.d[i];
+	return r;
+}
+
+struct dual_s
+dual_add(struct dual_s a, struct dual_s b)
+{
+	int i;
+
+	a.v += b.v;
+	for (i = 0; i < DUAL_N; i++)
+		a.d[i] += b.d[i];
+	return a;
+}
+
+struct dual_s
+dual_sub(struct dual_s a, struct dual_s b)
+{
+	int i;
+
+	a.v -= b.v;
+	for (i = 0; i < DUAL_N; i++)
+		a.d[i] -= b.d[i];
+	return a;
+}
+
+struct dual_s
+dual_mul(struct dual_s a, struct dual_s b)
+{
+	int i;
+	struct dual_s r;
+
+	r.v = a.v * b.v;
+	for (i = 0; i < DUAL_N; i++)
+		r.d[i] = a.d[i] * b.v + a.v * b.d[i];
+	return r;
+}
+
+struct dual_s
+dual_div(struct dual_s a, struct dual_s b)
+{
+	int i;
+	struct dual_s r;
+
+	r.v = a.v / b.v;
+	for (i = 0; i < DUAL_N; i++)
+		r.d[i] = (a.d[i] - r.v * b.d[i]) / b.v;
+	return r;
+}
+
+struct dual_s
+dual_scale(struct dual_s a, double k)
+{
+	int i;
+
+	a.v *= k;
+	for (i = 0; i < DUAL_N; i++)
+		a.d[i] *= k;
+	return a;
+}
+
+struct dual_s
+dual_sqrt(struct dual_s a)
+{
+	double v;
+
+	v = sqrt(a.v);
+	return dual_chain(v, v > 0.? .5 / v: 0., a);
+}
+
+/*
+ * a ** b, for positive a.
+ */
+struct dual_s
+dual_pow(struct dual_s a, struct dual_s b)
+{
+	int i;
+	double v, lna;
+	struct dual_s r;
+
+	v = pow(a.v, b.v);
+	lna = log(a.v);
+	r.v = v;
+	for (i = 0; i < DUAL_N; i++)
+		r.d[i] = v * (b.v * a.d[i] / a.v + lna * b.d[i]);
+	return r;
+}
+
+struct dual_s
+dual_cos(struct dual_s a)
+{
+	return dual_chain(cos(a.v), -sin(a.v), a);
+}
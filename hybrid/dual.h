@@ -0,0 +1,45 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Dual numbers for forward-mode differentiation.
+ *
+ * A dual number carries a value and its derivatives with respect to
+ * DUAL_N independent variables.  The arithmetic below propagates the
+ * derivatives by the chain rule, so any formula written with these
+ * routines yields its exact derivatives along with its value.
+ */
+
+#define	DUAL_N	24
+
+struct dual_s {
+	double v;		/* value */
+	double d[DUAL_N];	/* d value / d variable i */
+};
+
+struct dual_s dual_const(double v);
+struct dual_s dual_var(double v, int i);
+struct dual_s dual_chain(double v, double slope, struct dual_s x);
+struct dual_s dual_add(struct dual_s a, struct dual_s b);
+struct dual_s dual_sub(struct dual_s a, struct dual_s b);
+struct dual_s dual_mul(struct dual_s a, struct dual_s b);
+struct dual_s dual_div(struct dual_s a, struct dual_s b);
+struct dual_s dual_scale(struct dual_s a, double k);
+struct dual_s dual_sqrt(struct dual_s a);
+struct dual_s dual_pow(struct dual_s a, struct dual_s b);
+struct dual_s dual_cos(struct dual_s a);
@@ -0,0 +1,303 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+
+/*
+ * Engine Map
+ *
+ * For a given fuel, nozzle and injector the converged chamber pressure
+ * is a function of only a few state variables:
+ *	tank_pressure and n2o_liquid_density
+ *	grain_core		(hybrid)
+ *	nitrogen_pressure	(liquid)
+ *
+ * The tank is always on the saturation curve, so tank_pressure and
+ * n2o_liquid_density are both functions of tank_temperature.  The map
+ * is therefore a 2-D grid over tank temperature and grain core (or
+ * nitrogen pressure).  Both axes are uniform, so finding the cell
+ * is just arithmetic.
+ *
+ * engine_map_build() samples chamber_converge() at every grid node
+ * before the run.  engine_map_lookup() interpolates the chamber pressure,
+ * polishes it with a couple of passes through the injector, fuel and
+ * cpropep models, and accepts the result if it satisfies the chamber
+ * equation to within MAP_TOLERANCE.  Otherwise, or when the state is
+ * outside the map, it returns false and the caller does the full solve.
+ *
+ * DYNAMIC INPUTS:
+ *	tank_temperature	(from the tank model)
+ *	fuel_mass		(hybrid)
+ *	nitrogen_pressure	(liquid)
+ *
+ * OUTPUTS:
+ *	Same as one pass through the chamber convergence loop.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "state.h"
+#include "linkage.h"
+
+extern char *myname;
+
+#define	MAP_NT		64	/* temperature nodes */
+#define	MAP_NX		32	/* grain core or nitrogen pressure nodes */
+#define	MAP_TOLERANCE	(1e-6)	/* relative chamber equation residual */
+#define	MAP_SECANT_STEPS 4
+#define	MAP_WINDOW	0.01	/* secant steps stay this close to the map */
+
+#define	IN_WINDOW(x, cp)	(fabs((x) - (cp)) <= MAP_WINDOW * (cp))
+
+static int map_valid;
+static double t_min, t_step;
+static double x_min, x_step;
+static double map_cp[MAP_NT][MAP_NX];	/* NAN where the solve failed */
+
+static int n_lookups;
+static int n_misses;
+
+/*
+ * The second map coordinate for the current state.
+ * Grain core is computed the same way fuel_regression() does it.
+ */
+static double
+map_x()
+{
+	double a1, a2;
+
+	if (sim_type == LIQUID)
+		return nitrogen_pressure;
+
+	a1 = fuel_mass / fuel_density / grain_length;
+	a2 = pi/4. * grain_diameter * grain_diameter - a1;
+	if (a2 < 0.)
+		return -1.;
+	return sqrt(a2 / (pi/4.));
+}
+
+/*
+ * Run the chamber model once at pressure cp.
+ * Returns the difference between the pressure the nozzle supports
+ * at the resulting flow and cp.
+ */
+static double
+chamber_residual(double cp)
+{
+	chamber_pressure = cp;
+	injector();
+	if (sim_type == LIQUID)
+		liquid_injector();
+	else
+		fuel_regression();
+	cpropep();
+
+	return c_star * combustion_efficiency *
+		(n2o_flow_rate + fuel_flow_rate) / nozzle_throat_area - cp;
+}
+
+/*
+ * Set the state so that the chamber model sees node (i, j).
+ */
+static void
+map_set_node(int i, int j)
+{
+	double x;
+
+	tank_temperature = t_min + i * t_step;
+	n2o_thermo_error = 0;
+	tank_pressure = saturation_pressure(tank_temperature);
+	n2o_liquid_density = liquid_density(tank_temperature);
+
+	x = x_min + j * x_step;
+	if (sim_type == LIQUID)
+		nitrogen_pressure = x;
+	else
+		fuel_mass = fuel_density * pi / 4. * grain_length *
+			(grain_diameter * grain_diameter - x * x);
+}
+
+/*
+ * Sample the chamber state over the range of the run.
+ * Must be called after the tank has been filled.
+ */
+void
+engine_map_build()
+{
+	int i, j;
+	int n_bad;
+	double t_max, t_low, x_max;
+	double save_temp, save_fuel_mass, save_n2_pressure, save_cp;
+	double guess_cp;
+
+	map_valid = 0;
+	if (dry_fire)
+		return;
+
+	save_temp = tank_temperature;
+	save_fuel_mass = fuel_mass;
+	save_n2_pressure = nitrogen_pressure;
+	save_cp = chamber_pressure;
+
+	/*
+	 * The tank only cools during the burn, and the run stops
+	 * when the tank pressure falls below 2 atmospheres.
+	 */
+	t_max = tank_temperature + 0.5;
+	t_low = temp_from_pressure(2 * atmosphere_pressure);
+	n2o_thermo_error = 0;
+	t_min = t_low;
+	t_step = (t_max - t_min) / (MAP_NT - 1);
+
+	if (sim_type == LIQUID) {
+		x_min = 1.5 * atmosphere_pressure;
+		x_max = nitrogen_pressure_initial;
+	} else {
+		x_min = grain_init_core;
+		x_max = grain_diameter;
+	}
+	x_step = (x_max - x_min) / (MAP_NX - 1);
+
+	/*
+	 * Walk from the hot end so that each solve starts
+	 * from the converged pressure of its neighbour.
+	 */
+	n_bad = 0;
+	guess_cp = save_cp;
+	for (j = 0; j < MAP_NX; j++) {
+		chamber_pressure = guess_cp;
+		for (i = MAP_NT - 1; i >= 0; i--) {
+			map_set_node(i, j);
+			if (n2o_thermo_error || chamber_converge() < 0 ||
+			    chamber_pressure < 2 * atmosphere_pressure ||
+			    tank_pressure - chamber_pressure <=
+			    		atmosphere_pressure) {
+				map_cp[i][j] = NAN;
+				chamber_pressure = save_cp;
+				n_bad++;
+				continue;
+			}
+			map_cp[i][j] = chamber_pressure;
+			if (i == MAP_NT - 1)
+				guess_cp = chamber_pressure;
+		}
+	}
+
+	tank_temperature = save_temp;
+	fuel_mass = save_fuel_mass;
+	nitrogen_pressure = save_n2_pressure;
+	chamber_pressure = save_cp;
+	tank();
+
+	if (n_bad == MAP_NT * MAP_NX) {
+		fprintf(stderr, "%s: Warning: engine map is empty, "
+				"using the full chamber solution\n",
+			myname);
+		return;
+	}
+	map_valid = 1;
+	n_lookups = 0;
+	n_misses = 0;
+}
+
+/*
+ * Try to find the chamber state from the map.
+ * Returns true if the chamber state has been set.
+ */
+int
+engine_map_lookup()
+{
+	int i, j, k;
+	double t, u;
+	double x;
+	double cp, start_cp;
+	double x0, x1, x2, g0, g1;
+
+	if (!map_valid)
+		return 0;
+	n_lookups++;
+	start_cp = chamber_pressure;
+
+	t = (tank_temperature - t_min) / t_step;
+	x = map_x();
+	u = (x - x_min) / x_step;
+	if (t < 0. || u < 0. || t > MAP_NT - 1 || u > MAP_NX - 1)
+		goto miss;
+
+	i = t;
+	j = u;
+	if (i >= MAP_NT - 1)
+		i = MAP_NT - 2;
+	if (j >= MAP_NX - 1)
+		j = MAP_NX - 2;
+	t -= i;
+	u -= j;
+
+	cp = (1 - t) * (1 - u) * map_cp[i][j] +
+		t * (1 - u) * map_cp[i+1][j] +
+		t * u * map_cp[i+1][j+1] +
+		(1 - t) * u * map_cp[i][j+1];
+	if (isnan(cp))
+		goto miss;
+
+	/*
+	 * The chamber equation can have more than one root.  The run
+	 * follows whichever branch it started on, so the map is only
+	 * trusted when it agrees with the previous time step.
+	 */
+	if (!IN_WINDOW(start_cp, cp))
+		goto miss;
+
+	/*
+	 * The interpolated pressure is close, but not close enough to use
+	 * directly.  Polish it with a few secant steps on the chamber
+	 * equation, which is much cheaper than the bracketing solve.
+	 * The first step is a plain fixed point iteration.
+	 */
+	x0 = cp;
+	g0 = chamber_residual(x0);
+	if (fabs(g0) <= MAP_TOLERANCE * x0)
+		return 1;
+	x1 = x0 + g0;
+	for (k = 0; k < MAP_SECANT_STEPS && IN_WINDOW(x1, cp); k++) {
+		g1 = chamber_residual(x1);
+		if (fabs(g1) <= MAP_TOLERANCE * x1)
+			return 1;
+		if (g1 == g0)
+			break;
+		x2 = x1 - g1 * (x1 - x0) / (g1 - g0);
+		x0 = x1;
+		g0 = g1;
+		x1 = x2;
+	}
+	chamber_pressure = start_cp;	/* so the full solve is unchanged */
+
+    miss:
+	n_misses++;
+	return 0;
+}
+
+void
+engine_map_stats(FILE *output)
+{
+	if (!map_valid)
+		return;
+
+	fprintf(output, "%s: engine map: %d lookups, %d full solves\n",
+		myname, n_lookups, n_misses);
+}
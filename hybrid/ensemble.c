@@ -0,0 +1,804 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Monte Carlo Ensembles
+ *
+ * Runs the design many times with some of the input parameters
+ * drawn at random, and summarizes the spread of the results:
+ * percentile bands of thrust and chamber pressure over time,
+ * and histograms of total impulse and burn time.
+ *
+ * The ensemble is described by a spec file:
+ *
+ *	members		200
+ *	seed		12345
+ *	workers		4
+ *	bin		.05 sec
+ *	span		6 sec
+ *	percentiles	5 50 95
+ *	buckets		20
+ *	lanes		on
+ *	injectorcd	normal	.7 .02
+ *	filltemp	uniform	65 85 F
+ *
+ * Any numeric design parameter may be dispersed.  Normal distributions
+ * take a mean and a standard deviation, uniform distributions take the
+ * limits.  The unit, if any, is the last word as in the design file.
+ *
+ * Every member draws from its own random stream, seeded from the
+ * ensemble seed and the member number, so the results do not depend
+ * on the number of workers.
+ *
+ * The model keeps its state in globals, so each member runs in a
+ * forked child.  The tables are loaded by the nominal run before the
+ * first fork and are shared with the children.
+ *
+ * The results are kept in sketches (see sketch.h), so the memory used
+ * does not grow with the number of members.  There is one set of
+ * sketches, in shared memory, for each worker slot.  Only one child
+ * uses a slot at a time, and the slots are merged at the end.
+ *
+ * Hybrid ensembles that do not disperse the nozzle run in the lanes
+ * engine (see lanes.h) unless "lanes off" is given.  Then each worker
+ * is one child that runs LANES members at a time, taking members from
+ * a queue shared by the workers.  Each member is still set up in a
+ * child of its own, so that a bad member only fails itself.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include "scio.h"
+#include "sketch.h"
+#include "linkage.h"
+#include "state.h"
+#include "design.h"
+#include "lanes.h"
+
+extern char *myname;
+
+#define	MAX_DISPERSED	32
+#define	MAX_PERCENTILES	16
+#define	MAX_BINS	4096
+
+#define	NORMAL		1
+#define	UNIFORM		2
+
+
+/*
+ * The time series kept for each bin.
+ */
+#define	THRUST		0
+#define	CHAMBER_PRESSURE 1
+#define	TANK_PRESSURE	2
+#define	OF_RATIO	3
+#define	N_SERIES	4
+
+static char *series_name[N_SERIES] = {
+	"thrust",
+	"chamber pressure",
+	"tank pressure",
+	"o/f",
+};
+
+/*
+ * The per-member totals.
+ */
+#define	IMPULSE		0
+#define	BURN_TIME	1
+#define	PEAK_THRUST	2
+#define	PEAK_PRESSURE	3
+#define	N_TOTALS	4
+
+static char *total_name[N_TOTALS] = {
+	"impulse",
+	"burn time",
+	"peak thrust",
+	"peak chamber pressure",
+};
+
+struct dispersion_s {
+	struct scio_input_parameter_s *ip;
+	int distribution;	/* NORMAL or UNIFORM */
+	double a, b;		/* mean and sd, or low and high limits */
+};
+
+/*
+ * A worker slot, in shared memory.
+ * It is followed by N_SERIES sketches for each time bin.
+ */
+struct slot_s {
+	int done;		/* members finished */
+	int warned;		/* of those, members with warnings */
+	struct sketch_s total[N_TOTALS];
+};
+
+/*
+ * The spec.
+ */
+static int n_members;
+static unsigned long long seed;
+static int n_workers;
+static double bin_width;
+static double span;
+static int n_percentiles;
+static double percentile[MAX_PERCENTILES];
+static int n_buckets;
+static int n_dispersed;
+static struct dispersion_s dispersed[MAX_DISPERSED];
+static int use_lanes;
+
+static int n_bins;
+static char *slots;
+static size_t slot_size;
+
+#define	SLOT(w)		((struct slot_s *)(slots + (w) * slot_size))
+#define	BIN(w, i, s)	((struct sketch_s *)(SLOT(w) + 1) + (i) * N_SERIES + (s))
+
+/*
+ * Accumulated during a run, for each lane.  Scalar runs use lane 0.
+ * Each bin holds sums for the mean over the bin.
+ */
+static double run_total[LANES][N_TOTALS];
+static double run_sum[LANES][MAX_BINS][N_SERIES];
+static int run_count[LANES][MAX_BINS][N_SERIES];
+
+/*
+ * The lanes workers.
+ */
+static int *next_member;		/* shared by the workers */
+static int worker;
+static struct lane_design_s *member_design;	/* shared with set up */
+
+
+/*
+ * The random streams, design_random(); uniform on (0, 1].
+ */
+static double
+uniform_random(unsigned long long *state)
+{
+	return ((design_random(state) >> 11) + 1) * (1. / 9007199254740992.);
+}
+
+/* Box-Muller; the second value is thrown away */
+static double
+normal_random(unsigned long long *state)
+{
+	double u1, u2;
+
+	u1 = uniform_random(state);
+	u2 = uniform_random(state);
+	return sqrt(-2. * log(u1)) * cos(2. * pi * u2);
+}
+
+/*
+ * Read a dispersion line: <parameter> normal|uniform a b [unit]
+ */
+static void
+spec_dispersion(char **words, int n, int line, int *errors)
+{
+	struct scio_input_parameter_s *ip;
+	struct dispersion_s *dp;
+	double a, b, zero;
+
+	ip = design_parameter(words[0]);
+	if (!ip) {
+		fprintf(stderr, "%s: ensemble line %d: unknown keyword or "
+				"parameter %s\n", myname, line, words[0]);
+		(*errors)++;
+		return;
+	}
+	if (ip->unit == STRING) {
+		fprintf(stderr, "%s: ensemble line %d: %s cannot be "
+				"dispersed\n", myname, line, words[0]);
+		(*errors)++;
+		return;
+	}
+	if (n_dispersed >= MAX_DISPERSED) {
+		fprintf(stderr, "%s: ensemble line %d: more than %d "
+				"dispersed parameters\n",
+			myname, line, MAX_DISPERSED);
+		(*errors)++;
+		return;
+	}
+	if (n != (ip->unit == NUMBER? 4: 5)) {
+		fprintf(stderr, "%s: ensemble line %d: expected "
+				"%s normal|uniform <value> <value>%s\n",
+			myname, line, words[0],
+			ip->unit == NUMBER? "": " <unit>");
+		(*errors)++;
+		return;
+	}
+
+	dp = dispersed + n_dispersed;
+	dp->ip = ip;
+	if (strcasecmp(words[1], "normal") == 0)
+		dp->distribution = NORMAL;
+	else if (strcasecmp(words[1], "uniform") == 0)
+		dp->distribution = UNIFORM;
+	else {
+		fprintf(stderr, "%s: ensemble line %d: unknown "
+				"distribution %s\n", myname, line, words[1]);
+		(*errors)++;
+		return;
+	}
+
+	a = design_spec_number("ensemble", words[2], line, errors);
+	b = design_spec_number("ensemble", words[3], line, errors);
+	if (ip->unit != NUMBER) {
+		/*
+		 * A standard deviation is a difference,
+		 * so it is scaled but not offset.
+		 */
+		zero = scio_f_convert(0., ip->unit, words[4]);
+		a = scio_f_convert(a, ip->unit, words[4]);
+		if (dp->distribution == NORMAL)
+			b = scio_f_convert(b, ip->unit, words[4]) - zero;
+		else
+			b = scio_f_convert(b, ip->unit, words[4]);
+	}
+	if ((dp->distribution == NORMAL && b < 0.) ||
+	    (dp->distribution == UNIFORM && b < a)) {
+		fprintf(stderr, "%s: ensemble line %d: bad range for %s\n",
+			myname, line, words[0]);
+		(*errors)++;
+		return;
+	}
+	dp->a = a;
+	dp->b = b;
+	n_dispersed++;
+}
+
+/*
+ * A line of the ensemble file.
+ */
+static void
+spec_line(char **words, int n, int line, int *errors)
+{
+	if (strcasecmp(words[0], "members") == 0 && n == 2)
+		n_members = design_spec_number("ensemble", words[1],
+			line, errors);
+	else if (strcasecmp(words[0], "seed") == 0 && n == 2)
+		seed = strtoull(words[1], NULL, 0);
+	else if (strcasecmp(words[0], "workers") == 0 && n == 2)
+		n_workers = design_spec_number("ensemble", words[1],
+			line, errors);
+	else if (strcasecmp(words[0], "bin") == 0 && n == 3)
+		bin_width = scio_f_convert(design_spec_number("ensemble",
+			words[1], line, errors), TIME, words[2]);
+	else if (strcasecmp(words[0], "span") == 0 && n == 3)
+		span = scio_f_convert(design_spec_number("ensemble",
+			words[1], line, errors), TIME, words[2]);
+	else if (strcasecmp(words[0], "buckets") == 0 && n == 2)
+		n_buckets = design_spec_number("ensemble", words[1],
+			line, errors);
+	else if (strcasecmp(words[0], "lanes") == 0 && n == 2)
+		use_lanes = strcasecmp(words[1], "off") != 0;
+	else if (strcasecmp(words[0], "percentiles") == 0) {
+		if (n - 1 > MAX_PERCENTILES) {
+			fprintf(stderr, "%s: ensemble line %d: more "
+					"than %d percentiles\n",
+				myname, line, MAX_PERCENTILES);
+			(*errors)++;
+			return;
+		}
+		for (n_percentiles = 0; n_percentiles < n - 1;
+		     n_percentiles++) {
+			percentile[n_percentiles] = design_spec_number(
+				"ensemble", words[n_percentiles + 1],
+				line, errors);
+			if (percentile[n_percentiles] < 0. ||
+			    percentile[n_percentiles] > 100.) {
+				fprintf(stderr, "%s: ensemble line %d: "
+					"percentiles are 0 to 100\n",
+					myname, line);
+				(*errors)++;
+			}
+		}
+	} else
+		spec_dispersion(words, n, line, errors);
+}
+
+static void
+spec_read(char *specfile)
+{
+	int errors;
+
+	n_members = 100;
+	seed = 1;
+	n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	bin_width = .05;
+	span = 0.;
+	n_percentiles = 3;
+	percentile[0] = 5.;
+	percentile[1] = 50.;
+	percentile[2] = 95.;
+	n_buckets = 20;
+	n_dispersed = 0;
+	use_lanes = 1;
+
+	errors = design_spec_read("ensemble", specfile, spec_line);
+
+	if (n_members < 1 || n_workers < 1 || n_buckets < 1 ||
+	    bin_width <= 0. || span < 0.) {
+		fprintf(stderr, "%s: ensemble members, workers, buckets "
+				"and bin must be positive\n", myname);
+		errors++;
+	}
+	if (errors) {
+		fprintf(stderr, "%s: exiting on ensemble errors.\n", myname);
+		error_exit(1);
+	}
+}
+
+
+/*
+ * Add one step of a run in lane l.
+ */
+static void
+accumulate(int l, double time, double time_step, double f, double pc,
+	double tank_p, double n2o_flow, double fuel_flow)
+{
+	int i;
+	double *tp;
+
+	tp = run_total[l];
+	tp[IMPULSE] += f * time_step;
+	tp[BURN_TIME] = time + time_step;
+	if (f > tp[PEAK_THRUST])
+		tp[PEAK_THRUST] = f;
+	if (pc > tp[PEAK_PRESSURE])
+		tp[PEAK_PRESSURE] = pc;
+
+	i = time / bin_width;
+	if (i >= n_bins)
+		return;
+	run_sum[l][i][THRUST] += f;
+	run_count[l][i][THRUST]++;
+	run_sum[l][i][CHAMBER_PRESSURE] += pc;
+	run_count[l][i][CHAMBER_PRESSURE]++;
+	run_sum[l][i][TANK_PRESSURE] += tank_p;
+	run_count[l][i][TANK_PRESSURE]++;
+	if (fuel_flow > 0.) {
+		run_sum[l][i][OF_RATIO] += n2o_flow / fuel_flow;
+		run_count[l][i][OF_RATIO]++;
+	}
+}
+
+static void
+clear(int l)
+{
+	memset(run_total[l], 0, sizeof run_total[l]);
+	memset(run_sum[l], 0, n_bins * sizeof run_sum[l][0]);
+	memset(run_count[l], 0, n_bins * sizeof run_count[l][0]);
+}
+
+/*
+ * Called at every time step of a scalar run.
+ */
+static void
+ensemble_record()
+{
+	accumulate(0, sim_time, sim_time_step, thrust, chamber_pressure,
+		tank_pressure, n2o_flow_rate, fuel_flow_rate);
+}
+
+/*
+ * Set up the design with member m's parameters.
+ * Member -1 is the nominal design.
+ */
+static void
+member_setup(int m)
+{
+	int i;
+	unsigned long long state;
+	struct dispersion_s *dp;
+	double v;
+
+	design_restore();
+	if (m >= 0) {
+		state = seed + (unsigned long long)m * 0xd1b54a32d192ed03ULL;
+		for (i = 0, dp = dispersed; i < n_dispersed; i++, dp++) {
+			if (dp->distribution == NORMAL)
+				v = dp->a + dp->b * normal_random(&state);
+			else
+				v = dp->a + (dp->b - dp->a) *
+					uniform_random(&state);
+			*(double *)(dp->ip->vp) = v;
+			*(dp->ip->nvp) = 1;
+		}
+	}
+
+	design_setup();
+	sim_init();
+	design_fill();
+}
+
+/*
+ * Run the design once, with member m's parameters.
+ */
+static void
+run_member(int m)
+{
+	member_setup(m);
+
+	clear(0);
+	record_data_hook(ensemble_record);
+	record_data_init(0., NULL);
+	if (sim_loop() != SIM_OK)
+		error_exit(1);
+	record_data_term();
+	record_data_hook(NULL);
+}
+
+/*
+ * Add the run in lane l to slot w.
+ * A member that burns out before the end of the span adds zero
+ * thrust and chamber pressure to the later bins; it adds nothing
+ * to the tank pressure or O/F.
+ */
+static void
+add_results(int l, int w, int warned)
+{
+	int i, s;
+	struct slot_s *sp;
+
+	sp = SLOT(w);
+	for (i = 0; i < N_TOTALS; i++)
+		sketch_add(&sp->total[i], run_total[l][i]);
+	for (i = 0; i < n_bins; i++)
+		for (s = 0; s < N_SERIES; s++)
+			if (run_count[l][i][s])
+				sketch_add(BIN(w, i, s),
+					run_sum[l][i][s] / run_count[l][i][s]);
+			else if (s == THRUST || s == CHAMBER_PRESSURE)
+				sketch_add(BIN(w, i, s), 0.);
+	if (warned)
+		sp->warned++;
+	sp->done++;
+}
+
+/*
+ * Run member m in a child, and add its results to slot w.
+ */
+static void
+child(int m, int w)
+{
+	run_member(m);
+	add_results(0, w, warn_n2o_flux || warn_core_throat_ratio == 1 ||
+		warn_injector_pressure || warn_supply_pressure);
+	_exit(0);
+}
+
+/*
+ * The lanes engine callbacks.
+ * Members that fail to set up are skipped, and count as failed.
+ */
+static int
+lanes_next(struct lane_design_s *dp)
+{
+	int m, status;
+	pid_t pid;
+
+	for (;;) {
+		m = __sync_fetch_and_add(next_member, 1);
+		if (m >= n_members)
+			return -1;
+
+		fflush(stderr);
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			continue;
+		}
+		if (pid == 0) {
+			member_setup(m);
+			lanes_capture(member_design);
+			_exit(0);
+		}
+		if (waitpid(pid, &status, 0) == pid &&
+		    WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+			*dp = *member_design;
+			return m;
+		}
+	}
+}
+
+static void
+lanes_record(int l, int m, struct lane_step_s *sp)
+{
+	accumulate(l, sp->time, sp->time_step, sp->thrust,
+		sp->chamber_pressure, sp->tank_pressure,
+		sp->n2o_flow_rate, sp->fuel_flow_rate);
+}
+
+static void
+lanes_finish(int l, int m, int status, int warned)
+{
+	if (status == LANE_DONE)
+		add_results(l, worker, warned);
+	clear(l);
+}
+
+/*
+ * A lanes worker, using slot w.
+ */
+static void
+lanes_child(int w)
+{
+	int l;
+
+	worker = w;
+	member_design = mmap(NULL, sizeof *member_design,
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (member_design == MAP_FAILED) {
+		perror("mmap");
+		_exit(1);
+	}
+	for (l = 0; l < LANES; l++)
+		clear(l);
+	lanes_run(lanes_next, lanes_record, lanes_finish);
+	_exit(0);
+}
+
+/*
+ * Histogram from the sketch, as an estimated member count per bucket.
+ */
+static void
+print_histogram(FILE *output, char *name, struct sketch_s *sp)
+{
+	int i;
+	double lo, hi, width;
+
+	fprintf(output, "SECTION,%s histogram\n", name);
+	fprintf(output, "low,high,members\n");
+	width = (sp->max - sp->min) / n_buckets;
+	for (i = 0; i < n_buckets; i++) {
+		lo = sp->min + i * width;
+		hi = i == n_buckets - 1? sp->max: lo + width;
+		fprintf(output, "%e,%e,%.0f\n", lo, hi, sp->count *
+			((i == n_buckets - 1? 1.: sketch_cdf(sp, hi)) -
+			 (i == 0? 0.: sketch_cdf(sp, lo))));
+	}
+	fprintf(output, "\n");
+}
+
+static void
+print_results(FILE *output, double nominal_impulse)
+{
+	int i, j, k, s;
+	struct slot_s *sp;
+	struct sketch_s *bp;
+
+	/*
+	 * Merge everything into slot 0.
+	 */
+	sp = SLOT(0);
+	for (i = 1; i < n_workers; i++) {
+		sp->done += SLOT(i)->done;
+		sp->warned += SLOT(i)->warned;
+		for (j = 0; j < N_TOTALS; j++)
+			sketch_merge(&sp->total[j], &SLOT(i)->total[j]);
+		for (j = 0; j < n_bins; j++)
+			for (s = 0; s < N_SERIES; s++)
+				sketch_merge(BIN(0, j, s), BIN(i, j, s));
+	}
+
+	fprintf(output, "SECTION,ensemble\n");
+	fprintf(output, "members,failed,warned,seed,workers,"
+			"nominal impulse,lanes\n");
+	fprintf(output, "%d,%d,%d,%llu,%d,%e,%d\n\n",
+		n_members, n_members - sp->done, sp->warned, seed, n_workers,
+		nominal_impulse, use_lanes? LANES: 1);
+
+	fprintf(output, "SECTION,dispersion\n");
+	fprintf(output, "Parameter,Distribution,A,B\n");
+	for (i = 0; i < n_dispersed; i++)
+		fprintf(output, "%s,%s,%e,%e\n", dispersed[i].ip->name,
+			dispersed[i].distribution == NORMAL?
+				"normal": "uniform",
+			dispersed[i].a, dispersed[i].b);
+	fprintf(output, "\n");
+
+	if (sp->done == 0) {
+		fprintf(stderr, "%s: every ensemble member failed\n",
+			myname);
+		return;
+	}
+
+	/*
+	 * Mean, standard deviation and percentiles, one bin per line.
+	 */
+	fprintf(output, "SECTION,percentiles\n");
+	fprintf(output, "time");
+	for (s = 0; s < N_SERIES; s++) {
+		fprintf(output, ",%s mean,%s sd",
+			series_name[s], series_name[s]);
+		for (k = 0; k < n_percentiles; k++)
+			fprintf(output, ",%s p%g",
+				series_name[s], percentile[k]);
+	}
+	fprintf(output, "\n");
+	for (j = 0; j < n_bins; j++) {
+		fprintf(output, "%f", (j + .5) * bin_width);
+		for (s = 0; s < N_SERIES; s++) {
+			bp = BIN(0, j, s);
+			fprintf(output, ",%f,%f", bp->mean, sketch_sd(bp));
+			for (k = 0; k < n_percentiles; k++)
+				fprintf(output, ",%f", sketch_quantile(bp,
+					percentile[k] / 100.));
+		}
+		fprintf(output, "\n");
+	}
+	fprintf(output, "END-OF-DATA\n\n");
+
+	print_histogram(output, "impulse", &sp->total[IMPULSE]);
+	print_histogram(output, "burn time", &sp->total[BURN_TIME]);
+
+	fprintf(output, "SECTION,summary\n");
+	fprintf(output, "Quantity,mean,sd,min");
+	for (k = 0; k < n_percentiles; k++)
+		fprintf(output, ",p%g", percentile[k]);
+	fprintf(output, ",max\n");
+	for (i = 0; i < N_TOTALS; i++) {
+		bp = &sp->total[i];
+		fprintf(output, "%s,%e,%e,%e", total_name[i],
+			bp->mean, sketch_sd(bp), bp->min);
+		for (k = 0; k < n_percentiles; k++)
+			fprintf(output, ",%e",
+				sketch_quantile(bp, percentile[k] / 100.));
+		fprintf(output, ",%e\n", bp->max);
+	}
+	fprintf(output, "\n");
+	fflush(output);
+}
+
+/*
+ * Run an ensemble.  The design must have been parsed.
+ */
+void
+ensemble(char *specfile, FILE *output)
+{
+	int m, w, i, s, running;
+	pid_t pid, *slot_pid;
+	double nominal_impulse;
+
+	spec_read(specfile);
+	design_save();
+
+	/*
+	 * The nominal run loads the tables and sets the span.
+	 */
+	n_bins = 0;
+	run_member(-1);
+	nominal_impulse = run_total[0][IMPULSE];
+	if (span == 0.)
+		span = 1.5 * run_total[0][BURN_TIME];
+	n_bins = ceil(span / bin_width);
+	if (n_bins > MAX_BINS) {
+		fprintf(stderr, "%s: ensemble span needs %d bins, "
+				"limit is %d\n", myname, n_bins, MAX_BINS);
+		error_exit(1);
+	}
+	if (n_workers > n_members)
+		n_workers = n_members;
+
+	slot_size = sizeof (struct slot_s) +
+		(size_t)n_bins * N_SERIES * sizeof (struct sketch_s);
+	slot_size = (slot_size + 15) & ~(size_t)15;
+	slots = mmap(NULL, n_workers * slot_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	slot_pid = (pid_t *)malloc(n_workers * sizeof (pid_t));
+	if (slots == MAP_FAILED || !slot_pid) {
+		fprintf(stderr, "%s: cannot allocate %d ensemble "
+				"workers\n", myname, n_workers);
+		error_exit(1);
+	}
+	for (w = 0; w < n_workers; w++) {
+		slot_pid[w] = 0;
+		for (i = 0; i < N_TOTALS; i++)
+			sketch_init(&SLOT(w)->total[i]);
+		for (i = 0; i < n_bins; i++)
+			for (s = 0; s < N_SERIES; s++)
+				sketch_init(BIN(w, i, s));
+	}
+
+	design_restore();
+	design_setup();
+	design_report(output);
+
+	/*
+	 * The lanes share the cpropep data, which is for one nozzle ratio.
+	 */
+	if (sim_type != HYBRID || dry_fire || use_engine_map)
+		use_lanes = 0;
+	for (i = 0; i < n_dispersed; i++)
+		if (strncasecmp(dispersed[i].ip->name, "nozzle", 6) == 0)
+			use_lanes = 0;
+
+	fflush(output);
+	fflush(stderr);
+	running = 0;
+	if (use_lanes) {
+		/*
+		 * One lanes worker in every slot.
+		 */
+		next_member = mmap(NULL, sizeof *next_member,
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+			-1, 0);
+		if (next_member == MAP_FAILED) {
+			perror("mmap");
+			error_exit(1);
+		}
+		*next_member = 0;
+		for (w = 0; w < n_workers; w++) {
+			pid = fork();
+			if (pid < 0) {
+				perror("fork");
+				break;
+			}
+			if (pid == 0)
+				lanes_child(w);
+			running++;
+		}
+		if (running == 0)
+			error_exit(1);
+		while (wait(NULL) > 0)
+			;
+		munmap(next_member, sizeof *next_member);
+	}
+
+	/*
+	 * Otherwise start a child in every free slot.
+	 */
+	for (m = 0; !use_lanes && (m < n_members || running > 0); ) {
+		for (w = 0; w < n_workers && m < n_members; w++) {
+			if (slot_pid[w])
+				continue;
+			pid = fork();
+			if (pid < 0) {
+				perror("fork");
+				if (running == 0)
+					error_exit(1);
+				break;
+			}
+			if (pid == 0)
+				child(m, w);
+			slot_pid[w] = pid;
+			running++;
+			m++;
+		}
+		pid = wait(NULL);
+		for (w = 0; w < n_workers; w++)
+			if (pid > 0 && slot_pid[w] == pid) {
+				slot_pid[w] = 0;
+				running--;
+			}
+	}
+
+	print_results(output, nominal_impulse);
+	munmap(slots, n_workers * slot_size);
+	free(slot_pid);
+}
@@ -23,11 +23,16 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <setjmp.h>
 #include "ts_parse.h"
 #include "scio.h"
 #include "linkage.h"
 #include "state.h"
 
+extern char *myname;
+
 void
 errors_init()
 {
@@ -35,9 +40,15 @@ errors_init()
 	warn_n2o_flux_value = .0;
 	warn_core_throat_ratio = 0;
 	warn_core_throat_ratio_value = WARN_CORE_THROAT_RATIO_2;
+	warn_injector_pressure = 0;
 	warn_injector_pressure_drop_value = 1e8;
+	warn_exit_pressure = 0;
+	warn_exit_pressure_value = WARN_EXIT_PRESSURE;
 	warn_supply_pressure = 0;
 	warn_negative_vent_to_fill = 0;
+	hard_constraint = 0;
+	sim_error = SIM_OK;
+	sim_error_message[0] = '\0';
 }
 
 void
@@ -100,9 +111,128 @@ print_errors(FILE *output)
 	}
 }
 
+/*
+ * The hard constraints by name, in HARD_ bit order.
+ */
+static char *hard_names[N_HARD] = {
+	"n2oflux",
+	"corethroat",
+	"injector",
+	"exitpressure",
+};
+
+/*
+ * Returns the HARD_ bits for a comma separated list of names, or
+ * "all", or -1 if one is not a constraint.
+ */
+int
+hard_parse(char *list)
+{
+	char *end;
+	int bits, i, n;
+
+	if (strcmp(list, "all") == 0)
+		return (1 << N_HARD) - 1;
+	for (bits = 0; *list; list = *end? end + 1: end) {
+		end = list + strcspn(list, ",");
+		n = end - list;
+		for (i = 0; i < N_HARD; i++)
+			if (strncmp(hard_names[i], list, n) == 0 &&
+			    hard_names[i][n] == '\0')
+				break;
+		if (i == N_HARD)
+			return -1;
+		bits |= 1 << i;
+	}
+	return bits;
+}
+
+/*
+ * The name of a HARD_ bit.
+ */
+char *
+hard_name(int bit)
+{
+	int i;
+
+	for (i = 0; i < N_HARD; i++)
+		if (bit == 1 << i)
+			return hard_names[i];
+	return "none";
+}
+
+/*
+ * The run broke a hard constraint.  Stops it the way sim_fail() does,
+ * with the constraint's name first in the message and the bit kept in
+ * hard_constraint.
+ */
+void
+hard_fail(int bit, char *format, ...)
+{
+	va_list ap;
+	char reason[200];
+
+	va_start(ap, format);
+	vsnprintf(reason, sizeof reason, format, ap);
+	va_end(ap);
+	hard_constraint = bit;
+	sim_fail(SIM_E_CONSTRAINT, "constraint %s at %.4f s: %s",
+		hard_name(bit), sim_time, reason);
+}
+
+static jmp_buf *recover;
+
+/*
+ * While jp is set, error_exit() goes back to it with longjmp()
+ * instead of exiting.  The simulation state is then only good for
+ * setting up another run.
+ * Returns the previous setting, to be put back.
+ */
+jmp_buf *
+error_recover(jmp_buf *jp)
+{
+	jmp_buf *old;
+
+	old = recover;
+	recover = jp;
+	return old;
+}
+
+/*
+ * Is a caller set to recover?  It then has the reason for a failure
+ * in sim_error_message, and the messages are left to it.
+ */
+int
+error_recovering()
+{
+	return recover != NULL;
+}
+
+/*
+ * The run cannot go on.  Keep the reason in sim_error and
+ * sim_error_message, report it on stderr unless a caller is set to
+ * recover, and leave through error_exit().
+ */
+void
+sim_fail(int code, char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	vsnprintf(sim_error_message, sizeof sim_error_message, format, ap);
+	va_end(ap);
+	sim_error = code;
+
+	if (!recover)
+		fprintf(stderr, "%s: %s\n", myname, sim_error_message);
+	error_exit(1);
+}
+
 void
 error_exit(int code)
 {
+	if (recover)
+		longjmp(*recover, code? code: 1);
 	fprintf(stderr, "\n\n");
 	exit(code);
 }
@@ -65,12 +65,11 @@ fuel_init()
 	struct fuel_data_s f;
 
 	if (sim_type != HYBRID) {
-		fprintf(stderr, "%s: INTERAL ERROR in fuel_init\n", myname);
-		exit(1);
+		sim_fail(SIM_E_INTERNAL, "INTERAL ERROR in fuel_init");
 	}
 
 	if (fuel_data(fuel, &f))
-		error_exit(1);
+		sim_fail(SIM_E_DATA, "no data for fuel %s", fuel);
 
     	fuel_n = f.fuel_n;
     	fuel_a = f.fuel_a;
@@ -100,9 +99,7 @@ fuel_regression()
 	 */
 	a2 = pi/4. * grain_diameter  * grain_diameter - a1;
 	if (a2 < 0.) {
-		fprintf(stderr, "%s: fuel port shrank!\n",
-			myname);
-		error_exit(1);
+		sim_fail(SIM_E_FUEL_PORT, "fuel port shrank!");
 	}
 
 	/*
@@ -52,19 +52,28 @@ static char *columns[] ={
 #define	FUEL_DENSITY	4
 #define FUEL_CPROPEP	5
 
-int
-fuel_data(char *fuel_name, struct fuel_data_s *fp)
+/*
+ * The file is read once, on the first call.
+ */
+#define	MAX_FUELS	64
+
+static struct {
+	char name[32];
+	struct fuel_data_s f;
+} fuels[MAX_FUELS];
+static int n_fuels = -1;	/* not read yet */
+
+/*
+ * Read the whole file.  Returns non-zero on error.
+ */
+static int
+load()
 {
 	int j;
 	FILE *input;
 	char buffer[256];
 	char *ptrs[NCOL];
-
-	if (!fuel_name) {
-		fprintf(stderr, "%s: no fuel specified\n",
-			myname);
-		return 1;
-	}
+	struct fuel_data_s *fp;
 
 	input = fopen(FUEL, "r");
 	if (input == NULL) {
@@ -77,6 +86,7 @@ fuel_data(char *fuel_name, struct fuel_data_s *fp)
 	if (csv_read(input, buffer, sizeof buffer, ptrs, NCOL) == 0) {
 		fprintf(stderr, "%s: data file %s is empty\n",
 			myname, FUEL);
+		fclose(input);
 		return 1;
 	}
 
@@ -86,7 +96,8 @@ fuel_data(char *fuel_name, struct fuel_data_s *fp)
 					"Column %d is blank\n",
 					myname,
 					j + 1);
-			exit(1);
+			fclose(input);
+			return 1;
 		}
 				
 		if (strcmp(ptrs[j], columns[j]) != 0) {
@@ -96,27 +107,49 @@ fuel_data(char *fuel_name, struct fuel_data_s *fp)
 		    fprintf(stderr, "\tExpected \'%s\' got \'%s\' "
 					"in column %d\n",
 			columns[j], ptrs[j], j);
+		    fclose(input);
 		    return 1;
 		}
 	}
 
-	while (csv_read(input, buffer, sizeof buffer, ptrs, NCOL))
-		if (strcasecmp(ptrs[0], fuel_name) == 0)
-			goto found;
-
-	/* The supplied fuel is not a solid fuel */
-	fclose(input);
-	return 2;
-
-    found:
-	fclose(input);
-	if (fp) {
+	n_fuels = 0;
+	while (csv_read(input, buffer, sizeof buffer, ptrs, NCOL) &&
+	       n_fuels < MAX_FUELS) {
+		strncpy(fuels[n_fuels].name, ptrs[FUEL_NAME],
+			sizeof fuels[0].name - 1);
+		fp = &fuels[n_fuels].f;
 		fp->fuel_n = atof(ptrs[FUEL_N]);
 		fp->fuel_a = atof(ptrs[FUEL_A]);
 		fp->fuel_k = atof(ptrs[FUEL_K]);
 		fp->fuel_density = atof(ptrs[FUEL_DENSITY]);
 		fp->cpropep = atoi(ptrs[FUEL_CPROPEP]);
+		n_fuels++;
 	}
-
+	fclose(input);
 	return 0;
 }
+
+int
+fuel_data(char *fuel_name, struct fuel_data_s *fp)
+{
+	int i;
+
+	if (!fuel_name) {
+		fprintf(stderr, "%s: no fuel specified\n",
+			myname);
+		return 1;
+	}
+
+	if (n_fuels < 0 && load())
+		return 1;
+
+	for (i = 0; i < n_fuels; i++)
+		if (strcasecmp(fuels[i].name, fuel_name) == 0) {
+			if (fp)
+				*fp = fuels[i].f;
+			return 0;
+		}
+
+	/* The supplied fuel is not a solid fuel */
+	return 2;
+}
@@ -0,0 +1,644 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * The simulator as a library.  See hsim.h.
+ *
+ * hsim_run() sets the design up through the same table the input
+ * file is read into, runs it with a record_data() hook that turns the
+ * state into rows, and summarises the rows with the report program's
+ * statistics, report_stats.c.  A design that cannot be simulated
+ * comes back from sim_loop(), or from sim_fail() while it is set up,
+ * with one of the SIM_E_* codes, which are the same numbers as the
+ * HSIM_E* codes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <setjmp.h>
+#include "scio.h"
+#include "linkage.h"
+#include "state.h"
+#include "design.h"
+#include "hsim.h"
+#include "report_stats.h"
+
+/*
+ * The parameters, by their place in struct hsim_params_s.
+ */
+#define	P(f)	offsetof(struct hsim_params_s, f)
+
+static struct param_field_s {
+	char	*name;
+	size_t	offset;
+} param_fields[] = {
+	{ "tankheight",		P(tankheight),		},
+	{ "ullageheight",	P(ullageheight),	},
+	{ "tankdia",		P(tankdia),		},
+	{ "grainlength",	P(grainlength),		},
+	{ "graindiameter",	P(graindiameter),	},
+	{ "graincore",		P(graincore),		},
+	{ "nozzlethroat",	P(nozzlethroat),	},
+	{ "nozzleexit",		P(nozzleexit),		},
+	{ "nozzleratio",	P(nozzleratio),		},
+	{ "nozcfadj",		P(nozcfadj),		},
+	{ "nozhalfangle",	P(nozhalfangle),	},
+	{ "cstaradj",		P(cstaradj),		},
+	{ "injectordia",	P(injectordia),		},
+	{ "injectorcd",		P(injectorcd),		},
+	{ "injectorcount",	P(injectorcount),	},
+	{ "ventdia",		P(ventdia),		},
+	{ "ventcd",		P(ventcd),		},
+	{ "timestep",		P(timestep),		},
+	{ "filltemp",		P(filltemp),		},
+	{ "filldrop",		P(filldrop),		},
+	{ "fillpress",		P(fillpress),		},
+	{ "drymass",		P(drymass),		},
+	{ "ambientpressure",	P(ambientpressure),	},
+	{ "fuelinjectorid",	P(fuelinjectorid),	},
+	{ "fuelinjectorod",	P(fuelinjectorod),	},
+	{ "fuelinjectordia",	P(fuelinjectordia),	},
+	{ "fuelinjectorcount",	P(fuelinjectorcount),	},
+	{ "fuelinjectorcd",	P(fuelinjectorcd),	},
+	{ "fueltankvolume",	P(fueltankvolume),	},
+	{ "fuelmass",		P(fuelmass),		},
+	{ "fuelvolume",		P(fuelvolume),		},
+	{ "nitrogenpressure",	P(nitrogenpressure),	},
+};
+
+#define	PARAM(pp, i)	((double *)((char *)(pp) + param_fields[i].offset))
+
+#define	N_PARAMS	(sizeof (param_fields) / sizeof (param_fields[0]))
+
+/* the run in progress */
+static const struct hsim_options_s *options;
+static struct hsim_result_s *result;
+static int rows_size;
+static int out_of_memory;
+
+/* the summary, kept as the report program keeps it */
+static struct report_s report;
+
+void
+hsim_params_init(struct hsim_params_s *pp)
+{
+	int i;
+
+	pp->fuel = NULL;
+	for (i = 0; i < N_PARAMS; i++)
+		*PARAM(pp, i) = HSIM_UNSET;
+}
+
+void
+hsim_options_init(struct hsim_options_s *op)
+{
+	memset(op, 0, sizeof *op);
+}
+
+const char *
+hsim_strerror(int status)
+{
+	switch (status) {
+	    case HSIM_OK:
+		return "no error";
+	    case HSIM_EINPUT:
+		return "bad design parameters";
+	    case HSIM_EDATA:
+		return "missing or bad data file";
+	    case HSIM_ETANK_HOT:
+		return "N2O tank too hot";
+	    case HSIM_ETANK_COLD:
+		return "N2O tank too cold";
+	    case HSIM_ETANK_CONVERGE:
+		return "tank solution did not converge";
+	    case HSIM_ECHAMBER_CONVERGE:
+		return "chamber solution did not converge";
+	    case HSIM_ECHAMBER_PRESSURE:
+		return "chamber pressure out of range";
+	    case HSIM_ECORE_THROAT:
+		return "grain core smaller than the throat";
+	    case HSIM_EFUEL_PORT:
+		return "fuel port burned through";
+	    case HSIM_ESYSTEM:
+		return "system error";
+	    case HSIM_EINTERNAL:
+		return "internal error";
+	    case HSIM_ENOMEM:
+		return "out of memory";
+	    case HSIM_ECONSTRAINT:
+		return "hard constraint broken";
+	}
+	return "unknown error";
+}
+
+void
+hsim_result_free(struct hsim_result_s *rp)
+{
+	free(rp->rows);
+	rp->rows = NULL;
+	rp->n_rows = 0;
+}
+
+/*
+ * Hand the parameters to the design.
+ */
+static void
+set_params(const struct hsim_params_s *pp)
+{
+	int i;
+	double v;
+	struct scio_input_parameter_s *ip;
+
+	design_defaults();
+	design_clear();
+	if (pp->fuel) {
+		ip = design_parameter("fuel");
+		*(char **)(ip->vp) = (char *)pp->fuel;
+		*(ip->nvp) = 1;
+	}
+	for (i = 0; i < N_PARAMS; i++) {
+		v = *PARAM(pp, i);
+		if (isnan(v))
+			continue;
+		ip = design_parameter(param_fields[i].name);
+		*(double *)(ip->vp) = v;
+		*(ip->nvp) = 1;
+	}
+	if ((i = design_check()) != 0)
+		sim_fail(SIM_E_INPUT, "%d required parameters missing", i);
+}
+
+static void
+range(struct hsim_range_s *rp, int column)
+{
+	rp->min = report.column_min[column];
+	rp->max = report.column_max[column];
+	rp->average = report_average(&report, column);
+}
+
+/*
+ * Fill in the summary from the report statistics.
+ */
+static void
+summary_term()
+{
+	struct hsim_summary_s *sp;
+	struct report_summary_s summary;
+	int fuel_mass_column;
+
+	sp = &result->summary;
+	sp->rows = report.nrow;
+	if (sp->rows == 0)
+		return;
+	report_summary(&report, &summary);
+	fuel_mass_column = sp->liquid? REPORT_LFUEL_MASS: REPORT_FUEL_MASS;
+
+	sp->init_tank_pressure = report.column_init[REPORT_TANK_PRESSURE];
+	sp->final_tank_pressure = report.column_final[REPORT_TANK_PRESSURE];
+	sp->init_tank_temperature =
+		report.column_init[REPORT_TANK_TEMPERATURE];
+	sp->final_tank_temperature =
+		report.column_final[REPORT_TANK_TEMPERATURE];
+	sp->init_n2o_mass = report.column_init[REPORT_TANK_N2O_MASS];
+	sp->final_n2o_mass = report.column_final[REPORT_TANK_N2O_MASS];
+	sp->init_n2o_liquid_mass = report.column_init[REPORT_N2O_LIQUID_MASS];
+	sp->final_n2o_liquid_mass =
+		report.column_final[REPORT_N2O_LIQUID_MASS];
+	sp->init_n2o_liquid_density =
+		report.column_init[REPORT_N2O_LIQUID_DENSITY];
+	sp->init_fuel_mass = report.column_init[fuel_mass_column];
+	sp->final_fuel_mass = report.column_final[fuel_mass_column];
+	sp->init_grain_core = report.column_init[REPORT_GRAIN_CORE];
+	sp->final_grain_core = report.column_final[REPORT_GRAIN_CORE];
+	sp->init_nitrogen_pressure = report.column_init[REPORT_LFUEL_PRESSURE];
+	sp->final_nitrogen_pressure =
+		report.column_final[REPORT_LFUEL_PRESSURE];
+
+	range(&sp->grain_core, REPORT_GRAIN_CORE);
+	range(&sp->chamber_pressure, REPORT_CHAMBER_PRESSURE);
+	range(&sp->of_ratio, REPORT_OF_RATIO);
+	range(&sp->n2o_pressure_ratio, REPORT_IP_RATIO);
+	if (sp->liquid)
+		range(&sp->fuel_pressure_ratio, REPORT_IPL_RATIO);
+	range(&sp->exit_pressure, REPORT_EXIT_PRESSURE);
+	range(&sp->thrust, REPORT_THRUST);
+	range(&sp->isp, REPORT_ISP);
+	sp->isp.average = summary.delivered_isp;
+
+	sp->init_thrust = report.column_init[REPORT_THRUST];
+	sp->init_isp = report.column_init[REPORT_ISP];
+	sp->burn_time = summary.burn_time;
+	sp->total_impulse = summary.total_impulse;
+	sp->motor_class = summary.motor_class[0];
+	sp->motor_class_fraction = summary.class_fraction;
+}
+
+/*
+ * The record_data() hook.
+ */
+static void
+record()
+{
+	struct hsim_row_s row, *rp;
+	double values[RECORD_COLUMNS_MAX];
+
+	row.time = sim_time;
+	row.tank_energy = tank_energy;
+	row.tank_n2o_mass = tank_n2o_mass;
+	row.tank_pressure = tank_pressure;
+	row.tank_temperature = tank_temperature;
+	row.n2o_liquid_mass = n2o_liquid_mass;
+	row.n2o_liquid_density = n2o_liquid_density;
+	if (sim_type == HYBRID) {
+		row.fuel_mass = fuel_mass;
+		row.grain_core = grain_core;
+		row.fuel_rb = fuel_rb;
+		row.liquid_fuel_mass = 0.;
+		row.liquid_fuel_volume = 0.;
+		row.nitrogen_pressure = 0.;
+	} else {
+		row.fuel_mass = 0.;
+		row.grain_core = 0.;
+		row.fuel_rb = 0.;
+		row.liquid_fuel_mass = lfuelmass;
+		row.liquid_fuel_volume = lfuelvolume;
+		row.nitrogen_pressure = nitrogen_pressure;
+	}
+	row.chamber_pressure = chamber_pressure;
+	row.c_star = c_star;
+	row.n2o_flow_rate = n2o_flow_rate;
+	row.n2o_vent_rate = n2o_vent_rate;
+	row.n2o_flux = n2o_flux;
+	row.fuel_flow_rate = fuel_flow_rate;
+	row.isp = isp;
+	row.nozzle_cf = nozzle_cf;
+	row.thrust = thrust;
+	row.exit_pressure = exit_pressure;
+
+	record_data_values(values);
+	report_row(&report, values);
+	if (options->row)
+		(*options->row)(options->arg, &row);
+
+	if (!options->keep_rows || out_of_memory)
+		return;
+	if (result->n_rows >= rows_size) {
+		rows_size = rows_size? 2 * rows_size: 1024;
+		rp = realloc(result->rows, rows_size * sizeof (row));
+		if (!rp) {
+			out_of_memory = 1;
+			return;
+		}
+		result->rows = rp;
+	}
+	result->rows[result->n_rows++] = row;
+}
+
+static int
+warnings()
+{
+	int w;
+
+	w = 0;
+	if (warn_n2o_flux)
+		w |= HSIM_WARN_N2O_FLUX;
+	if (warn_core_throat_ratio == 1)
+		w |= HSIM_WARN_CORE_THROAT_RATIO;
+	if (warn_core_throat_ratio == 2)
+		w |= HSIM_WARN_CORE_THROAT_LOW;
+	if (warn_injector_pressure)
+		w |= HSIM_WARN_INJECTOR_PRESSURE;
+	if (warn_supply_pressure)
+		w |= HSIM_WARN_SUPPLY_PRESSURE;
+	if (warn_negative_vent_to_fill)
+		w |= HSIM_WARN_NEGATIVE_VENT;
+	return w;
+}
+
+/*
+ * Run the design in pp, or if pp is NULL the design design_parse()
+ * has read.  If raw is not NULL the parameters and timeseries
+ * sections are written to it as hsim writes them.
+ */
+static int
+run(const struct hsim_params_s *pp, const struct hsim_options_s *op,
+	struct hsim_result_s *rp, FILE *raw)
+{
+	static struct hsim_options_s defaults;
+	jmp_buf recover, *outer;
+	int status;
+	int save_dry_fire, save_engine_map, save_enthalpy, save_hard;
+	char *names[RECORD_COLUMNS_MAX];
+
+	if (!op) {
+		hsim_options_init(&defaults);
+		op = &defaults;
+	}
+	options = op;
+	result = rp;
+	memset(rp, 0, sizeof *rp);
+	rows_size = 0;
+	out_of_memory = 0;
+	report_init(&report, 0, 0);
+
+	save_dry_fire = dry_fire;
+	save_engine_map = use_engine_map;
+	save_enthalpy = use_enthalpy;
+	save_hard = hard_constraints;
+	dry_fire = op->dry_fire;
+	use_engine_map = op->engine_map;
+	use_enthalpy = !op->internal_energy;
+	hard_constraints = op->constraints;
+
+	/* failures while setting up come back here */
+	errors_init();
+	outer = error_recover(&recover);
+	if (setjmp(recover)) {
+		status = sim_error? sim_error: HSIM_EINTERNAL;
+		goto done;
+	}
+
+	constants_init();
+	if (pp)
+		set_params(pp);
+	design_setup();
+	sim_init();
+	design_fill();
+	rp->summary.liquid = (sim_type == LIQUID);
+	rp->summary.tank_volume = tank_volume;
+	rp->summary.vent_mass = *(design_parameter("filltemp")->nvp)?
+		vent_mass: 0.;
+
+	if (use_engine_map)
+		engine_map_build();
+	if (raw)
+		design_report(raw);
+	report_columns(&report, record_data_names(names), names);
+	record_data_hook(record);
+	record_data_init(op->record_step, raw);
+	status = sim_loop();
+	record_data_term();
+
+	summary_term();
+	rp->summary.warnings = warnings();
+	if (status == HSIM_OK && out_of_memory) {
+		status = HSIM_ENOMEM;
+		strcpy(sim_error_message, "cannot keep the rows");
+	}
+
+    done:
+	if (status != HSIM_OK)
+		strcpy(rp->message, sim_error_message);
+	rp->constraint = hard_constraint;
+	error_recover(outer);
+	record_data_hook(NULL);
+	report_free(&report);
+	dry_fire = save_dry_fire;
+	use_engine_map = save_engine_map;
+	use_enthalpy = save_enthalpy;
+	hard_constraints = save_hard;
+	return status;
+}
+
+int
+hsim_run(const struct hsim_params_s *pp, const struct hsim_options_s *op,
+	struct hsim_result_s *rp)
+{
+	return run(pp, op, rp, NULL);
+}
+
+int
+hsim_run_parsed(const struct hsim_options_s *op, struct hsim_result_s *rp,
+	FILE *raw)
+{
+	return run(NULL, op, rp, raw);
+}
+
+/*
+ * The summary section, a line for each number, in this order.
+ * A range is three lines: min, max and average.
+ */
+#define	S_BOTH		0
+#define	S_HYBRID	1
+#define	S_LIQUID	2
+
+#define	S_DOUBLE	0
+#define	S_INT		1
+#define	S_CLASS		2	/* the motor class letter */
+#define	S_RANGE		3
+
+#define	S(f)	offsetof(struct hsim_summary_s, f)
+
+static struct summary_field_s {
+	char	*name;
+	size_t	offset;
+	char	*unit;
+	int	kind;
+	int	which;		/* the motors that have it */
+} summary_fields[] = {
+	{ "rows",		S(rows),		"",		S_INT, },
+	{ "tank volume",	S(tank_volume),		"meters**3",	},
+	{ "vent mass",		S(vent_mass),		"kg",		},
+	{ "init tank pressure",	S(init_tank_pressure),	"pascal",	},
+	{ "final tank pressure", S(final_tank_pressure), "pascal",	},
+	{ "init tank temperature", S(init_tank_temperature), "kelvin",	},
+	{ "final tank temperature", S(final_tank_temperature), "kelvin", },
+	{ "init n2o mass",	S(init_n2o_mass),	"kg",		},
+	{ "final n2o mass",	S(final_n2o_mass),	"kg",		},
+	{ "init n2o liquid mass", S(init_n2o_liquid_mass), "kg",	},
+	{ "final n2o liquid mass", S(final_n2o_liquid_mass), "kg",	},
+	{ "init n2o liquid density", S(init_n2o_liquid_density), "kg/m3", },
+	{ "init fuel mass",	S(init_fuel_mass),	"kg",		},
+	{ "final fuel mass",	S(final_fuel_mass),	"kg",		},
+	{ "init nitrogen pressure", S(init_nitrogen_pressure), "pascal",
+		S_DOUBLE, S_LIQUID, },
+	{ "final nitrogen pressure", S(final_nitrogen_pressure), "pascal",
+		S_DOUBLE, S_LIQUID, },
+	{ "init grain core",	S(init_grain_core),	"meters",
+		S_DOUBLE, S_HYBRID, },
+	{ "final grain core",	S(final_grain_core),	"meters",
+		S_DOUBLE, S_HYBRID, },
+	{ "grain core",		S(grain_core),		"meters",
+		S_RANGE, S_HYBRID, },
+	{ "chamber pressure",	S(chamber_pressure),	"pascal", S_RANGE, },
+	{ "o/f ratio",		S(of_ratio),		"",	S_RANGE, },
+	{ "n2o pressure ratio",	S(n2o_pressure_ratio),	"",	S_RANGE, },
+	{ "fuel pressure ratio", S(fuel_pressure_ratio), "",
+		S_RANGE, S_LIQUID, },
+	{ "exit pressure",	S(exit_pressure),	"pascal", S_RANGE, },
+	{ "init thrust",	S(init_thrust),		"newtons",	},
+	{ "thrust",		S(thrust),		"newtons", S_RANGE, },
+	{ "init isp",		S(init_isp),		"meters/second", },
+	{ "isp",		S(isp),			"meters/second", S_RANGE, },
+	{ "burn time",		S(burn_time),		"seconds",	},
+	{ "total impulse",	S(total_impulse),	"newton-seconds", },
+	{ "motor class",	S(motor_class),		"",	S_CLASS, },
+	{ "motor class fraction", S(motor_class_fraction), "",		},
+	{ "warnings",		S(warnings),		"",	S_INT, },
+	{ (char *)0, },
+};
+
+static char *range_names[] = { "min", "max", "average", };
+
+#define	FIELD(sp, fp, type)	((type *)((char *)(sp) + (fp)->offset))
+
+static int
+has_field(const struct hsim_summary_s *sp, struct summary_field_s *fp)
+{
+	return fp->which == S_BOTH ||
+		fp->which == (sp->liquid? S_LIQUID: S_HYBRID);
+}
+
+void
+hsim_print_summary(FILE *output, const struct hsim_summary_s *sp)
+{
+	struct summary_field_s *fp;
+	double *v;
+	int i;
+
+	fprintf(output, "SECTION,summary\n");
+	fprintf(output, "Parameter,Value,Unit\n");
+	for (fp = summary_fields; fp->name; fp++) {
+		if (!has_field(sp, fp))
+			continue;
+		switch (fp->kind) {
+		    case S_INT:
+			fprintf(output, "%s,%d,%s\n", fp->name,
+				*FIELD(sp, fp, int), fp->unit);
+			break;
+		    case S_CLASS:
+			fprintf(output, "%s,%c,%s\n", fp->name,
+				*FIELD(sp, fp, char), fp->unit);
+			break;
+		    case S_RANGE:
+			v = FIELD(sp, fp, double);
+			for (i = 0; i < 3; i++)
+				fprintf(output, "%s %s,%.6e,%s\n", fp->name,
+					range_names[i], v[i], fp->unit);
+			break;
+		    default:
+			fprintf(output, "%s,%.6e,%s\n", fp->name,
+				*FIELD(sp, fp, double), fp->unit);
+			break;
+		}
+	}
+	fprintf(output, "\n");
+}
+
+/*
+ * Number i of the summary: its field, and which of a range it is.
+ * The motor class letter is not a number.
+ */
+static struct summary_field_s *
+summary_number(int i, int *part)
+{
+	struct summary_field_s *fp;
+
+	for (fp = summary_fields; fp->name; fp++) {
+		*part = 0;
+		if (fp->kind == S_CLASS)
+			continue;
+		if (fp->kind == S_RANGE && i < 3) {
+			*part = i;
+			return fp;
+		}
+		if (i == 0)
+			return fp;
+		i -= fp->kind == S_RANGE? 3: 1;
+	}
+	return NULL;
+}
+
+const char *
+hsim_summary_field(int i, char *name, int size, const char **unit)
+{
+	struct summary_field_s *fp;
+	int part;
+
+	if ((fp = summary_number(i, &part)) == NULL)
+		return NULL;
+	if (fp->kind == S_RANGE)
+		snprintf(name, size, "%s %s", fp->name, range_names[part]);
+	else
+		snprintf(name, size, "%s", fp->name);
+	if (unit)
+		*unit = fp->unit;
+	return name;
+}
+
+double
+hsim_summary_number(const struct hsim_summary_s *sp, int i)
+{
+	struct summary_field_s *fp;
+	int part;
+
+	if ((fp = summary_number(i, &part)) == NULL || !has_field(sp, fp))
+		return NAN;
+	if (fp->kind == S_INT)
+		return *FIELD(sp, fp, int);
+	return FIELD(sp, fp, double)[part];
+}
+
+int
+hsim_summary_line(struct hsim_summary_s *sp, char *line)
+{
+	struct summary_field_s *fp;
+	char *value;
+	size_t n;
+	int i;
+
+	if ((value = strchr(line, ',')) == NULL)
+		return 0;
+	n = value++ - line;
+	for (fp = summary_fields; fp->name; fp++) {
+		if (strncmp(line, fp->name, strlen(fp->name)) != 0)
+			continue;
+		for (i = 0; i < 3; i++)
+			if (fp->kind == S_RANGE &&
+			    n == strlen(fp->name) + 1 + strlen(range_names[i]) &&
+			    line[strlen(fp->name)] == ' ' &&
+			    strncmp(line + strlen(fp->name) + 1, range_names[i],
+			    strlen(range_names[i])) == 0)
+				break;
+		if (fp->kind == S_RANGE? i == 3: n != strlen(fp->name))
+			continue;
+
+		/* only a liquid has the liquid lines */
+		if (fp->which == S_LIQUID)
+			sp->liquid = 1;
+		switch (fp->kind) {
+		    case S_INT:
+			*FIELD(sp, fp, int) = atoi(value);
+			break;
+		    case S_CLASS:
+			*FIELD(sp, fp, char) = *value;
+			break;
+		    case S_RANGE:
+			FIELD(sp, fp, double)[i] = atof(value);
+			break;
+		    default:
+			*FIELD(sp, fp, double) = atof(value);
+			break;
+		}
+		return 1;
+	}
+	return 0;
+}
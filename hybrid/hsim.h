@@ -0,0 +1,279 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * The simulator as a library.
+ *
+ * Fill in a struct hsim_params_s, in SI units, and call hsim_run().
+ * The timeseries rows are handed to a callback, or kept in an array,
+ * or both, and the run is summarised the way the report program
+ * summarises an hsim data file.  Failures are returned as a status,
+ * not by exiting.
+ *
+ * The simulator keeps its state in globals, so only one run can be
+ * in progress in a process at a time.  Run designs in parallel in
+ * separate processes.
+ *
+ * The messages the library writes on stderr start with myname,
+ * "hsim" unless the program calls hsim_set_name(), or, as the rest of
+ * the simulator does, defines
+ *
+ *	char *myname;
+ *
+ * itself.
+ */
+
+#ifndef HSIM_H
+#define	HSIM_H
+
+#include <stdio.h>
+#include <math.h>
+
+/*
+ * A parameter that has not been given.
+ * hsim_params_init() sets every parameter to this.
+ */
+#define	HSIM_UNSET	NAN
+
+/*
+ * The input parameters, one for each line of an hsim input file.
+ * The names are the names used in the input file.  Values are in
+ * meters, kilograms, seconds, pascal, kelvin and radians.
+ */
+struct hsim_params_s {
+	const char *fuel;		/* NULL for the default, PVC */
+	double tankheight;
+	double ullageheight;
+	double tankdia;
+	double grainlength;
+	double graindiameter;
+	double graincore;
+	double nozzlethroat;
+	double nozzleexit;
+	double nozzleratio;
+	double nozcfadj;
+	double nozhalfangle;
+	double cstaradj;
+	double injectordia;
+	double injectorcd;
+	double injectorcount;
+	double ventdia;
+	double ventcd;
+	double timestep;
+	double filltemp;
+	double filldrop;
+	double fillpress;
+	double drymass;
+	double ambientpressure;
+	double fuelinjectorid;
+	double fuelinjectorod;
+	double fuelinjectordia;
+	double fuelinjectorcount;
+	double fuelinjectorcd;
+	double fueltankvolume;
+	double fuelmass;
+	double fuelvolume;
+	double nitrogenpressure;
+};
+
+/*
+ * One timeseries row, the same values as the timeseries section of
+ * an hsim data file.  fuel_mass, grain_core and fuel_rb are for
+ * hybrids; liquid_fuel_mass, liquid_fuel_volume and
+ * nitrogen_pressure are for liquids.
+ */
+struct hsim_row_s {
+	double time;
+	double tank_energy;
+	double tank_n2o_mass;
+	double tank_pressure;
+	double tank_temperature;
+	double n2o_liquid_mass;
+	double n2o_liquid_density;
+	double fuel_mass;
+	double grain_core;
+	double fuel_rb;
+	double liquid_fuel_mass;
+	double liquid_fuel_volume;
+	double nitrogen_pressure;
+	double chamber_pressure;
+	double c_star;
+	double n2o_flow_rate;
+	double n2o_vent_rate;
+	double n2o_flux;
+	double fuel_flow_rate;
+	double isp;
+	double nozzle_cf;
+	double thrust;
+	double exit_pressure;
+};
+
+/*
+ * The minimum, maximum and average of a value over the rows.
+ */
+struct hsim_range_s {
+	double min;
+	double max;
+	double average;		/* over time */
+};
+
+/* summary warnings */
+#define	HSIM_WARN_N2O_FLUX		0x01
+#define	HSIM_WARN_CORE_THROAT_RATIO	0x02	/* below the error limit */
+#define	HSIM_WARN_CORE_THROAT_LOW	0x04	/* below the warning limit */
+#define	HSIM_WARN_INJECTOR_PRESSURE	0x08
+#define	HSIM_WARN_SUPPLY_PRESSURE	0x10
+#define	HSIM_WARN_NEGATIVE_VENT		0x20
+
+/*
+ * The numbers in the report program's summary, in SI units.
+ */
+struct hsim_summary_s {
+	int liquid;			/* liquid fuel, not a hybrid */
+	int rows;
+
+	double tank_volume;
+	double vent_mass;		/* N2O vented to chill the tank */
+
+	double init_tank_pressure, final_tank_pressure;
+	double init_tank_temperature, final_tank_temperature;
+	double init_n2o_mass, final_n2o_mass;
+	double init_n2o_liquid_mass, final_n2o_liquid_mass;
+	double init_n2o_liquid_density;
+
+	double init_fuel_mass, final_fuel_mass;		/* either kind */
+	struct hsim_range_s grain_core;			/* hybrid */
+	double init_grain_core, final_grain_core;	/* hybrid */
+	double init_nitrogen_pressure, final_nitrogen_pressure; /* liquid */
+
+	struct hsim_range_s chamber_pressure;
+	struct hsim_range_s of_ratio;
+	struct hsim_range_s n2o_pressure_ratio;	/* tank / chamber */
+	struct hsim_range_s fuel_pressure_ratio;	/* liquid, N2 / chamber */
+	struct hsim_range_s exit_pressure;
+
+	double init_thrust;
+	struct hsim_range_s thrust;
+	double init_isp;
+	struct hsim_range_s isp;	/* average is the delivered isp */
+	double burn_time;
+	double total_impulse;
+	char motor_class;		/* 'C' and up */
+	double motor_class_fraction;	/* of the way through the class */
+
+	int warnings;			/* HSIM_WARN_* */
+};
+
+/*
+ * Hard constraints: the warnings, at their limits, that stop a run
+ * the first step they are broken.
+ */
+#define	HSIM_HARD_N2O_FLUX		0x01
+#define	HSIM_HARD_CORE_THROAT		0x02	/* below the error limit */
+#define	HSIM_HARD_INJECTOR_PRESSURE	0x04
+#define	HSIM_HARD_EXIT_PRESSURE		0x08
+
+/*
+ * How to run.  hsim_options_init() sets the defaults.
+ */
+struct hsim_options_s {
+	double record_step;	/* seconds between rows, 0 for every step */
+	int engine_map;		/* use a precomputed engine map (hsim -M) */
+	int internal_energy;	/* not enthalpy, for the N2O (hsim -E) */
+	int dry_fire;		/* hsim -D */
+	int keep_rows;		/* keep the rows in the result */
+	int constraints;	/* HSIM_HARD_ limits that stop the run (hsim -H) */
+
+	/* called with each row, if not NULL */
+	void (*row)(void *arg, const struct hsim_row_s *rp);
+	void *arg;
+};
+
+struct hsim_result_s {
+	struct hsim_summary_s summary;
+	struct hsim_row_s *rows;	/* if keep_rows */
+	int n_rows;
+	char message[256];		/* why the run failed */
+	int constraint;			/* the HSIM_HARD_ bit that stopped it */
+};
+
+/*
+ * hsim_run() status.  The run stops at the first error.
+ */
+#define	HSIM_OK			0
+#define	HSIM_EINPUT		1	/* missing or inconsistent parameters */
+#define	HSIM_EDATA		2	/* missing or bad data file */
+#define	HSIM_ETANK_HOT		3	/* N2O above the table */
+#define	HSIM_ETANK_COLD		4	/* N2O below the table */
+#define	HSIM_ETANK_CONVERGE	5	/* tank solution did not converge */
+#define	HSIM_ECHAMBER_CONVERGE	6	/* chamber solution did not converge */
+#define	HSIM_ECHAMBER_PRESSURE	7	/* below 2 atm, or up to the tank */
+#define	HSIM_ECORE_THROAT	8	/* grain core smaller than the throat */
+#define	HSIM_EFUEL_PORT		9	/* the port burned through the grain */
+#define	HSIM_ESYSTEM		10	/* fork, exec or the like failed */
+#define	HSIM_EINTERNAL		11
+#define	HSIM_ENOMEM		12
+#define	HSIM_ECONSTRAINT	13	/* a hard constraint was broken */
+
+void hsim_params_init(struct hsim_params_s *pp);
+void hsim_options_init(struct hsim_options_s *op);
+
+/*
+ * Run one design.  op may be NULL for the defaults.
+ * Returns HSIM_OK or one of the errors above, with the message in
+ * the result.  The result is filled in as far as the run got; free
+ * it with hsim_result_free().
+ */
+int hsim_run(const struct hsim_params_s *pp, const struct hsim_options_s *op,
+	struct hsim_result_s *rp);
+void hsim_result_free(struct hsim_result_s *rp);
+
+/*
+ * A short description of a status.
+ */
+const char *hsim_strerror(int status);
+
+/*
+ * Start the library's messages with name, for a program that does not
+ * define myname.
+ */
+void hsim_set_name(const char *name);
+
+/*
+ * Write the summary as a "summary" section of an hsim data file.
+ */
+void hsim_print_summary(FILE *output, const struct hsim_summary_s *sp);
+
+/*
+ * The summary's numbers one at a time, named as the summary section
+ * names them: hsim_summary_field() writes the name of number i into
+ * name and returns it, or NULL past the last, and sets *unit;
+ * hsim_summary_number() is its value, NAN if the kind of motor does
+ * not have it.  The motor class letter is not one of the numbers.
+ */
+const char *hsim_summary_field(int i, char *name, int size,
+	const char **unit);
+double hsim_summary_number(const struct hsim_summary_s *sp, int i);
+
+/*
+ * Take back one line of a summary section.  Returns true if it was
+ * one of the summary's lines.
+ */
+int hsim_summary_line(struct hsim_summary_s *sp, char *line);
+
+#endif /* HSIM_H */
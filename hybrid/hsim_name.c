@@ -0,0 +1,35 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * The library's myname, for a program that does not define its own.
+ *
+ * It is in a file of its own so that a static link only takes it
+ * when the program leaves myname undefined; a program's own myname
+ * also takes the place of this one in libhsim.so.
+ */
+
+#include "hsim.h"
+
+char *myname = "hsim";
+
+void
+hsim_set_name(const char *name)
+{
+	myname = (char *)name;
+}
@@ -0,0 +1,116 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * The report, in process.
+ *
+ * hsim --report prints what report prints for the run's data file,
+ * without the data file: the report statistics take the design's
+ * parameters and every recorded step, through the record_data() hook,
+ * as the run makes them.
+ *
+ * DYNAMIC INPUTS:
+ *	the run, through the record_data() hook
+ *
+ * STATIC INPUTS:
+ *	the design, as design_report() writes it
+ *
+ * OUTPUTS:
+ *	the report, the errors, and the Rocksim engine file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rsim.h"
+#include "rocksim.h"
+#include "report_stats.h"
+#include "state.h"
+#include "linkage.h"
+#include "design.h"
+
+extern char *myname;
+
+static struct report_s report;
+static void (*previous)();
+
+static void
+hsim_report_step()
+{
+	double row[RECORD_COLUMNS_MAX];
+
+	if (previous)
+		(*previous)();
+	record_data_values(row);
+	report_row(&report, row);
+}
+
+/*
+ * Start the report.  Call after design_fill(), before sim_loop().
+ * The parameters section is a few dozen short lines, so it is simply
+ * written and read back.
+ */
+void
+hsim_report_init(int rocksim)
+{
+	FILE *fp;
+	char *text;
+	size_t length;
+	char buffer[512];
+	char *ptrs[8];
+	char *names[RECORD_COLUMNS_MAX];
+	int n;
+
+	report_init(&report, rocksim, 0);
+
+	text = NULL;
+	if ((fp = open_memstream(&text, &length)) == NULL) {
+		fprintf(stderr, "%s: cannot report the parameters\n", myname);
+		exit(1);
+	}
+	design_report(fp);
+	fclose(fp);
+	if ((fp = fmemopen(text, length, "r")) != NULL) {
+		while ((n = csv_read(fp, buffer, sizeof buffer, ptrs, 8)) > 0)
+			if (n >= 2)
+				report_parameter(&report, ptrs[0], ptrs[1]);
+		fclose(fp);
+	}
+	free(text);
+
+	n = record_data_names(names);
+	report_columns(&report, n, names);
+	previous = record_data_hook(hsim_report_step);
+}
+
+/*
+ * Print the report and the errors, as report does for a data file.
+ */
+void
+hsim_report_term(FILE *output, FILE *rocksim)
+{
+	record_data_hook(previous);
+	if (report.nrow > 0) {
+		report_print(&report, output, 0);
+		if (rocksim)
+			report_rocksim(&report, rocksim);
+	}
+	fputc('\n', output);
+	print_errors(output);
+	report_free(&report);
+}
@@ -0,0 +1,124 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Test the library interface.
+ *
+ * Runs a built in design, prints the summary, and then runs some
+ * designs that fail.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hsim.h"
+
+#define	IN	0.0254		/* meters */
+#define	PSI	6894.7573	/* pascal */
+
+char *myname = "hsim_test";
+
+static int n_rows;
+
+static void
+count_row(void *arg, const struct hsim_row_s *rp)
+{
+	n_rows++;
+}
+
+static void
+design(struct hsim_params_s *pp)
+{
+	hsim_params_init(pp);
+	pp->fuel = "pvc";
+	pp->tankheight = 30 * IN;
+	pp->ullageheight = 3 * IN;
+	pp->tankdia = 4 * IN;
+	pp->grainlength = 20 * IN;
+	pp->graindiameter = 3 * IN;
+	pp->graincore = 1.25 * IN;
+	pp->nozzlethroat = .75 * IN;
+	pp->nozzleratio = 4;
+	pp->nozcfadj = .9;
+	pp->cstaradj = .85;
+	pp->injectordia = .07 * IN;
+	pp->injectorcount = 8;
+	pp->injectorcd = .7;
+	pp->ventdia = .03 * IN;
+	pp->ventcd = .8;
+	pp->fillpress = 700 * PSI;
+	pp->filltemp = (75. - 32.) / 1.8 + 273.15;
+	pp->drymass = 8;
+}
+
+static void
+run(char *name, struct hsim_params_s *pp, struct hsim_options_s *op)
+{
+	int status;
+	struct hsim_result_s result;
+	struct hsim_summary_s *sp;
+
+	n_rows = 0;
+	status = hsim_run(pp, op, &result);
+	sp = &result.summary;
+	printf("%s: %s\n", name, hsim_strerror(status));
+	if (status != HSIM_OK)
+		printf("\t%s\n", result.message);
+	if (status == HSIM_OK) {
+		printf("\trows %d (callback %d, kept %d)\n",
+			sp->rows, n_rows, result.n_rows);
+		printf("\tchamber pressure %.0f %.0f %.0f pascal\n",
+			sp->chamber_pressure.min, sp->chamber_pressure.max,
+			sp->chamber_pressure.average);
+		printf("\tthrust %.1f %.1f %.1f N\n",
+			sp->thrust.min, sp->thrust.max, sp->thrust.average);
+		printf("\tdelivered isp %.1f m/s\n", sp->isp.average);
+		printf("\tburn time %.3f s, impulse %.1f N-s, %c (%.0f%%)\n",
+			sp->burn_time, sp->total_impulse, sp->motor_class,
+			sp->motor_class_fraction * 100.);
+		printf("\twarnings 0x%x\n", sp->warnings);
+	}
+	hsim_result_free(&result);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct hsim_params_s params;
+	struct hsim_options_s options;
+
+	hsim_options_init(&options);
+	options.record_step = 0.01;
+	options.row = count_row;
+	options.keep_rows = 1;
+
+	design(&params);
+	run("nominal", &params, &options);
+
+	design(&params);
+	params.nozzlethroat = 0.05 * IN;
+	run("tiny throat", &params, &options);
+
+	design(&params);
+	params.tankdia = HSIM_UNSET;
+	run("no tank diameter", &params, &options);
+
+	design(&params);
+	run("nominal again", &params, NULL);
+
+	exit(0);
+}
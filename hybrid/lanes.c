@@ -0,0 +1,539 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Lanes
+ *
+ * A structure-of-arrays version of the hybrid step loop, for runs of
+ * many designs in one process.  See lanes.h.
+ *
+ * Every lane does the work of sim_loop(): the tank solution of
+ * tank_state(), vent(), the chamber solution of chamber_converge(),
+ * the thrust and sanity checks of chamber(), and the time step of
+ * tank_step() and fuel_step().  The arithmetic is written the same
+ * way, in the same order, so that a lane gives the same numbers as a
+ * scalar run.
+ *
+ * The two solvers iterate all of the lanes together, each lane
+ * dropping out of the iteration when it has converged.  The plain
+ * arithmetic is done in loops over all of the lanes, which the
+ * compiler can vectorize.  The table lookups start from where the
+ * lane's last lookup was, which is almost always the right segment.
+ *
+ * An error that would make a scalar run exit fails the lane instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "state.h"
+#include "linkage.h"
+#include "lanes.h"
+
+/* as in tank.c and chamber.c */
+#define	TANK_ITERATIONS		10000
+#define	TANK_TOLERANCE		(1e-6)
+#define	CHAMBER_ITERATIONS	10000
+#define	CHAMBER_TOLERANCE	(1e-6)
+
+#define	IDLE	(-1)
+
+/* lane state */
+static int id[LANES];			/* IDLE if not in use */
+static int n_step[LANES];
+static int warned[LANES];
+static int hint[LANES][2];		/* n2o table segments */
+static int cell[LANES][2];		/* cpropep table cell */
+static struct lane_design_s design[LANES];
+
+static double tank_energy_l[LANES];
+static double tank_n2o_mass_l[LANES];
+static double tank_temperature_l[LANES];
+static double fuel_mass_l[LANES];
+static double chamber_pressure_l[LANES];
+
+/* results of the current step */
+static struct n2o_saturation_s sat[LANES];
+static double liquid_mass[LANES];
+static double vent_rate[LANES];
+static double n2o_flow[LANES];
+static double fuel_flow[LANES];
+static double flux[LANES];
+static double core[LANES];
+static double cstar[LANES];
+static double exit_p[LANES];
+static double cf[LANES];
+static double thrust_l[LANES];
+
+/* solver state */
+static int solving[LANES];
+static int failed[LANES];
+static int hi_set[LANES], lo_set[LANES];
+static double hi[LANES], lo[LANES];
+
+static void (*finish_fn)(int lane, int id, int status, int warned);
+
+void
+lanes_capture(struct lane_design_s *dp)
+{
+	dp->tank_volume = tank_volume;
+	dp->injector_cd = injector_cd;
+	dp->injector_area = injector_area;
+	dp->injector_count = injector_count;
+	dp->vent_area = vent_area;
+	dp->vent_cd = vent_cd;
+	dp->nozzle_throat_area = nozzle_throat_area;
+	dp->nozzle_exit_area = nozzle_exit_area;
+	dp->nozzle_cf_correction = nozzle_cf_correction;
+	dp->nozzle_half_angle = nozzle_half_angle;
+	dp->combustion_efficiency = combustion_efficiency;
+	dp->ambient_air_pressure = ambient_air_pressure;
+	dp->grain_length = grain_length;
+	dp->grain_diameter = grain_diameter;
+	dp->fuel_a = fuel_a;
+	dp->fuel_n = fuel_n;
+	dp->fuel_k = fuel_k;
+	dp->fuel_density = fuel_density;
+	dp->time_step = sim_time_step;
+
+	dp->tank_energy = tank_energy;
+	dp->tank_n2o_mass = tank_n2o_mass;
+	dp->tank_temperature = tank_temperature;
+	dp->fuel_mass = fuel_mass;
+	dp->chamber_pressure = chamber_pressure;
+
+	dp->warned = warn_supply_pressure;
+}
+
+static void
+lane_start(int l, int i, struct lane_design_s *dp)
+{
+	id[l] = i;
+	design[l] = *dp;
+	n_step[l] = 0;
+	warned[l] = dp->warned;
+	hint[l][0] = hint[l][1] = 0;
+	cell[l][0] = cell[l][1] = 0;
+	tank_energy_l[l] = dp->tank_energy;
+	tank_n2o_mass_l[l] = dp->tank_n2o_mass;
+	tank_temperature_l[l] = dp->tank_temperature;
+	fuel_mass_l[l] = dp->fuel_mass;
+	chamber_pressure_l[l] = dp->chamber_pressure;
+}
+
+static void
+lane_end(int l, int status)
+{
+	int i;
+
+	i = id[l];
+	id[l] = IDLE;
+	(*finish_fn)(l, i, status, warned[l]);
+}
+
+/*
+ * tank_thermo() for lane l.  Sets *energy.
+ * Returns non-zero on a table error.
+ */
+static int
+lane_thermo(int l, double *energy)
+{
+	double calc_tank_energy;
+	double n2o_vapor_mass;
+	double liquid_fraction;
+	double average_density;
+	struct n2o_saturation_s *sp;
+
+	sp = &sat[l];
+	average_density = tank_n2o_mass_l[l] / design[l].tank_volume;
+
+	if (n2o_saturation(tank_temperature_l[l], sp, hint[l], 0))
+		return 1;
+
+	liquid_fraction = 
+		(1./average_density - 1./sp->vapor_density) /
+		 (1./sp->liquid_density - 1./sp->vapor_density);
+
+	liquid_mass[l] = liquid_fraction * tank_n2o_mass_l[l];
+	n2o_vapor_mass = tank_n2o_mass_l[l] - liquid_mass[l];
+	if (liquid_mass[l] < 0) {
+		liquid_mass[l] = 0;
+		n2o_vapor_mass = tank_n2o_mass_l[l];
+	}
+	if (n2o_vapor_mass < 0) {
+		n2o_vapor_mass = 0;
+		liquid_mass[l] = tank_n2o_mass_l[l];
+	}
+
+	calc_tank_energy = liquid_mass[l] * sp->liquid_energy;
+	calc_tank_energy += n2o_vapor_mass * sp->vapor_energy;
+
+	*energy = calc_tank_energy;
+	return 0;
+}
+
+/*
+ * tank_state() for every lane in use.
+ */
+static void
+lanes_tank()
+{
+	int l, i, n;
+	double t, e;
+
+	n = 0;
+	for (l = 0; l < LANES; l++) {
+		solving[l] = id[l] != IDLE;
+		n += solving[l];
+		hi_set[l] = lo_set[l] = 0;
+	}
+
+	for (i = 0; i < TANK_ITERATIONS && n > 0; i++) {
+		n = 0;
+		for (l = 0; l < LANES; l++) {
+			if (!solving[l])
+				continue;
+
+			if (lane_thermo(l, &e)) {
+				solving[l] = 0;
+				failed[l] = 1;
+				continue;
+			}
+
+			t = e - tank_energy_l[l];
+			if (t < 0)
+				t = -t;
+			if (t / tank_energy_l[l] < TANK_TOLERANCE) {
+				solving[l] = 0;
+				continue;
+			}
+
+			n++;
+			if (e > tank_energy_l[l]) {
+				hi[l] = tank_temperature_l[l];
+				hi_set[l] = 1;
+				if (!lo_set[l]) {
+					tank_temperature_l[l] -= 1;
+					continue;
+				}
+			} else {
+				lo[l] = tank_temperature_l[l];
+				lo_set[l] = 1;
+				if (!hi_set[l]) {
+					tank_temperature_l[l] += 1;
+					continue;
+				}
+			}
+			tank_temperature_l[l] = (hi[l] + lo[l]) * .5;
+		}
+	}
+
+	for (l = 0; l < LANES; l++)
+		if (solving[l])
+			failed[l] = 1;
+}
+
+/*
+ * vent(), and the cpcv lookup that goes with it.
+ */
+static void
+lanes_vent()
+{
+	int l;
+	double k, R, T1;
+	double c;
+
+	for (l = 0; l < LANES; l++) {
+		if (id[l] == IDLE || failed[l])
+			continue;
+		if (n2o_saturation(tank_temperature_l[l], &sat[l], hint[l], 1)) {
+			failed[l] = 1;
+			continue;
+		}
+
+		T1 = tank_temperature_l[l];
+		R = ideal_gas_constant;
+		k = sat[l].cpcv;
+
+		c = sqrt(k * R * T1) / (
+			k * sqrt(pow(2 / (k + 1), (k + 1) / k - 1)) );
+
+		vent_rate[l] = sat[l].pressure * design[l].vent_area *
+			design[l].vent_cd / c;
+	}
+}
+
+/*
+ * One pass of injector(), fuel_regression() and cpropep() for lane l.
+ * Returns the new chamber pressure.
+ */
+static double
+lane_chamber_pass(int l)
+{
+	double pressure_drop;
+	double a1, a2;
+	double of, nzr;
+	struct lane_design_s *dp;
+
+	dp = &design[l];
+
+	pressure_drop = sat[l].pressure - chamber_pressure_l[l];
+	if (pressure_drop < 0.)
+		pressure_drop = 0.;
+	n2o_flow[l] = dp->injector_cd * dp->injector_area *
+		dp->injector_count *
+		sqrt(2 * sat[l].liquid_density * pressure_drop);
+
+	a1 = fuel_mass_l[l] / dp->fuel_density / dp->grain_length;
+	a2 = pi/4. * dp->grain_diameter  * dp->grain_diameter - a1;
+	if (a2 < 0.) {
+		failed[l] = 1;
+		return chamber_pressure_l[l];
+	}
+	core[l] = sqrt(a2 / (pi/4.));
+	flux[l] = n2o_flow[l] / (pi / 4. * core[l] * core[l]);
+	fuel_flow[l] = dp->fuel_k * pow(flux[l] * dp->fuel_a, dp->fuel_n) *
+		(pi * core[l]) * dp->grain_length * dp->fuel_density;
+	if (fuel_flow[l] < 0.)
+		fuel_flow[l] = 0.;
+
+	nzr = dp->nozzle_exit_area / dp->nozzle_throat_area;
+	of = n2o_flow[l] / fuel_flow[l];
+	cpropep_table(nzr, of, chamber_pressure_l[l],
+		&cstar[l], &exit_p[l], &cf[l], cell[l]);
+
+	return cstar[l] * dp->combustion_efficiency *
+		(n2o_flow[l] + fuel_flow[l]) / dp->nozzle_throat_area;
+}
+
+/*
+ * chamber_converge() for every lane still going.
+ */
+static void
+lanes_chamber()
+{
+	int l, i, n;
+	double t, old_cp, cp;
+
+	n = 0;
+	for (l = 0; l < LANES; l++) {
+		solving[l] = id[l] != IDLE && !failed[l];
+		n += solving[l];
+		hi_set[l] = lo_set[l] = 0;
+		hi[l] = lo[l] = chamber_pressure_l[l];
+	}
+
+	for (i = 0; i < CHAMBER_ITERATIONS && n > 0; i++) {
+		n = 0;
+		for (l = 0; l < LANES; l++) {
+			if (!solving[l])
+				continue;
+
+			cp = lane_chamber_pass(l);
+			if (failed[l]) {
+				solving[l] = 0;
+				continue;
+			}
+			old_cp = chamber_pressure_l[l];
+
+			if (cp >= sat[l].pressure) {
+				if (!hi_set[l] || hi[l] > cp)
+					hi[l] = cp;
+				hi_set[l] = 1;
+			}
+			if (old_cp > cp) {
+				if (!hi_set[l] || hi[l] > old_cp)
+					hi[l] = old_cp;
+				hi_set[l] = 1;
+			}
+			if (cp < atmosphere_pressure) {
+				if (!lo_set[l] || lo[l] < cp)
+					lo[l] = cp;
+				lo_set[l] = 1;
+			}
+			if (old_cp < cp) {
+				if (!lo_set[l] || lo[l] < old_cp)
+					lo[l] = old_cp;
+				lo_set[l] = 1;
+			}
+			if (hi_set[l] && lo_set[l])
+				cp = (hi[l] + lo[l]) / 2.;
+			if (!hi_set[l])
+				hi[l] = cp = hi[l] + atmosphere_pressure;
+			if (!lo_set[l])
+				lo[l] = cp = lo[l] - atmosphere_pressure;
+			chamber_pressure_l[l] = cp;
+
+			t = (old_cp - cp) / old_cp;
+			if (t < 0)
+				t = -t;
+			if (t <= CHAMBER_TOLERANCE)
+				solving[l] = 0;
+			else
+				n++;
+		}
+	}
+
+	for (l = 0; l < LANES; l++)
+		if (solving[l])
+			failed[l] = 1;
+}
+
+/*
+ * The thrust and the checks of chamber().
+ */
+static void
+lanes_thrust()
+{
+	int l;
+	double adjusted_nozzle_cf;
+	double drop, ratio;
+	struct lane_design_s *dp;
+
+	for (l = 0; l < LANES; l++) {
+		dp = &design[l];
+		adjusted_nozzle_cf = 1 + dp->nozzle_cf_correction *
+			(cf[l] - 1.);
+		thrust_l[l] = chamber_pressure_l[l] *
+			dp->nozzle_throat_area * adjusted_nozzle_cf;
+		thrust_l[l] *= (1. + cos(dp->nozzle_half_angle)) / 2.;
+		thrust_l[l] += (exit_p[l] - dp->ambient_air_pressure) *
+			dp->nozzle_exit_area;
+	}
+
+	for (l = 0; l < LANES; l++) {
+		if (id[l] == IDLE || failed[l])
+			continue;
+		drop = sat[l].pressure - chamber_pressure_l[l];
+		ratio = core[l] * core[l] * pi / 4. /
+			design[l].nozzle_throat_area;
+		if (chamber_pressure_l[l] < 2 * atmosphere_pressure ||
+		    drop <= atmosphere_pressure || ratio < 1.) {
+			failed[l] = 1;
+			continue;
+		}
+		if (drop < WARN_INJECTOR_RATIO * chamber_pressure_l[l] ||
+		    flux[l] > WARN_N2O_FLUX_LIMIT ||
+		    ratio < WARN_CORE_THROAT_RATIO_1)
+			warned[l] = 1;
+	}
+}
+
+/*
+ * tank_step() and fuel_step().  Returns 0 if the lane burned out.
+ */
+static int
+lane_step(int l)
+{
+	int r;
+	double dt;
+	double n2o_loss;
+	struct n2o_saturation_s *sp;
+
+	dt = design[l].time_step;
+	sp = &sat[l];
+
+	n2o_loss = vent_rate[l] * dt;
+	tank_n2o_mass_l[l] -= n2o_loss;
+	tank_energy_l[l] -= n2o_loss * sp->vapor_energy;
+	tank_energy_l[l] -= sp->pressure * n2o_loss / sp->vapor_density;
+
+	r = 1;
+	n2o_loss = n2o_flow[l] * dt;
+	if (n2o_loss > liquid_mass[l])
+		r = 0;
+
+	tank_n2o_mass_l[l] -= n2o_loss;
+	tank_energy_l[l] -= n2o_loss * sp->liquid_energy;
+	tank_energy_l[l] -= sp->pressure * n2o_loss / sp->liquid_density;
+
+	if (!r)
+		return 0;
+	fuel_mass_l[l] -= fuel_flow[l] * dt;
+	return fuel_mass_l[l] >= 0.;
+}
+
+void
+lanes_run(int (*next)(struct lane_design_s *dp),
+	void (*record)(int lane, int id, struct lane_step_s *sp),
+	void (*finish)(int lane, int id, int status, int warned))
+{
+	int l, i, n, empty;
+	struct lane_design_s d;
+	struct lane_step_s s;
+
+	finish_fn = finish;
+	for (l = 0; l < LANES; l++)
+		id[l] = IDLE;
+
+	for (empty = 0; ; ) {
+		/*
+		 * Refill the idle lanes.
+		 */
+		n = 0;
+		for (l = 0; l < LANES; l++) {
+			if (id[l] == IDLE && !empty) {
+				if ((i = next(&d)) < 0)
+					empty = 1;
+				else
+					lane_start(l, i, &d);
+			}
+			failed[l] = 0;
+			n += id[l] != IDLE;
+		}
+		if (n == 0)
+			break;
+
+		/*
+		 * sim_to_steady_state()
+		 */
+		lanes_tank();
+		for (l = 0; l < LANES; l++)
+			if (id[l] != IDLE && !failed[l] && liquid_mass[l] <= 0.)
+				lane_end(l, LANE_DONE);
+		lanes_vent();
+		lanes_chamber();
+		lanes_thrust();
+
+		for (l = 0; l < LANES; l++) {
+			if (id[l] == IDLE)
+				continue;
+			if (failed[l]) {
+				lane_end(l, LANE_FAILED);
+				continue;
+			}
+			if (sat[l].pressure < 2 * atmosphere_pressure) {
+				lane_end(l, LANE_DONE);
+				continue;
+			}
+
+			s.time = design[l].time_step * n_step[l];
+			s.time_step = design[l].time_step;
+			s.thrust = thrust_l[l];
+			s.chamber_pressure = chamber_pressure_l[l];
+			s.tank_pressure = sat[l].pressure;
+			s.n2o_flow_rate = n2o_flow[l];
+			s.fuel_flow_rate = fuel_flow[l];
+			(*record)(l, id[l], &s);
+
+			n_step[l]++;
+			if (!lane_step(l))
+				lane_end(l, LANE_DONE);
+		}
+	}
+}
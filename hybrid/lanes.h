@@ -0,0 +1,108 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * The lanes engine runs LANES hybrid designs side by side, one step
+ * at a time, with the state of each design in one element of a set of
+ * arrays.  Finished lanes are refilled from a queue of designs.
+ *
+ * The designs share the fuel and the cpropep data.  Designs with
+ * different nozzle ratios work, but make the data be reloaded.
+ *
+ * Each lane does the same arithmetic as a scalar run, so the results
+ * are the same.
+ */
+
+#define	LANES	8
+
+/*
+ * The saturated N2O properties at one temperature.
+ * See n2o_saturation().
+ */
+struct n2o_saturation_s {
+	double pressure;
+	double vapor_density;
+	double liquid_density;
+	double vapor_energy;
+	double liquid_energy;
+	double cpcv;
+};
+
+/*
+ * One design, as design_fill() leaves it.
+ */
+struct lane_design_s {
+	double tank_volume;
+	double injector_cd;
+	double injector_area;
+	int injector_count;
+	double vent_area;
+	double vent_cd;
+	double nozzle_throat_area;
+	double nozzle_exit_area;
+	double nozzle_cf_correction;
+	double nozzle_half_angle;
+	double combustion_efficiency;
+	double ambient_air_pressure;
+	double grain_length;
+	double grain_diameter;
+	double fuel_a, fuel_n, fuel_k, fuel_density;
+	double time_step;
+
+	double tank_energy;
+	double tank_n2o_mass;
+	double tank_temperature;
+	double fuel_mass;
+	double chamber_pressure;
+
+	int warned;		/* the fill raised a warning */
+};
+
+/*
+ * The results of one step of one lane.
+ */
+struct lane_step_s {
+	double time;
+	double time_step;
+	double thrust;
+	double chamber_pressure;
+	double tank_pressure;
+	double n2o_flow_rate;
+	double fuel_flow_rate;
+};
+
+#define	LANE_DONE	0	/* burned out */
+#define	LANE_FAILED	1	/* a scalar run would have exited */
+
+/*
+ * Copy the design from the globals, after design_fill().
+ */
+void lanes_capture(struct lane_design_s *dp);
+
+/*
+ * Run designs until next() returns a negative id.
+ *
+ * next(dp) returns the id of the next design and fills in *dp.
+ * record(lane, id, sp) is called at every step of every design.
+ * finish(lane, id, status, warned) is called when a design is done;
+ * the lane is then refilled.  warned is set if a scalar run of the
+ * design would have raised one of the ensemble warnings.
+ */
+void lanes_run(int (*next)(struct lane_design_s *dp),
+	void (*record)(int lane, int id, struct lane_step_s *sp),
+	void (*finish)(int lane, int id, int status, int warned));
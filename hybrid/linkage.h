@@ -17,8 +17,41 @@
 
  */
 
+#include <setjmp.h>
+
 void cpropep();
+void cpropep_table(double nzr, double of, double pc,
+	double *cs, double *pe, double *cf, int hint[2]);
+void cpropep_slopes(double d_of[3], double d_cp[3]);
+void cpropep_preload();
+int cpropep_load(char *f, double Nzr);
+char *cpropep_directory();
 void chamber();
+int chamber_converge();
+void engine_map_build();
+int engine_map_lookup();
+void engine_map_stats(FILE *output);
+void ensemble(char *specfile, FILE *output);
+void optimize(char *specfile, FILE *output);
+void calibrate(char *specfile, FILE *output);
+void doe(char *specfile, FILE *input, FILE *output);
+void sensitivity_init();
+void sensitivity_report(FILE *output);
+int thrust_sweep_cases();
+void thrust_sweep_init();
+void thrust_sweep_report(FILE *output);
+struct hsim_options_s;
+struct hsim_result_s;
+struct hsim_summary_s;
+int hsim_run_parsed(const struct hsim_options_s *op, struct hsim_result_s *rp,
+	FILE *raw);
+void server(char *path, int workers, int queue, double timeout);
+void server_client(char *path);
+int batch(FILE *input, int workers, double timeout, int warm);
+int cache_run(FILE *output, int raw, int summary, char *message,
+	struct hsim_summary_s *sp, FILE *errors);
+void hsim_report_init(int rocksim);
+void hsim_report_term(FILE *output, FILE *rocksim);
 void liquid_init();
 void fuel_init();
 void fuel_regression();
@@ -31,12 +64,16 @@ void liquid_injector();
 int liquid_step();
 void chamber_init();
 void vent();
-void sim_loop();
+int sim_loop();
 void sim_init();
 void constants_init();
 void record_data();
 void record_data_init(double s, FILE *out);
 void record_data_term();
+void record_data_flush();
+int record_data_names(char **names);
+void record_data_values(double *values);
+void (*record_data_hook(void (*fn)()))();
 double liquid_density(double temp);
 double vapor_density(double temp);
 double saturation_pressure(double temp);
@@ -47,8 +84,23 @@ double cpcv(double temperature);
 double sound_speed(double temperature);
 double temp_from_pressure(double pressure);
 double temp_from_vapor_energy(double vapor_energy);
+double liquid_density_slope(double temp);
+double vapor_density_slope(double temp);
+double saturation_pressure_slope(double temp);
+double liquid_energy_slope(double temp);
+double vapor_energy_slope(double temp);
+double cpcv_slope(double temp);
+struct n2o_saturation_s;
+int n2o_saturation(double temp, struct n2o_saturation_s *sp, int hint[2],
+	int with_cpcv);
 void n2o_thermo_init();
 void errors_init();
 void print_errors(FILE *output);
 void error_exit(int code);
+jmp_buf *error_recover(jmp_buf *jp);
+int error_recovering();
+void sim_fail(int code, char *format, ...);
+int hard_parse(char *list);
+char *hard_name(int bit);
+void hard_fail(int bit, char *format, ...);
 void license(int c);
@@ -42,18 +42,14 @@ liquid_init()
 {
 	int r;
 	struct liquid_fuel_data_s lfd;
-	extern char *myname;
 
 	if (sim_type != LIQUID) {
-		fprintf(stderr, "%s: INTERAL ERROR in liquid_init\n", myname);
-		exit(1);
+		sim_fail(SIM_E_INTERNAL, "INTERAL ERROR in liquid_init");
 	}
 
 	r = liquid_fuel_data(fuel, &lfd);
 	if (r != 0) {
-		fprintf(stderr, "%s: unknown fuel %s\n",
-			myname, fuel);
-		exit(1);
+		sim_fail(SIM_E_DATA, "unknown fuel %s", fuel);
 	}
 
 	/*
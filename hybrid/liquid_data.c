@@ -73,6 +73,7 @@ liquid_fuel_data(char *liquid_fuel_name, struct liquid_fuel_data_s *fp)
 	if (csv_read(input, buffer, sizeof buffer, ptrs, NCOL) == 0) {
 		fprintf(stderr, "%s: data file %s is empty\n",
 			myname, LIQUID_FUEL);
+		fclose(input);
 		return 1;
 	}
 
@@ -83,7 +84,8 @@ liquid_fuel_data(char *liquid_fuel_name, struct liquid_fuel_data_s *fp)
 					myname,
 					LIQUID_FUEL,
 					j + 1);
-			exit(1);
+			fclose(input);
+			return 1;
 		}
 				
 		if (strcmp(ptrs[j], columns[j]) != 0) {
@@ -93,6 +95,7 @@ liquid_fuel_data(char *liquid_fuel_name, struct liquid_fuel_data_s *fp)
 		    fprintf(stderr, "\tExpected \'%s\' got \'%s\' "
 					"in column %d\n",
 			columns[j], ptrs[j], j);
+		    fclose(input);
 		    return 1;
 		}
 	}
@@ -30,6 +30,7 @@
 #include "state.h"
 #include "linkage.h"
 #include "rsim.h"
+#include "lanes.h"
 
 /*
  * Define the first thermo data file
@@ -121,16 +122,14 @@ n2o_thermo_init_1()
 	vapor_energy_col = use_enthalpy? VAPOR_ENTHALPY: VAPOR_ENERGY;
 
 	if (n2o_mols_per_kg == 0.) {
-		fprintf(stderr, "%s: n2o_therm_init error\n", myname);
-		error_exit(1);
+		sim_fail(SIM_E_INTERNAL, "n2o_therm_init error");
 	}
 
 	input = fopen(THERMODAT_1, "r");
 	if (input == NULL) {
-		fprintf(stderr, "%s: cannot open data file %s for reading.\n",
-			myname, THERMODAT_1);
 		perror("open");
-		error_exit(1);
+		sim_fail(SIM_E_DATA, "cannot open data file %s for reading.",
+			THERMODAT_1);
 	}
 
 	for (i = -1; ; i++) {
@@ -138,23 +137,21 @@ n2o_thermo_init_1()
 		if (n == 0)
 			break;
 		if (i >= MAX_THERMO) {
-			fprintf(stderr, "%s: more than %d lines "
-					"in data file %s\n",
-				myname, MAX_THERMO, THERMODAT_1);
-			error_exit(1);
+			fclose(input);
+			sim_fail(SIM_E_DATA, "more than %d lines "
+					"in data file %s",
+				MAX_THERMO, THERMODAT_1);
 		}
 
 		/* validate column headings */
 		if (i < 0) {
 		    for (j = 0; j < NCOL_1; j++)
 			if (strcmp(ptrs[j], columns_1[j]) != 0) {
-			    fprintf(stderr, "%s: bad column heading in "
-			    			"data file %s\n",
-				myname, THERMODAT_1);
-			    fprintf(stderr, "\tExpected \'%s\' got \'%s\' "
-			    			"in column %d\n",
-				columns_1[j], ptrs[j], j);
-			    error_exit(1);
+			    fclose(input);
+			    sim_fail(SIM_E_DATA, "bad column heading in "
+			    			"data file %s: expected \'%s\' "
+						"got \'%s\' in column %d",
+				THERMODAT_1, columns_1[j], ptrs[j], j);
 			}
 			continue;
 		}
@@ -234,10 +231,9 @@ n2o_thermo_init_2()
 
 	input = fopen(THERMODAT_2, "r");
 	if (input == NULL) {
-		fprintf(stderr, "%s: cannot open data file %s for reading.\n",
-			myname, THERMODAT_2);
 		perror("open");
-		error_exit(1);
+		sim_fail(SIM_E_DATA, "cannot open data file %s for reading.",
+			THERMODAT_2);
 	}
 
 	for (i = -1; ; i++) {
@@ -245,23 +241,21 @@ n2o_thermo_init_2()
 		if (n == 0)
 			break;
 		if (i >= MAX_THERMO) {
-			fprintf(stderr, "%s: more than %d lines "
-					"in data file %s\n",
-				myname, MAX_THERMO, THERMODAT_2);
-			error_exit(1);
+			fclose(input);
+			sim_fail(SIM_E_DATA, "more than %d lines "
+					"in data file %s",
+				MAX_THERMO, THERMODAT_2);
 		}
 
 		/* validate column headings */
 		if (i < 0) {
 		    for (j = 0; j < NCOL_2; j++)
 			if (strcmp(ptrs[j], columns_2[j]) != 0) {
-			    fprintf(stderr, "%s: bad column heading in "
-			    			"data file %s\n",
-				myname, THERMODAT_2);
-			    fprintf(stderr, "\tExpected \'%s\' got \'%s\' "
-			    			"in column %d\n",
-				columns_2[j], ptrs[j], j);
-			    error_exit(1);
+			    fclose(input);
+			    sim_fail(SIM_E_DATA, "bad column heading in "
+			    			"data file %s: expected \'%s\' "
+						"got \'%s\' in column %d",
+				THERMODAT_2, columns_2[j], ptrs[j], j);
 			}
 			continue;
 		}
@@ -287,11 +281,20 @@ n2o_thermo_init_2()
 				n2o_temp, n2o_liquid_energy, n);
 }
 
+/*
+ * The tables only depend on use_enthalpy, so they are read once
+ * even when one process runs the simulation many times.
+ */
 void
 n2o_thermo_init()
 {
+	static int loaded_enthalpy = -1;
+
+	if (loaded_enthalpy == use_enthalpy)
+		return;
 	n2o_thermo_init_1();
 	n2o_thermo_init_2();
+	loaded_enthalpy = use_enthalpy;
 }
 
 
@@ -393,3 +396,101 @@ temp_from_vapor_energy(double vapor_energy)
 {
 	return i_i(vapor_energy, ve_temp_ic);
 }
+
+/*
+ * The saturation properties the tank and vent models use, at one
+ * temperature, with the searches started from the segments found last
+ * time.  hint[0] is for the vapor tables and hint[1] for the liquid
+ * tables; start them at 0.  The ratio of specific heats is only
+ * looked up if with_cpcv is set.
+ *
+ * The values are the same as from the routines above.
+ * Returns 0, or the interpolation error as in n2o_thermo_error.
+ */
+int
+n2o_saturation(double temp, struct n2o_saturation_s *sp, int hint[2],
+	int with_cpcv)
+{
+	int r, e;
+	double cp, cv;
+
+	e = 0;
+	if ((r = interpolate_1d_hint(temp, &sp->liquid_density,
+	    liquid_density_ic, &hint[1])) < 0)
+		e = r;
+	if ((r = interpolate_1d_hint(temp, &sp->liquid_energy,
+	    liquid_energy_ic, &hint[1])) < 0)
+		e = r;
+	if ((r = interpolate_1d_hint(temp, &sp->vapor_density,
+	    vapor_density_ic, &hint[0])) < 0)
+		e = r;
+	if ((r = interpolate_1d_hint(temp, &sp->vapor_energy,
+	    vapor_energy_ic, &hint[0])) < 0)
+		e = r;
+	if ((r = interpolate_1d_hint(temp, &sp->pressure,
+	    vapor_pressure_ic, &hint[0])) < 0)
+		e = r;
+	if (with_cpcv) {
+		if ((r = interpolate_1d_hint(temp, &cp, Cp_ic, &hint[0])) < 0)
+			e = r;
+		if ((r = interpolate_1d_hint(temp, &cv, Cv_ic, &hint[0])) < 0)
+			e = r;
+		sp->cpcv = cp / cv;
+	}
+	return e;
+}
+
+/*
+ * Slopes of the saturation properties with respect to temperature,
+ * from the same table segments as the values above.
+ * Used for differentiating the simulation.
+ */
+static double
+i_i_slope(double x, void *ic)
+{
+	double y, slope;
+
+	interpolate_1d_slope(x, &y, &slope, ic);
+	return slope;
+}
+
+double
+liquid_density_slope(double temp)
+{
+	return i_i_slope(temp, liquid_density_ic);
+}
+
+double
+vapor_density_slope(double temp)
+{
+	return i_i_slope(temp, vapor_density_ic);
+}
+
+double
+saturation_pressure_slope(double temp)
+{
+	return i_i_slope(temp, vapor_pressure_ic);
+}
+
+double
+liquid_energy_slope(double temp)
+{
+	return i_i_slope(temp, liquid_energy_ic);
+}
+
+double
+vapor_energy_slope(double temp)
+{
+	return i_i_slope(temp, vapor_energy_ic);
+}
+
+double
+cpcv_slope(double temp)
+{
+	double cp, cv;
+
+	cp = i_i(temp, Cp_ic);
+	cv = i_i(temp, Cv_ic);
+	return (i_i_slope(temp, Cp_ic) * cv - cp * i_i_slope(temp, Cv_ic)) /
+		(cv * cv);
+}
@@ -0,0 +1,600 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Design Optimizer
+ *
+ * Searches for the design that maximizes an objective, varying some of
+ * the design parameters within bounds.  The search is Nelder-Mead on
+ * the parameters scaled to [0, 1].
+ *
+ * The optimizer is described by a spec file:
+ *
+ *	objective	impulse		# or isp, or impulse/wetmass
+ *	iterations	200
+ *	workers		4
+ *	tolerance	1e-4
+ *	penalty		10
+ *	tankdia		3 5 in
+ *	nozzlethroat	.5 1 in
+ *	injectorcount	4 12
+ *
+ * Each variable line gives the parameter, its lower and upper bounds,
+ * and the unit if it has one.  The run starts from the design's value,
+ * or from the middle of the bounds if the design value is outside them.
+ * The injector counts are whole numbers to design_setup(), so they are
+ * rounded before each run, and reported rounded.
+ *
+ * The constraints are the simulator's warnings: N2O flux, core to
+ * throat area ratio, injector pressure drop ratio and exit pressure.
+ * Each is measured as a relative violation, and the sum, times the
+ * penalty weight, is subtracted from the scaled objective.  A design
+ * that fails to run is worse than any design that runs.
+ *
+ * Each iteration evaluates the reflection, expansion and both
+ * contractions at once, in forked children, so the step costs one
+ * round of simulations whichever way it goes.  The simulator tables
+ * are loaded before the first fork and shared by every evaluation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include "scio.h"
+#include "rsim.h"
+#include "linkage.h"
+#include "state.h"
+#include "design.h"
+
+extern char *myname;
+
+#define	MAX_VARS	16
+#define	MAX_BATCH	(MAX_VARS + 1)
+
+#define	IMPULSE		1
+#define	AVERAGE_ISP	2
+#define	IMPULSE_PER_WET_MASS 3
+
+#define	REFLECT		1.
+#define	EXPAND		2.
+#define	CONTRACT	.5
+#define	SHRINK		.5
+#define	START_STEP	.1	/* initial simplex, in scaled units */
+
+struct variable_s {
+	struct scio_input_parameter_s *ip;
+	char *unit;		/* as given in the spec, or NULL */
+	double lo, hi;		/* internal units */
+	int whole;		/* a count, rounded */
+};
+
+static char *whole_names[] = {
+	"injectorcount",
+	"fuelinjectorcount",
+	NULL,
+};
+
+/*
+ * One evaluation, as written by the child.
+ */
+struct result_s {
+	int status;		/* 1 when the run finished */
+	double objective;
+	double violation;
+};
+
+/*
+ * The spec.
+ */
+static int objective;
+static int max_iterations;
+static int n_workers;
+static double tolerance;
+static double penalty;
+static int n_vars;
+static struct variable_s vars[MAX_VARS];
+
+static struct result_s *results;	/* shared, MAX_BATCH */
+static double scale;			/* objective of the start point */
+static int n_evaluations;
+
+/*
+ * Accumulated during a run.
+ */
+static double run_impulse;
+static double run_propellant;
+
+/*
+ * Read a variable line: <parameter> <low> <high> [unit]
+ */
+static void
+spec_variable(char **words, int n, int line, int *errors)
+{
+	struct scio_input_parameter_s *ip;
+	struct variable_s *vp;
+	int i;
+
+	ip = design_parameter(words[0]);
+	if (!ip || ip->unit == STRING) {
+		fprintf(stderr, "%s: optimize line %d: unknown keyword or "
+				"numeric parameter %s\n",
+			myname, line, words[0]);
+		(*errors)++;
+		return;
+	}
+	if (n_vars >= MAX_VARS) {
+		fprintf(stderr, "%s: optimize line %d: more than %d "
+				"variables\n", myname, line, MAX_VARS);
+		(*errors)++;
+		return;
+	}
+	if (n != (ip->unit == NUMBER? 3: 4)) {
+		fprintf(stderr, "%s: optimize line %d: expected "
+				"%s <low> <high>%s\n",
+			myname, line, words[0],
+			ip->unit == NUMBER? "": " <unit>");
+		(*errors)++;
+		return;
+	}
+
+	vp = vars + n_vars;
+	vp->ip = ip;
+	vp->whole = 0;
+	for (i = 0; whole_names[i]; i++)
+		if (strcasecmp(ip->name, whole_names[i]) == 0)
+			vp->whole = 1;
+	vp->lo = design_spec_number("optimize", words[1], line, errors);
+	vp->hi = design_spec_number("optimize", words[2], line, errors);
+	vp->unit = NULL;
+	if (ip->unit != NUMBER) {
+		vp->unit = ds_copy(words[3]);
+		vp->lo = scio_f_convert(vp->lo, ip->unit, vp->unit);
+		vp->hi = scio_f_convert(vp->hi, ip->unit, vp->unit);
+	}
+	if (vp->hi <= vp->lo) {
+		fprintf(stderr, "%s: optimize line %d: bad bounds for %s\n",
+			myname, line, words[0]);
+		(*errors)++;
+		return;
+	}
+	n_vars++;
+}
+
+/*
+ * A line of the optimize file.
+ */
+static void
+spec_line(char **words, int n, int line, int *errors)
+{
+	if (strcasecmp(words[0], "objective") == 0 && n == 2) {
+		if (strcasecmp(words[1], "impulse") == 0)
+			objective = IMPULSE;
+		else if (strcasecmp(words[1], "isp") == 0)
+			objective = AVERAGE_ISP;
+		else if (strcasecmp(words[1], "impulse/wetmass") == 0)
+			objective = IMPULSE_PER_WET_MASS;
+		else {
+			fprintf(stderr, "%s: optimize line %d: "
+					"unknown objective %s\n",
+				myname, line, words[1]);
+			(*errors)++;
+		}
+	} else if (strcasecmp(words[0], "iterations") == 0 && n == 2)
+		max_iterations = design_spec_number("optimize", words[1],
+			line, errors);
+	else if (strcasecmp(words[0], "workers") == 0 && n == 2)
+		n_workers = design_spec_number("optimize", words[1],
+			line, errors);
+	else if (strcasecmp(words[0], "tolerance") == 0 && n == 2)
+		tolerance = design_spec_number("optimize", words[1],
+			line, errors);
+	else if (strcasecmp(words[0], "penalty") == 0 && n == 2)
+		penalty = design_spec_number("optimize", words[1],
+			line, errors);
+	else
+		spec_variable(words, n, line, errors);
+}
+
+static void
+spec_read(char *specfile)
+{
+	int errors;
+
+	objective = IMPULSE;
+	max_iterations = 200;
+	n_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	tolerance = 1e-4;
+	penalty = 10.;
+	n_vars = 0;
+
+	errors = design_spec_read("optimize", specfile, spec_line);
+
+	if (n_vars == 0) {
+		fprintf(stderr, "%s: no variables to optimize\n", myname);
+		errors++;
+	}
+	if (max_iterations < 1 || n_workers < 1 || tolerance <= 0. ||
+	    penalty < 0.) {
+		fprintf(stderr, "%s: optimize iterations, workers and "
+				"tolerance must be positive\n", myname);
+		errors++;
+	}
+	if (errors) {
+		fprintf(stderr, "%s: exiting on optimize errors.\n", myname);
+		error_exit(1);
+	}
+}
+
+static void
+optimize_record()
+{
+	run_impulse += thrust * sim_time_step;
+	run_propellant += (n2o_flow_rate + fuel_flow_rate) * sim_time_step;
+}
+
+/*
+ * The sum of the relative constraint violations of the last run.
+ */
+static double
+violation()
+{
+	double v;
+
+	v = 0.;
+	if (warn_n2o_flux)
+		v += warn_n2o_flux_value / WARN_N2O_FLUX_LIMIT - 1.;
+	if (sim_type == HYBRID &&
+	    warn_core_throat_ratio_value < WARN_CORE_THROAT_RATIO_2)
+		v += 1. - warn_core_throat_ratio_value /
+			WARN_CORE_THROAT_RATIO_2;
+	if (warn_injector_pressure)
+		v += 1. - warn_injector_pressure_drop_value /
+			warn_injector_pressure_drop_chamber_value /
+			WARN_INJECTOR_RATIO;
+	if (warn_exit_pressure)
+		v += 1. - warn_exit_pressure_value / WARN_EXIT_PRESSURE;
+	return v;
+}
+
+/*
+ * The value of variable i at scaled point x.
+ */
+static double
+value(int i, double *x)
+{
+	double v;
+
+	v = vars[i].lo + x[i] * (vars[i].hi - vars[i].lo);
+	return vars[i].whole? floor(v + .5): v;
+}
+
+/*
+ * Set up the design at scaled point x.
+ */
+static void
+set_point(double *x)
+{
+	int i;
+
+	design_restore();
+	for (i = 0; i < n_vars; i++) {
+		*(double *)(vars[i].ip->vp) = value(i, x);
+		*(vars[i].ip->nvp) = 1;
+	}
+	design_setup();
+	sim_init();
+}
+
+/*
+ * Run the design at scaled point x.
+ */
+static void
+run_point(double *x, struct result_s *rp)
+{
+	double wet_mass;
+
+	set_point(x);
+	design_fill();
+
+	wet_mass = dry_mass + tank_n2o_mass +
+		(sim_type == HYBRID? fuel_mass: lfuelmass);
+	run_impulse = 0.;
+	run_propellant = 0.;
+	record_data_hook(optimize_record);
+	record_data_init(0., NULL);
+	if (sim_loop() != SIM_OK)
+		error_exit(1);
+	record_data_term();
+	record_data_hook(NULL);
+
+	switch (objective) {
+	    case IMPULSE:
+		rp->objective = run_impulse;
+		break;
+	    case AVERAGE_ISP:
+		rp->objective = run_propellant > 0.?
+			run_impulse / run_propellant / earth_gravity: 0.;
+		break;
+	    case IMPULSE_PER_WET_MASS:
+		rp->objective = run_impulse / wet_mass;
+		break;
+	}
+	rp->violation = violation();
+	rp->status = 1;
+}
+
+/*
+ * Evaluate n points at once.  Returns the values to minimize in f.
+ */
+static void
+evaluate(double x[][MAX_VARS], double *f, int n)
+{
+	int i, running;
+	struct result_s *rp;
+
+	memset(results, 0, n * sizeof (struct result_s));
+	fflush(stdout);
+	fflush(stderr);
+	running = 0;
+	for (i = 0; i < n || running > 0; ) {
+		if (i < n && running < n_workers) {
+			switch (fork()) {
+			    case -1:
+				perror("fork");
+				if (running == 0)
+					error_exit(1);
+				break;
+			    case 0:
+				run_point(x[i], results + i);
+				_exit(0);
+			    default:
+				running++;
+				i++;
+				continue;
+			}
+		}
+		if (wait(NULL) > 0)
+			running--;
+	}
+
+	n_evaluations += n;
+	for (i = 0, rp = results; i < n; i++, rp++)
+		if (rp->status != 1)
+			f[i] = HUGE_VAL;
+		else
+			f[i] = -rp->objective / scale + penalty * rp->violation;
+}
+
+static double
+clamp(double x)
+{
+	return x < 0.? 0.: x > 1.? 1.: x;
+}
+
+/*
+ * Point x + t (x - y), clamped to the bounds.
+ */
+static void
+step(double *to, double *x, double *y, double t)
+{
+	int i;
+
+	for (i = 0; i < n_vars; i++)
+		to[i] = clamp(x[i] + t * (x[i] - y[i]));
+}
+
+/*
+ * Sort the simplex, best first.
+ */
+static void
+sort_simplex(double simplex[][MAX_VARS], double *f)
+{
+	int i, j;
+	double t, tx[MAX_VARS];
+
+	for (i = 1; i <= n_vars; i++)
+		for (j = i; j > 0 && f[j] < f[j - 1]; j--) {
+			t = f[j];
+			f[j] = f[j - 1];
+			f[j - 1] = t;
+			memcpy(tx, simplex[j], sizeof tx);
+			memcpy(simplex[j], simplex[j - 1], sizeof tx);
+			memcpy(simplex[j - 1], tx, sizeof tx);
+		}
+}
+
+static int
+converged(double simplex[][MAX_VARS], double *f)
+{
+	int i, j;
+	double d;
+
+	if (fabs(f[n_vars] - f[0]) > tolerance * (fabs(f[0]) + tolerance))
+		return 0;
+	for (i = 1; i <= n_vars; i++)
+		for (j = 0; j < n_vars; j++) {
+			d = fabs(simplex[i][j] - simplex[0][j]);
+			if (d > tolerance)
+				return 0;
+		}
+	return 1;
+}
+
+static void
+print_point(FILE *output, double *x)
+{
+	int i;
+	double v;
+
+	fprintf(output, "Parameter,Value,Unit\n");
+	for (i = 0; i < n_vars; i++) {
+		v = value(i, x);
+		if (vars[i].unit)
+			fprintf(output, "%s,%.6e,%s\n", vars[i].ip->name,
+				scio_convert(v, vars[i].ip->unit,
+					vars[i].unit),
+				vars[i].unit);
+		else
+			fprintf(output, "%s,%.6e,\n", vars[i].ip->name, v);
+	}
+	fprintf(output, "\n");
+}
+
+/*
+ * Optimize the design.  The design must have been parsed.
+ */
+void
+optimize(char *specfile, FILE *output)
+{
+	int i, j, iteration;
+	double simplex[MAX_BATCH][MAX_VARS], f[MAX_BATCH];
+	double centroid[MAX_VARS];
+	double trial[4][MAX_VARS], ft[4];
+	double v;
+
+	spec_read(specfile);
+	design_save();
+
+	results = mmap(NULL, MAX_BATCH * sizeof (struct result_s),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (results == MAP_FAILED) {
+		perror("mmap");
+		error_exit(1);
+	}
+
+	/*
+	 * The start point, and a step along each axis.
+	 */
+	for (j = 0; j < n_vars; j++) {
+		v = *(double *)(vars[j].ip->vp);
+		if (*(vars[j].ip->nvp) == 0 ||
+		    v < vars[j].lo || v > vars[j].hi)
+			simplex[0][j] = .5;
+		else
+			simplex[0][j] = (v - vars[j].lo) /
+				(vars[j].hi - vars[j].lo);
+	}
+	for (i = 1; i <= n_vars; i++) {
+		memcpy(simplex[i], simplex[0], sizeof simplex[0]);
+		if (simplex[0][i - 1] + START_STEP <= 1.)
+			simplex[i][i - 1] += START_STEP;
+		else
+			simplex[i][i - 1] -= START_STEP;
+	}
+
+	/*
+	 * Load the tables once, here, so the children share them.
+	 */
+	set_point(simplex[0]);
+
+	/*
+	 * Scale the objective by its value at the start point,
+	 * so that the penalty weight means the same for any objective.
+	 */
+	scale = 1.;
+	evaluate(simplex, f, n_vars + 1);
+	if (results[0].status == 1 && results[0].objective != 0.) {
+		scale = fabs(results[0].objective);
+		for (i = 0; i <= n_vars; i++)
+			if (results[i].status == 1)
+				f[i] = -results[i].objective / scale +
+					penalty * results[i].violation;
+	}
+
+	fprintf(output, "SECTION,optimization history\n");
+	fprintf(output, "iteration,evaluations,best,worst\n");
+	for (iteration = 0; iteration < max_iterations; iteration++) {
+		sort_simplex(simplex, f);
+		fprintf(output, "%d,%d,%e,%e\n",
+			iteration, n_evaluations, f[0], f[n_vars]);
+		if (f[0] < HUGE_VAL && converged(simplex, f))
+			break;
+
+		for (j = 0; j < n_vars; j++) {
+			centroid[j] = 0.;
+			for (i = 0; i < n_vars; i++)
+				centroid[j] += simplex[i][j];
+			centroid[j] /= n_vars;
+		}
+
+		/*
+		 * Reflection, expansion, outside and inside contraction.
+		 */
+		step(trial[0], centroid, simplex[n_vars], REFLECT);
+		step(trial[1], centroid, simplex[n_vars], EXPAND);
+		step(trial[2], centroid, simplex[n_vars], CONTRACT * REFLECT);
+		step(trial[3], centroid, simplex[n_vars], -CONTRACT);
+		evaluate(trial, ft, 4);
+
+		if (ft[0] < f[0])
+			i = ft[1] < ft[0]? 1: 0;
+		else if (ft[0] < f[n_vars - 1])
+			i = 0;
+		else if (ft[0] < f[n_vars] && ft[2] <= ft[0])
+			i = 2;
+		else if (ft[0] >= f[n_vars] && ft[3] < f[n_vars])
+			i = 3;
+		else
+			i = -1;		/* shrink */
+
+		if (i >= 0) {
+			memcpy(simplex[n_vars], trial[i], sizeof trial[i]);
+			f[n_vars] = ft[i];
+			continue;
+		}
+
+		for (i = 1; i <= n_vars; i++)
+			for (j = 0; j < n_vars; j++)
+				simplex[i][j] = simplex[0][j] + SHRINK *
+					(simplex[i][j] - simplex[0][j]);
+		evaluate(simplex + 1, f + 1, n_vars);
+	}
+	fprintf(output, "END-OF-DATA\n\n");
+
+	sort_simplex(simplex, f);
+	if (f[0] == HUGE_VAL) {
+		fprintf(stderr, "%s: no design could be run\n", myname);
+		error_exit(1);
+	}
+
+	/*
+	 * Run the best design here, for its report and warnings.
+	 */
+	run_point(simplex[0], results);
+	fprintf(output, "SECTION,optimization\n");
+	fprintf(output, "objective,value,violation,iterations,evaluations\n");
+	fprintf(output, "%s,%e,%e,%d,%d\n\n",
+		objective == IMPULSE? "impulse":
+		objective == AVERAGE_ISP? "isp": "impulse/wetmass",
+		results->objective, results->violation, iteration,
+		n_evaluations);
+	fprintf(output, "SECTION,optimum\n");
+	print_point(output, simplex[0]);
+	design_report(output);
+	fprintf(output, "SECTION,errors\n");
+	print_errors(output);
+	fprintf(output, "\n");
+	fflush(output);
+	munmap(results, MAX_BATCH * sizeof (struct result_s));
+}
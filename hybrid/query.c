@@ -0,0 +1,801 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Queries the sweep store that hsim -A writes (see store.c).
+ *
+ *	query -w drymass=:8 -w "warn n2o flux=0:0" -w status=0:0 \
+ *		-s "-total impulse" -n 1 sweep.store
+ *
+ * is the design with the most impulse at no more than 8 kg dry mass
+ * and without an n2o flux warning.  Each -w keeps the rows with a
+ * column between two values, either of which may be left out, or a
+ * text column equal to a word.  The store keeps the least and greatest
+ * value of each column in each block of rows, so a block that cannot
+ * hold a match is passed over without reading its rows; the rest are
+ * filtered a column at a time.
+ *
+ *	query -w status=0:0 -p "total impulse+,drymass-" sweep.store
+ *
+ * is the Pareto front of impulse against dry mass: the runs no other
+ * run beats on one objective without losing on another.  A + objective
+ * is maximized and a - one minimized.  Two or three objectives take
+ * O(n log n): sort on the first and sweep, keeping the best of the
+ * second (and, for three, the best third for each rank of the second
+ * in a Fenwick tree).  More objectives are checked against the front
+ * so far, in order of their sum.
+ *
+ * The rows are written as csv: the run, and the columns named by -c or
+ * else the ones the query uses.
+ */
+
+char *Version = "Sweep Query 1.0";
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include "colstore.h"
+
+#define	MAX_TERMS	32
+
+char *myname;
+
+static struct colstore_s store;
+static char *store_name;
+
+/* -w: a range of a numeric column, or a word of a text column */
+static struct filter_s {
+	char	*name;
+	int	column;
+	double	lo, hi;
+	char	*word;
+} filters[MAX_TERMS];
+static int n_filters;
+
+/* -p: the objectives, with 1 to maximize and -1 to minimize */
+static struct objective_s {
+	char	*name;
+	int	column;
+	int	sign;
+} objectives[MAX_TERMS];
+static int n_objectives;
+
+static char *shown[MAX_TERMS];		/* -c */
+static int n_shown;
+static int show_columns[MAX_TERMS + 2 * MAX_TERMS + 2];
+static int n_show;
+
+static char *sort_name;			/* -s */
+static int sort_column;
+static int sort_sign;
+static long limit;			/* -n */
+static int list_mode;			/* -l */
+static int verbose;			/* -v */
+
+/*
+ * The matching rows.  Only the columns the query needs are kept,
+ * a row at a time: value j of row i is match_values[i * n_kept + j].
+ */
+static int kept[MAX_TERMS * 4 + 2];	/* store column of each kept one */
+static int n_kept;
+static double *match_values;
+static char **match_text;		/* likewise, NULL for a numeric */
+static long n_matches, matches_size;
+static char *on_front;
+
+static void
+usage()
+{
+	fprintf(stderr, "Usage: %s <Options> <store>\n", myname);
+	fprintf(stderr, "  Finds the runs in a sweep store, writes them "
+			"as csv on stdout.\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "\t-w <column>=<low>:<high>: rows with the column "
+			"in the range;\n"
+			"\t\teither end may be left out\n");
+	fprintf(stderr, "\t-w <column>=<word>: rows with the text column "
+			"equal to the word\n");
+	fprintf(stderr, "\t-p <column>[+-],...: the Pareto front over "
+			"these objectives,\n"
+			"\t\t+ to maximize (the default), - to minimize\n");
+	fprintf(stderr, "\t-c <column>,...: the columns to write "
+			"(the ones the query uses)\n");
+	fprintf(stderr, "\t-s [-]<column>: sort the rows, - for largest "
+			"first\n");
+	fprintf(stderr, "\t-n <rows>: write at most this many rows\n");
+	fprintf(stderr, "\t-l: list the columns and count the rows\n");
+	fprintf(stderr, "\t-v: say how many blocks were read\n");
+	exit(1);
+}
+
+static int
+find_column(char *name)
+{
+	int c;
+
+	if ((c = colstore_column(&store, name)) < 0) {
+		fprintf(stderr, "%s: %s has no column \"%s\"\n",
+			myname, store_name, name);
+		exit(1);
+	}
+	return c;
+}
+
+static int
+text_column(int c)
+{
+	return c < store.ntext;
+}
+
+/*
+ * A -w option.  Returns true if it is good.
+ */
+static int
+add_filter(char *arg)
+{
+	struct filter_s *fp;
+	char *eq, *colon, *tail;
+
+	if (n_filters == MAX_TERMS || (eq = strchr(arg, '=')) == NULL)
+		return 0;
+	fp = filters + n_filters++;
+	fp->name = strndup(arg, eq - arg);
+	fp->lo = -INFINITY;
+	fp->hi = INFINITY;
+	fp->word = eq + 1;
+	if ((colon = strchr(eq + 1, ':')) == NULL)
+		return 1;
+	fp->word = NULL;
+	if (colon > eq + 1) {
+		fp->lo = strtod(eq + 1, &tail);
+		if (tail != colon)
+			return 0;
+	}
+	if (colon[1]) {
+		fp->hi = strtod(colon + 1, &tail);
+		if (*tail)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * A -p option.  Returns true if it is good.
+ */
+static int
+add_objectives(char *arg)
+{
+	struct objective_s *op;
+	char *p, *name;
+	int n;
+
+	for (p = strtok(arg, ","); p; p = strtok(NULL, ",")) {
+		if (n_objectives == MAX_TERMS)
+			return 0;
+		op = objectives + n_objectives++;
+		n = strlen(p);
+		op->sign = 1;
+		if (n > 1 && (p[n - 1] == '+' || p[n - 1] == '-')) {
+			op->sign = p[n - 1] == '-'? -1: 1;
+			n--;
+		}
+		name = strndup(p, n);
+		op->name = name;
+	}
+	return n_objectives > 0;
+}
+
+static void
+grok_args(int argc, char **argv)
+{
+	int c, errors;
+	char *p;
+
+	myname = *argv;
+	errors = 0;
+	while ((c = getopt(argc, argv, "w:p:c:s:n:lvh")) != EOF)
+	switch (c) {
+	    case 'w':
+		if (!add_filter(optarg)) {
+			fprintf(stderr, "%s: bad -w option \"%s\"\n",
+				myname, optarg);
+			errors++;
+		}
+		break;
+	    case 'p':
+		if (!add_objectives(optarg)) {
+			fprintf(stderr, "%s: bad -p option\n", myname);
+			errors++;
+		}
+		break;
+	    case 'c':
+		for (p = strtok(optarg, ","); p && n_shown < MAX_TERMS;
+		    p = strtok(NULL, ","))
+			shown[n_shown++] = p;
+		break;
+	    case 's':
+		sort_name = optarg;
+		break;
+	    case 'n':
+		limit = atol(optarg);
+		if (limit < 1) {
+			fprintf(stderr, "%s: bad -n option\n", myname);
+			errors++;
+		}
+		break;
+	    case 'l':
+		list_mode++;
+		break;
+	    case 'v':
+		verbose++;
+		break;
+	    case 'h':
+	    case '?':
+	    default:
+		usage();
+	}
+	if (argc - optind != 1) {
+		fprintf(stderr, "%s: one store, please\n", myname);
+		errors++;
+	}
+	if (errors)
+		usage();
+	store_name = argv[optind];
+}
+
+/*
+ * The place of a store column in the kept ones, adding it if need be.
+ */
+static int
+keep(int c)
+{
+	int j;
+
+	for (j = 0; j < n_kept; j++)
+		if (kept[j] == c)
+			return j;
+	kept[n_kept] = c;
+	return n_kept++;
+}
+
+static void
+show(int c)
+{
+	int j;
+
+	c = keep(c);
+	for (j = 0; j < n_show; j++)
+		if (show_columns[j] == c)
+			return;
+	show_columns[n_show++] = c;
+}
+
+/*
+ * Look the names up, and choose the columns to keep and to write.
+ */
+static void
+resolve()
+{
+	int i;
+
+	for (i = 0; i < n_filters; i++) {
+		filters[i].column = find_column(filters[i].name);
+		if (text_column(filters[i].column) != (filters[i].word != NULL)) {
+			fprintf(stderr, "%s: -w %s takes %s\n", myname,
+				filters[i].name, filters[i].word?
+				"a range, <low>:<high>": "a word");
+			exit(1);
+		}
+	}
+	for (i = 0; i < n_objectives; i++) {
+		objectives[i].column = find_column(objectives[i].name);
+		if (text_column(objectives[i].column)) {
+			fprintf(stderr, "%s: %s is text, not an objective\n",
+				myname, objectives[i].name);
+			exit(1);
+		}
+	}
+	if (sort_name) {
+		sort_sign = *sort_name == '-'? -1: 1;
+		sort_column = find_column(sort_name +
+			(*sort_name == '-'));
+	}
+
+	show(find_column("run"));
+	if (n_shown)
+		for (i = 0; i < n_shown; i++)
+			show(find_column(shown[i]));
+	else {
+		for (i = 0; i < n_objectives; i++)
+			show(objectives[i].column);
+		if (sort_name)
+			show(sort_column);
+		for (i = 0; i < n_filters; i++)
+			show(filters[i].column);
+	}
+	for (i = 0; i < n_objectives; i++)
+		objectives[i].column = keep(objectives[i].column);
+	if (sort_name)
+		sort_column = keep(sort_column);
+}
+
+/*
+ * Could the block hold a row that passes the numeric filters?
+ */
+static int
+zone_passes(struct colstore_block_s *bp)
+{
+	struct filter_s *fp;
+	int c;
+
+	for (fp = filters; fp < filters + n_filters; fp++) {
+		if (fp->word)
+			continue;
+		c = fp->column - store.ntext;
+		if (bp->max[c] < fp->lo || bp->min[c] > fp->hi)
+			return 0;
+	}
+	return 1;
+}
+
+static void
+add_match(struct colstore_block_s *bp, char **text, int r)
+{
+	int j, c;
+
+	if (n_matches == matches_size) {
+		matches_size = matches_size? 2 * matches_size: 1024;
+		match_values = realloc(match_values,
+			matches_size * n_kept * sizeof (double));
+		match_text = realloc(match_text,
+			matches_size * n_kept * sizeof (char *));
+		if (!match_values || !match_text) {
+			fprintf(stderr, "%s: cannot malloc %ld matches\n",
+				myname, matches_size);
+			exit(1);
+		}
+	}
+	for (j = 0; j < n_kept; j++) {
+		c = kept[j];
+		if (text_column(c)) {
+			match_text[n_matches * n_kept + j] =
+				strdup(text[r * store.ntext + c]);
+			match_values[n_matches * n_kept + j] = NAN;
+		} else {
+			match_text[n_matches * n_kept + j] = NULL;
+			match_values[n_matches * n_kept + j] =
+				bp->values[(c - store.ntext) * bp->nrows + r];
+		}
+	}
+	n_matches++;
+}
+
+/*
+ * Read the store, keeping the rows that pass every filter.
+ */
+static void
+scan()
+{
+	struct colstore_block_s block;
+	struct filter_s *fp;
+	const double *v;
+	char **text;
+	int *selected;
+	int i, n, r, status;
+	long blocks, skipped, rows;
+
+	blocks = skipped = rows = 0;
+	selected = malloc(COLSTORE_BLOCK * sizeof (int));
+	if (!selected) {
+		fprintf(stderr, "%s: cannot malloc a block\n", myname);
+		exit(1);
+	}
+	while ((status = colstore_next(&store, &block)) > 0) {
+		blocks++;
+		rows += block.nrows;
+		if (!zone_passes(&block)) {
+			skipped++;
+			continue;
+		}
+
+		/* a column at a time, over the rows still selected */
+		for (r = 0; r < block.nrows; r++)
+			selected[r] = r;
+		n = block.nrows;
+		for (fp = filters; fp < filters + n_filters && n > 0; fp++) {
+			if (fp->word)
+				continue;
+			v = block.values + (size_t)(fp->column - store.ntext) *
+				block.nrows;
+			for (i = r = 0; i < n; i++)
+				if (v[selected[i]] >= fp->lo &&
+				    v[selected[i]] <= fp->hi)
+					selected[r++] = selected[i];
+			n = r;
+		}
+		if (n == 0)
+			continue;
+		text = colstore_texts(&store, &block);
+		if (!text) {
+			fprintf(stderr, "%s: cannot malloc a block\n", myname);
+			exit(1);
+		}
+		for (fp = filters; fp < filters + n_filters; fp++) {
+			if (!fp->word)
+				continue;
+			for (i = r = 0; i < n; i++)
+				if (strcmp(text[selected[i] * store.ntext +
+				    fp->column], fp->word) == 0)
+					selected[r++] = selected[i];
+			n = r;
+		}
+		for (i = 0; i < n; i++)
+			add_match(&block, text, selected[i]);
+	}
+	free(selected);
+	if (status < 0)
+		fprintf(stderr, "%s: %s is damaged after row %ld\n",
+			myname, store_name, rows);
+	if (verbose)
+		fprintf(stderr, "%s: %ld rows in %ld blocks, %ld blocks "
+				"passed over, %ld rows match\n",
+			myname, rows, blocks, skipped, n_matches);
+}
+
+/*
+ * Objective k of match i, to be maximized.
+ */
+static double
+objective(long i, int k)
+{
+	return objectives[k].sign *
+		match_values[i * n_kept + objectives[k].column];
+}
+
+static int
+compare_objectives(const void *a, const void *b)
+{
+	long i = *(const long *)a, j = *(const long *)b;
+	double x, y;
+	int k;
+
+	for (k = 0; k < n_objectives && k < 3; k++) {
+		x = objective(i, k);
+		y = objective(j, k);
+		if (x != y)
+			return x > y? -1: 1;
+	}
+	return i < j? -1: i > j? 1: 0;
+}
+
+static int
+same_point(long i, long j)
+{
+	int k;
+
+	for (k = 0; k < n_objectives; k++)
+		if (objective(i, k) != objective(j, k))
+			return 0;
+	return 1;
+}
+
+/* does match i dominate match j? */
+static int
+dominates(long i, long j)
+{
+	int k, better;
+
+	better = 0;
+	for (k = 0; k < n_objectives; k++) {
+		if (objective(i, k) < objective(j, k))
+			return 0;
+		if (objective(i, k) > objective(j, k))
+			better = 1;
+	}
+	return better;
+}
+
+static double *sums;
+
+static int
+compare_sums(const void *a, const void *b)
+{
+	long i = *(const long *)a, j = *(const long *)b;
+
+	if (sums[i] != sums[j])
+		return sums[i] > sums[j]? -1: 1;
+	return i < j? -1: i > j? 1: 0;
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x > y? -1: x < y? 1: 0;
+}
+
+/*
+ * The place of x among the distinct values, best first, counting
+ * from 1 as the Fenwick tree does.
+ */
+static long
+rank_of(double x, double *values, long n)
+{
+	long lo, hi, mid;
+
+	lo = 0;
+	hi = n - 1;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (values[mid] > x)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo + 1;
+}
+
+/*
+ * Mark the matches on the Pareto front.
+ */
+static void
+pareto()
+{
+	long *order, *front;
+	double best, *tree, *ranks;
+	long i, j, g, n, n_front, n_ranks, rank = 0;
+	int k, ok;
+
+	on_front = calloc(n_matches + 1, 1);
+	order = malloc((n_matches + 1) * sizeof (long));
+	if (!on_front || !order) {
+		fprintf(stderr, "%s: cannot malloc the front\n", myname);
+		exit(1);
+	}
+
+	/* a point with a NaN objective is on no front */
+	for (i = n = 0; i < n_matches; i++) {
+		for (ok = 1, k = 0; k < n_objectives; k++)
+			ok &= !isnan(objective(i, k));
+		if (ok)
+			order[n++] = i;
+	}
+
+	if (n_objectives > 3) {
+		sums = malloc((n_matches + 1) * sizeof (double));
+		front = malloc((n + 1) * sizeof (long));
+		if (!sums || !front) {
+			fprintf(stderr, "%s: cannot malloc the front\n",
+				myname);
+			exit(1);
+		}
+		for (i = 0; i < n; i++)
+			for (sums[order[i]] = 0., k = 0; k < n_objectives; k++)
+				sums[order[i]] += objective(order[i], k);
+		qsort(order, n, sizeof (long), compare_sums);
+		n_front = 0;
+		for (i = 0; i < n; i++) {
+			for (j = 0; j < n_front; j++)
+				if (dominates(front[j], order[i]))
+					break;
+			if (j == n_front) {
+				front[n_front++] = order[i];
+				on_front[order[i]] = 1;
+			}
+		}
+		free(front);
+		free(sums);
+		free(order);
+		return;
+	}
+
+	qsort(order, n, sizeof (long), compare_objectives);
+
+	/* the ranks of the second objective, best first */
+	tree = ranks = NULL;
+	n_ranks = 0;
+	if (n_objectives == 3) {
+		ranks = malloc((n + 1) * sizeof (double));
+		tree = malloc((n + 1) * sizeof (double));
+		if (!ranks || !tree) {
+			fprintf(stderr, "%s: cannot malloc the front\n",
+				myname);
+			exit(1);
+		}
+		for (i = 0; i < n; i++)
+			ranks[i] = objective(order[i], 1);
+		qsort(ranks, n, sizeof (double), compare_doubles);
+		for (i = 0; i < n; i++)
+			if (n_ranks == 0 || ranks[i] != ranks[n_ranks - 1])
+				ranks[n_ranks++] = ranks[i];
+		for (i = 0; i <= n_ranks; i++)
+			tree[i] = -INFINITY;
+	}
+
+	/*
+	 * Every point before this one is as good on the first objective.
+	 * Equal points are taken together, so they do not knock each
+	 * other out.
+	 */
+	best = -INFINITY;
+	for (i = 0; i < n; i = g) {
+		for (g = i + 1; g < n && same_point(order[i], order[g]); g++)
+			;
+		if (n_objectives == 1)
+			ok = i == 0;
+		else if (n_objectives == 2)
+			ok = best < objective(order[i], 1);
+		else {
+			/* the best third among seconds at least as good */
+			rank = rank_of(objective(order[i], 1), ranks, n_ranks);
+			best = -INFINITY;
+			for (j = rank; j > 0; j -= j & -j)
+				if (tree[j] > best)
+					best = tree[j];
+			ok = best < objective(order[i], 2);
+		}
+		for (j = i; j < g; j++)
+			on_front[order[j]] = ok;
+		if (n_objectives == 2 && objective(order[i], 1) > best)
+			best = objective(order[i], 1);
+		if (n_objectives == 3)
+			for (j = rank; j <= n_ranks; j += j & -j)
+				if (tree[j] < objective(order[i], 2))
+					tree[j] = objective(order[i], 2);
+	}
+	free(ranks);
+	free(tree);
+	free(order);
+}
+
+static int
+compare_sort(const void *a, const void *b)
+{
+	long i = *(const long *)a, j = *(const long *)b;
+	double x, y;
+	char *s, *t;
+	int c;
+
+	s = match_text[i * n_kept + sort_column];
+	t = match_text[j * n_kept + sort_column];
+	if (s && t)
+		c = strcmp(s, t);
+	else {
+		x = match_values[i * n_kept + sort_column];
+		y = match_values[j * n_kept + sort_column];
+		/* NaN last */
+		if (isnan(x) || isnan(y))
+			return isnan(x) - isnan(y)? isnan(x) - isnan(y):
+				i < j? -1: 1;
+		c = x < y? -1: x > y? 1: 0;
+	}
+	if (c == 0)
+		return i < j? -1: i > j? 1: 0;
+	return c * sort_sign;
+}
+
+static void
+csv_text(char *p)
+{
+	if (strpbrk(p, ",\"\n") == NULL)
+		fputs(p, stdout);
+	else {
+		putchar('"');
+		for (; *p; p++) {
+			if (*p == '"')
+				putchar('"');
+			putchar(*p);
+		}
+		putchar('"');
+	}
+}
+
+static void
+print_matches()
+{
+	long *order;
+	long i, n;
+	int j, c;
+
+	order = malloc((n_matches + 1) * sizeof (long));
+	if (!order) {
+		fprintf(stderr, "%s: cannot malloc the order\n", myname);
+		exit(1);
+	}
+	for (i = n = 0; i < n_matches; i++)
+		if (!on_front || on_front[i])
+			order[n++] = i;
+	if (!sort_name && n_objectives) {
+		/* the front, best first on the first objective */
+		sort_column = objectives[0].column;
+		sort_sign = -objectives[0].sign;
+		sort_name = objectives[0].name;
+	}
+	if (sort_name)
+		qsort(order, n, sizeof (long), compare_sort);
+	if (limit && n > limit)
+		n = limit;
+
+	for (j = 0; j < n_show; j++) {
+		csv_text(store.names[kept[show_columns[j]]]);
+		putchar(j < n_show - 1? ',': '\n');
+	}
+	for (i = 0; i < n; i++)
+		for (j = 0; j < n_show; j++) {
+			c = order[i] * n_kept + show_columns[j];
+			if (match_text[c])
+				csv_text(match_text[c]);
+			else
+				printf("%.10g", match_values[c]);
+			putchar(j < n_show - 1? ',': '\n');
+		}
+	free(order);
+}
+
+/*
+ * The columns, and how many rows and blocks there are.
+ */
+static void
+list()
+{
+	struct colstore_block_s block;
+	long blocks, rows;
+	int i, status;
+
+	printf("column,unit\n");
+	for (i = 0; i < store.ntext + store.ncols; i++) {
+		csv_text(store.names[i]);
+		printf(",%s\n", text_column(i)? "text": store.units[i]);
+	}
+	blocks = rows = 0;
+	while ((status = colstore_next(&store, &block)) > 0) {
+		blocks++;
+		rows += block.nrows;
+	}
+	printf("\nrows,%ld\nblocks,%ld\n", rows, blocks);
+	if (status < 0)
+		fprintf(stderr, "%s: %s is damaged after row %ld\n",
+			myname, store_name, rows);
+}
+
+int
+main(int argc, char **argv)
+{
+	grok_args(argc, argv);
+	if (colstore_open(&store, store_name) < 0) {
+		fprintf(stderr, "%s: cannot read store %s: %s\n", myname,
+			store_name, errno == EINVAL? "not a store":
+			strerror(errno));
+		exit(1);
+	}
+	if (list_mode) {
+		list();
+		exit(0);
+	}
+	resolve();
+	scan();
+	if (n_objectives)
+		pareto();
+	print_matches();
+	colstore_close(&store);
+	exit(0);
+}
@@ -19,80 +19,328 @@
 
 /*
  * Function to record the data at each time step
+ *
+ * The timeseries is written as CSV, or with timeseries_format set to
+ * TS_F64 or TS_F32, as a "binary timeseries" section:
+ *
+ *	SECTION,binary timeseries
+ *	format,f64,<columns>		(or f32)
+ *	<name>,<unit>			(one line per column)
+ *	BLOCK,<rows>
+ *	<rows * columns little-endian IEEE values, row by row>
+ *	BLOCK,<rows>
+ *	...
+ *	END-OF-DATA
+ *
+ * The binary values are exact (or float precise), where the CSV has
+ * csv_precision decimal places (six, as "%f").  CSV rows are formatted
+ * by rowfmt and written in large chunks.
+ *
+ * The recording policy decides which steps become rows:
+ *
+ *	record_interval	at least this many seconds of simulated time
+ *			between rows, whatever the solver time step.
+ *	RECORD_DEADBAND	a row only when some column has changed by more
+ *			than record_deadband (relative) since the last row.
+ *	RECORD_SUMMARY	no timeseries section at all.
+ *
+ * Under a policy that skips rows, the first and last steps are always
+ * written, so the trace keeps its ends.  The hook sees every step
+ * whatever the policy, so summaries and sweeps do not change.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rowfmt.h"
 #include "state.h"
 #include "linkage.h"
 
+struct column_s {
+	char *name;
+	char *unit;
+	double *vp;
+};
+
+static struct column_s hybrid_columns[] = {
+	{ "time",		"seconds",		&sim_time, },
+	{ "tank energy",	"joules",		&tank_energy, },
+	{ "tank n2o mass",	"kg",			&tank_n2o_mass, },
+	{ "tank pressure",	"pascal",		&tank_pressure, },
+	{ "tank temperature",	"kelvin",		&tank_temperature, },
+	{ "n2o liquid mass",	"kg",			&n2o_liquid_mass, },
+	{ "n2o liquid density",	"kg/meters**3",		&n2o_liquid_density, },
+	{ "fuel mass",		"kg",			&fuel_mass, },
+	{ "grain core",		"meters",		&grain_core, },
+	{ "fuel rb",		"meters/second",	&fuel_rb, },
+	{ "chamber pressure",	"pascal",		&chamber_pressure, },
+	{ "c star",		"meters/second",	&c_star, },
+	{ "n2o flow rate",	"kg/second",		&n2o_flow_rate, },
+	{ "n2o vent rate",	"kg/second",		&n2o_vent_rate, },
+	{ "n2o flux",		"kg/second/meters**2",	&n2o_flux, },
+	{ "fuel flow rate",	"kg/second",		&fuel_flow_rate, },
+	{ "isp",		"meters/second",	&isp, },
+	{ "nozzle cf",		"",			&nozzle_cf, },
+	{ "thrust",		"newtons",		&thrust, },
+	{ "exit pressure",	"pascal",		&exit_pressure, },
+};
+
+static struct column_s liquid_columns[] = {
+	{ "time",		"seconds",		&sim_time, },
+	{ "tank energy",	"joules",		&tank_energy, },
+	{ "tank n2o mass",	"kg",			&tank_n2o_mass, },
+	{ "tank pressure",	"pascal",		&tank_pressure, },
+	{ "tank temperature",	"kelvin",		&tank_temperature, },
+	{ "n2o liquid mass",	"kg",			&n2o_liquid_mass, },
+	{ "n2o liquid density",	"kg/meters**3",		&n2o_liquid_density, },
+	{ "liquid fuel mass",	"kg",			&lfuelmass, },
+	{ "liquid fuel volume",	"meters**3",		&lfuelvolume, },
+	{ "nitrogen pressure",	"pascal",		&nitrogen_pressure, },
+	{ "chamber pressure",	"pascal",		&chamber_pressure, },
+	{ "c star",		"meters/second",	&c_star, },
+	{ "n2o flow rate",	"kg/second",		&n2o_flow_rate, },
+	{ "n2o vent rate",	"kg/second",		&n2o_vent_rate, },
+	{ "n2o flux",		"kg/second/meters**2",	&n2o_flux, },
+	{ "fuel flow rate",	"kg/second",		&fuel_flow_rate, },
+	{ "isp",		"meters/second",	&isp, },
+	{ "nozzle cf",		"",			&nozzle_cf, },
+	{ "thrust",		"newtons",		&thrust, },
+	{ "exit pressure",	"pascal",		&exit_pressure, },
+};
+
+#define	N_COLUMNS	(sizeof (hybrid_columns) / sizeof (hybrid_columns[0]))
+#define	BLOCK_ROWS	256
+
 static double last_time;
 static double step;
 static FILE *output;
+static void (*hook)();
+static struct column_s *columns;
+
+static int mode;
+static double interval;
+static double deadband;
+static double row[N_COLUMNS];		/* the step just recorded */
+static double written[N_COLUMNS];	/* the last row written */
+static int rows_written;
+static int pending;			/* row is newer than written */
+
+static unsigned char block[BLOCK_ROWS * N_COLUMNS * sizeof (double)];
+static int block_rows;
+static struct rowfmt_s csv;
+
+/*
+ * The hook, if any, is called at every recorded step.
+ * With no output file only the hook is called.
+ * Returns the previous hook, for a hook that passes the step on.
+ */
+void
+(*record_data_hook(void (*fn)()))()
+{
+	void (*previous)();
+
+	previous = hook;
+	hook = fn;
+	return previous;
+}
+
+static void
+pick_columns()
+{
+	switch (sim_type) {
+	    case HYBRID:
+		columns = hybrid_columns;
+		break;
+	    case LIQUID:
+		columns = liquid_columns;
+		break;
+	    default:
+		sim_fail(SIM_E_INTERNAL, "BAD SIM TYPE in record_data.c");
+	}
+}
+
+/*
+ * The column names, for a hook that wants the row.
+ * Returns the number of columns, at most RECORD_COLUMNS_MAX.
+ */
+int
+record_data_names(char **names)
+{
+	int i;
+
+	pick_columns();
+	for (i = 0; i < N_COLUMNS; i++)
+		names[i] = columns[i].name;
+	return N_COLUMNS;
+}
+
+/*
+ * The row for the step being recorded, for a hook.
+ */
+void
+record_data_values(double *values)
+{
+	int i;
+
+	for (i = 0; i < N_COLUMNS; i++)
+		values[i] = *columns[i].vp;
+}
 
 void
 record_data_init(double s, FILE *out)
 {
+	int i;
+
 	output = out;
 	step = s;
 	last_time = 0.;
+	block_rows = 0;
+	mode = record_mode < 0? RECORD_ALL: record_mode;
+	interval = record_interval < 0.? 0.: record_interval;
+	deadband = record_deadband < 0.? RECORD_DEADBAND_DEFAULT:
+		record_deadband;
+	rows_written = 0;
+	pending = 0;
+	pick_columns();
+	if (mode == RECORD_SUMMARY)
+		output = NULL;
+	if (!output)
+		return;
+
+	if (timeseries_format != TS_CSV) {
+		fprintf(output, "SECTION,binary timeseries\n");
+		fprintf(output, "format,%s,%d\n",
+			timeseries_format == TS_F32? "f32": "f64",
+			(int)N_COLUMNS);
+		for (i = 0; i < N_COLUMNS; i++)
+			fprintf(output, "%s,%s\n", columns[i].name,
+				columns[i].unit);
+		return;
+	}
+
 	fprintf(output, "SECTION,timeseries\n");
-	switch (sim_type) {
-	    case HYBRID:
-		fprintf(output, 
-			"time,"
-			"tank energy,"
-			"tank n2o mass,"
-			"tank pressure,"
-			"tank temperature,"
-			"n2o liquid mass,"
-			"n2o liquid density,"
-			"fuel mass,"
-			"grain core,"
-			"fuel rb,"
-			"chamber pressure,"
-			"c star,"
-			"n2o flow rate,"
-			"n2o vent rate,"
-			"n2o flux,"
-			"fuel flow rate,"
-			"isp,"
-			"nozzle cf,"
-			"thrust,"
-			"exit pressure\n");
+	for (i = 0; i < N_COLUMNS; i++)
+		fprintf(output, "%s%c", columns[i].name,
+			i < N_COLUMNS - 1? ',': '\n');
+	rowfmt_init(&csv, output, csv_precision);
+}
+
+/*
+ * Store v little-endian at p, in n bytes.
+ */
+static void
+put_le(unsigned char *p, void *v, int n)
+{
+	static const union {
+		int i;
+		char c;
+	} endian = { 1 };
+	int i;
+
+	if (endian.c)
+		memcpy(p, v, n);
+	else
+		for (i = 0; i < n; i++)
+			p[i] = ((unsigned char *)v)[n - 1 - i];
+}
+
+static void
+flush_block()
+{
+	int size;
+
+	if (block_rows == 0)
+		return;
+	size = timeseries_format == TS_F32? sizeof (float): sizeof (double);
+	fprintf(output, "BLOCK,%d\n", block_rows);
+	fwrite(block, size * N_COLUMNS, block_rows, output);
+	fflush(output);
+	block_rows = 0;
+}
+
+/*
+ * Write the recorded step.
+ */
+static void
+write_row()
+{
+	int i;
+	float f;
+	unsigned char *p;
+
+	memcpy(written, row, sizeof row);
+	rows_written++;
+	pending = 0;
+
+	switch (timeseries_format) {
+	    case TS_F64:
+		p = block + block_rows * N_COLUMNS * sizeof (double);
+		for (i = 0; i < N_COLUMNS; i++, p += sizeof (double))
+			put_le(p, &row[i], sizeof (double));
+		if (++block_rows == BLOCK_ROWS)
+			flush_block();
+		break;
+	    case TS_F32:
+		p = block + block_rows * N_COLUMNS * sizeof (float);
+		for (i = 0; i < N_COLUMNS; i++, p += sizeof (float)) {
+			f = row[i];
+			put_le(p, &f, sizeof (float));
+		}
+		if (++block_rows == BLOCK_ROWS)
+			flush_block();
 		break;
-	    case LIQUID:
-		fprintf(output, 
-			"time,"
-			"tank energy,"
-			"tank n2o mass,"
-			"tank pressure,"
-			"tank temperature,"
-			"n2o liquid mass,"
-			"n2o liquid density,"
-			"liquid fuel mass,"
-			"liquid fuel volume,"
-			"nitrogen pressure,"
-			"chamber pressure,"
-			"c star,"
-			"n2o flow rate,"
-			"n2o vent rate,"
-			"n2o flux,"
-			"fuel flow rate,"
-			"isp,"
-			"nozzle cf,"
-			"thrust,"
-			"exit pressure\n");
-	    	break;
 	    default:
-	    	fprintf(stderr, "BAD SIM TYPE in record_data.c\n");
-		exit(1);
+		for (i = 0; i < N_COLUMNS - 1; i++) {
+			rowfmt_double(&csv, row[i]);
+			rowfmt_text(&csv, ",");
+		}
+		rowfmt_double(&csv, row[i]);
+		rowfmt_text(&csv, "\n ");
+		break;
 	}
 }
 
+/*
+ * Has some column, other than time, moved out of the deadband?
+ */
+static int
+moved()
+{
+	int i;
+	double d, m;
+
+	for (i = 1; i < N_COLUMNS; i++) {
+		d = fabs(row[i] - written[i]);
+		m = fmax(fabs(row[i]), fabs(written[i]));
+		if (d > deadband * m)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Write out the rows recorded so far, as when a run stops short.
+ */
+void
+record_data_flush()
+{
+	if (!output)
+		return;
+	if (timeseries_format != TS_CSV)
+		flush_block();
+	else
+		rowfmt_flush(&csv);
+}
+
 void
 record_data_term()
 {
+	if (!output)
+		return;
+	if (pending)
+		write_row();
+	record_data_flush();
 	fprintf(output, "END-OF-DATA\n\n");
 	fflush(output);
 }
@@ -104,51 +352,18 @@ record_data()
 		return;
 	last_time = sim_time;
 
-	switch (sim_type) {
-	    case HYBRID:
-		fprintf(output,"%f,", sim_time);
-		fprintf(output,"%f,", tank_energy);
-		fprintf(output,"%f,", tank_n2o_mass);
-		fprintf(output,"%f,", tank_pressure);
-		fprintf(output,"%f,", tank_temperature);
-		fprintf(output,"%f,", n2o_liquid_mass);
-		fprintf(output,"%f,", n2o_liquid_density);
-		fprintf(output,"%f,", fuel_mass);
-		fprintf(output,"%f,", grain_core);
-		fprintf(output,"%f,", fuel_rb);
-		fprintf(output,"%f,", chamber_pressure);
-		fprintf(output,"%f,", c_star);
-		fprintf(output,"%f,", n2o_flow_rate);
-		fprintf(output,"%f,", n2o_vent_rate);
-		fprintf(output,"%f,", n2o_flux);
-		fprintf(output,"%f,", fuel_flow_rate);
-		fprintf(output,"%f,", isp);
-		fprintf(output,"%f,", nozzle_cf);
-		fprintf(output,"%f,", thrust);
-		fprintf(output,"%f\n ", exit_pressure);
-		break;
-	    case LIQUID:
-		fprintf(output,"%f,", sim_time);
-		fprintf(output,"%f,", tank_energy);
-		fprintf(output,"%f,", tank_n2o_mass);
-		fprintf(output,"%f,", tank_pressure);
-		fprintf(output,"%f,", tank_temperature);
-		fprintf(output,"%f,", n2o_liquid_mass);
-		fprintf(output,"%f,", n2o_liquid_density);
-		fprintf(output, "%f,", lfuelmass);
-		fprintf(output, "%f,", lfuelvolume);
-		fprintf(output, "%f,", nitrogen_pressure);
-		fprintf(output,"%f,", chamber_pressure);
-		fprintf(output,"%f,", c_star);
-		fprintf(output,"%f,", n2o_flow_rate);
-		fprintf(output,"%f,", n2o_vent_rate);
-		fprintf(output,"%f,", n2o_flux);
-		fprintf(output,"%f,", fuel_flow_rate);
-		fprintf(output,"%f,", isp);
-		fprintf(output,"%f,", nozzle_cf);
-		fprintf(output,"%f,", thrust);
-		fprintf(output,"%f\n ", exit_pressure);
-		break;
+	if (hook)
+		(*hook)();
+	if (!output)
+		return;
+
+	record_data_values(row);
+	if (rows_written > 0 &&
+	    ((interval > 0. &&
+	      row[0] + sim_time_step / 2. < written[0] + interval) ||
+	     (mode == RECORD_DEADBAND && !moved()))) {
+		pending = 1;
+		return;
 	}
-	fflush(output);
+	write_row();
 }
@@ -29,31 +29,118 @@ char *Version = "Report Generator 1.0";
 #include <string.h>
 #include <strings.h>
 #include <getopt.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include "rsim.h"
+#include "csvscan.h"
 #include "ts_parse.h"
 #include "scio.h"
 #include "rocksim.h"
+#include "report_stats.h"
 
 char *myname;
-FILE *input;
-char *input_file_name;
 int rocksim_mode;
 int html_mode;
 char * rocksim_output_name;
 FILE *rocksim_output;
 int debug;
+double thrust_error = REPORT_THRUST_ERROR;
+double impulse_error = REPORT_IMPULSE_ERROR;
+int compare_mode;		/* 1 text table, 2 csv table */
+char *sort_metric;
+int n_threads;
 
-const double g = 32.174 * 0.3048;
+/*
+ * One input file, and what the report has made of it.  Runs are
+ * parsed by several threads at once, so everything a parse touches
+ * lives here.
+ */
+struct run_s {
+	char	*name;
+	int	order;		/* the place it was given in, for ties */
+	FILE	*input;
+	struct report_s report;
+	struct csvscan_s scan;
+
+	/* the timeseries row, and the columns of it that the report uses */
+	double	*row;
+	char	*wanted;
+	int	row_columns;
+
+	/* the errors section */
+	char	*saved_text;
+	int	saved_n_bytes;
+	int	saved_size;
+
+	int	status;		/* 1 END-OF-DATA found, 0 not, -1 no data */
+	struct report_summary_s summary;
+	int	n_errors;
+	int	n_warnings;
+};
+
+static struct run_s *runs;
+static int n_runs;
+static int next_run;		/* shared by the parse threads */
+static pthread_mutex_t next_run_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * The comparison table's columns; -s sorts on any of them.
+ */
+static struct metric_s {
+	char	*name;		/* for -s */
+	char	*heading;	/* in the csv table */
+} metrics[] = {
+	{ "file",	"file",		  },
+#define	M_FILE		0
+	{ "impulse",	"total impulse",  },
+#define	M_IMPULSE	1
+	{ "thrust",	"average thrust", },
+#define	M_THRUST	2
+	{ "peak",	"peak thrust",	  },
+#define	M_PEAK		3
+	{ "burn",	"burn time",	  },
+#define	M_BURN		4
+	{ "class",	"motor class",	  },
+#define	M_CLASS		5
+	{ "of_init",	"initial O/F",	  },
+#define	M_OF_INIT	6
+	{ "of_final",	"final O/F",	  },
+#define	M_OF_FINAL	7
+	{ "errors",	"errors",	  },
+#define	M_ERRORS	8
+	{ "warnings",	"warnings",	  },
+#define	M_WARNINGS	9
+	{ (char *)0, },
+};
 
 static void
 usage()
 {
-	fprintf(stderr, "Usage: %s <Options>\n", myname);
+	struct metric_s *mp;
+
+	fprintf(stderr, "Usage: %s <Options> [file|directory ...]\n", myname);
 	fprintf(stderr, "  Reads raw data on stdin, produces "
 			"report on stdout.\n");
+	fprintf(stderr, "  Given several files, or a directory of them, "
+			"produces a table\n  comparing the runs.\n");
 	fprintf(stderr, "Options:\n");
 	fprintf(stderr, "\t-r (rockim file (%s)>\n",
 		rocksim_output_name? rocksim_output_name: "none");
+	fprintf(stderr, "\t-c: comparison table, as text\n");
+	fprintf(stderr, "\t-C: comparison table, as csv\n");
+	fprintf(stderr, "\t-s [-]<metric>: sort the table, "
+			"- for largest first:\n\t\t");
+	for (mp = metrics; mp->name; mp++)
+		fprintf(stderr, "%s%s", mp->name, mp[1].name? ", ": "\n");
+	fprintf(stderr, "\t-j <threads>: parse this many files at once "
+			"(%ld)\n", sysconf(_SC_NPROCESSORS_ONLN));
+	fprintf(stderr, "\t-e <thrust error>[,<impulse error>]: how far "
+			"the rocksim curve may be\n"
+			"\t\tfrom the run, as fractions of the peak thrust "
+			"and total impulse\n"
+			"\t\t(%g,%g)\n",
+		REPORT_THRUST_ERROR, REPORT_IMPULSE_ERROR);
 	exit(1);
 }
 
@@ -64,21 +151,76 @@ set_defaults()
 	rocksim_mode = 0;
 	html_mode = 0;
 	rocksim_output_name = (char *)0;
+	compare_mode = 0;
+	sort_metric = (char *)0;
+	n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+/*
+ * Add a run for the file, or for each file in the directory, in name
+ * order.  Returns the number of errors.
+ */
+static int
+add_runs(char *name)
+{
+	struct stat st;
+	struct dirent **list;
+	char *path;
+	int i, n;
+
+	if (stat(name, &st) < 0 || !S_ISDIR(st.st_mode)) {
+		runs = realloc(runs, (n_runs + 1) * sizeof *runs);
+		if (runs == NULL) {
+			fprintf(stderr, "%s: cannot malloc the runs\n",
+				myname);
+			exit(1);
+		}
+		memset(runs + n_runs, 0, sizeof *runs);
+		runs[n_runs].order = n_runs;
+		runs[n_runs++].name = name;
+		return 0;
+	}
+
+	compare_mode = compare_mode? compare_mode: 1;
+	if ((n = scandir(name, &list, NULL, alphasort)) < 0) {
+		fprintf(stderr, "%s: cannot read directory %s\n",
+			myname, name);
+		perror("scandir");
+		return 1;
+	}
+	for (i = 0; i < n; i++) {
+		path = malloc(strlen(name) + strlen(list[i]->d_name) + 2);
+		if (path == NULL) {
+			fprintf(stderr, "%s: cannot malloc a path\n", myname);
+			exit(1);
+		}
+		sprintf(path, "%s/%s", name, list[i]->d_name);
+		if (list[i]->d_name[0] != '.' && stat(path, &st) == 0 &&
+		    S_ISREG(st.st_mode))
+			add_runs(path);
+		else
+			free(path);
+		free(list[i]);
+	}
+	free(list);
+	return 0;
 }
 
 static void
 grok_args(int argc, char **argv)
 {
-	int c;
+	int c, n;
 	int errors;
 	int nargs;
+	char *p;
+	struct metric_s *mp;
 
 	myname = *argv;
 	set_defaults();
 
 	errors = 0;
 
-	while ((c = getopt(argc, argv, "Hdr:h")) != EOF)
+	while ((c = getopt(argc, argv, "Hdr:e:cCs:j:h")) != EOF)
 	switch (c) {
 
 	    case 'H':
@@ -91,6 +233,39 @@ grok_args(int argc, char **argv)
 	    case 'd':
 	    	debug++;
 		break;
+	    case 'e':
+		n = sscanf(optarg, "%lf,%lf", &thrust_error, &impulse_error);
+		if (n < 1 || thrust_error < 0. || impulse_error < 0.) {
+			fprintf(stderr, "%s: bad -e option\n", myname);
+			errors++;
+		}
+		break;
+
+	    case 'c':
+		compare_mode = 1;
+		break;
+	    case 'C':
+		compare_mode = 2;
+		break;
+	    case 's':
+		sort_metric = optarg;
+		p = *optarg == '-'? optarg + 1: optarg;
+		for (mp = metrics; mp->name; mp++)
+			if (strcmp(p, mp->name) == 0)
+				break;
+		if (mp->name == NULL) {
+			fprintf(stderr, "%s: unknown metric \"%s\"\n",
+				myname, p);
+			errors++;
+		}
+		break;
+	    case 'j':
+		n_threads = atoi(optarg);
+		if (n_threads < 1) {
+			fprintf(stderr, "%s: bad -j option\n", myname);
+			errors++;
+		}
+		break;
 
 	    case 'h':
 	    case '?':
@@ -102,23 +277,30 @@ grok_args(int argc, char **argv)
 	nargs = argc - optind;
 
 	if (nargs == 0) {
-		input = stdin;
-		input_file_name = "(stdin)";
-	} else if (nargs == 1) {
-		input_file_name = argv[optind];
-		input = fopen(input_file_name, "r");
-		if (input == NULL) {
+		add_runs("(stdin)");
+		runs[0].input = stdin;
+	} else
+		for (; optind < argc; optind++)
+			errors += add_runs(argv[optind]);
+	if (nargs > 1)
+		compare_mode = compare_mode? compare_mode: 1;
+
+	if (compare_mode && rocksim_mode) {
+		fprintf(stderr, "%s: -r writes one run; it does not go "
+				"with a comparison\n", myname);
+		errors++;
+	} else if (compare_mode && n_runs == 0) {
+		fprintf(stderr, "%s: no files to compare\n", myname);
+		errors++;
+	} else if (!compare_mode && runs[0].input == NULL) {
+		runs[0].input = fopen(runs[0].name, "r");
+		if (runs[0].input == NULL) {
 			fprintf(stderr, "%s: cannot open data file %s "
 					"for reading\n",
-				myname, input_file_name);
+				myname, runs[0].name);
 			perror("open");
 			errors++;
 		}
-	} else {
-		fprintf(stderr, "%s: only one positional argument "
-				"(input file) allowed\n",
-			myname);
-		errors++;
 	}
 
 	if (rocksim_mode) {
@@ -136,537 +318,319 @@ grok_args(int argc, char **argv)
 		usage();
 }
 
-/*
- * This function reads the simulator input parameters.
- */
-double tank_height;
-double ullage_height;
-double tank_volume;
-double grain_length;
-double grain_diameter;
-double grain_core;
-double nozzle_throat;
-double nozzle_exit;
-double nozzle_cf_adjust;
-double nozzle_half_angle;
-double cstar;
-double cstar_adjust;
-double injector_diameter;
-double injector_cd;
-double injector_count;
-double vent_diameter;
-double vent_cd;
-double fill_temp;
-double fill_pressure_drop;
-double dry_mass;
-double vent_mass;
-double engine_dia;
-double engine_len;
-double supply_press;
-double ambientpressure;
-
-double burn_time;
-
-#define	HYBRID	1
-#define	LIQUID	2
-int sim_type;
-
-char fuel[128];
-
-int tank_height_set;
-int ullage_height_set;
-int tank_volume_set;
-int vent_mass_set;
-int grain_length_set;
-int grain_diameter_set;
-int grain_core_set;
-int nozzle_throat_set;
-int nozzle_exit_set;
-int nozzle_cf_adjust_set;
-int cstar_set;
-int cstar_adjust_set;
-int injector_diameter_set;
-int injector_cd_set;
-int injector_count_set;
-int vent_diameter_set;
-int vent_cd_set;
-int fill_temp_set;
-int fill_pressure_drop_set;
-int dry_mass_set;
-int engine_dia_set;
-int engine_len_set;
-int supply_press_set;
-int ambientpressure_set;
-int nozzle_half_angle_set;
-
-struct input_param_s {
-	char *name;
-	double *value;
-	int *set;
-} input_parameters[] = {
-  { "tankheight",    &tank_height,        &tank_height_set,        },
-  { "ullageheight",  &ullage_height,      &ullage_height_set,      },
-  { "tankvolume",    &tank_volume,        &tank_volume_set,        },
-  { "ventmass",      &vent_mass,          &vent_mass_set,          },
-  { "grainlength",   &grain_length,       &grain_length_set,       },
-  { "graindiameter", &grain_diameter,     &grain_diameter_set,     },
-  { "graincore",     &grain_core,         &grain_core_set,         },
-  { "nozzlethroat",  &nozzle_throat,      &nozzle_throat_set,      },
-  { "nozzleexit",    &nozzle_exit,        &nozzle_exit_set,        },
-  { "nozcfadj",      &nozzle_cf_adjust,   &nozzle_cf_adjust_set,   },
-  { "nozzlehalfangle",&nozzle_half_angle, &nozzle_half_angle_set,  },
-  { "cstaradj",      &cstar_adjust,       &cstar_adjust_set,       },
-  { "injectordia",   &injector_diameter,  &injector_diameter_set,  },
-  { "injectorcd",    &injector_cd,        &injector_cd_set,        },
-  { "injectorcount", &injector_count,     &injector_count_set,     },
-  { "ventdia",       &vent_diameter,      &vent_diameter_set,      },
-  { "ventcd",        &vent_cd,            &vent_cd_set,            },
-  { "filltemp",      &fill_temp,          &fill_temp_set,          },
-  { "filldrop",      &fill_pressure_drop, &fill_pressure_drop_set, },
-  { "supplypress",   &supply_press,       &supply_press_set,       },
-  { "drymass",       &dry_mass,           &dry_mass_set,           },
-  { "enginedia",     &engine_dia,         &engine_dia_set,         },
-  { "enginelen",     &engine_len,         &engine_len_set,         },
-  { "ambientpressure",&ambientpressure,   &ambientpressure_set,    },
-  { (char *)0,       (double *)0,         (int *)0,                },
-};
-
 /*
  * Process lines from the first section of the file.
+ * The first is the column header.
  */
 
 static void
-input_1_headers(int nptrs, char **ptrs)
+input_1_headers(struct run_s *rn, int nptrs, char **ptrs)
 {
-	struct input_param_s *ip;
-
-	/* mark all input parameters as not yet received. */
-	for (ip = input_parameters; ip->name; ip++)
-		*(ip->set) = 0;
 }
 
-/*
- * Find parameter values.
- * Handles "fuel" separately, as it is a string, not a float.
- */
 static void
-input_1(int nptrs, char **ptrs)
+input_1(struct run_s *rn, int nptrs, char **ptrs)
 {
-	struct input_param_s *ip;
-
-	/* search for the match */
-	if (strcmp(ptrs[0], "fuel") == 0)
-		strncpy(fuel, ptrs[1], sizeof fuel);
-	else
-	    for (ip = input_parameters; ip->name; ip++)
-		if (strcmp(ptrs[0], ip->name) == 0) {
-			/* matched */
-			*(ip->value) = atof(ptrs[1]);
-			*(ip->set) += 1;
-			break;
-		}
-}
-
-static void
-print_input1()
-{
-	struct input_param_s *ip;
-
-	for (ip = input_parameters; ip->name; ip++) {
-		printf("%s: ", ip->name);
-		if (*(ip->set))
-			printf("%f\n", *(ip->value));
-		else
-			printf("not set\n");
-	}
+	if (nptrs >= 2)
+		report_parameter(&rn->report, ptrs[0], ptrs[1]);
 }
 
-static char *column_names[] = {
-	"tank n2o mass",
-#define	TANK_N2O_MASS		0
-
-	"tank pressure",
-#define	TANK_PRESSURE		1
-
-	"tank temperature",
-#define	TANK_TEMPERATURE	2
-
-	"n2o liquid mass",
-#define	N2O_LIQUID_MASS		3
-
-	"n2o liquid density",
-#define	N2O_LIQUID_DENSITY	4
-
-	"fuel mass",
-#define	FUEL_MASS		5
-
-	"grain core",
-#define	GRAIN_CORE		6
-
-	"chamber pressure",
-#define	CHAMBER_PRESSURE	7
-
-	"n2o flow rate",
-#define N2O_FLOW_RATE		8
-
-	"n2o vent rate",
-#define	N2O_VENT_RATE		9
-
-	"n2o flux",
-#define	N2O_FLUX		10
-
-	"fuel flow rate",
-#define	FUEL_FLOW_RATE		11
-
-	"isp",
-#define	ISP			12
-
-	"nozzle cf",
-#define	NOZZLE_CF		13
-
-	"thrust",
-#define	THRUST			14
-
-	"exit pressure",
-#define	EXIT_PRESSURE		15
-
-	"XXX O/F RATIO",		/* computed */
-#define	OF_RATIO		16
-
-	"XXX injector pressure ratio",	/* computed */
-#define	IP_RATIO		17
-
-	"time",
-#define BURN_TIME		18
-
-	"liquid fuel mass",
-#define	LFUEL_MASS		19
-
-	"liquid fuel volume",
-#define	LFUEL_VOLUME		20
-
-	"nitrogen pressure",
-#define	LFUEL_PRESSURE		21
-
-	"XXX LF injector pressure ratio",	/* computed */
-#define	IPL_RATIO		22
-};
-
-#define	NCOL	(sizeof (column_names) / sizeof (column_names[0]))
-
-static int column_numbers[NCOL];
-
-static double column_min[NCOL];
-static double column_max[NCOL];
-static double column_sum[NCOL];
-static double column_init[NCOL];
-static double column_final[NCOL];
-
-static int nrow;
-
-#define	RS_MAX_TIMES	10000
-#define	RS_AVERAGE	10		/*average 10 lines together */
-
-static struct rse_datapoint_s *rs_data;
-int rs_n_points;
-int rs_n_av;
-
 /*
- * Compute an impulse class.
- * Doesn't work for smaller than C class engines.
+ * Only the columns that the report uses are converted.
  */
-static char
-impulse_to_class(double impulse)
+static void
+input_2_headers(struct run_s *rn, int nptrs, char **ptrs)
 {
-	char c;
-
-	c = 'C';
-	while (impulse >= 10.) {
-		c++;
-		impulse /= 2;
+	int j;
+
+	report_columns(&rn->report, nptrs, ptrs);
+	rn->row = realloc(rn->row, nptrs * sizeof (double));
+	rn->wanted = realloc(rn->wanted, nptrs);
+	if (!rn->row || !rn->wanted) {
+		fprintf(stderr, "%s: cannot malloc a row of %d columns\n",
+			myname, nptrs);
+		exit(1);
 	}
-	return c;
-}
-
-static double
-impulse_to_class_fraction(double impulse)
-{
-	while (impulse >= 10.)
-		impulse /= 2;
-
-	return (impulse - 5.) / 5.;
+	for (j = 0; j < nptrs; j++) {
+		rn->row[j] = 0.;
+		rn->wanted[j] = report_wanted(&rn->report, j);
+	}
+	rn->row_columns = nptrs;
 }
 
+/* 
+ * This function reads the time-sequence data from the simulator,
+ * one row of values at a time.  A field the report uses is converted
+ * in place, which finds the comma after it; other fields are skipped
+ * with memchr.
+ */
 static void
-rocksim_init()
+input_2(struct run_s *rn, char *line, size_t length)
 {
-	int errors;
-
-	rs_n_points = 0;
-	rs_n_av = 0;
-
-	if (!rocksim_mode)
-		return;
-
-	errors = 0;
-
-	rs_data = (struct rse_datapoint_s *)malloc(
-		RS_MAX_TIMES * sizeof (struct rse_datapoint_s));
-	if (rs_data == (struct rse_datapoint_s *)0) {
-		fprintf(stderr, "%s: failed to malloc memory for "
-				"rocksim data.\n", myname);
-		errors++;
-	}
-
-	if (!dry_mass_set) {
-		fprintf(stderr, "%s: motor dry mass was not specified.\n",
-			myname);
-		errors++;
-	}
-
-	if (errors) {
-		fprintf(stderr, "\tRocksim report disabled\n");
-		rocksim_mode = 0;
-		return;
+	int j;
+	char *p, *q, *end;
+	const char *stop;
+
+	end = line + length;
+	if ((q = memchr(line, '#', length)) != NULL)
+		end = q;
+	for (j = 0, p = line; j < rn->row_columns; j++) {
+		if (rn->wanted[j]) {
+			rn->row[j] = csvscan_double(p, end, &stop);
+			q = (char *)stop;
+			if (q >= end || *q != ',')
+				q = memchr(q, ',', end - q);
+		} else
+			q = memchr(p, ',', end - p);
+		if (!q)
+			break;
+		p = q + 1;
 	}
+	while (++j < rn->row_columns)
+		rn->row[j] = 0.;
+	report_row(&rn->report, rn->row);
 }
 
+/*
+ * Fetch a little-endian value of n bytes from p.
+ */
 static void
-rocksim_point_close()
+get_le(void *v, unsigned char *p, int n)
 {
-	struct rse_datapoint_s *rp;
-
-	if (rs_n_av == 0)
-		return;
-
-	rp = rs_data + rs_n_points;
+	static const union {
+		int i;
+		char c;
+	} endian = { 1 };
+	int i;
 
-	rp->Time /= (double)rs_n_av;
-	rp->Thrust /= (double)rs_n_av;
-	rp->Mass /= (double)rs_n_av;
-	rp->CG /= (double)rs_n_av;
-	
-	rs_n_av = 0;
-	rs_n_points++;
+	if (endian.c)
+		memcpy(v, p, n);
+	else
+		for (i = 0; i < n; i++)
+			((unsigned char *)v)[i] = p[n - 1 - i];
 }
 
 /*
- * Computes the rocksim data points.
- * CG stuff is currently NYI.
+ * The next line, split into fields.  Returns the number of fields,
+ * 0 at the end of the input.
  */
-void
-rocksim_point(double sim_time, double thrust, double fuelmass, double cg)
+static int
+next_fields(struct run_s *rn, char ***ptrs)
 {
-	struct rse_datapoint_s *rp;
-
-	if (!rocksim_mode)
-		return;
-
-	rp = rs_data + rs_n_points;
-	if (rs_n_av == 0) {
-		rp->Time = 0.;
-		rp->Thrust = 0.;
-		rp->Mass = 0.;
-		rp->CG = 0.;
-	}
-	rp->Time += sim_time;
-	rp->Thrust += thrust;
-	rp->Mass += fuelmass;
-	rp->CG += cg;
+	char *line;
+	size_t length;
+	int nptrs;
 
-	if (++rs_n_av >= RS_AVERAGE || rs_n_points == 0)
-		rocksim_point_close();
+	while ((line = csvscan_line(&rn->scan, &length)) != NULL)
+		if ((nptrs = csvscan_fields(&rn->scan, line, length, ptrs)) > 0)
+			return nptrs;
+	return 0;
 }
 
-static void
-input_2_headers(int nptrs, char **ptrs)
+/*
+ * Read a binary timeseries section, as record_data.c writes it,
+ * through its END-OF-DATA.  Returns true if the end was found.
+ */
+static int
+input_binary(struct run_s *rn)
 {
-	int i, j;
-
-	if (debug)
-	print_input1();
-
-	nrow = 0;
-
-	for (i = 0; i < NCOL; i++)
-		column_numbers[i] = -1;
-
-	for (j = 0; j < nptrs; j++)
-	    for (i = 0; i < NCOL; i++)
-	    	if (strcmp(ptrs[j], column_names[i]) == 0) {
-			column_numbers[i] = j;
-			break;
-		}
+	int i, j, k, n, size, ncols;
+	int nptrs;
+	float f;
+	char **names, **ptrs;
+	unsigned char *p;
 
-	if (debug) {
-		for (i = 0; i < NCOL; i++)
-			printf("COL: %s is col %d\n",
-				column_names[i],
-				column_numbers[i]);
+	nptrs = next_fields(rn, &ptrs);
+	if (nptrs != 3 || strcmp(ptrs[0], "format") != 0) {
+		fprintf(stderr, "%s: binary timeseries has no format\n",
+			myname);
+		return 0;
+	}
+	if (strcmp(ptrs[1], "f64") == 0)
+		size = sizeof (double);
+	else if (strcmp(ptrs[1], "f32") == 0)
+		size = sizeof (float);
+	else {
+		fprintf(stderr, "%s: unknown binary format \"%s\"\n",
+			myname, ptrs[1]);
+		return 0;
+	}
+	ncols = atoi(ptrs[2]);
+	if (ncols < 1) {
+		fprintf(stderr, "%s: bad binary column count %d\n",
+			myname, ncols);
+		return 0;
 	}
-	rocksim_init();
-}
-
-/* 
- * This function reads the time-sequence data from the simulator.
- */
-static void
-input_2(int nptrs, char **ptrs)
-{
-	int i;
-	double v;
-	double r_time, r_thrust, r_mass;
-
-	r_mass = 0;
-	for (i = 0; i < NCOL; i++) {
-		if (i == OF_RATIO)
-			v = atof(ptrs[column_numbers[N2O_FLOW_RATE]]) /
-			    atof(ptrs[column_numbers[FUEL_FLOW_RATE]]);
-		else if (i == IP_RATIO)
-			v = atof(ptrs[column_numbers[TANK_PRESSURE]]) /
-			    atof(ptrs[column_numbers[CHAMBER_PRESSURE]]);
-		else if (i == IPL_RATIO)
-			v = atof(ptrs[column_numbers[LFUEL_PRESSURE]]) /
-			    atof(ptrs[column_numbers[CHAMBER_PRESSURE]]);
-		else if (column_numbers[i] >= 0)
-			v = atof(ptrs[column_numbers[i]]);
-		else
-			v = 0.;
 
-		switch(i) {
-		case BURN_TIME:
-			r_time = v;
-			break;
-		case THRUST:
-			r_thrust = v;
+	names = calloc(ncols, sizeof (char *));
+	for (j = 0; names && j < ncols; j++) {
+		if (next_fields(rn, &ptrs) < 1)
+			return 0;
+		names[j] = strdup(ptrs[0]);
+	}
+	if (!names || !names[ncols - 1]) {
+		fprintf(stderr, "%s: cannot malloc the column names\n",
+			myname);
+		exit(1);
+	}
+	input_2_headers(rn, ncols, names);
+	for (j = 0; j < ncols; j++)
+		free(names[j]);
+	free(names);
+
+	while ((nptrs = next_fields(rn, &ptrs)) > 0) {
+		if (strcmp(ptrs[0], "END-OF-DATA") == 0)
+			return 1;
+		if (strcmp(ptrs[0], "BLOCK") != 0 || nptrs != 2)
 			break;
-		case TANK_N2O_MASS:
-		case FUEL_MASS:
-		case LFUEL_MASS:
-			r_mass += v;
+		n = atoi(ptrs[1]);
+		if (n < 0 || (p = csvscan_bytes(&rn->scan,
+		    (size_t)n * ncols * size)) == NULL)
 			break;
+		for (i = 0; i < n; i++) {
+			for (k = 0; k < ncols; k++, p += size)
+				if (size == sizeof (float)) {
+					get_le(&f, p, size);
+					rn->row[k] = f;
+				} else
+					get_le(rn->row + k, p, size);
+			report_row(&rn->report, rn->row);
 		}
-
-		if (nrow == 0) {
-			column_min[i] = v;
-			column_max[i] = v;
-			column_sum[i] = v;
-			column_init[i] = v;
-		} else {
-			if (v < column_min[i])
-				column_min[i] = v;
-			if (v > column_max[i])
-				column_max[i] = v;
-			column_sum[i] += v;
-		}
-
-		column_final[i] = v;
 	}
-	nrow++;
-
-	rocksim_point(r_time, r_thrust, r_mass, 0.);
+	fprintf(stderr, "%s: binary timeseries is cut short\n", myname);
+	return 0;
 }
 
 #define	SAVE_INCR	4096
-static int saved_n_bytes;
-static int saved_size;
-static char *saved_text;
 
 static void
-save_text_init()
+save_text_init(struct run_s *rn)
 {
-	saved_text = malloc(SAVE_INCR);
-	if (saved_text == (char *)0) {
+	rn->saved_text = malloc(SAVE_INCR);
+	if (rn->saved_text == (char *)0) {
 		fprintf(stderr, "%s: malloc of %d bytes failed\n",
 			myname, SAVE_INCR);
 		exit(1);
 	}
-	saved_size = SAVE_INCR;
-	saved_n_bytes = 0;
+	rn->saved_size = SAVE_INCR;
+	rn->saved_n_bytes = 0;
 }
 
 static void
-save_text(char *p)
+save_text(struct run_s *rn, char *p)
 {
 	int l;
 
 	l = strlen(p);
-	while (saved_n_bytes + l + 1 >= saved_size) {
-		saved_size += SAVE_INCR;
-		saved_text = realloc(saved_text, saved_size);
-		if (saved_text == (char *)0) {
+	while (rn->saved_n_bytes + l + 1 >= rn->saved_size) {
+		rn->saved_size += SAVE_INCR;
+		rn->saved_text = realloc(rn->saved_text, rn->saved_size);
+		if (rn->saved_text == (char *)0) {
 			fprintf(stderr, "%s: realloc of %d bytes failed\n",
-				myname, saved_size);
+				myname, rn->saved_size);
 			exit(1);
 		}
 		
 	}
-	strcpy(saved_text + saved_n_bytes, p);
-	saved_n_bytes += l;
+	strcpy(rn->saved_text + rn->saved_n_bytes, p);
+	rn->saved_n_bytes += l;
 }
 
 static void
-save_text_dump(FILE *output)
+save_text_dump(struct run_s *rn, FILE *output)
 {
-	fwrite(saved_text, 1, saved_n_bytes, output);
+	fwrite(rn->saved_text, 1, rn->saved_n_bytes, output);
 }
 
 void
-input_errors(int nptrs, char **ptrs)
+input_errors(struct run_s *rn, int nptrs, char **ptrs)
 {
 	int i;
 
 	for (i = 0; i < nptrs - 1; i++) {
-		save_text(ptrs[i]);
-		save_text(",");
+		save_text(rn, ptrs[i]);
+		save_text(rn, ",");
 	}
-	save_text(ptrs[i]);
-	save_text("\n");
+	save_text(rn, ptrs[i]);
+	save_text(rn, "\n");
+	if (strncasecmp(ptrs[0], "Error", 5) == 0)
+		rn->n_errors++;
+	else if (strncasecmp(ptrs[0], "Warning", 7) == 0)
+		rn->n_warnings++;
 }
 
 void
-input_errors_headers(int nptrs, char **ptrs)
+input_errors_headers(struct run_s *rn, int nptrs, char **ptrs)
 {
-	save_text_init();
-	input_errors(nptrs, ptrs);
+	save_text_init(rn);
+	input_errors(rn, nptrs, ptrs);
 }
 
+/*
+ * A section's lines after the first go to its parser, or if it has a
+ * row function, the lines that start with a number go to that whole.
+ */
 struct section_s {
 	char *section;
-	void (*parse_headers)(int nptrs, char **ptrs);
-	void (*parser)(int nptrs, char **ptrs);
+	void (*parse_headers)(struct run_s *rn, int nptrs, char **ptrs);
+	void (*parser)(struct run_s *rn, int nptrs, char **ptrs);
+	void (*row)(struct run_s *rn, char *line, size_t length);
 } parsers[] = {
-	{ "parameters", input_1_headers,       input_1,      },
-	{ "timeseries", input_2_headers,       input_2,      },
-	{ "errors",     input_errors_headers,  input_errors, },
+	{ "parameters", input_1_headers,       input_1,      0,       },
+	{ "timeseries", input_2_headers,       0,            input_2, },
+	{ "errors",     input_errors_headers,  input_errors, 0,       },
 	{ (char *)0, },
 };
 
+static int
+numeric(char *line, size_t length)
+{
+	char *end;
+
+	for (end = line + length; line < end; line++)
+		if (*line != ' ' && *line != '\t')
+			break;
+	return line < end && ((*line >= '0' && *line <= '9') ||
+	    *line == '-' || *line == '+' || *line == '.');
+}
 
 /*
  * Process the input file.
  * Uses the section table above
- * Returns true if the END-OF-DATA marker was found
+ * Returns true if the END-OF-DATA marker was found, -1 if there
+ * was no timeseries at all.
  */
 static int
-do_input()
+do_input(struct run_s *rn)
 {
 	int first_line;
 	int state;
 	int nptrs;
 	int found_end_of_data;
-	char *p;
+	char *p, *line;
+	size_t length;
 	struct section_s *sp;
-	char *ptrs[32];
-	char buffer[512];
+	char **ptrs;
 
 	state = -1;
+	sp = NULL;
 	first_line = 1;
 	found_end_of_data = 0;
+	if (csvscan_open(&rn->scan, rn->input) < 0) {
+		fprintf(stderr, "%s: cannot malloc an input buffer\n",
+			myname);
+		exit(1);
+	}
 
 	/* for each input line */
-	while ((nptrs = csv_read(input, buffer, sizeof (buffer),
-	       ptrs, sizeof (ptrs) / sizeof (char *))) > 0) {
+	while ((line = csvscan_line(&rn->scan, &length)) != NULL) {
+		if (state >= 0 && !first_line && sp->row &&
+		    numeric(line, length)) {
+			(sp->row)(rn, line, length);
+			continue;
+		}
+		if ((nptrs = csvscan_fields(&rn->scan, line, length, &ptrs)) == 0)
+			continue;
  
 		for (p = ptrs[0]; *p == ' ' || *p == '\t'; p++ ) ;
 		if (strcmp(p, "END-OF-DATA") == 0) {
@@ -674,6 +638,19 @@ do_input()
 			continue;
 		}
 
+		if (strcmp(p, "SECTION") == 0 && nptrs < 2) {
+			state = -1;
+			continue;
+		}
+
+		if (strcmp(p, "SECTION") == 0 &&
+		    strcmp(ptrs[1], "binary timeseries") == 0) {
+			if (input_binary(rn))
+				found_end_of_data = 1;
+			state = -1;
+			continue;
+		}
+
 		if (strcmp(p, "SECTION") == 0) {
 			for (sp = parsers; sp->section; sp++)
 				if (strcmp(ptrs[1], sp->section) == 0) {
@@ -689,337 +666,289 @@ do_input()
 		if (state < 0)
 			continue;
 		if (first_line)
-			(sp->parse_headers)(nptrs, ptrs);
-		else
-			(sp->parser)(nptrs, ptrs);
+			(sp->parse_headers)(rn, nptrs, ptrs);
+		else if (sp->parser)
+			(sp->parser)(rn, nptrs, ptrs);
 		first_line = 0;
 	     contin:;
 	}
+	csvscan_close(&rn->scan);
 
-	if (nrow <= 0) {
-		fprintf(stderr, "%s: No input data\n", myname);
-		exit(1);
-	}
+	if (rn->report.nrow <= 0)
+		return -1;
 	return found_end_of_data;
 }
 
+/*
+ * The parse threads take the next run until there are none left.
+ */
+static void *
+parse_runs(void *arg)
+{
+	struct run_s *rn;
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&next_run_lock);
+		i = next_run++;
+		pthread_mutex_unlock(&next_run_lock);
+		if (i >= n_runs)
+			return NULL;
+		rn = runs + i;
+
+		if (rn->input == NULL &&
+		    (rn->input = fopen(rn->name, "r")) == NULL) {
+			fprintf(stderr, "%s: cannot open data file %s "
+					"for reading\n",
+				myname, rn->name);
+			rn->status = -1;
+			continue;
+		}
+		report_init(&rn->report, 0, debug);
+		rn->status = do_input(rn);
+		if (rn->input != stdin)
+			fclose(rn->input);
+		if (rn->status < 0)
+			fprintf(stderr, "%s: %s: No input data\n",
+				myname, rn->name);
+		else if (rn->status == 0)
+			fprintf(stderr, "%s: %s: no END-OF-DATA, "
+					"left out\n", myname, rn->name);
+		report_summary(&rn->report, &rn->summary);
+		report_free(&rn->report);
+		free(rn->row);
+		free(rn->wanted);
+		rn->row = NULL;
+		rn->wanted = NULL;
+	}
+}
+
 static void
-set_fuel_type()
+parse_all()
 {
-	if (strcmp(fuel, "ipa") == 0 ||
-	    strcmp(fuel, "IPA") == 0)
-	    	sim_type = LIQUID;
-	else
-		sim_type = HYBRID;
+	pthread_t *threads;
+	int i, n;
+
+	n = n_threads < n_runs? n_threads: n_runs;
+	threads = calloc(n, sizeof (pthread_t));
+	if (threads == NULL) {
+		fprintf(stderr, "%s: cannot malloc %d threads\n", myname, n);
+		exit(1);
+	}
+	for (i = 0; i < n; i++)
+		if (pthread_create(threads + i, NULL, parse_runs, NULL) != 0) {
+			fprintf(stderr, "%s: cannot start a parse thread\n",
+				myname);
+			exit(1);
+		}
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
 }
 
-static char warning[] =
-   "THERE IS NO WARRANTY FOR THIS PROGRAM, TO THE EXTENT PERMITTED\n"
-   "BY APPLICABLE LAW.  THE COPYRIGHT HOLDERS AND/OR OTHER PARTIES\n"
-   "PROVIDE THIS PROGRAM \"AS IS\" WITHOUT WARRANTY OF ANY KIND,\n"
-   "EITHER EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO,\n"
-   "THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR\n"
-   "A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE QUALITY AND\n"
-   "PERFORMANCE OF THE PROGRAM IS WITH YOU.\n"
-   "\n"
-   "Specifically, while this simulator has been somewhat tested\n"
-   "and appears to give reasonable results over a useful range\n"
-   "of inputs, the authors make no claims of correctness or even\n"
-   "reasonableness.\n"
-   "\n";
+/*
+ * The value of a metric for a run, for sorting.
+ */
+static double
+metric_value(struct run_s *rn, int m)
+{
+	switch (m) {
+	    case M_IMPULSE:	return rn->summary.total_impulse;
+	    case M_THRUST:	return rn->summary.average_thrust;
+	    case M_PEAK:	return rn->summary.peak_thrust;
+	    case M_BURN:	return rn->summary.burn_time;
+	    case M_CLASS:	return rn->summary.total_impulse;
+	    case M_OF_INIT:	return rn->summary.of_init;
+	    case M_OF_FINAL:	return rn->summary.of_final;
+	    case M_ERRORS:	return rn->n_errors;
+	    case M_WARNINGS:	return rn->n_warnings;
+	}
+	return 0.;
+}
+
+static int sort_index;
+static int sort_sign;
+
+/* ties keep the order the runs were given in */
+static int
+compare_runs(const void *a, const void *b)
+{
+	const struct run_s *ra = a, *rb = b;
+	double va, vb;
+	int c;
+
+	if (sort_index == M_FILE)
+		c = strcmp(ra->name, rb->name);
+	else {
+		va = metric_value((struct run_s *)ra, sort_index);
+		vb = metric_value((struct run_s *)rb, sort_index);
+		c = va < vb? -1: va > vb? 1: 0;
+	}
+	if (c == 0)
+		return ra->order - rb->order;
+	return c * sort_sign;
+}
 
 static void
-print_header(FILE *stream)
+sort_runs()
 {
-	fputs(warning, stream);
+	char *p;
+
+	if (sort_metric == NULL)
+		return;
+	sort_sign = *sort_metric == '-'? -1: 1;
+	p = *sort_metric == '-'? sort_metric + 1: sort_metric;
+	for (sort_index = 0; metrics[sort_index].name; sort_index++)
+		if (strcmp(p, metrics[sort_index].name) == 0)
+			break;
+	qsort(runs, n_runs, sizeof *runs, compare_runs);
 }
 
 /*
- * Format and print the report.
- *
- * Section 1: summary of geometry.
- * Section 2: fill conditions (pressure, temp, N2O mass, N2O density)
- * Section 3: final tank conditions (same, less density, incl ullage %).
- * Section 4: chamber summary: initial/final grain port, i/f grain mass,
- *	delta mass burned, m/m/a pressure, m/m/a O/F
- * Section 5: injector specs
- * Section 6: nozzle stuff: m/m/a exit pressure
- * Section 7: initial + m/m/a trust, burn time, total impulse, delivered ISP
+ * A csv field, quoted if it has to be.
  */
 static void
-print_report()
+csv_field(FILE *output, char *p, int separator)
 {
-	int icnt;
-	double total_impulse;
-	double ave_isp;
-
-	if (html_mode)
-		printf("<pre>\n");
-
-	print_header(stdout);
-
-	/* Section 1 */
-	printf("\nSection 1: Geometry\n");
-	printf("\tTank Height              %.3f meters\n", tank_height);
-	printf("\tTank Volume              %.3f liters\n", tank_volume * 1000.);
-	printf("\tUllage Height            %.3f meters\n", ullage_height);
-	if (sim_type == HYBRID)
-		printf("\tGrain Length             %.3f meters\n", grain_length);
-	printf("\tNozzle Throat            %.3f inches\n",
-		scio_convert(nozzle_throat, LENGTH, "in"));
-	printf("\tNozzle Exit              %.3f inches\n",
-		scio_convert(nozzle_exit, LENGTH, "in"));
-	if (nozzle_half_angle_set)
-	    printf("\tNozzle Half Angle        %.1f degrees\n",
-		scio_convert(nozzle_half_angle, ANGLE, "degree"));
-	printf("\tC* Adjustment            %.2f\n", cstar_adjust);
-	printf("\tCf Adjustment            %.2f\n", nozzle_cf_adjust);
-	if (!ambientpressure_set)
-		ambientpressure = 101325.;
-	printf("\tAmbient Pressure      %6.1f  atm\n",
-			scio_convert(ambientpressure, PRESSURE, "atm"));
-
-	/* Section 2 */
-	printf("\nSection 2: Fill Conditions\n");
-	if (supply_press_set)
-		printf("\tN2O Supply Pressure      %.1f psi\n",
-			scio_convert(supply_press, PRESSURE, "psi"));
-	printf("\tInit Pressure            %.1f psi\n", 
-			scio_convert(column_init[TANK_PRESSURE],
-				PRESSURE, "psi"));
-	printf("\tInit Temp                %5.0f F\n", 
-			scio_convert(column_init[TANK_TEMPERATURE],
-				TEMPERATURE, "F"));
-	printf("\tInit N2O Total Mass      %5.2f kg\n", 
-			scio_convert(column_init[TANK_N2O_MASS],
-				MASS, "kg"));
-	printf("\tInit N2O Liquid Mass     %5.2f kg\n", 
-			scio_convert(column_init[N2O_LIQUID_MASS],
-				MASS, "kg"));
-	printf("\tInit N2O Density         %5.2f g/cc\n", 
-			scio_convert(column_init[N2O_LIQUID_DENSITY],
-				DENSITY, "g/cc"));
-	printf("\tInit N2O Liquid Volume   %5.2f cc\n", 
-			scio_convert(column_init[N2O_LIQUID_MASS] /
-				    column_init[N2O_LIQUID_DENSITY],
-				VOLUME, "cc"));
-	if (vent_mass_set) {
-		printf("\tN2O Vented to chill      %5.2f kg\n",
-			scio_convert(vent_mass,
-				MASS, "kg"));
-		printf("\t                         %5.2f lbs\n",
-			scio_convert(vent_mass,
-				MASS, "lbm"));
-		printf("\tTotal N2O Consumed       %5.2f lbs\n",
-			scio_convert(vent_mass + column_init[TANK_N2O_MASS],
-				MASS, "lbm"));
-	}
-	if (sim_type == LIQUID) {
-		printf("\tInit LFuel Pressure      %.1f psi\n", 
-				scio_convert(column_init[LFUEL_PRESSURE],
-					PRESSURE, "psi"));
-		printf("\tInit Lfuel Mass          %5.2f kg\n", 
-				scio_convert(column_init[LFUEL_MASS],
-					MASS, "kg"));
-	}
-	printf("\tFuel                      %s\n", fuel);
-
-	/* Section 3 */
-	printf("\nSection 3: Empty Conditions\n");
-	printf("\tFinal Pressure           %.1f psi\n", 
-			scio_convert(column_final[TANK_PRESSURE],
-				PRESSURE, "psi"));
-	printf("\tFinal Temp               %5.0f F\n", 
-			scio_convert(column_final[TANK_TEMPERATURE],
-				TEMPERATURE, "F"));
-	printf("\tUllage N2O Mass          %5.2f kg\n", 
-			scio_convert(column_final[TANK_N2O_MASS],
-				MASS, "kg"));
-	printf("\tUllage Percentage         %.1f %%\n",
-			100 * column_final[TANK_N2O_MASS] /
-			    column_init[TANK_N2O_MASS]);
-
-	if (sim_type == LIQUID) {
-		printf("\tFinal N2O Liquid Mass    %5.2f kg\n", 
-				scio_convert(column_final[N2O_LIQUID_MASS],
-					MASS, "kg"));
-		printf("\tFinal LFuel Pressure     %.1f psi\n", 
-				scio_convert(column_final[LFUEL_PRESSURE],
-					PRESSURE, "psi"));
-		printf("\tFinal LFuel Mass         %5.2f kg\n", 
-				scio_convert(column_final[LFUEL_MASS],
-					MASS, "kg"));
+	if (strpbrk(p, ",\"\n") == NULL)
+		fputs(p, output);
+	else {
+		putc('"', output);
+		for (; *p; p++) {
+			if (*p == '"')
+				putc('"', output);
+			putc(*p == '\n'? ' ': *p, output);
+		}
+		putc('"', output);
 	}
+	putc(separator, output);
+}
 
-	/* Section 4 */
-	if (sim_type == HYBRID) {
-		printf("\nSection 4: Chamber Summary        Init  Final   Average\n");
-		printf("\tGrain Port               %6.3f %6.3f %6.3f inches\n",
-			scio_convert(column_init[GRAIN_CORE],
-				LENGTH, "in"),
-			scio_convert(column_final[GRAIN_CORE],
-				LENGTH, "in"),
-			scio_convert(column_sum[GRAIN_CORE] / (double) nrow,
-				LENGTH, "in"));
-		printf("\tGrain Mass               %6.3f %6.3f kg\n",
-			scio_convert(column_init[FUEL_MASS],
-				MASS, "kg"),
-			scio_convert(column_final[FUEL_MASS],
-				MASS, "kg"));
-		printf("\tFuel Consumed                   %6.3f kg\n",
-			scio_convert(column_init[FUEL_MASS] -
-					column_final[FUEL_MASS],
-				MASS, "kg"));
-		printf("\t\t\t      Min     Max     Average\n");
-	} else
-		printf("\nSection 4: Chamber Summary        Min     Max     Average\n");
-	printf("\tChamber Pressure         %7.2f %7.2f %7.2f psi\n",
-			scio_convert(column_min[CHAMBER_PRESSURE],
-				PRESSURE, "psi"),
-			scio_convert(column_max[CHAMBER_PRESSURE],
-				PRESSURE, "psi"),
-			scio_convert(column_sum[CHAMBER_PRESSURE] / (double) nrow,
-				PRESSURE, "psi"));
-	printf("\tO/F Ratio                %6.1f  %6.1f  %6.1f\n",
-			column_min[OF_RATIO],
-			column_max[OF_RATIO],
-			column_sum[OF_RATIO] / (double) nrow);
-
-	/* Section 5 */
-	printf("\nSection 5: Injector Summary \n");
-	icnt = injector_count + .001;
-	if (icnt > 1) {
-		printf("\tInjector Count           %d\n", icnt);
-		printf("\tDiameter of Injectors    %.2f  mm\n",
-			scio_convert(injector_diameter, LENGTH, "mm"));
-		printf("\t                         %.3f inches\n",
-			scio_convert(injector_diameter, LENGTH, "in"));
-		printf("\tCd of Injectors          %.2f\n", injector_cd);
-	} else {
-		printf("\tInjector Diameter     %.2f  mm\n",
-			scio_convert(injector_diameter, LENGTH, "mm"));
-		printf("\t                      %.3f inches\n",
-			scio_convert(injector_diameter, LENGTH, "in"));
-		printf("\tInjector Cd           %.2f\n", injector_cd);
+/*
+ * One row a run, in the order of the metrics table, then the
+ * errors section's lines.
+ */
+static void
+print_comparison_csv(FILE *output)
+{
+	struct run_s *rn;
+	struct metric_s *mp;
+	char *p;
 
+	for (mp = metrics; mp->name; mp++)
+		fprintf(output, "%s,", mp->heading);
+	fprintf(output, "messages\n");
+
+	for (rn = runs; rn < runs + n_runs; rn++) {
+		if (rn->status <= 0)
+			continue;
+		csv_field(output, rn->name, ',');
+		fprintf(output, "%.10g,%.10g,%.10g,%.10g,",
+			rn->summary.total_impulse,
+			rn->summary.average_thrust,
+			rn->summary.peak_thrust,
+			rn->summary.burn_time);
+		fprintf(output, "%s,%.10g,%.10g,%d,%d,",
+			rn->summary.motor_class,
+			rn->summary.of_init,
+			rn->summary.of_final,
+			rn->n_errors,
+			rn->n_warnings);
+		/* the messages, one field, ';' between them */
+		if (rn->saved_n_bytes > 0) {
+			while (rn->saved_n_bytes > 0 &&
+			    rn->saved_text[rn->saved_n_bytes - 1] == '\n')
+				rn->saved_text[--rn->saved_n_bytes] = '\0';
+			for (p = rn->saved_text; (p = strchr(p, '\n')); )
+				*p = ';';
+			csv_field(output, rn->saved_text, '\n');
+		} else
+			putc('\n', output);
 	}
-	printf("\tTank/Chamber Pressure Ratio\n");
-	printf("\t                        Min     Max    Average\n");
-	printf("\t   N2O                  %.2f    %.2f    %.2f\n",
-			column_min[IP_RATIO],
-			column_max[IP_RATIO],
-			column_sum[IP_RATIO] / (double) nrow);
-	if (sim_type == LIQUID)
-		printf("\t   LFuel                %.2f    %.2f    %.2f\n",
-			column_min[IPL_RATIO],
-			column_max[IPL_RATIO],
-			column_sum[IPL_RATIO] / (double) nrow);
-
-	/* Section 6 */
-	printf("\nSection 6: Nozzle Summary        Min     Max    Average\n");
-	printf("\tExit Pressure        %7.2f %7.2f %7.2f atm\n",
-			scio_convert(column_min[EXIT_PRESSURE],
-				PRESSURE, "atm"),
-			scio_convert(column_max[EXIT_PRESSURE],
-				PRESSURE, "atm"),
-			scio_convert(column_sum[EXIT_PRESSURE] / (double) nrow,
-				PRESSURE, "atm"));
-	
-	/* Section 7 */
-
-	burn_time = column_final[BURN_TIME] - column_init[BURN_TIME];
-	total_impulse = column_sum[THRUST] / (double)nrow * burn_time;
-	if (sim_type == HYBRID) {
-	    ave_isp = total_impulse /
-		(column_init[TANK_N2O_MASS] - column_final[TANK_N2O_MASS] +
-		 column_init[FUEL_MASS] - column_final[FUEL_MASS]);
-	} else {
-	    ave_isp = total_impulse /
-		(column_init[TANK_N2O_MASS] - column_final[TANK_N2O_MASS] +
-		 column_init[LFUEL_MASS] - column_final[LFUEL_MASS]);
-	}
+}
 
-	printf("\nSection 7: Performance Summary  Init   Min    Max    Average\n");
-	printf("\tThrust               %6.0f %6.0f %6.0f %6.0f lbf\n",
-			scio_convert(column_init[THRUST], FORCE, "lb"),
-			scio_convert(column_min[THRUST], FORCE, "lb"),
-			scio_convert(column_max[THRUST], FORCE, "lb"),
-			scio_convert(column_sum[THRUST] / (double) nrow,
-				FORCE, "lb"));
-	printf("\t                     %6.0f %6.0f %6.0f %6.0f N\n",
-			scio_convert(column_init[THRUST], FORCE, "N"),
-			scio_convert(column_min[THRUST], FORCE, "N"),
-			scio_convert(column_max[THRUST], FORCE, "N"),
-			scio_convert(column_sum[THRUST] / (double) nrow,
-				FORCE, "N"));
-	printf("\tDelivered ISP        %6.0f %6.0f %6.0f %6.0f meters/sec\n",
-			scio_convert(column_init[ISP], VELOCITY, "m/s"),
-			scio_convert(column_min[ISP], VELOCITY, "m/s"),
-			scio_convert(column_max[ISP], VELOCITY, "m/s"),
-			scio_convert(ave_isp, VELOCITY, "m/s"));
-	printf("\tDelivered ISP        %6.0f %6.0f %6.0f %6.0f seconds\n",
-			scio_convert(column_init[ISP]/g, TIME, "sec"),
-			scio_convert(column_min[ISP]/g, TIME, "sec"),
-			scio_convert(column_max[ISP]/g, TIME, "sec"),
-			scio_convert(ave_isp/g, TIME, "sec"));
-	printf("\tBurn Time            %6.3f seconds\n", burn_time);
-
-	printf("\tTotal Impulse        %6.0f N-seconds\n", total_impulse);
-
-	printf("\tMotor Designation     %c-%d (%.0f%%)\n",
-		impulse_to_class(total_impulse),
-		(int)(scio_convert(column_sum[THRUST] / (double) nrow,
-			FORCE, "N") + .5),
-		impulse_to_class_fraction(total_impulse) * 100.);
+static void
+print_comparison_text(FILE *output)
+{
+	struct run_s *rn;
+	char class[32];
+	char *p, *q;
+	int width;
+
+	width = 4;
+	for (rn = runs; rn < runs + n_runs; rn++)
+		if (rn->status > 0 && strlen(rn->name) > width)
+			width = strlen(rn->name);
 
 	if (html_mode)
-		printf("</pre>\n");
+		fprintf(output, "<pre>\n");
+	fprintf(output, "%-*s %9s %8s %8s %7s  %-14s %7s %7s\n",
+		width, "", "Total", "Average", "Peak", "Burn", "Motor",
+		"Initial", "Final");
+	fprintf(output, "%-*s %9s %8s %8s %7s  %-14s %7s %7s %6s %8s\n",
+		width, "Run", "Impulse", "Thrust", "Thrust", "Time", "Class",
+		"O/F", "O/F", "Errors", "Warnings");
+	fprintf(output, "%-*s %9s %8s %8s %7s\n",
+		width, "", "N-sec", "N", "N", "sec");
+	for (rn = runs; rn < runs + n_runs; rn++) {
+		if (rn->status <= 0)
+			continue;
+		snprintf(class, sizeof class, "%s (%.0f%%)",
+			rn->summary.motor_class,
+			rn->summary.class_fraction * 100.);
+		fprintf(output, "%-*s %9.0f %8.0f %8.0f %7.3f  %-14s "
+				"%7.2f %7.2f %6d %8d\n",
+			width, rn->name,
+			rn->summary.total_impulse,
+			rn->summary.average_thrust,
+			rn->summary.peak_thrust,
+			rn->summary.burn_time,
+			class,
+			rn->summary.of_init,
+			rn->summary.of_final,
+			rn->n_errors,
+			rn->n_warnings);
+	}
+
+	/* then each run's errors section */
+	for (rn = runs; rn < runs + n_runs; rn++) {
+		if (rn->status <= 0 || rn->saved_n_bytes == 0)
+			continue;
+		fprintf(output, "\n%s:\n", rn->name);
+		for (p = rn->saved_text; *p; p = q) {
+			if ((q = strchr(p, '\n')) == NULL)
+				q = p + strlen(p);
+			fprintf(output, "\t%.*s\n", (int)(q - p), p);
+			if (*q)
+				q++;
+		}
+	}
+	if (html_mode)
+		fprintf(output, "</pre>\n");
 }
 
+/*
+ * Compare the runs: parse them all, then one table.
+ */
 static void
-rocksim_report()
+compare()
 {
-	int i;
-	struct rse_s rse;
-
-	if (!rocksim_mode)
-		return;
-
-	rocksim_point_close();
-
-	rse.EngineMfg = "Evan Daniel";
-	rse.TotalImpulse =
-		column_sum[THRUST] / (double)nrow * burn_time;
-	rse.EngineImpulseClass =
-		impulse_to_class(rse.TotalImpulse);
-	rse.EngineType = "hybrid";
-	rse.EngineDia = 0.054;	/* reasonable default */
-	if (engine_dia_set)
-		rse.EngineDia = engine_dia;
-	rse.EngineLen = 0.900;	/* reasonable default */
-	if (engine_len_set)
-		rse.EngineLen = engine_len;
-	rse.PropellantMass = column_init[TANK_N2O_MASS] +
-				column_init[FUEL_MASS];
-	rse.EngineWetMass = dry_mass + rse.PropellantMass;
-	rse.PeakThrust = column_max[THRUST];
-	rse.AverageThrust = column_sum[THRUST]/ (double) nrow;
-	rse.NozzleThroatDia = nozzle_throat;
-	rse.NozzleExitDia = nozzle_exit;
-	rse.BurnTimeSecs = burn_time;
-	rse.MassFrac = 1. - (dry_mass + column_final[TANK_N2O_MASS] +
-					column_final[FUEL_MASS]) /
-				rse.EngineWetMass;
-	rse.ISPSecs = column_sum[ISP] / (double) nrow;
-
-
-	rse.comment = "Simulated by HSim Version 0.3.\n";
-
-	rse_begin(rocksim_output);
-	rse_datafile(&rse);
-	for (i = 0; i < rs_n_points; i++)
-		rse_datafile_point(rs_data + i);
-	rse_end();
+	struct run_s *rn;
+	int n;
+
+	parse_all();
+	for (n = 0, rn = runs; rn < runs + n_runs; rn++)
+		if (rn->status > 0)
+			n++;
+	if (n == 0) {
+		fprintf(stderr, "%s: No runs to compare\n", myname);
+		exit(1);
+	}
+	sort_runs();
+	if (compare_mode == 2)
+		print_comparison_csv(stdout);
+	else
+		print_comparison_text(stdout);
 }
 
 /*
@@ -1028,14 +957,30 @@ rocksim_report()
 int
 main(int argc, char **argv)
 {
+	struct run_s *rn;
+
 	grok_args(argc, argv);
+	if (compare_mode) {
+		compare();
+		exit(0);
+	}
 
-	if (do_input()) {
-		set_fuel_type();
-		print_report();
-		rocksim_report();
+	rn = runs;
+	report_init(&rn->report, rocksim_mode, debug);
+	rn->report.rs_thrust_error = thrust_error;
+	rn->report.rs_impulse_error = impulse_error;
+
+	rn->status = do_input(rn);
+	if (rn->status < 0) {
+		fprintf(stderr, "%s: No input data\n", myname);
+		exit(1);
+	}
+	if (rn->status) {
+		report_print(&rn->report, stdout, html_mode);
+		if (rocksim_mode)
+			report_rocksim(&rn->report, rocksim_output);
 	}
 	putchar('\n');
-	save_text_dump(stdout);
+	save_text_dump(rn, stdout);
 	exit(0);
 }
@@ -0,0 +1,829 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Report Statistics
+ *
+ * The per column statistics of a run (min, max, time integral, initial
+ * and final values), the derived ratios, and the human readable report
+ * and Rocksim file made from them.  See report_stats.h.
+ *
+ * DYNAMIC INPUTS:
+ *	the parameters, by name
+ *	the timeseries rows, after their column names
+ *
+ * OUTPUTS:
+ *	the report, and the Rocksim engine file
+ *
+ * The averages are over time, and the impulse is the integral of the
+ * thrust, both by the trapezoid rule on the time column, so rows need
+ * not be evenly spaced (hsim -R deadband, or -I).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "rsim.h"
+#include "ts_parse.h"
+#include "scio.h"
+#include "rocksim.h"
+#include "report_stats.h"
+
+extern char *myname;
+
+static const double g = 32.174 * 0.3048;
+
+#define	P(x)	offsetof(struct report_s, x), offsetof(struct report_s, x##_set)
+
+static struct input_param_s {
+	char *name;
+	size_t value;
+	size_t set;
+} input_parameters[] = {
+  { "tankheight",      P(tank_height),        },
+  { "ullageheight",    P(ullage_height),      },
+  { "tankvolume",      P(tank_volume),        },
+  { "ventmass",        P(vent_mass),          },
+  { "grainlength",     P(grain_length),       },
+  { "graindiameter",   P(grain_diameter),     },
+  { "graincore",       P(grain_core),         },
+  { "nozzlethroat",    P(nozzle_throat),      },
+  { "nozzleexit",      P(nozzle_exit),        },
+  { "nozcfadj",        P(nozzle_cf_adjust),   },
+  { "nozzlehalfangle", P(nozzle_half_angle),  },
+  { "cstaradj",        P(cstar_adjust),       },
+  { "injectordia",     P(injector_diameter),  },
+  { "injectorcd",      P(injector_cd),        },
+  { "injectorcount",   P(injector_count),     },
+  { "ventdia",         P(vent_diameter),      },
+  { "ventcd",          P(vent_cd),            },
+  { "filltemp",        P(fill_temp),          },
+  { "filldrop",        P(fill_pressure_drop), },
+  { "supplypress",     P(supply_press),       },
+  { "drymass",         P(dry_mass),           },
+  { "enginedia",       P(engine_dia),         },
+  { "enginelen",       P(engine_len),         },
+  { "ambientpressure", P(ambientpressure),    },
+  { (char *)0, },
+};
+
+#define	VALUE(rp, ip)	((double *)((char *)(rp) + (ip)->value))
+#define	SET(rp, ip)	((int *)((char *)(rp) + (ip)->set))
+
+/* in the order of the REPORT_ indices in report_stats.h */
+static char *column_names[] = {
+	"tank n2o mass",
+	"tank pressure",
+	"tank temperature",
+	"n2o liquid mass",
+	"n2o liquid density",
+	"fuel mass",
+	"grain core",
+	"chamber pressure",
+	"n2o flow rate",
+	"n2o vent rate",
+	"n2o flux",
+	"fuel flow rate",
+	"isp",
+	"nozzle cf",
+	"thrust",
+	"exit pressure",
+	"XXX O/F RATIO",	/* computed */
+	"XXX injector pressure ratio",	/* computed */
+	"time",
+	"liquid fuel mass",
+	"liquid fuel volume",
+	"nitrogen pressure",
+	"XXX LF injector pressure ratio",	/* computed */
+};
+
+#define	NCOL	(sizeof (column_names) / sizeof (column_names[0]))
+
+void
+report_init(struct report_s *rp, int rocksim, int debug)
+{
+	int i;
+
+	if (NCOL != REPORT_COLUMNS) {
+		fprintf(stderr, "%s: report_stats.h has the wrong "
+				"REPORT_COLUMNS\n", myname);
+		exit(1);
+	}
+	memset(rp, 0, sizeof *rp);
+	for (i = 0; i < NCOL; i++)
+		rp->column_numbers[i] = -1;
+	rp->rocksim = rocksim;
+	rp->rs_thrust_error = REPORT_THRUST_ERROR;
+	rp->rs_impulse_error = REPORT_IMPULSE_ERROR;
+	rp->debug = debug;
+}
+
+void
+report_free(struct report_s *rp)
+{
+	free(rp->rs_data);
+	rp->rs_data = NULL;
+}
+
+/*
+ * Take a parameter value.
+ * Handles "fuel" separately, as it is a string, not a float.
+ */
+void
+report_parameter(struct report_s *rp, char *name, char *value)
+{
+	struct input_param_s *ip;
+
+	/* search for the match */
+	if (strcmp(name, "fuel") == 0)
+		strncpy(rp->fuel, value, sizeof rp->fuel - 1);
+	else
+	    for (ip = input_parameters; ip->name; ip++)
+		if (strcmp(name, ip->name) == 0) {
+			/* matched */
+			*VALUE(rp, ip) = atof(value);
+			*SET(rp, ip) += 1;
+			break;
+		}
+}
+
+static void
+print_input1(struct report_s *rp)
+{
+	struct input_param_s *ip;
+
+	for (ip = input_parameters; ip->name; ip++) {
+		printf("%s: ", ip->name);
+		if (*SET(rp, ip))
+			printf("%f\n", *VALUE(rp, ip));
+		else
+			printf("not set\n");
+	}
+}
+
+/*
+ * Compute an impulse class.
+ * Doesn't work for smaller than C class engines.
+ */
+static char
+impulse_to_class(double impulse)
+{
+	char c;
+
+	c = 'C';
+	while (impulse >= 10.) {
+		c++;
+		impulse /= 2;
+	}
+	return c;
+}
+
+static double
+impulse_to_class_fraction(double impulse)
+{
+	while (impulse >= 10.)
+		impulse /= 2;
+
+	return (impulse - 5.) / 5.;
+}
+
+static void
+rocksim_init(struct report_s *rp)
+{
+	rp->rs_n_points = 0;
+
+	if (!rp->rocksim)
+		return;
+
+	if (!rp->dry_mass_set) {
+		fprintf(stderr, "%s: motor dry mass was not specified.\n",
+			myname);
+		fprintf(stderr, "\tRocksim report disabled\n");
+		rp->rocksim = 0;
+	}
+}
+
+/*
+ * Keeps every row's Rocksim point; report_rocksim() picks the ones
+ * that are written.  CG stuff is currently NYI.
+ */
+static void
+rocksim_point(struct report_s *rp, double sim_time, double thrust,
+	double fuelmass, double cg)
+{
+	struct rse_datapoint_s *dp;
+	int size;
+
+	if (!rp->rocksim)
+		return;
+
+	if (rp->rs_n_points == rp->rs_size) {
+		size = rp->rs_size? rp->rs_size * 2: 4096;
+		dp = realloc(rp->rs_data, size * sizeof (*dp));
+		if (!dp) {
+			fprintf(stderr, "%s: failed to malloc memory for "
+					"rocksim data.\n", myname);
+			fprintf(stderr, "\tRocksim report disabled\n");
+			rp->rocksim = 0;
+			return;
+		}
+		rp->rs_data = dp;
+		rp->rs_size = size;
+	}
+	dp = rp->rs_data + rp->rs_n_points++;
+	dp->Time = sim_time;
+	dp->Thrust = thrust;
+	dp->Mass = fuelmass;
+	dp->CG = cg;
+}
+
+/*
+ * The impulse of the points that are kept, by the trapezoid rule.
+ */
+static double
+kept_impulse(struct rse_datapoint_s *dp, int n, char *keep)
+{
+	int i, last;
+	double impulse;
+
+	impulse = 0.;
+	for (i = 1, last = 0; i < n; i++)
+		if (keep[i]) {
+			impulse += (dp[i].Time - dp[last].Time) *
+				(dp[i].Thrust + dp[last].Thrust) / 2.;
+			last = i;
+		}
+	return impulse;
+}
+
+/*
+ * Douglas-Peucker: keep the point of each span that is furthest from
+ * the line between the span's ends, until every point is within
+ * thrust_error of the line in thrust and mass_error in mass.  The
+ * first, last and peak thrust points are always kept.  Uses a stack of
+ * spans, not recursion, as there can be millions of points.
+ */
+static void
+simplify(struct rse_datapoint_s *dp, int n, char *keep, int peak,
+	double thrust_error, double mass_error)
+{
+	int *stack;
+	int depth, a, b, i, worst;
+	double w, e, worst_e, dt;
+
+	memset(keep, 0, n);
+	keep[0] = keep[n - 1] = keep[peak] = 1;
+	stack = malloc(2 * n * sizeof (int));
+	if (!stack) {
+		memset(keep, 1, n);
+		return;
+	}
+	depth = 0;
+	stack[depth++] = 0;
+	stack[depth++] = peak;
+	stack[depth++] = peak;
+	stack[depth++] = n - 1;
+
+	while (depth > 0) {
+		b = stack[--depth];
+		a = stack[--depth];
+		if (b - a < 2)
+			continue;
+		dt = dp[b].Time - dp[a].Time;
+		worst = -1;
+		worst_e = 1.;
+		for (i = a + 1; i < b; i++) {
+			w = dt > 0.? (dp[i].Time - dp[a].Time) / dt: 0.;
+			e = fabs(dp[i].Thrust - (dp[a].Thrust +
+				w * (dp[b].Thrust - dp[a].Thrust))) /
+				thrust_error;
+			if (e <= worst_e)
+				e = fabs(dp[i].Mass - (dp[a].Mass +
+					w * (dp[b].Mass - dp[a].Mass))) /
+					mass_error;
+			if (e > worst_e) {
+				worst = i;
+				worst_e = e;
+			}
+		}
+		if (worst < 0)
+			continue;
+		keep[worst] = 1;
+		stack[depth++] = a;
+		stack[depth++] = worst;
+		stack[depth++] = worst;
+		stack[depth++] = b;
+	}
+	free(stack);
+}
+
+/*
+ * Pick the Rocksim points to write: as few as keep every point within
+ * rs_thrust_error of the peak thrust (and as much of the initial
+ * propellant mass) of the curve through them, with the impulse within
+ * rs_impulse_error of the impulse of all of them.  The thrust bound is
+ * halved until the impulse bound holds.
+ * Returns the flags, or NULL to write them all.
+ */
+static char *
+rocksim_keep(struct report_s *rp)
+{
+	struct rse_datapoint_s *dp;
+	char *keep;
+	int i, n, peak, tries;
+	double full, thrust_error, mass_error;
+
+	dp = rp->rs_data;
+	n = rp->rs_n_points;
+	if ((keep = malloc(n)) == NULL)
+		return NULL;
+
+	peak = 0;
+	full = 0.;
+	for (i = 1; i < n; i++) {
+		if (dp[i].Thrust > dp[peak].Thrust)
+			peak = i;
+		full += (dp[i].Time - dp[i - 1].Time) *
+			(dp[i].Thrust + dp[i - 1].Thrust) / 2.;
+	}
+	thrust_error = fmax(rp->rs_thrust_error * fabs(dp[peak].Thrust),
+		DBL_MIN);
+	mass_error = fmax(rp->rs_thrust_error * fabs(dp[0].Mass), DBL_MIN);
+
+	for (tries = 0; tries < 30; tries++) {
+		simplify(dp, n, keep, peak, thrust_error, mass_error);
+		if (fabs(kept_impulse(dp, n, keep) - full) <=
+		    rp->rs_impulse_error * fabs(full))
+			break;
+		thrust_error /= 2.;
+		mass_error /= 2.;
+	}
+	return keep;
+}
+
+/*
+ * Find the columns kept, by name, in a timeseries header.
+ */
+void
+report_columns(struct report_s *rp, int ncols, char **names)
+{
+	int i, j;
+
+	if (rp->debug)
+		print_input1(rp);
+
+	rp->nrow = 0;
+
+	for (i = 0; i < NCOL; i++)
+		rp->column_numbers[i] = -1;
+
+	for (j = 0; j < ncols; j++)
+	    for (i = 0; i < NCOL; i++)
+	    	if (strcmp(names[j], column_names[i]) == 0) {
+			rp->column_numbers[i] = j;
+			break;
+		}
+
+	if (rp->debug) {
+		for (i = 0; i < NCOL; i++)
+			printf("COL: %s is col %d\n",
+				column_names[i],
+				rp->column_numbers[i]);
+	}
+	rocksim_init(rp);
+}
+
+/*
+ * Does the report use this column of the row?
+ */
+int
+report_wanted(struct report_s *rp, int column)
+{
+	int i;
+
+	for (i = 0; i < NCOL; i++)
+		if (rp->column_numbers[i] == column)
+			return 1;
+	return 0;
+}
+
+/*
+ * The ratio of two columns, or 0 if the row does not have both.
+ */
+static double
+ratio(struct report_s *rp, double *row, int a, int b)
+{
+	if (rp->column_numbers[a] < 0 || rp->column_numbers[b] < 0)
+		return 0.;
+	return row[rp->column_numbers[a]] / row[rp->column_numbers[b]];
+}
+
+/* 
+ * Take one row of the timeseries, in the order of the column names.
+ */
+void
+report_row(struct report_s *rp, double *row)
+{
+	int i;
+	double v[NCOL], dt;
+
+	for (i = 0; i < NCOL; i++)
+		v[i] = rp->column_numbers[i] >= 0?
+			row[rp->column_numbers[i]]: 0.;
+	v[REPORT_OF_RATIO] = ratio(rp, row, REPORT_N2O_FLOW_RATE, REPORT_FUEL_FLOW_RATE);
+	v[REPORT_IP_RATIO] = ratio(rp, row, REPORT_TANK_PRESSURE, REPORT_CHAMBER_PRESSURE);
+	v[REPORT_IPL_RATIO] = ratio(rp, row, REPORT_LFUEL_PRESSURE, REPORT_CHAMBER_PRESSURE);
+
+	if (rp->nrow == 0) {
+		memcpy(rp->column_min, v, sizeof v);
+		memcpy(rp->column_max, v, sizeof v);
+		memset(rp->column_integral, 0, sizeof v);
+		memcpy(rp->column_init, v, sizeof v);
+	} else {
+		dt = v[REPORT_BURN_TIME] - rp->column_final[REPORT_BURN_TIME];
+		for (i = 0; i < NCOL; i++) {
+			if (v[i] < rp->column_min[i])
+				rp->column_min[i] = v[i];
+			if (v[i] > rp->column_max[i])
+				rp->column_max[i] = v[i];
+			rp->column_integral[i] += dt *
+				(v[i] + rp->column_final[i]) / 2.;
+		}
+	}
+	memcpy(rp->column_final, v, sizeof v);
+	rp->nrow++;
+
+	rocksim_point(rp, v[REPORT_BURN_TIME], v[REPORT_THRUST],
+		v[REPORT_TANK_N2O_MASS] + v[REPORT_FUEL_MASS] + v[REPORT_LFUEL_MASS], 0.);
+}
+
+static int
+liquid(struct report_s *rp)
+{
+	return strcmp(rp->fuel, "ipa") == 0 ||
+	       strcmp(rp->fuel, "IPA") == 0;
+}
+
+static double
+burn_seconds(struct report_s *rp)
+{
+	return rp->column_final[REPORT_BURN_TIME] - rp->column_init[REPORT_BURN_TIME];
+}
+
+/*
+ * The time average of a column; a run of one row is its own average.
+ */
+double
+report_average(struct report_s *rp, int column)
+{
+	if (burn_seconds(rp) <= 0.)
+		return rp->column_init[column];
+	return rp->column_integral[column] / burn_seconds(rp);
+}
+
+/*
+ * The headline numbers, for report_print() and for comparing runs.
+ */
+void
+report_summary(struct report_s *rp, struct report_summary_s *sp)
+{
+	memset(sp, 0, sizeof *sp);
+	if (rp->nrow <= 0)
+		return;
+	sp->burn_time = burn_seconds(rp);
+	sp->average_thrust = report_average(rp, REPORT_THRUST);
+	sp->peak_thrust = rp->column_max[REPORT_THRUST];
+	sp->total_impulse = rp->column_integral[REPORT_THRUST];
+	snprintf(sp->motor_class, sizeof sp->motor_class, "%c-%d",
+		impulse_to_class(sp->total_impulse),
+		(int)(scio_convert(sp->average_thrust, FORCE, "N") + .5));
+	sp->class_fraction = impulse_to_class_fraction(sp->total_impulse);
+	/* only one of the fuel columns changes, hybrid or liquid */
+	sp->delivered_isp = sp->total_impulse /
+		(rp->column_init[REPORT_TANK_N2O_MASS] -
+		 rp->column_final[REPORT_TANK_N2O_MASS] +
+		 rp->column_init[REPORT_FUEL_MASS] -
+		 rp->column_final[REPORT_FUEL_MASS] +
+		 rp->column_init[REPORT_LFUEL_MASS] -
+		 rp->column_final[REPORT_LFUEL_MASS]);
+	sp->of_init = rp->column_init[REPORT_OF_RATIO];
+	sp->of_final = rp->column_final[REPORT_OF_RATIO];
+}
+
+static char warning[] =
+   "THERE IS NO WARRANTY FOR THIS PROGRAM, TO THE EXTENT PERMITTED\n"
+   "BY APPLICABLE LAW.  THE COPYRIGHT HOLDERS AND/OR OTHER PARTIES\n"
+   "PROVIDE THIS PROGRAM \"AS IS\" WITHOUT WARRANTY OF ANY KIND,\n"
+   "EITHER EXPRESSED OR IMPLIED, INCLUDING, BUT NOT LIMITED TO,\n"
+   "THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR\n"
+   "A PARTICULAR PURPOSE. THE ENTIRE RISK AS TO THE QUALITY AND\n"
+   "PERFORMANCE OF THE PROGRAM IS WITH YOU.\n"
+   "\n"
+   "Specifically, while this simulator has been somewhat tested\n"
+   "and appears to give reasonable results over a useful range\n"
+   "of inputs, the authors make no claims of correctness or even\n"
+   "reasonableness.\n"
+   "\n";
+
+/*
+ * Format and print the report.
+ *
+ * Section 1: summary of geometry.
+ * Section 2: fill conditions (pressure, temp, N2O mass, N2O density)
+ * Section 3: final tank conditions (same, less density, incl ullage %).
+ * Section 4: chamber summary: initial/final grain port, i/f grain mass,
+ *	delta mass burned, m/m/a pressure, m/m/a O/F
+ * Section 5: injector specs
+ * Section 6: nozzle stuff: m/m/a exit pressure
+ * Section 7: initial + m/m/a trust, burn time, total impulse, delivered ISP
+ */
+void
+report_print(struct report_s *rp, FILE *output, int html)
+{
+	int icnt;
+	double burn_time;
+	double total_impulse;
+	double ave_isp;
+	struct report_summary_s summary;
+
+	if (html)
+		fprintf(output, "<pre>\n");
+
+	fputs(warning, output);
+
+	/* Section 1 */
+	fprintf(output, "\nSection 1: Geometry\n");
+	fprintf(output, "\tTank Height              %.3f meters\n", rp->tank_height);
+	fprintf(output, "\tTank Volume              %.3f liters\n",
+		rp->tank_volume * 1000.);
+	fprintf(output, "\tUllage Height            %.3f meters\n", rp->ullage_height);
+	if (!liquid(rp))
+		fprintf(output, "\tGrain Length             %.3f meters\n", rp->grain_length);
+	fprintf(output, "\tNozzle Throat            %.3f inches\n",
+		scio_convert(rp->nozzle_throat, LENGTH, "in"));
+	fprintf(output, "\tNozzle Exit              %.3f inches\n",
+		scio_convert(rp->nozzle_exit, LENGTH, "in"));
+	if (rp->nozzle_half_angle_set)
+	    fprintf(output, "\tNozzle Half Angle        %.1f degrees\n",
+		scio_convert(rp->nozzle_half_angle, ANGLE, "degree"));
+	fprintf(output, "\tC* Adjustment            %.2f\n", rp->cstar_adjust);
+	fprintf(output, "\tCf Adjustment            %.2f\n", rp->nozzle_cf_adjust);
+	if (!rp->ambientpressure_set)
+		rp->ambientpressure = 101325.;
+	fprintf(output, "\tAmbient Pressure      %6.1f  atm\n",
+			scio_convert(rp->ambientpressure, PRESSURE, "atm"));
+
+	/* Section 2 */
+	fprintf(output, "\nSection 2: Fill Conditions\n");
+	if (rp->supply_press_set)
+		fprintf(output, "\tN2O Supply Pressure      %.1f psi\n",
+			scio_convert(rp->supply_press, PRESSURE, "psi"));
+	fprintf(output, "\tInit Pressure            %.1f psi\n", 
+			scio_convert(rp->column_init[REPORT_TANK_PRESSURE],
+				PRESSURE, "psi"));
+	fprintf(output, "\tInit Temp                %5.0f F\n", 
+			scio_convert(rp->column_init[REPORT_TANK_TEMPERATURE],
+				TEMPERATURE, "F"));
+	fprintf(output, "\tInit N2O Total Mass      %5.2f kg\n", 
+			scio_convert(rp->column_init[REPORT_TANK_N2O_MASS],
+				MASS, "kg"));
+	fprintf(output, "\tInit N2O Liquid Mass     %5.2f kg\n", 
+			scio_convert(rp->column_init[REPORT_N2O_LIQUID_MASS],
+				MASS, "kg"));
+	fprintf(output, "\tInit N2O Density         %5.2f g/cc\n", 
+			scio_convert(rp->column_init[REPORT_N2O_LIQUID_DENSITY],
+				DENSITY, "g/cc"));
+	fprintf(output, "\tInit N2O Liquid Volume   %5.2f cc\n", 
+			scio_convert(rp->column_init[REPORT_N2O_LIQUID_MASS] /
+				    rp->column_init[REPORT_N2O_LIQUID_DENSITY],
+				VOLUME, "cc"));
+	if (rp->vent_mass_set) {
+		fprintf(output, "\tN2O Vented to chill      %5.2f kg\n",
+			scio_convert(rp->vent_mass,
+				MASS, "kg"));
+		fprintf(output, "\t                         %5.2f lbs\n",
+			scio_convert(rp->vent_mass,
+				MASS, "lbm"));
+		fprintf(output, "\tTotal N2O Consumed       %5.2f lbs\n",
+			scio_convert(rp->vent_mass + rp->column_init[REPORT_TANK_N2O_MASS],
+				MASS, "lbm"));
+	}
+	if (liquid(rp)) {
+		fprintf(output, "\tInit LFuel Pressure      %.1f psi\n", 
+				scio_convert(rp->column_init[REPORT_LFUEL_PRESSURE],
+					PRESSURE, "psi"));
+		fprintf(output, "\tInit Lfuel Mass          %5.2f kg\n", 
+				scio_convert(rp->column_init[REPORT_LFUEL_MASS],
+					MASS, "kg"));
+	}
+	fprintf(output, "\tFuel                      %s\n", rp->fuel);
+
+	/* Section 3 */
+	fprintf(output, "\nSection 3: Empty Conditions\n");
+	fprintf(output, "\tFinal Pressure           %.1f psi\n", 
+			scio_convert(rp->column_final[REPORT_TANK_PRESSURE],
+				PRESSURE, "psi"));
+	fprintf(output, "\tFinal Temp               %5.0f F\n", 
+			scio_convert(rp->column_final[REPORT_TANK_TEMPERATURE],
+				TEMPERATURE, "F"));
+	fprintf(output, "\tUllage N2O Mass          %5.2f kg\n", 
+			scio_convert(rp->column_final[REPORT_TANK_N2O_MASS],
+				MASS, "kg"));
+	fprintf(output, "\tUllage Percentage         %.1f %%\n",
+			100 * rp->column_final[REPORT_TANK_N2O_MASS] /
+			    rp->column_init[REPORT_TANK_N2O_MASS]);
+
+	if (liquid(rp)) {
+		fprintf(output, "\tFinal N2O Liquid Mass    %5.2f kg\n", 
+				scio_convert(rp->column_final[REPORT_N2O_LIQUID_MASS],
+					MASS, "kg"));
+		fprintf(output, "\tFinal LFuel Pressure     %.1f psi\n", 
+				scio_convert(rp->column_final[REPORT_LFUEL_PRESSURE],
+					PRESSURE, "psi"));
+		fprintf(output, "\tFinal LFuel Mass         %5.2f kg\n", 
+				scio_convert(rp->column_final[REPORT_LFUEL_MASS],
+					MASS, "kg"));
+	}
+
+	/* Section 4 */
+	if (!liquid(rp)) {
+		fprintf(output, "\nSection 4: Chamber Summary        Init  Final   Average\n");
+		fprintf(output, "\tGrain Port               %6.3f %6.3f %6.3f inches\n",
+			scio_convert(rp->column_init[REPORT_GRAIN_CORE],
+				LENGTH, "in"),
+			scio_convert(rp->column_final[REPORT_GRAIN_CORE],
+				LENGTH, "in"),
+			scio_convert(report_average(rp, REPORT_GRAIN_CORE),
+				LENGTH, "in"));
+		fprintf(output, "\tGrain Mass               %6.3f %6.3f kg\n",
+			scio_convert(rp->column_init[REPORT_FUEL_MASS],
+				MASS, "kg"),
+			scio_convert(rp->column_final[REPORT_FUEL_MASS],
+				MASS, "kg"));
+		fprintf(output, "\tFuel Consumed                   %6.3f kg\n",
+			scio_convert(rp->column_init[REPORT_FUEL_MASS] -
+					rp->column_final[REPORT_FUEL_MASS],
+				MASS, "kg"));
+		fprintf(output, "\t\t\t      Min     Max     Average\n");
+	} else
+		fprintf(output, "\nSection 4: Chamber Summary        Min     Max     Average\n");
+	fprintf(output, "\tChamber Pressure         %7.2f %7.2f %7.2f psi\n",
+			scio_convert(rp->column_min[REPORT_CHAMBER_PRESSURE],
+				PRESSURE, "psi"),
+			scio_convert(rp->column_max[REPORT_CHAMBER_PRESSURE],
+				PRESSURE, "psi"),
+			scio_convert(report_average(rp, REPORT_CHAMBER_PRESSURE),
+				PRESSURE, "psi"));
+	fprintf(output, "\tO/F Ratio                %6.1f  %6.1f  %6.1f\n",
+			rp->column_min[REPORT_OF_RATIO],
+			rp->column_max[REPORT_OF_RATIO],
+			report_average(rp, REPORT_OF_RATIO));
+
+	/* Section 5 */
+	fprintf(output, "\nSection 5: Injector Summary \n");
+	icnt = rp->injector_count + .001;
+	if (icnt > 1) {
+		fprintf(output, "\tInjector Count           %d\n", icnt);
+		fprintf(output, "\tDiameter of Injectors    %.2f  mm\n",
+			scio_convert(rp->injector_diameter, LENGTH, "mm"));
+		fprintf(output, "\t                         %.3f inches\n",
+			scio_convert(rp->injector_diameter, LENGTH, "in"));
+		fprintf(output, "\tCd of Injectors          %.2f\n", rp->injector_cd);
+	} else {
+		fprintf(output, "\tInjector Diameter     %.2f  mm\n",
+			scio_convert(rp->injector_diameter, LENGTH, "mm"));
+		fprintf(output, "\t                      %.3f inches\n",
+			scio_convert(rp->injector_diameter, LENGTH, "in"));
+		fprintf(output, "\tInjector Cd           %.2f\n", rp->injector_cd);
+
+	}
+	fprintf(output, "\tTank/Chamber Pressure Ratio\n");
+	fprintf(output, "\t                        Min     Max    Average\n");
+	fprintf(output, "\t   N2O                  %.2f    %.2f    %.2f\n",
+			rp->column_min[REPORT_IP_RATIO],
+			rp->column_max[REPORT_IP_RATIO],
+			report_average(rp, REPORT_IP_RATIO));
+	if (liquid(rp))
+		fprintf(output, "\t   LFuel                %.2f    %.2f    %.2f\n",
+			rp->column_min[REPORT_IPL_RATIO],
+			rp->column_max[REPORT_IPL_RATIO],
+			report_average(rp, REPORT_IPL_RATIO));
+
+	/* Section 6 */
+	fprintf(output, "\nSection 6: Nozzle Summary        Min     Max    Average\n");
+	fprintf(output, "\tExit Pressure        %7.2f %7.2f %7.2f atm\n",
+			scio_convert(rp->column_min[REPORT_EXIT_PRESSURE],
+				PRESSURE, "atm"),
+			scio_convert(rp->column_max[REPORT_EXIT_PRESSURE],
+				PRESSURE, "atm"),
+			scio_convert(report_average(rp, REPORT_EXIT_PRESSURE),
+				PRESSURE, "atm"));
+	
+	/* Section 7 */
+
+	report_summary(rp, &summary);
+	burn_time = summary.burn_time;
+	total_impulse = summary.total_impulse;
+	ave_isp = summary.delivered_isp;
+
+	fprintf(output, "\nSection 7: Performance Summary  Init   Min    Max    Average\n");
+	fprintf(output, "\tThrust               %6.0f %6.0f %6.0f %6.0f lbf\n",
+			scio_convert(rp->column_init[REPORT_THRUST], FORCE, "lb"),
+			scio_convert(rp->column_min[REPORT_THRUST], FORCE, "lb"),
+			scio_convert(rp->column_max[REPORT_THRUST], FORCE, "lb"),
+			scio_convert(report_average(rp, REPORT_THRUST),
+				FORCE, "lb"));
+	fprintf(output, "\t                     %6.0f %6.0f %6.0f %6.0f N\n",
+			scio_convert(rp->column_init[REPORT_THRUST], FORCE, "N"),
+			scio_convert(rp->column_min[REPORT_THRUST], FORCE, "N"),
+			scio_convert(rp->column_max[REPORT_THRUST], FORCE, "N"),
+			scio_convert(report_average(rp, REPORT_THRUST),
+				FORCE, "N"));
+	fprintf(output, "\tDelivered ISP        %6.0f %6.0f %6.0f %6.0f meters/sec\n",
+			scio_convert(rp->column_init[REPORT_ISP], VELOCITY, "m/s"),
+			scio_convert(rp->column_min[REPORT_ISP], VELOCITY, "m/s"),
+			scio_convert(rp->column_max[REPORT_ISP], VELOCITY, "m/s"),
+			scio_convert(ave_isp, VELOCITY, "m/s"));
+	fprintf(output, "\tDelivered ISP        %6.0f %6.0f %6.0f %6.0f seconds\n",
+			scio_convert(rp->column_init[REPORT_ISP]/g, TIME, "sec"),
+			scio_convert(rp->column_min[REPORT_ISP]/g, TIME, "sec"),
+			scio_convert(rp->column_max[REPORT_ISP]/g, TIME, "sec"),
+			scio_convert(ave_isp/g, TIME, "sec"));
+	fprintf(output, "\tBurn Time            %6.3f seconds\n", burn_time);
+
+	fprintf(output, "\tTotal Impulse        %6.0f N-seconds\n", total_impulse);
+
+	fprintf(output, "\tMotor Designation     %s (%.0f%%)\n",
+		summary.motor_class, summary.class_fraction * 100.);
+
+	if (html)
+		fprintf(output, "</pre>\n");
+}
+
+void
+report_rocksim(struct report_s *rp, FILE *output)
+{
+	int i;
+	char *keep;
+	double burn_time;
+	struct rse_s rse;
+
+	if (!rp->rocksim || rp->rs_n_points == 0)
+		return;
+
+	burn_time = burn_seconds(rp);
+
+	rse.EngineMfg = "Evan Daniel";
+	rse.TotalImpulse = rp->column_integral[REPORT_THRUST];
+	rse.EngineImpulseClass =
+		impulse_to_class(rse.TotalImpulse);
+	rse.EngineType = "hybrid";
+	rse.EngineDia = 0.054;	/* reasonable default */
+	if (rp->engine_dia_set)
+		rse.EngineDia = rp->engine_dia;
+	rse.EngineLen = 0.900;	/* reasonable default */
+	if (rp->engine_len_set)
+		rse.EngineLen = rp->engine_len;
+	rse.PropellantMass = rp->column_init[REPORT_TANK_N2O_MASS] +
+				rp->column_init[REPORT_FUEL_MASS];
+	rse.EngineWetMass = rp->dry_mass + rse.PropellantMass;
+	rse.PeakThrust = rp->column_max[REPORT_THRUST];
+	rse.AverageThrust = report_average(rp, REPORT_THRUST);
+	rse.NozzleThroatDia = rp->nozzle_throat;
+	rse.NozzleExitDia = rp->nozzle_exit;
+	rse.BurnTimeSecs = burn_time;
+	rse.MassFrac = 1. - (rp->dry_mass + rp->column_final[REPORT_TANK_N2O_MASS] +
+					rp->column_final[REPORT_FUEL_MASS]) /
+				rse.EngineWetMass;
+	rse.ISPSecs = report_average(rp, REPORT_ISP);
+
+
+	rse.comment = "Simulated by HSim Version 0.3.\n";
+
+	keep = rocksim_keep(rp);
+	rse_begin(output);
+	rse_datafile(&rse);
+	for (i = 0; i < rp->rs_n_points; i++)
+		if (!keep || keep[i])
+			rse_datafile_point(rp->rs_data + i);
+	rse_end();
+	free(keep);
+}
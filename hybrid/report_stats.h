@@ -0,0 +1,166 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * The report statistics, as a library.
+ *
+ * The report program reads an hsim data file into these; hsim --report
+ * feeds them the rows as the run records them.  Either way:
+ *
+ *	report_init()		once
+ *	report_parameter()	for each line of the parameters section
+ *	report_columns()	with the timeseries column names
+ *	report_row()		for each row, in column order
+ *				(report_wanted() says which columns count)
+ *	report_print()		the human readable report
+ *	report_rocksim()	the Rocksim engine file, if wanted
+ *	report_summary()	the headline numbers, for comparing runs
+ *	report_free()
+ *
+ * Requires stdio.h and rocksim.h.
+ */
+
+#define	REPORT_COLUMNS	23	/* statistics kept, see report_stats.c */
+#define	REPORT_THRUST_ERROR	0.005	/* Rocksim curve bounds */
+#define	REPORT_IMPULSE_ERROR	0.001
+
+/*
+ * The statistics kept, by their place in the column_ arrays: the
+ * timeseries columns report uses, and ratios computed from them.
+ */
+#define	REPORT_TANK_N2O_MASS		0
+#define	REPORT_TANK_PRESSURE		1
+#define	REPORT_TANK_TEMPERATURE		2
+#define	REPORT_N2O_LIQUID_MASS		3
+#define	REPORT_N2O_LIQUID_DENSITY	4
+#define	REPORT_FUEL_MASS		5
+#define	REPORT_GRAIN_CORE		6
+#define	REPORT_CHAMBER_PRESSURE		7
+#define	REPORT_N2O_FLOW_RATE		8
+#define	REPORT_N2O_VENT_RATE		9
+#define	REPORT_N2O_FLUX			10
+#define	REPORT_FUEL_FLOW_RATE		11
+#define	REPORT_ISP			12
+#define	REPORT_NOZZLE_CF		13
+#define	REPORT_THRUST			14
+#define	REPORT_EXIT_PRESSURE		15
+#define	REPORT_OF_RATIO			16
+#define	REPORT_IP_RATIO			17
+#define	REPORT_BURN_TIME		18
+#define	REPORT_LFUEL_MASS		19
+#define	REPORT_LFUEL_VOLUME		20
+#define	REPORT_LFUEL_PRESSURE		21
+#define	REPORT_IPL_RATIO		22
+
+struct report_s {
+	/* from the parameters section */
+	double	tank_height;
+	double	ullage_height;
+	double	tank_volume;
+	double	grain_length;
+	double	grain_diameter;
+	double	grain_core;
+	double	nozzle_throat;
+	double	nozzle_exit;
+	double	nozzle_cf_adjust;
+	double	nozzle_half_angle;
+	double	cstar_adjust;
+	double	injector_diameter;
+	double	injector_cd;
+	double	injector_count;
+	double	vent_diameter;
+	double	vent_cd;
+	double	fill_temp;
+	double	fill_pressure_drop;
+	double	dry_mass;
+	double	vent_mass;
+	double	engine_dia;
+	double	engine_len;
+	double	supply_press;
+	double	ambientpressure;
+	char	fuel[128];
+	int	tank_height_set;
+	int	ullage_height_set;
+	int	tank_volume_set;
+	int	vent_mass_set;
+	int	grain_length_set;
+	int	grain_diameter_set;
+	int	grain_core_set;
+	int	nozzle_throat_set;
+	int	nozzle_exit_set;
+	int	nozzle_cf_adjust_set;
+	int	nozzle_half_angle_set;
+	int	cstar_adjust_set;
+	int	injector_diameter_set;
+	int	injector_cd_set;
+	int	injector_count_set;
+	int	vent_diameter_set;
+	int	vent_cd_set;
+	int	fill_temp_set;
+	int	fill_pressure_drop_set;
+	int	supply_press_set;
+	int	dry_mass_set;
+	int	engine_dia_set;
+	int	engine_len_set;
+	int	ambientpressure_set;
+
+	/* from the timeseries */
+	int	column_numbers[REPORT_COLUMNS];	/* in the row, or -1 */
+	double	column_min[REPORT_COLUMNS];
+	double	column_max[REPORT_COLUMNS];
+	double	column_integral[REPORT_COLUMNS];	/* over time */
+	double	column_init[REPORT_COLUMNS];
+	double	column_final[REPORT_COLUMNS];
+	int	nrow;
+
+	/* Rocksim points, one a row, simplified when written */
+	int	rocksim;
+	struct rse_datapoint_s *rs_data;
+	int	rs_n_points;
+	int	rs_size;
+	double	rs_thrust_error;	/* fraction of the peak thrust */
+	double	rs_impulse_error;	/* fraction of the total impulse */
+
+	int	debug;			/* print the parsed input */
+};
+
+/*
+ * The headline numbers of a run, as report_print() gives them.
+ */
+struct report_summary_s {
+	double	total_impulse;		/* N-s */
+	double	average_thrust;		/* N */
+	double	peak_thrust;		/* N */
+	double	burn_time;		/* seconds */
+	char	motor_class[16];	/* e.g. "K-1234" */
+	double	class_fraction;		/* how far into the class, 0 to 1 */
+	double	delivered_isp;		/* impulse per kg burned, m/s */
+	double	of_init;		/* O/F ratio at the first row */
+	double	of_final;		/* and at the last */
+};
+
+void report_init(struct report_s *rp, int rocksim, int debug);
+void report_parameter(struct report_s *rp, char *name, char *value);
+void report_columns(struct report_s *rp, int ncols, char **names);
+void report_row(struct report_s *rp, double *row);
+int report_wanted(struct report_s *rp, int column);
+void report_print(struct report_s *rp, FILE *output, int html);
+void report_rocksim(struct report_s *rp, FILE *output);
+void report_summary(struct report_s *rp, struct report_summary_s *sp);
+double report_average(struct report_s *rp, int column);
+void report_free(struct report_s *rp);
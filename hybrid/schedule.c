@@ -0,0 +1,323 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Sweep Scheduling
+ *
+ * hsim -b runs its decks in an order of its own; the replies are
+ * still written in the decks' order.  The decks are grouped by fuel
+ * and nozzle ratio, which is what a nozzle table is read for, so the
+ * batch reads each table once, before the group's first job, and the
+ * jobs it forks share it.  Within a group, the decks run in order along
+ * a Hilbert curve through the design variables, so each design is
+ * close to the ones run just before it.  A job can then start its
+ * solver from the answer of a finished neighbour (hsim -W).
+ *
+ * The design variables are the numeric parameters the decks give,
+ * in SI units, scaled to run from 0 to 1 over the group.  A deck that
+ * leaves one out has its default, as design_defaults() sets it.  The
+ * curve is Skilling's, in SCHED_BITS bits a variable.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include "ts_parse.h"
+#include "scio.h"
+#include "state.h"
+#include "design.h"
+#include "schedule.h"
+
+extern char *myname;
+
+#define	SCHED_BITS	16
+#define	KEY_WORDS(d)	(((d) * SCHED_BITS + 63) / 64)
+
+static double *values;		/* n_vars for each deck */
+static unsigned long long *keys;
+static int key_words;
+static int *group_rank;
+static struct sched_s *sched;
+
+static void *
+sched_malloc(size_t size)
+{
+	void *p;
+
+	if (!(p = malloc(size ? size: 1))) {
+		fprintf(stderr, "%s: cannot malloc %ld bytes\n", myname,
+			(long)size);
+		exit(1);
+	}
+	return p;
+}
+
+/*
+ * The numeric parameters and the nozzle ratio of a deck.  A line
+ * that cannot be read is passed over; the job reports it.
+ */
+static void
+deck_values(char *text, struct sched_s *sp, int *var, int n_params)
+{
+	static struct ts_parsed_s *buffer;
+	struct scio_input_parameter_s *ip;
+	struct ts_parsed_s *bp;
+	double v, ratio, throat, exit;
+	char **w, *copy, *p, *tail;
+	int i, n;
+
+	strncpy(sp->fuel, fuel, sizeof sp->fuel - 1);
+	sp->fuel[sizeof sp->fuel - 1] = '\0';
+	ratio = throat = exit = 0.;
+
+	p = copy = sched_malloc(strlen(text) + 1);
+	strcpy(copy, text);
+	while ((bp = ts_parse_text(&p, buffer)) != NULL) {
+		buffer = bp;
+		w = bp->words;
+		for (n = 0; w[n]; n++)
+			;
+		if (n < 2 || !(ip = design_parameter(w[0])))
+			continue;
+		if (ip->unit == STRING) {
+			if (strcasecmp(w[0], "fuel") == 0)
+				strncpy(sp->fuel, w[1], sizeof sp->fuel - 1);
+			continue;
+		}
+		v = strtod(w[1], &tail);
+		if (tail == w[1] || (ip->unit != NUMBER &&
+		    scio_try_convert(v, ip->unit, w[n - 1], &v) < 0))
+			continue;
+		i = ip - design_parameter_index(0);
+		if (var[i] >= 0)
+			sp->x[var[i]] = v;
+		if (strcasecmp(w[0], "nozzleratio") == 0)
+			ratio = v;
+		else if (strcasecmp(w[0], "nozzlethroat") == 0)
+			throat = v;
+		else if (strcasecmp(w[0], "nozzleexit") == 0)
+			exit = v;
+	}
+	free(copy);
+
+	/* as design_setup() works it out */
+	sp->nzr = ratio;
+	if (ratio == 0. && throat > 0.)
+		sp->nzr = (exit / throat) * (exit / throat);
+}
+
+static int
+same_group(struct sched_s *a, struct sched_s *b)
+{
+	return (int)(a->nzr * 1000. + .5) == (int)(b->nzr * 1000. + .5) &&
+		strcmp(a->fuel, b->fuel) == 0;
+}
+
+/*
+ * Scale each variable to 0 to 1 over the group.
+ */
+static void
+normalize(struct sched_s *sp, int n, int n_vars, int n_groups)
+{
+	double *lo, *hi, v;
+	int g, i, k;
+
+	lo = sched_malloc(n_groups * n_vars * sizeof (double));
+	hi = sched_malloc(n_groups * n_vars * sizeof (double));
+	for (i = 0; i < n_groups * n_vars; i++) {
+		lo[i] = INFINITY;
+		hi[i] = -INFINITY;
+	}
+	for (i = 0; i < n; i++)
+		for (k = 0, g = sp[i].group * n_vars; k < n_vars; k++)
+			if (!isnan(v = sp[i].x[k])) {
+				if (v < lo[g + k])
+					lo[g + k] = v;
+				if (v > hi[g + k])
+					hi[g + k] = v;
+			}
+	for (i = 0; i < n; i++)
+		for (k = 0, g = sp[i].group * n_vars; k < n_vars; k++) {
+			v = sp[i].x[k];
+			if (isnan(v) || hi[g + k] <= lo[g + k])
+				sp[i].x[k] = 0.;
+			else
+				sp[i].x[k] = (v - lo[g + k]) /
+					(hi[g + k] - lo[g + k]);
+		}
+	free(lo);
+	free(hi);
+}
+
+/*
+ * The place of a point on the Hilbert curve through d dimensions,
+ * from Skilling, "Programming the Hilbert curve": the coordinates are
+ * turned into the curve's transposed index, whose bits, interleaved
+ * from the top, are the index.
+ */
+static void
+hilbert_key(unsigned *x, int d, unsigned long long *key)
+{
+	unsigned m, p, q, t;
+	int i, b, bit;
+
+	m = 1u << (SCHED_BITS - 1);
+	for (q = m; q > 1; q >>= 1) {
+		p = q - 1;
+		for (i = 0; i < d; i++)
+			if (x[i] & q)
+				x[0] ^= p;
+			else {
+				t = (x[0] ^ x[i]) & p;
+				x[0] ^= t;
+				x[i] ^= t;
+			}
+	}
+	for (i = 1; i < d; i++)
+		x[i] ^= x[i - 1];
+	t = 0;
+	for (q = m; q > 1; q >>= 1)
+		if (x[d - 1] & q)
+			t ^= q - 1;
+	for (i = 0; i < d; i++)
+		x[i] ^= t;
+
+	memset(key, 0, key_words * sizeof *key);
+	bit = 0;
+	for (b = SCHED_BITS - 1; b >= 0; b--)
+		for (i = 0; i < d; i++, bit++)
+			if ((x[i] >> b) & 1)
+				key[bit / 64] |= 1ULL << (63 - bit % 64);
+}
+
+static int
+compare_sched(const void *a, const void *b)
+{
+	const struct sched_s *s = a, *t = b;
+	int k;
+
+	if (s->group != t->group)
+		return group_rank[s->group] < group_rank[t->group]? -1: 1;
+	for (k = 0; k < key_words; k++)
+		if (keys[s->deck * key_words + k] !=
+		    keys[t->deck * key_words + k])
+			return keys[s->deck * key_words + k] <
+				keys[t->deck * key_words + k]? -1: 1;
+	return s->deck < t->deck? -1: s->deck > t->deck;
+}
+
+/*
+ * Fill sp with the n decks in the order to run them.  Returns the
+ * number of groups, and sets *n_vars to the number of variables in
+ * each x.
+ */
+int
+schedule(char **texts, int n, struct sched_s *sp, int *n_vars)
+{
+	struct scio_input_parameter_s *ip;
+	unsigned *u;
+	int *var;
+	double *defaults;
+	int i, j, k, n_params, n_groups;
+
+	schedule_free();
+	for (n_params = 0; design_parameter_index(n_params); n_params++)
+		;
+	var = sched_malloc(n_params * sizeof (int));
+	defaults = sched_malloc((n_params + 1) * sizeof (double));
+	design_defaults();
+	for (i = *n_vars = 0; i < n_params; i++) {
+		ip = design_parameter_index(i);
+		if (ip->unit == STRING)
+			var[i] = -1;
+		else {
+			/* the first value of a sweep */
+			defaults[*n_vars] = *(double *)ip->vp;
+			var[i] = (*n_vars)++;
+		}
+	}
+
+	values = sched_malloc((size_t)n * *n_vars * sizeof (double));
+	for (i = 0; i < n; i++) {
+		sp[i].deck = i;
+		sp[i].x = values + (size_t)i * *n_vars;
+		for (k = 0; k < *n_vars; k++)
+			sp[i].x[k] = defaults[k];
+		deck_values(texts[i], sp + i, var, n_params);
+	}
+	free(var);
+	free(defaults);
+
+	/* the groups, numbered as they first appear */
+	n_groups = 0;
+	group_rank = sched_malloc((n + 1) * sizeof (int));
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < i && !same_group(sp + j, sp + i); j++)
+			;
+		sp[i].group = j < i? sp[j].group: n_groups++;
+		group_rank[sp[i].group] = sp[i].group;
+	}
+	normalize(sp, n, *n_vars, n_groups);
+
+	key_words = KEY_WORDS(*n_vars > 0? *n_vars: 1);
+	keys = sched_malloc((size_t)n * key_words * sizeof *keys);
+	u = sched_malloc((*n_vars + 1) * sizeof (unsigned));
+	for (i = 0; i < n; i++) {
+		for (k = 0; k < *n_vars; k++)
+			u[k] = sp[i].x[k] * ((1u << SCHED_BITS) - 1) + .5;
+		if (*n_vars)
+			hilbert_key(u, *n_vars, keys + (size_t)i * key_words);
+		else
+			keys[i] = 0;
+	}
+	free(u);
+
+	qsort(sp, n, sizeof *sp, compare_sched);
+	free(keys);
+	keys = NULL;
+	sched = sp;
+	return n_groups;
+}
+
+/*
+ * How far apart two designs of a group are.
+ */
+double
+schedule_distance(struct sched_s *a, struct sched_s *b, int n_vars)
+{
+	double d, t;
+	int k;
+
+	for (d = 0., k = 0; k < n_vars; k++) {
+		t = a->x[k] - b->x[k];
+		d += t * t;
+	}
+	return d;
+}
+
+void
+schedule_free()
+{
+	free(values);
+	free(group_rank);
+	values = NULL;
+	group_rank = NULL;
+	sched = NULL;
+}
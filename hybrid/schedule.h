@@ -0,0 +1,33 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * The order a batch runs its decks in.  See schedule.c.
+ */
+
+struct sched_s {
+	int	deck;		/* the deck's place in the batch */
+	int	group;		/* decks sharing a fuel and nozzle table */
+	char	fuel[32];
+	double	nzr;		/* the nozzle ratio, 0 if the deck gives none */
+	double	*x;		/* the design, each variable 0 to 1 in the group */
+};
+
+int schedule(char **texts, int n, struct sched_s *sp, int *n_vars);
+double schedule_distance(struct sched_s *a, struct sched_s *b, int n_vars);
+void schedule_free();
@@ -0,0 +1,486 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Sensitivities
+ *
+ * Forward-mode differentiation of a hybrid run.  Every continuous
+ * design parameter is an independent variable of a dual number (see
+ * dual.h).  A tangent model follows the run through the record_data()
+ * hook: at every step it differentiates the tank state, vent,
+ * injector, fuel regression, cpropep lookup and thrust, and then the
+ * tank and fuel time step, along the states the run computed.  One
+ * run gives the derivatives of thrust(t) and of the total impulse
+ * with respect to all of the parameters.
+ *
+ * The tank temperature and the chamber pressure come out of iterative
+ * solvers.  Differentiating the iterations would give the derivative
+ * of the bisection rather than of the solution, so the implicit
+ * function theorem is used instead: if F(x, p) = 0 at the converged x
+ * then dx/dp = -(dF/dp) / (dF/dx).  The spare dual variable SOLVER
+ * carries dF/dx.
+ *
+ * The burn ends part way through the last step.  That step is counted
+ * only until the liquid (or the fuel) runs out, so the total impulse
+ * is a smooth function of the parameters.
+ *
+ * The thermodynamic and cpropep tables are piecewise linear, and the
+ * derivatives are those of the interpolated model.  The cpropep data
+ * is tabulated for one nozzle ratio at a time, so the nozzle ratio
+ * only enters through the pressure thrust.
+ *
+ * DYNAMIC INPUTS:
+ *	the run, through the record_data() hook
+ *
+ * STATIC INPUTS:
+ *	the design parameters
+ *
+ * OUTPUTS:
+ *	sensitivity and sensitivity timeseries sections
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "scio.h"
+#include "linkage.h"
+#include "state.h"
+#include "design.h"
+#include "dual.h"
+
+extern char *myname;
+
+/*
+ * The independent variables, in the order of param_table[].
+ */
+#define	TANKHEIGHT	0
+#define	ULLAGEHEIGHT	1
+#define	TANKDIA		2
+#define	GRAINLENGTH	3
+#define	GRAINDIAMETER	4
+#define	GRAINCORE	5
+#define	NOZZLETHROAT	6
+#define	NOZZLEEXIT	7
+#define	NOZZLERATIO	8
+#define	NOZCFADJ	9
+#define	NOZHALFANGLE	10
+#define	CSTARADJ	11
+#define	INJECTORDIA	12
+#define	INJECTORCD	13
+#define	VENTDIA		14
+#define	VENTCD		15
+#define	FILLTEMP	16
+#define	FILLDROP	17
+#define	FILLPRESS	18
+#define	AMBIENTPRESSURE	19
+#define	N_PARAMS	20
+
+#define	SOLVER		N_PARAMS	/* implicit function variable */
+
+#if DUAL_N <= N_PARAMS
+#error DUAL_N too small
+#endif
+
+static struct param_s {
+	char *name;
+	char *unit;
+	int always;		/* has a default, so always used */
+} param_table[N_PARAMS] = {
+	{ "tankheight",		"meters",	0, },
+	{ "ullageheight",	"meters",	0, },
+	{ "tankdia",		"meters",	0, },
+	{ "grainlength",	"meters",	0, },
+	{ "graindiameter",	"meters",	0, },
+	{ "graincore",		"meters",	0, },
+	{ "nozzlethroat",	"meters",	0, },
+	{ "nozzleexit",		"meters",	0, },
+	{ "nozzleratio",	"",		0, },
+	{ "nozcfadj",		"",		0, },
+	{ "nozhalfangle",	"radian",	1, },
+	{ "cstaradj",		"",		0, },
+	{ "injectordia",	"meters",	0, },
+	{ "injectorcd",		"",		0, },
+	{ "ventdia",		"meters",	0, },
+	{ "ventcd",		"",		0, },
+	{ "filltemp",		"kelvin",	0, },
+	{ "filldrop",		"pascal",	0, },
+	{ "fillpress",		"pascal",	0, },
+	{ "ambientpressure",	"pascal",	1, },
+};
+
+static int used[N_PARAMS];
+static struct dual_s p[N_PARAMS];
+
+/* derived design values */
+static struct dual_s volume;
+static struct dual_s throat_area, exit_area;
+static struct dual_s injector_a, vent_a;
+
+/* the state carried from step to step */
+static struct dual_s energy;		/* tank_energy */
+static struct dual_s mass;		/* tank_n2o_mass */
+static struct dual_s fuel_m;		/* fuel_mass */
+
+static struct dual_s impulse;		/* all but the last step */
+static struct dual_s last_thrust;
+static struct dual_s last_fraction;	/* of the last step that counts */
+static double last_liquid;
+static int n_steps;
+
+/* thrust and its derivatives at each step */
+#define	ROW		(N_PARAMS + 2)
+static double *series;
+static int n_series;
+static int max_series;
+
+/*
+ * x, given the residual f(x) = 0 as a function of dual_var(x, SOLVER)
+ * and the parameters.
+ */
+static struct dual_s
+implicit(double x, struct dual_s f)
+{
+	int i;
+	struct dual_s r;
+
+	r = dual_const(x);
+	for (i = 0; i < N_PARAMS; i++)
+		r.d[i] = -f.d[i] / f.d[SOLVER];
+	return r;
+}
+
+static struct dual_s
+circle_area(struct dual_s d)
+{
+	return dual_scale(dual_mul(d, d), pi / 4.);
+}
+
+/*
+ * The same as tank_thermo(), at temperature t.
+ * Returns the energy, the liquid mass and density, and the vapor density.
+ */
+static struct dual_s
+tank_thermo_d(struct dual_s t, struct dual_s *liquid_mass,
+	struct dual_s *liquid_dens, struct dual_s *vapor_dens)
+{
+	struct dual_s one;
+	struct dual_s lf, ml, mv;
+	struct dual_s e_l, e_v;
+
+	*vapor_dens = dual_chain(vapor_density(t.v),
+		vapor_density_slope(t.v), t);
+	*liquid_dens = dual_chain(liquid_density(t.v),
+		liquid_density_slope(t.v), t);
+
+	one = dual_const(1.);
+	lf = dual_div(
+		dual_sub(dual_div(volume, mass), dual_div(one, *vapor_dens)),
+		dual_sub(dual_div(one, *liquid_dens),
+			dual_div(one, *vapor_dens)));
+
+	ml = dual_mul(lf, mass);
+	mv = dual_sub(mass, ml);
+	if (ml.v < 0) {
+		ml = dual_const(0.);
+		mv = mass;
+	}
+	if (mv.v < 0) {
+		mv = dual_const(0.);
+		ml = mass;
+	}
+	*liquid_mass = ml;
+
+	e_l = dual_chain(liquid_energy(t.v), liquid_energy_slope(t.v), t);
+	e_v = dual_chain(vapor_energy(t.v), vapor_energy_slope(t.v), t);
+	return dual_add(dual_mul(ml, e_l), dual_mul(mv, e_v));
+}
+
+/*
+ * One pass through the injector, fuel regression and cpropep models
+ * at chamber pressure pc.  Returns the chamber pressure the nozzle
+ * supports at the resulting flow, as in chamber_converge().
+ *
+ * The cpropep slopes are for the current state.
+ */
+static struct dual_s
+chamber_d(struct dual_s pc, struct dual_s tank_p, struct dual_s liquid_dens,
+	double d_of[3], double d_cp[3],
+	struct dual_s *ox, struct dual_s *fu, struct dual_s *cs,
+	struct dual_s *pe, struct dual_s *cf)
+{
+	struct dual_s drop;
+	struct dual_s a1, a2, core;
+	struct dual_s flux, rb, of;
+
+	/* injector() */
+	drop = dual_sub(tank_p, pc);
+	if (drop.v < 0.)
+		drop = dual_const(0.);
+	*ox = dual_scale(dual_mul(dual_mul(p[INJECTORCD], injector_a),
+		dual_sqrt(dual_scale(dual_mul(liquid_dens, drop), 2.))),
+		injector_count);
+
+	/* fuel_regression() */
+	a1 = dual_div(fuel_m, dual_scale(p[GRAINLENGTH], fuel_density));
+	a2 = dual_sub(circle_area(p[GRAINDIAMETER]), a1);
+	core = dual_sqrt(dual_scale(a2, 4. / pi));
+	flux = dual_div(*ox, circle_area(core));
+	rb = dual_scale(dual_pow(dual_scale(flux, fuel_a),
+		dual_const(fuel_n)), fuel_k);
+	*fu = dual_scale(dual_mul(dual_mul(rb, core), p[GRAINLENGTH]),
+		pi * fuel_density);
+
+	/* cpropep() */
+	of = dual_div(*ox, *fu);
+	*cs = dual_add(dual_chain(c_star, d_of[0], of),
+		dual_chain(0., d_cp[0], pc));
+	*pe = dual_add(dual_chain(exit_pressure, d_of[1], of),
+		dual_chain(0., d_cp[1], pc));
+	*cf = dual_add(dual_chain(nozzle_cf, d_of[2], of),
+		dual_chain(0., d_cp[2], pc));
+
+	return dual_div(dual_mul(dual_mul(*cs, p[CSTARADJ]),
+		dual_add(*ox, *fu)), throat_area);
+}
+
+static void
+save_row(struct dual_s thrust_d)
+{
+	int i;
+	double *rp;
+
+	if (n_series >= max_series) {
+		max_series = max_series? 2 * max_series: 1024;
+		series = realloc(series, max_series * ROW * sizeof *series);
+		if (!series) {
+			fprintf(stderr, "%s: out of memory\n", myname);
+			error_exit(1);
+		}
+	}
+	rp = series + n_series++ * ROW;
+	rp[0] = sim_time;
+	rp[1] = thrust_d.v;
+	for (i = 0; i < N_PARAMS; i++)
+		rp[i + 2] = thrust_d.d[i];
+}
+
+/*
+ * Called at every step with the tank and chamber solved.
+ * Differentiates this step, then the time step to the next one.
+ */
+static void
+step()
+{
+	double dt;
+	double drain;
+	double d_of[3], d_cp[3];
+	struct dual_s t, f, pressure;
+	struct dual_s ml, rho_l, rho_v;
+	struct dual_s k, kr, cstar, vent_rate;
+	struct dual_s pc, ox, fu, cs, pe, cf;
+	struct dual_s adj_cf, thrust_d;
+	struct dual_s fraction, loss, one;
+
+	dt = sim_time_step;
+	one = dual_const(1.);
+
+	/*
+	 * The state is the one the run has, only the derivatives
+	 * are ours.
+	 */
+	energy.v = tank_energy;
+	mass.v = tank_n2o_mass;
+	fuel_m.v = fuel_mass;
+
+	/* tank temperature, from tank_thermo(t) == tank_energy */
+	t = dual_var(tank_temperature, SOLVER);
+	f = dual_sub(tank_thermo_d(t, &ml, &rho_l, &rho_v), energy);
+	t = implicit(tank_temperature, f);
+	tank_thermo_d(t, &ml, &rho_l, &rho_v);
+	pressure = dual_chain(saturation_pressure(t.v),
+		saturation_pressure_slope(t.v), t);
+
+	/* vent() */
+	k = dual_chain(cpcv(t.v), cpcv_slope(t.v), t);
+	kr = dual_div(dual_scale(one, 2.), dual_add(k, one));
+	cstar = dual_div(
+		dual_sqrt(dual_scale(dual_mul(k, t), ideal_gas_constant)),
+		dual_mul(k, dual_sqrt(dual_pow(kr, dual_div(one, k)))));
+	vent_rate = dual_div(dual_mul(dual_mul(pressure, vent_a), p[VENTCD]),
+		cstar);
+
+	/* chamber pressure, from chamber_d(pc) == pc */
+	cpropep_slopes(d_of, d_cp);
+	pc = dual_var(chamber_pressure, SOLVER);
+	f = dual_sub(chamber_d(pc, pressure, rho_l, d_of, d_cp,
+		&ox, &fu, &cs, &pe, &cf), pc);
+	pc = implicit(chamber_pressure, f);
+	chamber_d(pc, pressure, rho_l, d_of, d_cp, &ox, &fu, &cs, &pe, &cf);
+
+	/* chamber() */
+	adj_cf = dual_add(one, dual_mul(p[NOZCFADJ], dual_sub(cf, one)));
+	thrust_d = dual_mul(dual_mul(pc, throat_area), adj_cf);
+	thrust_d = dual_mul(thrust_d,
+		dual_scale(dual_add(one, dual_cos(p[NOZHALFANGLE])), .5));
+	thrust_d = dual_add(thrust_d, dual_mul(
+		dual_sub(pe, p[AMBIENTPRESSURE]), exit_area));
+	save_row(thrust_d);
+
+	/*
+	 * The previous step counts in full.  This one counts until
+	 * the liquid or the fuel runs out.  Some of the vapor condenses
+	 * as the tank empties, so the liquid drains a little slower than
+	 * the injector flow.  The end of the burn moves with the liquid
+	 * mass at the rate it actually drains.
+	 */
+	drain = ox.v;
+	if (n_steps && last_liquid > ml.v)
+		drain = (last_liquid - ml.v) / dt;
+	last_liquid = ml.v;
+	if (n_steps++)
+		impulse = dual_add(impulse, dual_scale(last_thrust, dt));
+	last_thrust = thrust_d;
+	last_fraction = dual_const(dt);
+	fraction = dual_scale(ml, 1. / drain);
+	if (fraction.v < last_fraction.v)
+		last_fraction = fraction;
+	fraction = dual_div(fuel_m, fu);
+	if (fraction.v < last_fraction.v)
+		last_fraction = fraction;
+
+	/* tank_step() */
+	loss = dual_scale(vent_rate, dt);
+	mass = dual_sub(mass, loss);
+	energy = dual_sub(energy, dual_mul(loss, dual_add(
+		dual_chain(vapor_energy(t.v), vapor_energy_slope(t.v), t),
+		dual_div(pressure, rho_v))));
+
+	loss = dual_scale(ox, dt);
+	mass = dual_sub(mass, loss);
+	energy = dual_sub(energy, dual_mul(loss, dual_add(
+		dual_chain(liquid_energy(t.v), liquid_energy_slope(t.v), t),
+		dual_div(pressure, rho_l))));
+
+	/* fuel_step() */
+	fuel_m = dual_sub(fuel_m, dual_scale(fu, dt));
+}
+
+/*
+ * Set up the derivatives of the initial state, after design_fill().
+ */
+void
+sensitivity_init()
+{
+	int i;
+	struct scio_input_parameter_s *ip;
+	struct dual_s p0, t0, ullage;
+	struct dual_s ml, rho_l, rho_v;
+
+	if (sim_type != HYBRID || dry_fire) {
+		fprintf(stderr, "%s: sensitivities need a hybrid motor "
+				"and a live fire\n", myname);
+		error_exit(1);
+	}
+
+	for (i = 0; i < N_PARAMS; i++) {
+		ip = design_parameter(param_table[i].name);
+		used[i] = param_table[i].always || !ip->nvp || *ip->nvp;
+		p[i] = dual_var(*(double *)ip->vp, i);
+	}
+
+	/* design_setup() */
+	volume = dual_mul(circle_area(p[TANKDIA]), p[TANKHEIGHT]);
+	injector_a = circle_area(p[INJECTORDIA]);
+	throat_area = circle_area(p[NOZZLETHROAT]);
+	if (used[NOZZLEEXIT])
+		exit_area = circle_area(p[NOZZLEEXIT]);
+	else
+		exit_area = dual_mul(throat_area, p[NOZZLERATIO]);
+	vent_a = circle_area(p[VENTDIA]);
+
+	/*
+	 * design_fill().  The tank is filled at the temperature where
+	 * the saturation pressure is the flight tank pressure.
+	 */
+	if (used[FILLPRESS])
+		p0 = p[FILLPRESS];
+	else
+		p0 = dual_sub(dual_chain(saturation_pressure(p[FILLTEMP].v),
+			saturation_pressure_slope(p[FILLTEMP].v), p[FILLTEMP]),
+			p[FILLDROP]);
+	t0 = dual_chain(tank_temperature,
+		1. / saturation_pressure_slope(tank_temperature), p0);
+
+	ullage = dual_mul(dual_div(p[ULLAGEHEIGHT], p[TANKHEIGHT]), volume);
+	mass = dual_add(dual_mul(ullage, dual_chain(vapor_density(t0.v),
+			vapor_density_slope(t0.v), t0)),
+		dual_mul(dual_sub(volume, ullage), dual_chain(
+			liquid_density(t0.v), liquid_density_slope(t0.v), t0)));
+	mass.v = tank_n2o_mass;
+	energy = tank_thermo_d(t0, &ml, &rho_l, &rho_v);
+
+	/* fuel_init() */
+	fuel_m = dual_scale(dual_mul(p[GRAINLENGTH],
+		dual_sub(dual_mul(p[GRAINDIAMETER], p[GRAINDIAMETER]),
+			dual_mul(p[GRAINCORE], p[GRAINCORE]))),
+		fuel_density * pi / 4.);
+
+	impulse = dual_const(0.);
+	last_thrust = dual_const(0.);
+	last_fraction = dual_const(0.);
+	n_steps = 0;
+	n_series = 0;
+	record_data_hook(step);
+}
+
+void
+sensitivity_report(FILE *output)
+{
+	int i, j;
+	struct dual_s total;
+	double *rp;
+
+	total = dual_add(impulse, dual_mul(last_thrust, last_fraction));
+
+	fprintf(output, "SECTION,sensitivity\n");
+	fprintf(output, "Parameter,Value,Unit,d impulse\n");
+	fprintf(output, "impulse,%.6e,newton-seconds,\n", total.v);
+	for (i = 0; i < N_PARAMS; i++)
+		if (used[i])
+			fprintf(output, "%s,%.6e,%s,%.6e\n",
+				param_table[i].name, p[i].v,
+				param_table[i].unit, total.d[i]);
+	fprintf(output, "\n");
+
+	fprintf(output, "SECTION,sensitivity timeseries\n");
+	fprintf(output, "time,thrust");
+	for (i = 0; i < N_PARAMS; i++)
+		if (used[i])
+			fprintf(output, ",d thrust/d %s", param_table[i].name);
+	fprintf(output, "\n");
+	for (j = 0; j < n_series; j++) {
+		rp = series + j * ROW;
+		fprintf(output, "%f,%f", rp[0], rp[1]);
+		for (i = 0; i < N_PARAMS; i++)
+			if (used[i])
+				fprintf(output, ",%.6e", rp[i + 2]);
+		fprintf(output, "\n");
+	}
+	fprintf(output, "END-OF-DATA\n\n");
+	fflush(output);
+}
@@ -0,0 +1,1033 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+
+/*
+ * Simulation Server
+ *
+ * hsim -d <socket> keeps the nozzle, fuel and n2o tables loaded and
+ * runs designs sent to it over a Unix domain socket, which saves the
+ * start up cost of a fresh hsim for every design.
+ *
+ * A client connects, writes an input deck in the usual format, and
+ * ends it either by shutting down its side of the connection or with a
+ * line holding just "---".  The deck may also hold lines for the server:
+ *
+ *	job output raw|summary|both	(raw)
+ *	job timeout <seconds>		(the -t value)
+ *
+ * raw is what hsim writes on stdout, summary is a "summary" section of
+ * the numbers libhsim reports.  Either way the reply ends with
+ *
+ *	SECTION,status
+ *	status,code,message
+ *	ok|error|timeout|cancelled,<code>,<message>
+ *
+ * where code is one of the SIM_E codes in state.h.  A deck the parser
+ * rejects gets an "errors" section ahead of the status, holding what
+ * the parser said, and the first of it as the message.  A client that
+ * ended the deck with "---" may cancel the run by writing "cancel", or
+ * by closing the connection.
+ *
+ * The server pre-forks a pool of workers which share the listening
+ * socket; connections the workers are not yet serving wait in its
+ * listen queue, so -q bounds the number of jobs waiting.  Each worker
+ * forks again for every job, so a job that fails in a way the
+ * simulator does not recover from, runs too long or is cancelled costs
+ * nothing but its own process.  The tables loaded before the first
+ * fork are shared copy on write.
+ *
+ * hsim -b runs the same way without the socket: stdin holds any number
+ * of decks separated by "---" lines, and the replies are written to
+ * stdout in the same order, -j at a time.  Every deck starts from the
+ * default parameters.  A line
+ *
+ *	run <id>
+ *
+ * names a deck, and the reply starts with a "run" section holding the
+ * name.  In batch mode a deck without one is named by its number.  A
+ * rejected deck's errors section is in its own reply, as from the
+ * server; anything else a job writes on stderr is passed on after it
+ * finishes, each line marked with the deck's name.
+ *
+ * With hsim -A, each job of a batch fills in its row of the sweep
+ * store (see store.c) in memory shared with the batch, which appends
+ * the rows in deck order.  A job that dies first gets a row with just
+ * its status.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include "state.h"
+#include "linkage.h"
+#include "fuel.h"
+#include "design.h"
+#include "hsim.h"
+#include "store.h"
+#include "schedule.h"
+
+extern char *myname;
+
+#define	DECK_MAX	(64*1024)	/* largest input deck accepted */
+#define	MAX_WORKERS	256
+#define	WARM_WINDOW	64		/* schedule places searched for -W */
+
+#define	JOB_FAILED	2		/* exit status, with its own status */
+
+#define	OUTPUT_RAW	1
+#define	OUTPUT_SUMMARY	2
+
+struct deck_s {
+	char *text;
+	int length;
+	int output;
+	double timeout;
+	char id[64];		/* from a run line */
+	struct store_row_s *store_row;	/* for hsim -A, or NULL */
+	struct job_stat_s *stat;	/* for hsim -b, or NULL */
+};
+
+/*
+ * What a batch job tells the batch about its run, in shared memory.
+ */
+struct job_stat_s {
+	int done;		/* it got through its first step */
+	double first_cp;	/* the chamber pressure of that step */
+	long iterations;	/* chamber solver iterations */
+	int first_iterations;	/* of those, the first step's */
+	int loads;		/* nozzle tables it read for itself */
+	int constraint;		/* the HARD_ bit that stopped it, or 0 */
+};
+
+static volatile sig_atomic_t stopping;
+
+static void
+stop(int sig)
+{
+	stopping = 1;
+}
+
+static void
+put(int fd, char *s)
+{
+	int n, len;
+
+	for (len = strlen(s); len > 0; len -= n, s += n)
+		if ((n = write(fd, s, len)) <= 0)
+			return;
+}
+
+static void
+put_status(int fd, char *status, int code, char *message)
+{
+	char buffer[512];
+
+	if (code < 0)
+		snprintf(buffer, sizeof buffer, "SECTION,status\n"
+			"status,code,message\n%s,,%s\n\n", status, message);
+	else
+		snprintf(buffer, sizeof buffer, "SECTION,status\n"
+			"status,code,message\n%s,%d,%s\n\n",
+			status, code, message);
+	put(fd, buffer);
+}
+
+/*
+ * Take the job and run lines out of a deck.
+ */
+static void
+deck_options(struct deck_s *dp)
+{
+	char *line, *end;
+	char word[16];
+
+	for (line = dp->text; *line; line = end + 1) {
+		end = strchr(line, '\n');
+		if (!end)
+			end = line + strlen(line) - 1;
+		if (strncmp(line, "run", 3) == 0 && (line[3] == ' ' ||
+		    line[3] == '\t')) {
+			sscanf(line, "run %63[^ \t\r\n,]", dp->id);
+			*line = '#';
+			continue;
+		}
+		if (strncmp(line, "job", 3) != 0 || (line[3] != ' ' &&
+		    line[3] != '\t'))
+			continue;
+		if (sscanf(line, "job output %15s", word) == 1) {
+			if (strcmp(word, "raw") == 0)
+				dp->output = OUTPUT_RAW;
+			else if (strcmp(word, "summary") == 0)
+				dp->output = OUTPUT_SUMMARY;
+			else if (strcmp(word, "both") == 0)
+				dp->output = OUTPUT_RAW|OUTPUT_SUMMARY;
+		} else
+			sscanf(line, "job timeout %lf", &dp->timeout);
+		*line = '#';		/* the parser ignores it now */
+	}
+}
+
+/*
+ * Read a deck from the connection into buffer.
+ * Returns false if the client did not send a whole deck.
+ */
+static int
+read_deck(int fd, char *buffer, struct deck_s *dp, int *delimited)
+{
+	int n;
+	char *end;
+
+	dp->text = buffer;
+	dp->length = 0;
+	*delimited = 0;
+	for (;;) {
+		if (dp->length == DECK_MAX)
+			return 0;
+		n = read(fd, buffer + dp->length, DECK_MAX - dp->length);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return 0;
+		if (n == 0)
+			break;
+		dp->length += n;
+		buffer[dp->length] = '\0';
+		if (strncmp(buffer, "---\n", 4) == 0) {
+			dp->length = 0;
+			*delimited = 1;
+			break;
+		}
+		if ((end = strstr(buffer, "\n---\n")) != NULL) {
+			dp->length = end + 1 - buffer;
+			*delimited = 1;
+			break;
+		}
+	}
+	buffer[dp->length] = '\0';
+	deck_options(dp);
+	return 1;
+}
+
+/*
+ * The job process: parse and run the deck, writing the reply to fd,
+ * and what it has to say on stderr to errors, if that is not -1.
+ */
+static void
+run_job(int fd, int errors, struct deck_s *dp)
+{
+	FILE *output;
+	char message[256];
+	struct hsim_summary_s summary;
+	int status;
+
+	signal(SIGPIPE, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	if (errors >= 0) {
+		dup2(errors, 2);
+		close(errors);
+	}
+	output = fdopen(fd, "w");
+	if (!output)
+		_exit(SIM_E_SYSTEM);
+	if (dp->id[0])
+		fprintf(output, "SECTION,run\nrun\n%s\n\n", dp->id);
+	fflush(output);
+
+	/* input errors exit, and the worker reports them */
+	design_defaults();
+	design_parse_text(dp->text);
+
+	message[0] = '\0';
+	cpropep_loads = 0;
+	status = cache_run(output, dp->output & OUTPUT_RAW,
+		dp->output & OUTPUT_SUMMARY, message,
+		dp->store_row? &summary: NULL, NULL);
+	if (dp->store_row)
+		store_fill(dp->store_row, dp->id, status, &summary);
+	if (dp->stat) {
+		dp->stat->first_cp = chamber_first;
+		dp->stat->iterations = chamber_iterations;
+		dp->stat->first_iterations = chamber_first_iterations;
+		dp->stat->loads = cpropep_loads;
+		dp->stat->constraint = hard_constraint;
+		dp->stat->done = chamber_first > 0.;
+	}
+	fflush(output);
+	put_status(fd, status == SIM_OK? "ok": "error", status, message);
+	_exit(status == SIM_OK? 0: JOB_FAILED);
+}
+
+/*
+ * Put what a job wrote on stderr into its reply, as an errors section,
+ * and leave the first line, without our name, in first.
+ */
+static void
+put_errors(int fd, int errors, char *first, int size)
+{
+	char buffer[BUFSIZ];
+	char *p;
+	int n, last;
+
+	first[0] = '\0';
+	last = '\n';
+	lseek(errors, 0L, SEEK_SET);
+	while ((n = read(errors, buffer, sizeof buffer - 1)) > 0) {
+		buffer[n] = '\0';
+		if (!first[0]) {
+			put(fd, "SECTION,errors\n");
+			p = buffer;
+			if (strncmp(p, myname, strlen(myname)) == 0 &&
+			    strncmp(p + strlen(myname), ": ", 2) == 0)
+				p += strlen(myname) + 2;
+			snprintf(first, size, "%.*s", (int)strcspn(p, "\n"), p);
+		}
+		put(fd, buffer);
+		last = buffer[n - 1];
+	}
+	if (last != '\n')
+		put(fd, "\n");
+	if (first[0])
+		put(fd, "\n");
+}
+
+/*
+ * Copy what a job wrote on stderr to our own, with "run <id>: " after
+ * our name on each line if the job has an id.
+ */
+static void
+pass_errors(int errors, char *id)
+{
+	FILE *input;
+	char *line, *p;
+	size_t size;
+	int fd;
+
+	lseek(errors, 0L, SEEK_SET);
+	if ((fd = dup(errors)) < 0 || !(input = fdopen(fd, "r"))) {
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+	line = NULL;
+	size = 0;
+	while (getline(&line, &size, input) > 0) {
+		p = line;
+		if (id && strncmp(p, myname, strlen(myname)) == 0 &&
+		    strncmp(p + strlen(myname), ": ", 2) == 0)
+			p += strlen(myname) + 2;
+		if (id)
+			fprintf(stderr, "%s: run %s: %s", myname, id, p);
+		else
+			fputs(line, stderr);
+	}
+	free(line);
+	fclose(input);
+}
+
+/*
+ * Write the status of a job that did not write its own.  errors, if
+ * not -1, holds what the job wrote on stderr: a job that stopped on
+ * input errors gets it in its reply, and the others pass it on, marked
+ * with id if it is not NULL.
+ */
+static void
+finish(int fd, int wstatus, char *killed, double timeout, int errors,
+	char *id)
+{
+	char message[256];
+
+	if (killed) {
+		if (*killed == 't')
+			snprintf(message, sizeof message,
+				"job ran longer than %g seconds", timeout);
+		else
+			strcpy(message, "job cancelled by the client");
+		put_status(fd, killed, -1, message);
+	} else if (WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 1) {
+		message[0] = '\0';
+		if (errors >= 0)
+			put_errors(fd, errors, message, sizeof message);
+		put_status(fd, "error", SIM_E_INPUT,
+			message[0]? message: "input errors");
+		return;
+	} else if (WIFSIGNALED(wstatus) && WTERMSIG(wstatus) != SIGPIPE) {
+		snprintf(message, sizeof message, "job died on signal %d",
+			WTERMSIG(wstatus));
+		put_status(fd, "error", SIM_E_INTERNAL, message);
+	} else if (!WIFEXITED(wstatus) || (WEXITSTATUS(wstatus) != 0 &&
+	    WEXITSTATUS(wstatus) != JOB_FAILED))
+		put_status(fd, "error", SIM_E_SYSTEM, "job failed");
+	if (errors >= 0)
+		pass_errors(errors, id);
+}
+
+static double
+now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Run one job in its own process and watch it, and the client, until
+ * the job finishes, times out or is cancelled.
+ */
+static void
+job(int fd, double timeout)
+{
+	static char deck[DECK_MAX+1];
+	struct deck_s d;
+	struct pollfd fds[2];
+	FILE *errors;
+	int pipe_fds[2];
+	int n, nfds, delimited, wstatus, wait_ms;
+	pid_t pid;
+	double deadline;
+	char buffer[256];
+	char *killed;
+
+	memset(&d, 0, sizeof d);
+	d.output = OUTPUT_RAW;
+	d.timeout = timeout;
+	if (!read_deck(fd, deck, &d, &delimited)) {
+		put_status(fd, "error", SIM_E_INPUT, "input deck too long "
+			"or unreadable");
+		return;
+	}
+
+	/* what the job says on stderr goes back to the client */
+	if (!(errors = tmpfile()) || pipe(pipe_fds) < 0 ||
+	    (pid = fork()) < 0) {
+		put_status(fd, "error", SIM_E_SYSTEM, strerror(errno));
+		if (errors)
+			fclose(errors);
+		return;
+	}
+	if (pid == 0) {
+		close(pipe_fds[0]);
+		run_job(fd, fileno(errors), &d);
+	}
+	close(pipe_fds[1]);
+
+	/*
+	 * The pipe closes when the job exits.  Only a client that sent
+	 * "---" still has its side of the connection open to cancel with.
+	 */
+	deadline = now() + d.timeout;
+	killed = NULL;
+	fds[0].fd = pipe_fds[0];
+	fds[0].events = POLLIN;
+	fds[1].fd = fd;
+	fds[1].events = POLLIN;
+	nfds = delimited? 2: 1;
+	for (;;) {
+		wait_ms = -1;
+		if (d.timeout > 0.) {
+			wait_ms = (deadline - now()) * 1000. + 1.;
+			if (wait_ms <= 0) {
+				killed = "timeout";
+				break;
+			}
+		}
+		n = poll(fds, nfds, wait_ms);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 || fds[0].revents)
+			break;
+		if (nfds > 1 && fds[1].revents) {
+			n = read(fd, buffer, sizeof buffer - 1);
+			if (n <= 0 || (fds[1].revents & (POLLHUP|POLLERR))) {
+				killed = "cancelled";
+				break;
+			}
+			buffer[n] = '\0';
+			if (strstr(buffer, "cancel")) {
+				killed = "cancelled";
+				break;
+			}
+		}
+	}
+	if (killed)
+		kill(pid, SIGKILL);
+	close(pipe_fds[0]);
+	while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR)
+		;
+
+	finish(fd, wstatus, killed, d.timeout, fileno(errors), NULL);
+	fclose(errors);
+}
+
+static void
+worker(int sock, double timeout)
+{
+	int fd;
+
+	signal(SIGTERM, SIG_DFL);
+	signal(SIGINT, SIG_DFL);
+	for (;;) {
+		fd = accept(sock, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			fprintf(stderr, "%s: accept: %s\n", myname,
+				strerror(errno));
+			_exit(1);
+		}
+		job(fd, timeout);
+		close(fd);
+	}
+}
+
+static int
+listen_on(char *path, int queue)
+{
+	struct sockaddr_un addr;
+	int sock;
+
+	if (strlen(path) >= sizeof addr.sun_path) {
+		fprintf(stderr, "%s: socket path %s is too long\n",
+			myname, path);
+		exit(1);
+	}
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		fprintf(stderr, "%s: socket: %s\n", myname, strerror(errno));
+		exit(1);
+	}
+	unlink(path);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof addr) < 0 ||
+	    listen(sock, queue) < 0) {
+		fprintf(stderr, "%s: %s: %s\n", myname, path, strerror(errno));
+		exit(1);
+	}
+	return sock;
+}
+
+/*
+ * Load everything a run would load for itself, so the workers
+ * start with it.  A batch reads the nozzle tables as it needs them.
+ */
+static void
+preload(int tables)
+{
+	struct fuel_data_s f;
+
+	constants_init();
+	n2o_thermo_init();
+	fuel_data("nitrous", &f);
+	if (tables)
+		cpropep_preload();
+}
+
+void
+server(char *path, int workers, int queue, double timeout)
+{
+	static pid_t pids[MAX_WORKERS];
+	struct sigaction sa;
+	pid_t pid;
+	int i, sock;
+
+	if (workers < 1)
+		workers = 1;
+	if (workers > MAX_WORKERS)
+		workers = MAX_WORKERS;
+
+	preload(1);
+	sock = listen_on(path, queue);
+
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = stop;
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+	fprintf(stderr, "%s: serving %s with %d workers\n",
+		myname, path, workers);
+
+	/*
+	 * Start the workers, and start them again if they die.
+	 */
+	while (!stopping) {
+		for (i = 0; i < workers; i++) {
+			if (pids[i] > 0)
+				continue;
+			pids[i] = fork();
+			if (pids[i] == 0)
+				worker(sock, timeout);
+			if (pids[i] < 0) {
+				fprintf(stderr, "%s: fork: %s\n", myname,
+					strerror(errno));
+				sleep(1);
+			}
+		}
+		pid = wait(NULL);
+		for (i = 0; i < workers; i++)
+			if (pids[i] == pid)
+				pids[i] = 0;
+	}
+
+	for (i = 0; i < workers; i++)
+		if (pids[i] > 0)
+			kill(pids[i], SIGTERM);
+	while (wait(NULL) > 0 || errno == EINTR)
+		;
+	close(sock);
+	unlink(path);
+}
+
+/*
+ * Read all of input, a NUL on the end, into memory.
+ */
+static char *
+slurp(FILE *input, int *lengthp)
+{
+	char *text, *p;
+	int size, length, n;
+
+	size = DECK_MAX;
+	length = 0;
+	text = malloc(size + 1);
+	while (text) {
+		n = fread(text + length, 1, size - length, input);
+		length += n;
+		if (length < size)
+			break;
+		size *= 2;
+		p = realloc(text, size + 1);
+		if (!p)
+			free(text);
+		text = p;
+	}
+	if (!text) {
+		fprintf(stderr, "%s: cannot malloc %d bytes\n", myname, size);
+		exit(1);
+	}
+	text[length] = '\0';
+	*lengthp = length;
+	return text;
+}
+
+/*
+ * A line holding just "---" ends a deck.
+ */
+static int
+delimiter(char *line)
+{
+	if (strncmp(line, "---", 3) != 0)
+		return 0;
+	line += 3;
+	return *line == '\0' || strspn(line, " \t\r") ==
+		strcspn(line, "\n");
+}
+
+/*
+ * Split the text into the decks between delimiter lines.
+ * Returns the number of decks, leaving out empty ones.
+ */
+static int
+split(char *text, int length, struct deck_s **decksp)
+{
+	struct deck_s *decks;
+	char *line, *start, *end, *stop;
+	int n, last;
+
+	n = 1;
+	for (line = text; (end = strchr(line, '\n')) != NULL; line = end + 1)
+		if (delimiter(line))
+			n++;
+	decks = calloc(n, sizeof *decks);
+	if (!decks) {
+		fprintf(stderr, "%s: cannot malloc %ld bytes\n", myname,
+			n * sizeof *decks);
+		exit(1);
+	}
+
+	n = 0;
+	start = line = text;
+	for (;;) {
+		end = strchr(line, '\n');
+		if (!end)
+			end = text + length;
+		last = (end == text + length);
+		if (delimiter(line) || last) {
+			stop = delimiter(line)? line: end;
+			*stop = '\0';
+			if (start[strspn(start, " \t\r\n")]) {
+				decks[n].text = start;
+				decks[n].length = stop - start;
+				n++;
+			}
+			start = end + 1;
+		}
+		if (last)
+			break;
+		line = end + 1;
+	}
+	*decksp = decks;
+	return n;
+}
+
+/*
+ * The launched job with the design nearest to order[next]'s, within
+ * WARM_WINDOW places back in the schedule, that got through its first
+ * step.  Returns its first chamber pressure, or 0 if there is none.
+ */
+static double
+warm_guess(struct sched_s *order, int next, struct job_stat_s *stats,
+	int n_vars)
+{
+	double d, best, guess;
+	int j;
+
+	best = HUGE_VAL;
+	guess = 0.;
+	for (j = next - 1; j >= 0 && j >= next - WARM_WINDOW; j--) {
+		if (order[j].group != order[next].group)
+			break;
+		if (!stats[order[j].deck].done)
+			continue;
+		d = schedule_distance(order + j, order + next, n_vars);
+		if (d < best) {
+			best = d;
+			guess = stats[order[j].deck].first_cp;
+		}
+	}
+	return guess;
+}
+
+/*
+ * Copy length bytes, or all, of a run's output to stdout or the spill.
+ */
+static long
+copy_output(FILE *from, FILE *to, long length)
+{
+	char buffer[BUFSIZ];
+	long total;
+	int n;
+
+	for (total = 0; length < 0 || total < length; total += n) {
+		n = sizeof buffer;
+		if (length >= 0 && length - total < n)
+			n = length - total;
+		if ((n = fread(buffer, 1, n, from)) <= 0)
+			break;
+		fwrite(buffer, 1, n, to);
+	}
+	return total;
+}
+
+/*
+ * Run each deck on stdin in its own process, workers at a time,
+ * and write the replies to stdout in order.
+ * Returns the number of decks that did not run ok.
+ *
+ * The decks run in the order schedule() gives.  A reply that is done
+ * before the ones ahead of it waits in a spill file, so only the
+ * running jobs hold files open.  Before the first job of each group,
+ * the nozzle table is read here, for the jobs to share.  If there is
+ * no such table yet and hsim -N may make one, that job runs alone
+ * and makes it, and the table is read after it.
+ */
+int
+batch(FILE *input, int workers, double timeout, int warm)
+{
+	struct run_s {
+		FILE *output;	/* while the job runs, and just after */
+		FILE *errors;	/* its stderr, while it runs */
+		long offset;	/* of its reply in the spill file */
+		long length;
+		int done;
+		int code;	/* SIM_E code, if it did not set its own */
+	} *runs;
+	struct slot_s {
+		pid_t pid;
+		int deck;
+	} slots[MAX_WORKERS];
+	struct store_row_s *rows;
+	struct job_stat_s *stats;
+	struct sched_s *order;
+	struct deck_s *decks;
+	struct itimerval it;
+	FILE *spill;
+	char **texts;
+	char *text, *killed;
+	int length, n_decks, n_groups, n_vars, next, emitted, running, failed;
+	int pilot, piloted, reload, loads, d, i, s, wstatus;
+	long iterations, first_iterations;
+	int stopped[N_HARD];
+	pid_t pid;
+
+	if (workers < 1)
+		workers = 1;
+	if (workers > MAX_WORKERS)
+		workers = MAX_WORKERS;
+	preload(0);
+	text = slurp(input, &length);
+	n_decks = split(text, length, &decks);
+	runs = calloc(n_decks + 1, sizeof *runs);
+	order = calloc(n_decks + 1, sizeof *order);
+	texts = calloc(n_decks + 1, sizeof *texts);
+	if (!runs || !order || !texts) {
+		fprintf(stderr, "%s: cannot malloc %ld bytes\n", myname,
+			(n_decks + 1) * (sizeof *runs + sizeof *order +
+			sizeof *texts));
+		exit(1);
+	}
+	for (i = 0; i < n_decks; i++) {
+		decks[i].output = OUTPUT_RAW;
+		decks[i].timeout = timeout;
+		deck_options(&decks[i]);
+		if (!decks[i].id[0])
+			snprintf(decks[i].id, sizeof decks[i].id, "%d", i + 1);
+		texts[i] = decks[i].text;
+	}
+	n_groups = schedule(texts, n_decks, order, &n_vars);
+
+	stats = mmap(NULL, (n_decks + 1) * sizeof *stats,
+		PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (stats == MAP_FAILED) {
+		fprintf(stderr, "%s: cannot map %ld bytes\n", myname,
+			(n_decks + 1) * sizeof *stats);
+		exit(1);
+	}
+	for (i = 0; i < n_decks; i++)
+		decks[i].stat = stats + i;
+
+	rows = NULL;
+	if (sweep_store) {
+		if (store_open(sweep_store) < 0)
+			exit(1);
+		rows = mmap(NULL, (n_decks + 1) * sizeof *rows,
+			PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+		if (rows == MAP_FAILED) {
+			fprintf(stderr, "%s: cannot map %ld bytes\n", myname,
+				(n_decks + 1) * sizeof *rows);
+			exit(1);
+		}
+		for (i = 0; i < n_decks; i++)
+			decks[i].store_row = rows + i;
+	}
+	if (!(spill = tmpfile())) {
+		fprintf(stderr, "%s: tmpfile: %s\n", myname, strerror(errno));
+		exit(1);
+	}
+
+	memset(slots, 0, sizeof slots);
+	next = emitted = running = failed = 0;
+	pilot = piloted = -1;
+	reload = 0;
+	fflush(stdout);
+	while (emitted < n_decks) {
+		while (next < n_decks && running < workers && pilot < 0) {
+			d = order[next].deck;
+			if (order[next].nzr > 0. && (reload || next == 0 ||
+			    order[next].group != order[next - 1].group)) {
+				reload = 0;
+				if (cpropep_load(order[next].fuel,
+				    order[next].nzr) < 0 &&
+				    ok_to_create_nzr != NZR_CREATE_NONE &&
+				    piloted != order[next].group) {
+					if (running > 0)
+						break;
+					pilot = d;
+					piloted = order[next].group;
+				}
+			}
+			runs[d].output = tmpfile();
+			runs[d].errors = tmpfile();
+			if (!runs[d].output || !runs[d].errors) {
+				fprintf(stderr, "%s: tmpfile: %s\n", myname,
+					strerror(errno));
+				exit(1);
+			}
+			chamber_guess = warm? warm_guess(order, next, stats,
+				n_vars): 0.;
+			pid = fork();
+			if (pid < 0) {
+				fprintf(stderr, "%s: fork: %s\n", myname,
+					strerror(errno));
+				exit(1);
+			}
+			if (pid == 0) {
+				if (decks[d].timeout > 0.) {
+					memset(&it, 0, sizeof it);
+					it.it_value.tv_sec = decks[d].timeout;
+					it.it_value.tv_usec = 1e6 *
+						(decks[d].timeout -
+						 it.it_value.tv_sec);
+					setitimer(ITIMER_REAL, &it, NULL);
+				}
+				run_job(fileno(runs[d].output),
+					fileno(runs[d].errors), &decks[d]);
+			}
+			chamber_guess = 0.;
+			for (s = 0; s < workers && slots[s].pid; s++)
+				;
+			slots[s].pid = pid;
+			slots[s].deck = d;
+			next++;
+			running++;
+		}
+
+		pid = wait(&wstatus);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		for (s = 0; s < workers && slots[s].pid != pid; s++)
+			;
+		if (s == workers)
+			continue;
+		i = slots[s].deck;
+		slots[s].pid = 0;
+		running--;
+		runs[i].done = 1;
+		if (i == pilot) {
+			pilot = -1;
+			reload = 1;
+		}
+
+		/*
+		 * A job that ran to the end wrote its status last;
+		 * anything else gets one here.
+		 */
+		killed = NULL;
+		if (WIFSIGNALED(wstatus) && WTERMSIG(wstatus) == SIGALRM)
+			killed = "timeout";
+		lseek(fileno(runs[i].output), 0L, SEEK_END);
+		finish(fileno(runs[i].output), wstatus, killed,
+			decks[i].timeout, fileno(runs[i].errors), decks[i].id);
+		fclose(runs[i].errors);
+		runs[i].errors = NULL;
+		if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0)
+			failed++;
+		runs[i].code = killed || WIFSIGNALED(wstatus)? -1:
+			WEXITSTATUS(wstatus) == 1? SIM_E_INPUT: SIM_E_SYSTEM;
+
+		for (; emitted < n_decks && runs[emitted].done; emitted++) {
+			if (runs[emitted].output) {
+				rewind(runs[emitted].output);
+				copy_output(runs[emitted].output, stdout, -1);
+				fclose(runs[emitted].output);
+				runs[emitted].output = NULL;
+			} else {
+				fseek(spill, runs[emitted].offset, SEEK_SET);
+				copy_output(spill, stdout,
+					runs[emitted].length);
+			}
+			if (rows && !rows[emitted].done)
+				store_failed(rows + emitted,
+					decks[emitted].id, runs[emitted].code);
+			if (rows && store_add(rows + emitted) < 0)
+				failed++;
+		}
+		fflush(stdout);
+
+		/* it finished ahead of its turn */
+		if (runs[i].output) {
+			fseek(spill, 0L, SEEK_END);
+			runs[i].offset = ftell(spill);
+			rewind(runs[i].output);
+			runs[i].length = copy_output(runs[i].output, spill, -1);
+			fclose(runs[i].output);
+			runs[i].output = NULL;
+		}
+	}
+
+	loads = cpropep_loads;
+	iterations = first_iterations = 0;
+	memset(stopped, 0, sizeof stopped);
+	for (i = 0; i < n_decks; i++) {
+		loads += stats[i].loads;
+		iterations += stats[i].iterations;
+		first_iterations += stats[i].first_iterations;
+		for (s = 0; s < N_HARD; s++)
+			if (stats[i].constraint == 1 << s)
+				stopped[s]++;
+	}
+	fprintf(stderr, "%s: %d decks in %d groups, %d nozzle tables read, "
+		"%ld chamber iterations, %ld in first steps\n", myname,
+		n_decks, n_groups, loads, iterations, first_iterations);
+	for (s = 0; s < N_HARD; s++)
+		if (hard_constraints & 1 << s)
+			fprintf(stderr, "%s: %d stopped by constraint %s\n",
+				myname, stopped[s], hard_name(1 << s));
+
+	if (rows) {
+		if (store_close() < 0)
+			failed++;
+		munmap(rows, (n_decks + 1) * sizeof *rows);
+	}
+	munmap(stats, (n_decks + 1) * sizeof *stats);
+	fclose(spill);
+	schedule_free();
+	free(order);
+	free(texts);
+	free(runs);
+	free(decks);
+	free(text);
+	return failed;
+}
+
+/*
+ * Send the deck on stdin to a server and copy the reply to stdout.
+ */
+void
+server_client(char *path)
+{
+	struct sockaddr_un addr;
+	char buffer[BUFSIZ];
+	int sock, n;
+
+	memset(&addr, 0, sizeof addr);
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof addr.sun_path - 1);
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0 ||
+	    connect(sock, (struct sockaddr *)&addr, sizeof addr) < 0) {
+		fprintf(stderr, "%s: %s: %s\n", myname, path, strerror(errno));
+		exit(1);
+	}
+	while ((n = read(0, buffer, sizeof buffer - 1)) > 0) {
+		buffer[n] = '\0';
+		put(sock, buffer);
+	}
+	shutdown(sock, SHUT_WR);
+	while ((n = read(sock, buffer, sizeof buffer)) > 0)
+		fwrite(buffer, 1, n, stdout);
+	close(sock);
+}
@@ -27,6 +27,8 @@
 #include "state.h"
 #include "linkage.h"
 
+extern char *myname;
+
 /*
  * Given the state of tank and fuel grain, find the new steady stae.
  * Returns true if we should keep going.
@@ -37,15 +39,11 @@ sim_to_steady_state()
 	int r;
 
 	r = tank();
-	if (n2o_thermo_error == TOO_HOT) {
-	    	fprintf(stderr, "N2O tank too hot.\n");
-		error_exit(1);
-	}
-	if (n2o_thermo_error == TOO_COLD) {
-	    	fprintf(stderr, "N2O tank too cold at time %.3f.\n",
+	if (n2o_thermo_error == TOO_HOT)
+		sim_fail(SIM_E_TANK_HOT, "N2O tank too hot.");
+	if (n2o_thermo_error == TOO_COLD)
+		sim_fail(SIM_E_TANK_COLD, "N2O tank too cold at time %.3f.",
 			 sim_time);
-		error_exit(1);
-	}
 
 	if (!r)
 		return 0;
@@ -108,8 +106,7 @@ sim_step(double delta_t)
 		r = (r &&liquid_step(delta_t));
 		break;
 	    default:
-		fprintf(stderr, " SIM TYPE ERROR IN sim_step\n");
-		exit(1);
+		sim_fail(SIM_E_INTERNAL, "SIM TYPE ERROR IN sim_step");
 	}
 	
 	return r;
@@ -118,8 +115,6 @@ sim_step(double delta_t)
 void
 sim_init()
 {
-	extern char *myname;
-
 	errors_init();
 	switch (sim_type) {
 	     case HYBRID:
@@ -129,18 +124,32 @@ sim_init()
 	     	liquid_init();
 		break;
 	     default:
-	     	fprintf(stderr, "%s: INTERNAL ERROR in sim_init\n", myname);
-		exit(1);
+		sim_fail(SIM_E_INTERNAL, "INTERNAL ERROR in sim_init");
 	}
 	n2o_thermo_init();
 	chamber_init();
 }
 
-void
+/*
+ * Run until the tank is dry or the fuel is gone.
+ * Returns SIM_OK, or why the run failed, as in sim_error.
+ */
+int
 sim_loop()
 {
 	int i;
 	int r;
+	jmp_buf recover, *outer;
+
+	outer = error_recover(&recover);
+	if (setjmp(recover)) {
+		error_recover(outer);
+		/* sim_fail() left the message to the caller */
+		if (!outer && sim_error_message[0])
+			fprintf(stderr, "%s: %s\n", myname,
+				sim_error_message);
+		return sim_error? sim_error: SIM_E_INTERNAL;
+	}
 
 	for (i = 0; ; i++) {
 		sim_time = sim_time_step * i;
@@ -151,4 +160,6 @@ sim_loop()
 		if (!sim_step(sim_time_step))
 			break;
 	}
+	error_recover(outer);
+	return SIM_OK;
 }
@@ -34,512 +34,53 @@
 #include <string.h>
 #include <strings.h>
 #include <getopt.h>
+#include <unistd.h>
 #include "ts_parse.h"
+#include "rowfmt.h"
 #include "scio.h"
 #include "linkage.h"
 #include "fuel.h"
 #include "state.h"
-
-#define	P_UNIT	"atm"
-
-
-static double tankdia;
-static double injectordia;
-static double noz_t_dia, noz_e_dia;
-static double noz_e_ratio;
-static int noz_e_dia_set, noz_e_ratio_set;
-static double supply_tank_pressure;
-
-static double ventdia;
-
-static int grainlength_set, graindiameter_set, graincore_set;
-static double filltemp, filldrop;
-static double fillpress;
-static double injector_count_d;
-static int filltemp_set, filldrop_set, fillpress_set;
-static int dry_mass_set;
-static int supply_tank_pressure_set;
-static int ambient_air_pressure_set;
-static int nozzle_half_angle_set;
-
-static double lfuelinjector_count_d;
-static int lfuelinjectordia_set;
-static int lfuelinjectorid_set, lfuelinjectorod_set;
-static int lfuelinjector_count_set;
-static int lfuelinjectorcd_set;
-static int lfueltankvolume_set;
-static int lfuelmass_set;
-static int lfuelvolume_set;
-static int nitrogen_pressure_initial_set;
-
-static double ullage_height; /* height from vent to top of tank */
-
-struct scio_input_parameter_s scio_input[] = {
-{ "fuel",          STRING,      0,        &fuel,                  1, 0, },
-{ "tankheight",    LENGTH,      REQUIRED, &tank_height,           1, 0, },
-{ "ullageheight",  LENGTH,      REQUIRED, &ullage_height,         1, 0, },
-{ "tankdia",       LENGTH,      REQUIRED, &tankdia,               1, 0, },
-{ "grainlength",   LENGTH,      0,        &grain_length,          1, &grainlength_set, },
-{ "graindiameter", LENGTH,      0,        &grain_diameter,        1, &graindiameter_set, },
-{ "graincore",     LENGTH,      0,	  &grain_init_core,       1, &graincore_set, },
-{ "nozzlethroat",  LENGTH,      REQUIRED, &noz_t_dia,             1, 0, },
-{ "nozzleexit",    LENGTH,      0,        &noz_e_dia,             1, &noz_e_dia_set, },
-{ "nozzleratio",   NUMBER,      0,        &noz_e_ratio,           1, &noz_e_ratio_set, },
-{ "nozcfadj",      NUMBER,      REQUIRED, &nozzle_cf_correction,  1, 0, },
-{ "nozhalfangle",  ANGLE,       0,        &nozzle_half_angle,     1, &nozzle_half_angle_set, },
-{ "cstaradj",      NUMBER,      REQUIRED, &combustion_efficiency, 1, 0, },
-{ "injectordia",   LENGTH,      REQUIRED, &injectordia,           1, 0, },
-{ "injectorcd",    NUMBER,      REQUIRED, &injector_cd,           1, 0, },
-{ "injectorcount", NUMBER,      0,        &injector_count_d,      1, 0, },
-{ "ventdia",       LENGTH,      REQUIRED, &ventdia,               1, 0, },
-{ "ventcd",        NUMBER,      REQUIRED, &vent_cd,               1, 0, },
-{ "timestep",      TIME,        0,        &sim_time_step,         1, 0, },
-{ "filltemp",      TEMPERATURE, 0,        &filltemp,              1, &filltemp_set, },
-{ "filldrop",      PRESSURE,    0,        &filldrop,              1, &filldrop_set, },
-{ "fillpress",     PRESSURE,    0,        &fillpress,             1, &fillpress_set, },
-{ "drymass",       MASS,        0,        &dry_mass,              1, &dry_mass_set,  },
-{ "ambientpressure", PRESSURE,	0,        &ambient_air_pressure,  1, &ambient_air_pressure_set, },
-{ "fuelinjectorid", LENGTH,	0,        &lfuelinjectorid,       1, &lfuelinjectorid_set, } ,
-{ "fuelinjectorod", LENGTH,	0,        &lfuelinjectorod,       1, &lfuelinjectorod_set, } ,
-{ "fuelinjectordia", LENGTH,	0,        &lfuelinjectordia,      1, &lfuelinjectordia_set, },
-{ "fuelinjectorcount", NUMBER,	0,	  &lfuelinjector_count_d, 1, &lfuelinjector_count_set, },
-{ "fuelinjectorcd", NUMBER,	0,	  &lfuelinjectorcd,       1, &lfuelinjectorcd_set, },
-{ "fueltankvolume", VOLUME,	0,	  &lfueltankvolume,       1, &lfueltankvolume_set, },
-{ "fuelmass",      MASS,	0,	  &lfuelmass,		  1, &lfuelmass_set, },
-{ "fuelvolume",    VOLUME,	0,	  &lfuelvolume,		  1, &lfuelvolume_set, },
-{ "nitrogenpressure",PRESSURE,	0,	  &nitrogen_pressure_initial,1, &nitrogen_pressure_initial_set, },
-
-};
-
-static void
-report_input(FILE *datafile)
-{
-	fprintf(datafile, "SECTION,parameters\n");
-	fprintf(datafile, "Parameter,Value,Unit\n");
-	fprintf(datafile, "tankheight,%.6e,meters\n", tank_height);
-	fprintf(datafile, "ullageheight,%.6e,meters\n", ullage_height);
-	fprintf(datafile, "tankvolume,%.6e,meters\n", tank_volume);
-	if (sim_type == HYBRID) {
-		fprintf(datafile, "grainlength,%.6e,meters\n", grain_length);
-		fprintf(datafile, "graindiameter,%.6e,meters\n", grain_diameter);
-		fprintf(datafile, "graincore,%.6e,meters\n", grain_init_core);
-	} else {
-		fprintf(datafile, "fuelinjectordia,%.6e,meters\n", lfuelinjectordia);
-		fprintf(datafile, "fuelinjectorid,%.6e,meters\n", lfuelinjectorid);
-		fprintf(datafile, "fuelinjectorod,%.6e,meters\n", lfuelinjectorod);
-		fprintf(datafile, "fuelinjectorcount,%.6e\n", (double)lfuelinjector_count);
-		fprintf(datafile, "fuelinjectorcd,%.6e\n", lfuelinjectorcd);
-		fprintf(datafile, "fueltankvolume,%.6e,meters**3\n", lfueltankvolume);
-		fprintf(datafile, "fuelmass,%.6e,kg\n", lfuelmass);
-		fprintf(datafile, "fuelvolume,%.6e,meters**3\n", lfuelvolume);
-	}
-	fprintf(datafile, "nozzlethroat,%.6e,meters\n", noz_t_dia);
-	fprintf(datafile, "nozzleexit,%.6e,meters\n", noz_e_dia);
-	fprintf(datafile, "nozcfadj,%.6e\n", nozzle_cf_correction);
-	fprintf(datafile, "nozzlehalfangle,%.6e,radian\n", nozzle_half_angle);
-	fprintf(datafile, "cstaradj,%.6e\n", combustion_efficiency);
-	fprintf(datafile, "injectordia,%.6e,meters\n", injectordia);
-	fprintf(datafile, "injectorcd,%.6e\n", injector_cd);
-	fprintf(datafile, "injectorcount,%.6e\n", (double)injector_count);
-	fprintf(datafile, "ventdia,%.6e,meters\n", ventdia);
-	fprintf(datafile, "ventcd,%.6e\n", vent_cd);
-	fprintf(datafile, "timestep,%.6e,seconds\n", sim_time_step);
-	fprintf(datafile, "filltemp,%.6e,kelvin\n", filltemp);
-	fprintf(datafile, "filldrop,%.6e,pascal\n", filldrop);
-	fprintf(datafile, "ambientpressure,%.6e,pascal\n",
-				ambient_air_pressure);
-	if (supply_tank_pressure_set)
-		fprintf(datafile, "supplypress,%.6e,pascal\n",
-			supply_tank_pressure);
-	if (dry_mass_set)
-		fprintf(datafile, "drymass,%.6e,kg\n",dry_mass);
-	if (filltemp_set)
-		fprintf(datafile, "ventmass,%.6e,kg\n",vent_mass);
-	fprintf(datafile, "fuel,%s,\n", fuel);
-	fprintf(datafile, "\n");
-	fflush(datafile);
-}
+#include "design.h"
+#include "hsim.h"
+#include "store.h"
 
 char *myname;
-
-static void
-parse_input()
-{
-	struct ts_parsed_s *input_buffer;
-	FILE *input;
-
-	ts_parse_init();
-	scio_init(scio_input, sizeof (scio_input) / sizeof (scio_input[0]));
-
-	/*
-	 * Read until EOF
-	 */
-	input = stdin;
-	input_buffer = NULL;
-
-	for (;;) {
-		input_buffer = ts_parse(input, input_buffer);
-		if (!input_buffer)
-			break;
-		scio_input_line(input_buffer);
-	}
-
-	scio_term();
-}
-
-static void
-set_default_parameters()
-{
-	fuel = "PVC";
-	injector_count_d = 1.0;
-	lfuelinjector_count_d = 1.0;
-	lfuelmass = 0.;
-	lfuelvolume = 0.;
-	sim_time_step = 0.001;
-}
-
-/*
- * Calculate some derived values.
- * Perform some basic input error checking.
- */
-static void
-parameter_setup()
-{
-	int errors;
-	double d1, d2;
-
-	errors = 0;
-
-	/*
-	 * First figure out if this is a liquid fuel or a hybrid fuel simulation
-	 */
-	if (fuel_data(fuel, 0))
-		sim_type = LIQUID;	// not found in the solid fuel database.
-	else
-		sim_type = HYBRID;
-
-	/*
-	 * Legal tank combinations:
-	 *   Fill pressure only
-	 *	Sets the flight tank to this pressure. No waste calculation.
-	 *   Fill pressure and fill temperature
-	 *	Sets the flight tank to this pressure. Calculates how
-	 *	much nitrous we boiled off to cool to this pressure.
-	 *   Fill pressure drop and fill temperature
-	 *	Sets the flight tank to the indicated drop from fill tank.
-	 *	Calculates how much nitrous boiled off.
-	 */
-	if (fillpress_set && filldrop_set) {
-		fprintf(stderr,"%s: cannot specify both fill pressure ",
-			myname);
-		fprintf(stderr, " and fill pressure drop\n");
-		errors++;
-	}
-
-	if (!fillpress_set && (!filldrop_set || !filltemp_set)) {
-		fprintf(stderr, "%s: both fill pressure drop and ",
-			myname);
-		fprintf(stderr, "fill temperature required "
-				"to calculate fill pressure.\n");
-		errors++;
-	}
-
-	if ((noz_e_dia_set && noz_e_ratio_set) ||
-	    (!noz_e_dia_set && !noz_e_ratio_set)) {
-	    	fprintf(stderr, "%s: must specify exactly one of "
-			"nozzleexit or nozzleratio\n",
-			myname);
-		errors++;
-	}
-
-	if (!nozzle_half_angle_set)
-		nozzle_half_angle = 15. * pi / 180.;	/* default = 15 */
-
-	if (nozzle_half_angle < 0. || nozzle_half_angle > pi / 2.) {
-		fprintf(stderr, "%s: nozzle half angle (%.1f) must be in "
-		                "the range [0., 90.] degrees\n",
-				myname, nozzle_half_angle);
-		errors++;
-	}
-
-	injector_count = injector_count_d + .0125;
-	if (injector_count < 1) {
-		fprintf(stderr, "%s: injector count (%d) must be positive.\n",
-			myname, injector_count);
-		errors++;
-	}
-
-	if (sim_type == LIQUID) {
-		lfuelinjector_count = lfuelinjector_count_d + .0125;
-
-		if (!lfuelmass_set && !lfuelvolume_set) {
-			fprintf(stderr, "%s: must set either fuelmass or "
-					"fuelvolume\n", myname);
-			errors++;
-		}
-		
-		if (!lfuelinjectorcd_set) {
-			fprintf(stderr, "%s: must set fuelinjectorcd\n",
-				myname);
-			errors++;
-		}
-		
-		if (!(lfuelinjectordia_set || (lfuelinjectorid_set && lfuelinjectorod_set))) {
-			fprintf(stderr, "%s: must set fuelinjectordia or\n",
-				myname);
-			fprintf(stderr, "\tboth fuelinjectorid and fuelinjectorod\n");
-			errors++;
-		}
-
-		if (!nitrogen_pressure_initial_set) {
-			fprintf(stderr, "%s: must set nitrogenpressure\n",
-				myname);
-			errors++;
-		}
-		if (lfuelinjectordia_set) {
-			d2 = lfuelinjectordia;
-			d1 = 0.;
-		} else {
-			d2 = lfuelinjectorod;
-			d1 = lfuelinjectorid;
-		}
-		liquid_injector_area = pi/4. * (d2 * d2 - d1 * d1);
-	}
-
-	if (sim_type == HYBRID) {
-		if (!grainlength_set) {
-			fprintf(stderr, "%s: grainlength parameter required ",
-				myname);
-			fprintf(stderr, "in hybrid simulations.\n");
-			errors++;
-		}
-
-		if (!graindiameter_set) {
-			fprintf(stderr, "%s: graindiameter parameter required ",
-				myname);
-			fprintf(stderr, "in hybrid simulations.\n");
-			errors++;
-		}
-
-		if (!graincore_set) {
-			fprintf(stderr, "%s: graincore parameter required ",
-				myname);
-			fprintf(stderr, "in hybrid simulations.\n");
-			errors++;
-		}
-	}
-
-	if (errors)
-		error_exit(1);
-
-	tank_volume = pi/4. * tankdia * tankdia * tank_height;
-	injector_area = pi/4. * injectordia * injectordia;
-
-	nozzle_throat_area = pi/4. * noz_t_dia * noz_t_dia;
-	if (noz_e_dia_set)
-		nozzle_exit_area = pi/4. * noz_e_dia * noz_e_dia;
-	else {
-		nozzle_exit_area = nozzle_throat_area *
-			noz_e_ratio;
-		noz_e_dia = noz_t_dia * sqrt(noz_e_ratio);
-	}
-
-	vent_area = pi/4. * ventdia * ventdia;
-
-	if (!ambient_air_pressure_set)
-		ambient_air_pressure = atmosphere_pressure;
-}
-
-/*
- * Find the energy at which the tank is at the requested tempurature.
- */
-
-static int
-converged(double temp)
-{
-	double delta;
-
-	delta = tank_temperature - temp;
-	if (delta < 0)
-		delta = -delta;
-
-	return (delta < 0.01);
-}
-
-static void
-tank_set_temp(double temp)
-{
-	int i;
-	int low_set;
-	int high_set;
-	double low_energy;
-	double high_energy;
-
-	low_set = 0;
-	high_set = 0;
-	tank_energy = 32768;
-
-
-	i = 0;
-	while (!low_set || !high_set || !converged(temp)) {
-		tank_temperature = temp;
-		tank();
-
-		if (n2o_thermo_error == TOO_HOT) {
-			high_energy = tank_energy;
-			high_set = 1;
-			if (!low_set)
-				tank_temperature -= 1;
-		} else if (n2o_thermo_error == TOO_COLD) {
-			low_energy = tank_energy;
-			low_set= 1;
-			if (!high_set)
-				tank_temperature += 1;
-		} else if (tank_temperature < temp) {
-			low_energy = tank_energy;
-			low_set= 1;
-		} else {
-			high_energy = tank_energy;
-			high_set = 1;
-		}
-
-		if (!low_set)
-			tank_energy /= 1.125;
-		else if (!high_set)
-			tank_energy *= 1.125;
-		else
-			tank_energy = (low_energy + high_energy) / 2.;
-		if (tank_energy < 1.) {
-			printf("FAILED: energy == 0\n");
-			break;
-		} else if (tank_energy > 1e8) {
-			printf("FAILED: energy > 100,000,000\n");
-			break;
-		}
-		if (i++ > 1000) {
-			printf("FAILED %d iterations\n", i);
-			break;
-		}
-	}
-}
-
-/*
- * Find the temperature that matches the required pressure.
- */
-static double
-n2o_temp(double pressure)
-{
-	double lo_temp, hi_temp;
-	double min_press, max_press;
-	double temp, tp;
-
-	lo_temp = 250.;
-	min_press = saturation_pressure(lo_temp);
-
-	if (pressure < min_press) {
-		fprintf(stderr, "%s: requested flight tank pressure (%.1f %s) "
-				"is less than minimum (%.1f %s)\n",
-			    myname,
-			    scio_convert(pressure, PRESSURE, P_UNIT), P_UNIT,
-			    scio_convert(min_press, PRESSURE, P_UNIT), P_UNIT);
-		error_exit(1);
-	}
-
-	hi_temp = 309.;
-	max_press = saturation_pressure(hi_temp);
-
-	if (pressure > max_press) {
-		fprintf(stderr, "%s: requested flight tank pressure (%.1f %s) "
-				"is less than minimum (%.1f %s)\n",
-			    myname,
-			    scio_convert(pressure, PRESSURE, P_UNIT), P_UNIT,
-			    scio_convert(max_press, PRESSURE, P_UNIT), P_UNIT);
-		error_exit(1);
-	}
-
-	while (hi_temp - lo_temp > .01) {
-		temp = (lo_temp + hi_temp) / 2.;
-		tp = saturation_pressure(temp);
-		if (tp < pressure)
-			lo_temp = temp;
-		else
-			hi_temp = temp;
-	}
-	return temp;
-}
-
-static double filltemp, filldrop;
-
-
-/*
- * This tank fill routine uses a very crude model.
- * Assume we know (from observation) how much pressure drop
- * we have between the supply tank and the flight tank.
- * Fill accordingly.
- *
- * Yuck.
- */
-
-static void
-simple_tank_fill()
-{
-	double flight_tank_pressure;
-	double ullage_volume;
-	double flight_tank_temp;
-
-	supply_tank_pressure_set = 0;
-	if (filltemp_set) {
-		supply_tank_pressure = saturation_pressure(filltemp);
-		supply_tank_pressure_set = 1;
-	}
-
-	if (fillpress_set)
-		flight_tank_pressure = fillpress;
-	else
-		flight_tank_pressure = supply_tank_pressure - filldrop;
-
-	if (supply_tank_pressure_set && fillpress_set &&
-	    supply_tank_pressure - fillpress < WARN_SUPPLY_PRESSURE_DROP) {
-		warn_supply_pressure = 1;
-		warn_supply_pressure_drop_value = supply_tank_pressure -
-			fillpress;
-	}
-
-	flight_tank_temp = n2o_temp(flight_tank_pressure);
-	
-	/* compute the mass of N2O vapor in the tank */
-	ullage_volume = (ullage_height / tank_height) * tank_volume;
-	tank_n2o_mass = ullage_volume * vapor_density(flight_tank_temp);
-
-	/* now N2O liquid */
-	tank_n2o_mass += (tank_volume - ullage_volume) *
-				liquid_density(flight_tank_temp);
-
-
-	/* Lastly, the initial energy state of the tank. */
-	tank_set_temp(flight_tank_temp);
-
-	/* How much nitrous did we boil off cooling the tank? */
-	if (filltemp_set)
-		tank_boil_off(filltemp);
-}
-
-static void
-initialize()
-{
-	constants_init();
-	set_default_parameters();
-	parse_input();
-	parameter_setup();
-	sim_init();
-	simple_tank_fill();
-}
+static char *ensemble_file;
+static char *optimize_file;
+static char *calibrate_file;
+static char *doe_file;
+static int sensitivities;
+static int batch_mode;
+static int warm_start;
+static char message[256];
+static char *server_socket;
+static char *client_socket;
+static int server_workers;
+static int server_queue = 64;
+static double server_timeout;
+static int report_mode;
+static char *raw_file;
+static char *rocksim_file;
+
+/* long options only */
+#define	OPT_REPORT	1000
+#define	OPT_RAW		1001
+#define	OPT_ROCKSIM	1002
+
+static struct option long_options[] = {
+	{ "report",	no_argument,		0,	OPT_REPORT, },
+	{ "raw",	required_argument,	0,	OPT_RAW, },
+	{ "rocksim",	required_argument,	0,	OPT_ROCKSIM, },
+	{ 0, },
+};
 
 static void
 set_defaults()
 {
 	ok_to_create_nzr = NZR_CREATE_NONE;
 	use_enthalpy = 1;
+	use_engine_map = 0;
 }
 
 
@@ -556,6 +97,61 @@ usage()
 	fprintf(stderr, "\t\texec = create using \"exec\" system calls "
 				"(recommended for Windows)\n");
 	fprintf(stderr, "\t-E: use internal energy, not enthalphy for thermo\n");
+	fprintf(stderr, "\t-M: precompute an engine map of chamber states\n");
+	fprintf(stderr, "\t-S: also compute the sensitivities of thrust "
+				"and impulse\n");
+	fprintf(stderr, "\t-e <file>: run the Monte Carlo ensemble "
+				"described in the file\n");
+	fprintf(stderr, "\t-O <file>: optimize the design as "
+				"described in the file\n");
+	fprintf(stderr, "\t-C <file>: calibrate the model to a measured "
+				"trace as described in the file\n");
+	fprintf(stderr, "\t-x <file>: write the decks of the experiment "
+				"described in the file,\n"
+				"\t\tor with -b, run them\n");
+	fprintf(stderr, "\t-T <format>: timeseries format (csv)\n");
+	fprintf(stderr, "\t\tcsv = comma separated text\n");
+	fprintf(stderr, "\t\tf64 = binary, little-endian doubles\n");
+	fprintf(stderr, "\t\tf32 = binary, little-endian floats\n");
+	fprintf(stderr, "\t-P <places>: decimal places in the csv timeseries "
+				"(6)\n");
+	fprintf(stderr, "\t\tshortest = as many as it takes to be "
+				"exact\n");
+	fprintf(stderr, "\t-R <policy>: which steps are written as rows "
+				"(all, or the deck's recordmode)\n");
+	fprintf(stderr, "\t\tall = every step\n");
+	fprintf(stderr, "\t\tdeadband[=<fraction>] = a step where a column "
+				"has changed (%g)\n", RECORD_DEADBAND_DEFAULT);
+	fprintf(stderr, "\t\tsummary = no timeseries, just the summary\n");
+	fprintf(stderr, "\t-I <seconds>: least time between rows "
+				"(the deck's recordinterval, or none)\n");
+	fprintf(stderr, "\t-k <dir>: keep results in the directory, and "
+				"reuse them\n");
+	fprintf(stderr, "\t-A <store>: add a row for each run to the sweep "
+				"store, for query\n");
+	fprintf(stderr, "\t-H <names>: stop a run at the first step it "
+				"breaks one of these (none)\n");
+	fprintf(stderr, "\t\tn2oflux, corethroat, injector, exitpressure, "
+				"comma separated, or all\n");
+	fprintf(stderr, "\t-b: run each of the decks on stdin, separated "
+				"by --- lines\n");
+	fprintf(stderr, "\t-W: with -b, start each run's chamber from "
+				"a finished neighbour's\n");
+	fprintf(stderr, "\t-d <socket>: serve designs on a Unix domain "
+				"socket\n");
+	fprintf(stderr, "\t-j <workers>: number of batch or server workers "
+				"(one per cpu)\n");
+	fprintf(stderr, "\t-q <jobs>: jobs waiting for a server worker (%d)\n",
+				server_queue);
+	fprintf(stderr, "\t-t <seconds>: default batch or server job "
+				"time limit (none)\n");
+	fprintf(stderr, "\t-c <socket>: run the design on a server\n");
+	fprintf(stderr, "\t--report: print the report, as report would "
+				"for the output\n");
+	fprintf(stderr, "\t--raw <file>: with --report, also write the "
+				"output to the file\n");
+	fprintf(stderr, "\t--rocksim <file>: with --report, write a Rocksim "
+				"engine file\n");
 	fprintf(stderr, "\t-w: print the warrentee\n");
 	fprintf(stderr, "\t-l: print the license\n");
 	fprintf(stderr, "\t-v: print the version\n");
@@ -574,7 +170,9 @@ grok_args(int argc, char **argv)
 
 	errors = 0;
 	set_defaults();
-	while ((c = getopt(argc, argv, "DvwlEN:h")) != EOF)
+	while ((c = getopt_long(argc, argv,
+	    "DvwlEMSbWk:A:H:T:P:R:I:e:O:C:x:N:d:j:q:t:c:h", long_options,
+	    NULL)) != EOF)
 	switch (c) {
 	
 		case 'D':
@@ -588,6 +186,116 @@ grok_args(int argc, char **argv)
 		case 'E':
 			use_enthalpy = 0;
 			break;
+		case 'M':
+			use_engine_map = 1;
+			break;
+		case 'S':
+			sensitivities = 1;
+			break;
+		case 'e':
+			ensemble_file = optarg;
+			break;
+		case 'O':
+			optimize_file = optarg;
+			break;
+		case 'C':
+			calibrate_file = optarg;
+			break;
+		case 'x':
+			doe_file = optarg;
+			break;
+		case 'T':
+			if (strcmp(optarg, "csv") == 0)
+				timeseries_format = TS_CSV;
+			else if (strcmp(optarg, "f64") == 0)
+				timeseries_format = TS_F64;
+			else if (strcmp(optarg, "f32") == 0)
+				timeseries_format = TS_F32;
+			else {
+				fprintf(stderr, "%s: bad -T option\n",
+					myname);
+				errors++;
+			}
+			break;
+		case 'P':
+			if (strcmp(optarg, "shortest") == 0)
+				csv_precision = ROWFMT_SHORTEST;
+			else if (*optarg >= '0' && *optarg <= '9' &&
+			    atoi(optarg) <= 9)
+				csv_precision = atoi(optarg);
+			else {
+				fprintf(stderr, "%s: bad -P option\n",
+					myname);
+				errors++;
+			}
+			break;
+		case 'R':
+			if (strcmp(optarg, "all") == 0)
+				record_mode = RECORD_ALL;
+			else if (strcmp(optarg, "summary") == 0)
+				record_mode = RECORD_SUMMARY;
+			else if (strncmp(optarg, "deadband", 8) == 0 &&
+			    (optarg[8] == '\0' || optarg[8] == '=')) {
+				record_mode = RECORD_DEADBAND;
+				if (optarg[8] == '=')
+					record_deadband = atof(optarg + 9);
+			} else {
+				fprintf(stderr, "%s: bad -R option\n",
+					myname);
+				errors++;
+			}
+			break;
+		case 'I':
+			record_interval = atof(optarg);
+			if (record_interval < 0.) {
+				fprintf(stderr, "%s: bad -I option\n",
+					myname);
+				errors++;
+			}
+			break;
+		case OPT_REPORT:
+			report_mode = 1;
+			break;
+		case OPT_RAW:
+			raw_file = optarg;
+			break;
+		case OPT_ROCKSIM:
+			rocksim_file = optarg;
+			break;
+		case 'k':
+			result_cache = optarg;
+			break;
+		case 'A':
+			sweep_store = optarg;
+			break;
+		case 'H':
+			if ((hard_constraints = hard_parse(optarg)) < 0) {
+				fprintf(stderr, "%s: bad -H option\n",
+					myname);
+				errors++;
+			}
+			break;
+		case 'b':
+			batch_mode = 1;
+			break;
+		case 'W':
+			warm_start = 1;
+			break;
+		case 'd':
+			server_socket = optarg;
+			break;
+		case 'j':
+			server_workers = atoi(optarg);
+			break;
+		case 'q':
+			server_queue = atoi(optarg);
+			break;
+		case 't':
+			server_timeout = atof(optarg);
+			break;
+		case 'c':
+			client_socket = optarg;
+			break;
 		case 'N':
 			if (strcmp(optarg, "none") == 0)
 				ok_to_create_nzr = NZR_CREATE_NONE;
@@ -610,6 +318,11 @@ grok_args(int argc, char **argv)
 	nargs = argc - optind;
 	if (nargs)
 		errors++;
+	if ((raw_file || rocksim_file) && !report_mode) {
+		fprintf(stderr, "%s: --raw and --rocksim go with --report\n",
+			myname);
+		errors++;
+	}
 
 	if (errors)
 		usage();
@@ -620,19 +333,143 @@ int
 main(int argc, char **argv)
 {
 	FILE *datafile;
+	FILE *extra;
+	FILE *rocksim;
+	FILE *decks;
+	char *text;
+	size_t size;
+	struct hsim_summary_s summary;
+	int status;
 
 	grok_args(argc, argv);
 
 	datafile = stdout;
 
-	initialize();
-	report_input(datafile);
+	if (server_workers <= 0)
+		server_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (doe_file && !batch_mode) {
+		doe(doe_file, stdin, stdout);
+		exit(0);
+	}
+	if (doe_file) {
+		if (!(decks = open_memstream(&text, &size))) {
+			fprintf(stderr, "%s: cannot malloc the decks\n",
+				myname);
+			exit(1);
+		}
+		doe(doe_file, stdin, decks);
+		fclose(decks);
+		if (!(decks = fmemopen(text, size, "r"))) {
+			fprintf(stderr, "%s: cannot read the decks\n",
+				myname);
+			exit(1);
+		}
+		exit(batch(decks, server_workers, server_timeout,
+		    warm_start) != 0);
+	}
+	if (batch_mode)
+		exit(batch(stdin, server_workers, server_timeout,
+		    warm_start) != 0);
+	if (server_socket) {
+		server(server_socket, server_workers, server_queue,
+			server_timeout);
+		exit(0);
+	}
+	if (client_socket) {
+		server_client(client_socket);
+		exit(0);
+	}
+
+	if (ensemble_file || optimize_file || calibrate_file) {
+		constants_init();
+		design_defaults();
+		design_parse(stdin);
+		if (ensemble_file)
+			ensemble(ensemble_file, datafile);
+		else if (optimize_file)
+			optimize(optimize_file, datafile);
+		else
+			calibrate(calibrate_file, datafile);
+		exit(0);
+	}
+
+	/*
+	 * The sensitivities and thrust sweeps are not kept, so run those.
+	 * A summary only run is a cache run without the timeseries.
+	 */
+	constants_init();
+	design_defaults();
+	design_parse(stdin);
+	if ((result_cache || record_mode == RECORD_SUMMARY || sweep_store) &&
+	    !report_mode && !sensitivities && thrust_sweep_cases() == 1) {
+		status = cache_run(datafile, 1, record_mode == RECORD_SUMMARY,
+			message, &summary, stderr);
+		if (sweep_store && store_run(sweep_store, "", status,
+		    &summary) < 0)
+			exit(1);
+		exit(status != SIM_OK);
+	}
+	if (sweep_store) {
+		fprintf(stderr, "%s: -A does not go with --report, -S or a "
+				"thrust sweep\n", myname);
+		exit(1);
+	}
+
+	/*
+	 * The report goes to stdout, and the output only to --raw if
+	 * that is given.  Sections that only the output has follow
+	 * the report.
+	 */
+	rocksim = NULL;
+	if (report_mode) {
+		datafile = NULL;
+		if (raw_file && (datafile = fopen(raw_file, "w")) == NULL) {
+			fprintf(stderr, "%s: cannot open %s for writing\n",
+				myname, raw_file);
+			exit(1);
+		}
+		if (rocksim_file &&
+		    (rocksim = fopen(rocksim_file, "w")) == NULL) {
+			fprintf(stderr, "%s: cannot open %s for writing\n",
+				myname, rocksim_file);
+			exit(1);
+		}
+	}
+	extra = datafile? datafile: stdout;
+
+	design_setup();
+	sim_init();
+	design_fill();
+	if (use_engine_map)
+		engine_map_build();
+	if (sensitivities)
+		sensitivity_init();
+	thrust_sweep_init();
+	if (datafile)
+		design_report(datafile);
 	record_data_init(0., datafile);
-	sim_loop();
+	if (report_mode)
+		hsim_report_init(rocksim != NULL);
+	if (sim_loop() != SIM_OK) {
+		record_data_flush();
+		error_exit(1);
+	}
 	record_data_term();
+	if (report_mode)
+		hsim_report_term(stdout, rocksim);
+	if (sensitivities)
+		sensitivity_report(extra);
+	thrust_sweep_report(extra);
+	engine_map_stats(stderr);
 	print_errors(stderr);
-	fprintf(datafile, "SECTION,errors\n");
-	print_errors(datafile);
-	fprintf(datafile, "\n");
+	if (datafile) {
+		fprintf(datafile, "SECTION,errors\n");
+		print_errors(datafile);
+		fprintf(datafile, "\n");
+	}
+	if (rocksim)
+		fclose(rocksim);
+	if (datafile && datafile != stdout)
+		fclose(datafile);
 	exit(0);
 }
@@ -44,6 +44,19 @@ double	n2o_vent_rate;
 double	sim_time;
 int	ok_to_create_nzr;
 int	use_enthalpy;
+int	use_engine_map;
+char	*result_cache;
+char	*sweep_store;
+int	timeseries_format;
+int	csv_precision = 6;
+int	record_mode = -1;
+double	record_interval = -1.;
+double	record_deadband = -1.;
+double	chamber_guess;
+double	chamber_first;
+long	chamber_iterations;
+int	chamber_first_iterations;
+int	cpropep_loads;
 double	isp;
 double	nozzle_cf;
 double	thrust;
@@ -96,7 +109,12 @@ double warn_n2o_flux_value;
 int warn_core_throat_ratio;
 double warn_core_throat_ratio_value;
 int warn_exit_pressure;
+double warn_exit_pressure_value;
 int n2o_thermo_error;
 int warn_supply_pressure;
 double warn_supply_pressure_drop_value;
 int warn_negative_vent_to_fill;
+int hard_constraints;
+int hard_constraint;
+int sim_error;
+char sim_error_message[256];
@@ -213,6 +213,29 @@ extern double	nitrogen_gamma;
 extern double	sim_time_step;		/* in seconds	*/
 extern int	use_enthalpy;		/* Use N2O enthalpy, not energy */
 extern int	ok_to_create_nzr;	/* flag		*/
+extern int	use_engine_map;		/* Precompute chamber states */
+extern char	*result_cache;		/* directory of saved runs, or NULL */
+extern char	*sweep_store;		/* store to add run rows to, or NULL */
+extern int	timeseries_format;	/* how record_data() writes */
+extern int	csv_precision;		/* decimal places, or ROWFMT_SHORTEST */
+extern int	record_mode;		/* RECORD_, -1 until given */
+extern double	record_interval;	/* seconds between rows, -1 until given */
+extern double	record_deadband;	/* relative change, -1 until given */
+extern double	chamber_guess;		/* first chamber pressure to try, or 0 */
+extern double	chamber_first;		/* the first step's chamber pressure */
+extern long	chamber_iterations;	/* chamber solver iterations, this run */
+extern int	chamber_first_iterations; /* of those, the first step's */
+extern int	cpropep_loads;		/* nozzle tables read from files */
+
+#define	TS_CSV			0
+#define	TS_F64			1	/* binary, little-endian doubles */
+#define	TS_F32			2	/* binary, little-endian floats */
+
+#define	RECORD_ALL		0	/* a row per recorded step */
+#define	RECORD_DEADBAND		1	/* a row when a column moves */
+#define	RECORD_SUMMARY		2	/* no timeseries */
+#define	RECORD_DEADBAND_DEFAULT	1e-3
+#define	RECORD_COLUMNS_MAX	32	/* see record_data_names() */
 
 #define	NZR_CREATE_NONE		0
 #define	NZR_CREATE_SYSTEM	1
@@ -258,6 +281,7 @@ extern double warn_core_throat_ratio_value;
 
 #define	WARN_EXIT_PRESSURE	(0.7 * atmosphere_pressure)
 extern int warn_exit_pressure;
+extern double warn_exit_pressure_value;	/* lowest seen */
 
 extern int n2o_thermo_error;	/* zero or one of the two below */
 #define	TOO_HOT		(-2)
@@ -268,3 +292,41 @@ extern int warn_supply_pressure;
 extern double warn_supply_pressure_drop_value;
 
 extern int warn_negative_vent_to_fill;		/* supply tank too cold or dip tube too long */
+
+/*
+ * Hard constraints.  chamber() checks the ones asked for every step,
+ * at the warning limits above, and the first one broken stops the run
+ * with SIM_E_CONSTRAINT.  The bits are the HSIM_HARD_ ones in hsim.h.
+ */
+#define	HARD_N2O_FLUX		0x01
+#define	HARD_CORE_THROAT	0x02	/* below WARN_CORE_THROAT_RATIO_1 */
+#define	HARD_INJECTOR_PRESSURE	0x04
+#define	HARD_EXIT_PRESSURE	0x08
+#define	N_HARD			4
+extern int hard_constraints;		/* HARD_ bits to enforce */
+extern int hard_constraint;		/* the one that stopped the run, or 0 */
+
+	/**********\
+	*          *
+	*  Errors  *
+	*          *
+	\**********/
+
+/*
+ * Why a run failed.  Set by sim_fail(), which also keeps the message.
+ */
+extern int sim_error;
+extern char sim_error_message[256];
+#define	SIM_OK			0
+#define	SIM_E_INPUT		1	/* bad design parameters */
+#define	SIM_E_DATA		2	/* missing or bad data file */
+#define	SIM_E_TANK_HOT		3	/* N2O above the table */
+#define	SIM_E_TANK_COLD		4	/* N2O below the table */
+#define	SIM_E_TANK_CONVERGE	5
+#define	SIM_E_CHAMBER_CONVERGE	6
+#define	SIM_E_CHAMBER_PRESSURE	7	/* below 2 atm, or up to the tank */
+#define	SIM_E_CORE_THROAT	8	/* grain core smaller than the throat */
+#define	SIM_E_FUEL_PORT		9	/* the port burned through the grain */
+#define	SIM_E_SYSTEM		10	/* fork, exec or the like failed */
+#define	SIM_E_INTERNAL		11
+#define	SIM_E_CONSTRAINT	13	/* a hard constraint was broken */
@@ -0,0 +1,258 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Sweep Results Store
+ *
+ * hsim -A <store> appends a row for each run to a columnar store (see
+ * colstore.h), which query reads.  A row holds
+ *
+ *	run, fuel, motor class		text
+ *	status				the SIM_E code, -1 if the job
+ *					was killed
+ *	each numeric design parameter	its first value, in SI units
+ *	each summary number		as the summary section names it
+ *	each summary warning		1 if the run has it, else 0
+ *
+ * A number the run does not have, such as the grain core of a liquid,
+ * or any number of a run that did not finish, is NaN.
+ *
+ * The columns come from the design table and the summary table, so a
+ * store written by an hsim with other parameters is refused rather
+ * than misread.
+ *
+ * A batch gathers the rows of its jobs and writes them a block at a
+ * time.  A single run writes a block of one row, so a sweep should be
+ * run as a batch.
+ *
+ * DYNAMIC INPUTS:
+ *	the run's summary and status
+ *
+ * STATIC INPUTS:
+ *	the parsed design
+ *
+ * OUTPUTS:
+ *	the store
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include "scio.h"
+#include "colstore.h"
+#include "state.h"
+#include "design.h"
+#include "hsim.h"
+#include "store.h"
+
+extern char *myname;
+
+/* the summary warnings, by HSIM_WARN bit */
+static char *warning_names[] = {
+	"warn n2o flux",
+	"warn core throat ratio",
+	"warn core throat low",
+	"warn injector pressure",
+	"warn supply pressure",
+	"warn negative vent",
+};
+
+#define	N_WARNINGS	(sizeof (warning_names) / sizeof (warning_names[0]))
+
+/* the stored unit of each kind of parameter */
+static char *si_units[] = {
+	[NUMBER] = "",
+	[LENGTH] = "meters",
+	[AREA] = "meters**2",
+	[VOLUME] = "meters**3",
+	[FORCE] = "newtons",
+	[MASS] = "kg",
+	[PRESSURE] = "pascal",
+	[TEMPERATURE] = "kelvin",
+	[ENERGY] = "joules",
+	[VELOCITY] = "meters/second",
+	[ACCELERATION] = "meters/second**2",
+	[DENSITY] = "kg/m3",
+	[MASSFLOW] = "kg/second",
+	[TIME] = "seconds",
+	[MASSFLUX] = "kg/m2/second",
+	[ANGLE] = "radian",
+};
+
+static struct colstore_s store;
+static int n_values;
+
+int
+store_open(char *path)
+{
+	struct scio_input_parameter_s *ip;
+	char *names[STORE_TEXT + STORE_VALUES];
+	char *units[STORE_TEXT + STORE_VALUES];
+	char name[128];
+	const char *unit;
+	int i, n, summary, status;
+
+	n = 0;
+	names[n] = "run";
+	units[n++] = "";
+	names[n] = "fuel";
+	units[n++] = "";
+	names[n] = "motor class";
+	units[n++] = "";
+	names[n] = "status";
+	units[n++] = "";
+	for (i = 0; (ip = design_parameter_index(i)) != NULL; i++)
+		if (ip->unit != STRING && n < STORE_TEXT + STORE_VALUES) {
+			names[n] = ip->name;
+			units[n++] = ip->unit < sizeof si_units /
+				sizeof si_units[0]? si_units[ip->unit]: "";
+		}
+	summary = n;
+	for (i = 0; n < STORE_TEXT + STORE_VALUES &&
+	    hsim_summary_field(i, name, sizeof name, &unit); i++) {
+		if ((names[n] = strdup(name)) == NULL) {
+			fprintf(stderr, "%s: cannot malloc a column name\n",
+				myname);
+			exit(1);
+		}
+		units[n++] = (char *)unit;
+	}
+	for (i = 0; i < N_WARNINGS && n < STORE_TEXT + STORE_VALUES; i++) {
+		names[n] = warning_names[i];
+		units[n++] = "";
+	}
+	if (n == STORE_TEXT + STORE_VALUES) {
+		fprintf(stderr, "%s: a store row has more than %d columns\n",
+			myname, STORE_VALUES);
+		exit(1);
+	}
+	n_values = n - STORE_TEXT;
+
+	status = colstore_create(&store, path, STORE_TEXT, n_values,
+		names, units);
+	if (status < 0)
+		fprintf(stderr, "%s: cannot append to store %s: %s\n",
+			myname, path, errno == EINVAL?
+			"it has other columns": strerror(errno));
+	for (i = summary; i < n - N_WARNINGS; i++)
+		free(names[i]);
+	return status;
+}
+
+/*
+ * Fill in the row of the parsed design's run.  sp may be NULL if the
+ * run has no summary.
+ */
+void
+store_fill(struct store_row_s *rp, char *id, int status,
+	struct hsim_summary_s *sp)
+{
+	struct scio_input_parameter_s *ip;
+	char name[128];
+	char *fuel;
+	int i, n;
+
+	memset(rp, 0, sizeof *rp);
+	snprintf(rp->text[0], STORE_TEXT_MAX, "%s", id);
+	if ((ip = design_parameter("fuel")) != NULL &&
+	    (fuel = *(char **)ip->vp) != NULL)
+		snprintf(rp->text[1], STORE_TEXT_MAX, "%s", fuel);
+	if (sp && sp->motor_class)
+		snprintf(rp->text[2], STORE_TEXT_MAX, "%c-%d",
+			sp->motor_class, (int)(sp->thrust.average + .5));
+
+	n = 0;
+	rp->values[n++] = status;
+	for (i = 0; (ip = design_parameter_index(i)) != NULL; i++)
+		if (ip->unit != STRING)
+			rp->values[n++] = *(double *)ip->vp;
+	for (i = 0; hsim_summary_field(i, name, sizeof name, NULL); i++)
+		rp->values[n++] = sp && status == SIM_OK?
+			hsim_summary_number(sp, i): NAN;
+	for (i = 0; i < N_WARNINGS; i++)
+		rp->values[n++] = sp && status == SIM_OK?
+			(sp->warnings >> i) & 1: NAN;
+	rp->done = 1;
+}
+
+/*
+ * The row of a job that died before it could fill in its own.
+ */
+void
+store_failed(struct store_row_s *rp, char *id, int status)
+{
+	int i;
+
+	memset(rp, 0, sizeof *rp);
+	snprintf(rp->text[0], STORE_TEXT_MAX, "%s", id);
+	rp->values[0] = status;
+	for (i = 1; i < n_values; i++)
+		rp->values[i] = NAN;
+	rp->done = 1;
+}
+
+/*
+ * Append a row; it is written when its block fills, or at
+ * store_close().
+ */
+int
+store_add(struct store_row_s *rp)
+{
+	char *text[STORE_TEXT];
+	int i;
+
+	for (i = 0; i < STORE_TEXT; i++)
+		text[i] = rp->text[i];
+	if (colstore_row(&store, text, rp->values) < 0) {
+		fprintf(stderr, "%s: cannot write the store: %s\n",
+			myname, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+int
+store_close()
+{
+	if (colstore_close(&store) < 0) {
+		fprintf(stderr, "%s: cannot write the store: %s\n",
+			myname, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Append the row of one run.
+ */
+int
+store_run(char *path, char *id, int status, struct hsim_summary_s *sp)
+{
+	struct store_row_s row;
+
+	if (store_open(path) < 0)
+		return -1;
+	store_fill(&row, id, status, sp);
+	if (store_add(&row) < 0) {
+		store_close();
+		return -1;
+	}
+	return store_close();
+}
@@ -0,0 +1,45 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * The sweep results store: a row for each run, in a columnar store
+ * that query reads.  See store.c.
+ *
+ * Requires hsim.h.
+ */
+
+#define	STORE_TEXT	3	/* run, fuel, motor class */
+#define	STORE_TEXT_MAX	64
+#define	STORE_VALUES	128	/* most numeric columns */
+
+/*
+ * A run's row.  A batch keeps these in memory its jobs share.
+ */
+struct store_row_s {
+	int	done;
+	char	text[STORE_TEXT][STORE_TEXT_MAX];
+	double	values[STORE_VALUES];
+};
+
+int store_open(char *path);
+void store_fill(struct store_row_s *rp, char *id, int status,
+	struct hsim_summary_s *sp);
+void store_failed(struct store_row_s *rp, char *id, int status);
+int store_add(struct store_row_s *rp);
+int store_close();
+int store_run(char *path, char *id, int status, struct hsim_summary_s *sp);
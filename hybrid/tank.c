@@ -201,10 +201,8 @@ tank_state()
 	 * Falls out of the loop if we fail to converge.
 	 */
 
-	fprintf(stderr, "%s: failed to converge "
-		"tank temperature solution after %d iterations\n",
-		myname, i);
-	error_exit(1);
+	sim_fail(SIM_E_TANK_CONVERGE, "failed to converge "
+		"tank temperature solution after %d iterations", i);
 }
 
 /*
@@ -0,0 +1,238 @@
+/*
+  This file is a portion of Hsim 0.4
+
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+
+/*
+ * Thrust Sweep
+ *
+ * ambientpressure, nozcfadj and nozhalfangle only enter chamber()'s
+ * thrust formula, after the chamber pressure has converged; they do
+ * not change the tank, the flows or the chamber state.  So a run can
+ * record the terms that do not depend on them,
+ *
+ *	Pc * At, the nozzle Cf, the exit pressure and the exit area,
+ *
+ * and work out the thrust curve for any values of the three without
+ * running the solvers again.
+ *
+ * Each of the three takes a list of values in the input file (or a
+ * range, "lo hi step incr").  The run itself uses the first of each.
+ * When any of them has more than one value, the thrust and summary of
+ * every combination is reported after the run.  Cases are numbered
+ * with ambientpressure varying slowest and nozhalfangle fastest.
+ *
+ * DYNAMIC INPUTS:
+ *	the run, through the record_data() hook
+ *
+ * STATIC INPUTS:
+ *	ambientpressure, nozcfadj and nozhalfangle values
+ *
+ * OUTPUTS:
+ *	thrust sweep and thrust sweep timeseries sections
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "scio.h"
+#include "state.h"
+#include "linkage.h"
+#include "design.h"
+
+extern char *myname;
+
+struct term_s {
+	double time;
+	double pc_at;		/* chamber pressure * throat area */
+	double cf;		/* nozzle Cf, before the adjustment */
+	double pe;		/* exit pressure */
+	double ae;		/* exit area */
+	double mass;		/* n2o + fuel left */
+};
+
+static struct term_s *terms;
+static int n_terms, terms_size;
+static int out_of_memory;
+static void (*chain)();
+
+static struct {
+	char *name;
+	double *values;
+	int n;
+} axis[3] = {
+	{ "ambientpressure", },
+	{ "nozcfadj", },
+	{ "nozhalfangle", },
+};
+
+static void
+axes()
+{
+	int i;
+	struct scio_input_parameter_s *ip;
+
+	for (i = 0; i < 3; i++) {
+		ip = design_parameter(axis[i].name);
+		axis[i].values = (double *)ip->vp;
+		axis[i].n = *(ip->nvp) > 1? *(ip->nvp): 1;
+	}
+}
+
+/*
+ * The number of combinations of the values given.
+ * Valid once the input has been parsed.
+ */
+int
+thrust_sweep_cases()
+{
+	axes();
+	return axis[0].n * axis[1].n * axis[2].n;
+}
+
+/*
+ * The thrust in chamber(), with the given parameter values.
+ */
+static double
+thrust_of(struct term_s *tp, double pa, double cf_adj, double half_angle)
+{
+	double t;
+
+	t = tp->pc_at * (1 + cf_adj * (tp->cf - 1.));
+	t *= (1. + cos(half_angle)) / 2.;
+	t += (tp->pe - pa) * tp->ae;
+	return t;
+}
+
+static void
+step()
+{
+	struct term_s *tp;
+
+	if (n_terms == terms_size) {
+		tp = realloc(terms, (terms_size + 4096) * sizeof *terms);
+		if (!tp) {
+			out_of_memory = 1;
+			goto done;
+		}
+		terms = tp;
+		terms_size += 4096;
+	}
+	tp = terms + n_terms++;
+	tp->time = sim_time;
+	tp->pc_at = chamber_pressure * nozzle_throat_area;
+	tp->cf = nozzle_cf;
+	tp->pe = exit_pressure;
+	tp->ae = nozzle_exit_area;
+	tp->mass = tank_n2o_mass +
+		(sim_type == HYBRID? fuel_mass: lfuelmass);
+
+    done:
+	if (chain)
+		(*chain)();
+}
+
+/*
+ * Start recording, if there is anything to sweep.
+ * Call after design_setup(), which fills in the defaults.
+ */
+void
+thrust_sweep_init()
+{
+	n_terms = 0;
+	out_of_memory = 0;
+	if (dry_fire || thrust_sweep_cases() < 2)
+		return;
+	chain = record_data_hook(step);
+}
+
+/*
+ * The case'th combination of values.
+ */
+static void
+case_values(int c, double *pa, double *cf_adj, double *half_angle)
+{
+	*half_angle = axis[2].values[c % axis[2].n];
+	c /= axis[2].n;
+	*cf_adj = axis[1].values[c % axis[1].n];
+	c /= axis[1].n;
+	*pa = axis[0].values[c];
+}
+
+void
+thrust_sweep_report(FILE *output)
+{
+	int c, n_cases, i;
+	double pa, cf_adj, half_angle;
+	double t, last, max, impulse, burned, burn_time;
+
+	if (dry_fire || (n_cases = thrust_sweep_cases()) < 2)
+		return;
+	record_data_hook(chain);
+	chain = NULL;
+	if (out_of_memory) {
+		fprintf(stderr, "%s: out of memory for the thrust sweep\n",
+			myname);
+		return;
+	}
+	if (n_terms == 0)
+		return;
+
+	/* as the report program does it */
+	burn_time = terms[n_terms - 1].time - terms[0].time;
+	burned = terms[0].mass - terms[n_terms - 1].mass;
+
+	fprintf(output, "SECTION,thrust sweep\n");
+	fprintf(output, "case,ambientpressure,nozcfadj,nozhalfangle,"
+			"max thrust,average thrust,total impulse,"
+			"average isp\n");
+	for (c = 0; c < n_cases; c++) {
+		case_values(c, &pa, &cf_adj, &half_angle);
+		max = impulse = last = 0.;
+		for (i = 0; i < n_terms; i++) {
+			t = thrust_of(terms + i, pa, cf_adj, half_angle);
+			if (i == 0 || t > max)
+				max = t;
+			if (i > 0)
+				impulse += (terms[i].time -
+					terms[i - 1].time) * (t + last) / 2.;
+			last = t;
+		}
+		fprintf(output, "%d,%.6e,%.6e,%.6e,%.6e,%.6e,%.6e,%.6e\n",
+			c + 1, pa, cf_adj, half_angle, max,
+			burn_time > 0.? impulse / burn_time: last,
+			impulse, impulse / burned);
+	}
+	fprintf(output, "\n");
+
+	fprintf(output, "SECTION,thrust sweep timeseries\n");
+	fprintf(output, "time");
+	for (c = 0; c < n_cases; c++)
+		fprintf(output, ",thrust %d", c + 1);
+	fprintf(output, "\n");
+	for (i = 0; i < n_terms; i++) {
+		fprintf(output, "%f", terms[i].time);
+		for (c = 0; c < n_cases; c++) {
+			case_values(c, &pa, &cf_adj, &half_angle);
+			fprintf(output, ",%f", thrust_of(terms + i, pa,
+				cf_adj, half_angle));
+		}
+		fprintf(output, "\n");
+	}
+	fprintf(output, "END-OF-DATA\n\n");
+	fflush(output);
+}
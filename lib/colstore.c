@@ -0,0 +1,475 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * A columnar store of results.  See colstore.h.
+ *
+ * The header is text:
+ *
+ *	hsim colstore 1
+ *	<text columns>,<numeric columns>
+ *	<name>,<unit>		for each column, the text columns first
+ *
+ * padded with newlines to a multiple of 8 bytes.  Each block is
+ *
+ *	"CBLK", rows, text bytes, 0	four little-endian 32 bit words
+ *	least value of each column	doubles
+ *	greatest value of each column
+ *	each column's values in turn
+ *	each row's text fields, NUL ended, padded to a multiple of 8
+ *
+ * so every double in a mapped store is aligned.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include "colstore.h"
+
+#define	MAGIC		"hsim colstore 1\n"
+#define	BLOCK_MAGIC	0x4b4c4243	/* "CBLK" */
+#define	BLOCK_HEADER	16
+#define	ALIGN(n)	(((n) + 7) & ~(size_t)7)
+
+static int
+little()
+{
+	static const union {
+		int i;
+		char c;
+	} endian = { 1 };
+
+	return endian.c;
+}
+
+static void
+swap_doubles(double *v, size_t n)
+{
+	unsigned char *p, t;
+	int i;
+
+	for (p = (unsigned char *)v; n-- > 0; p += sizeof (double))
+		for (i = 0; i < sizeof (double) / 2; i++) {
+			t = p[i];
+			p[i] = p[sizeof (double) - 1 - i];
+			p[sizeof (double) - 1 - i] = t;
+		}
+}
+
+static uint32_t
+get32(const char *p)
+{
+	const unsigned char *u = (const unsigned char *)p;
+
+	return u[0] | u[1] << 8 | u[2] << 16 | (uint32_t)u[3] << 24;
+}
+
+static void
+put32(char *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void
+free_names(struct colstore_s *sp)
+{
+	int i;
+
+	for (i = 0; sp->names && i < sp->ntext + sp->ncols; i++) {
+		free(sp->names[i]);
+		free(sp->units[i]);
+	}
+	free(sp->names);
+	free(sp->units);
+	sp->names = sp->units = NULL;
+}
+
+/*
+ * Read the header at p into the store's columns.
+ * Returns its length, or 0 if it is not a store header.
+ */
+static size_t
+read_header(struct colstore_s *sp, char *p, size_t size)
+{
+	char *line, *end, *comma;
+	int i, n;
+
+	if (size < sizeof MAGIC - 1 || memcmp(p, MAGIC, sizeof MAGIC - 1))
+		return 0;
+	line = p + sizeof MAGIC - 1;
+	end = memchr(line, '\n', p + size - line);
+	if (!end || sscanf(line, "%d,%d", &sp->ntext, &sp->ncols) != 2 ||
+	    sp->ntext < 0 || sp->ncols < 0)
+		return 0;
+	n = sp->ntext + sp->ncols;
+	sp->names = calloc(n + 1, sizeof (char *));
+	sp->units = calloc(n + 1, sizeof (char *));
+	if (!sp->names || !sp->units)
+		return 0;
+	for (i = 0; i < n; i++) {
+		line = end + 1;
+		end = memchr(line, '\n', p + size - line);
+		if (!end || (comma = memchr(line, ',', end - line)) == NULL)
+			return 0;
+		sp->names[i] = strndup(line, comma - line);
+		sp->units[i] = strndup(comma + 1, end - comma - 1);
+		if (!sp->names[i] || !sp->units[i])
+			return 0;
+	}
+	return ALIGN(end + 1 - p) <= size? ALIGN(end + 1 - p): 0;
+}
+
+/*
+ * The length of the block at offset, or 0 if there is not a whole
+ * block there.
+ */
+static size_t
+block_length(struct colstore_s *sp, char *map, size_t size, size_t offset)
+{
+	size_t length;
+
+	if (offset + BLOCK_HEADER > size ||
+	    get32(map + offset) != BLOCK_MAGIC)
+		return 0;
+	length = BLOCK_HEADER +
+		sizeof (double) * sp->ncols * (2 + (size_t)get32(map + offset + 4)) +
+		ALIGN(get32(map + offset + 8));
+	return offset + length <= size? length: 0;
+}
+
+static int
+write_all(int fd, char *p, size_t n)
+{
+	ssize_t w;
+
+	for (; n > 0; n -= w, p += w)
+		if ((w = write(fd, p, n)) < 0) {
+			if (errno == EINTR)
+				w = 0;
+			else
+				return -1;
+		}
+	return 0;
+}
+
+/*
+ * Check the columns of a store against the caller's, and cut off a
+ * block left short by a crash.  Called with the store locked.
+ */
+static int
+check_store(struct colstore_s *sp, int ntext, int ncols, char **names,
+	char **units, size_t size)
+{
+	struct colstore_s old;
+	char *map;
+	size_t offset, length;
+	int i, ok;
+
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, sp->fd, 0);
+	if (map == MAP_FAILED)
+		return -1;
+	memset(&old, 0, sizeof old);
+	offset = read_header(&old, map, size);
+	ok = offset > 0 && old.ntext == ntext && old.ncols == ncols;
+	for (i = 0; ok && i < ntext + ncols; i++)
+		ok = strcmp(old.names[i], names[i]) == 0 &&
+		     strcmp(old.units[i], units[i]? units[i]: "") == 0;
+	if (ok)
+		while ((length = block_length(&old, map, size, offset)) > 0)
+			offset += length;
+	free_names(&old);
+	munmap(map, size);
+	if (!ok) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (offset < size && ftruncate(sp->fd, offset) < 0)
+		return -1;
+	return 0;
+}
+
+int
+colstore_create(struct colstore_s *sp, char *path, int ntext, int ncols,
+	char **names, char **units)
+{
+	struct stat st;
+	char *header, *p;
+	size_t length;
+	int i, status;
+
+	memset(sp, 0, sizeof *sp);
+	sp->fd = open(path, O_RDWR|O_CREAT|O_APPEND, 0666);
+	if (sp->fd < 0)
+		return -1;
+	if (flock(sp->fd, LOCK_EX) < 0 || fstat(sp->fd, &st) < 0)
+		goto fail;
+
+	if (st.st_size == 0) {
+		length = sizeof MAGIC + 32;
+		for (i = 0; i < ntext + ncols; i++)
+			length += strlen(names[i]) + 2 +
+				(units[i]? strlen(units[i]): 0);
+		if ((header = malloc(ALIGN(length))) == NULL)
+			goto fail;
+		p = header + sprintf(header, "%s%d,%d\n", MAGIC, ntext, ncols);
+		for (i = 0; i < ntext + ncols; i++)
+			p += sprintf(p, "%s,%s\n", names[i],
+				units[i]? units[i]: "");
+		while ((p - header) % 8)
+			*p++ = '\n';
+		status = write_all(sp->fd, header, p - header);
+		free(header);
+		if (status < 0)
+			goto fail;
+	} else if (check_store(sp, ntext, ncols, names, units,
+	    st.st_size) < 0)
+		goto fail;
+	flock(sp->fd, LOCK_UN);
+
+	sp->ntext = ntext;
+	sp->ncols = ncols;
+	sp->names = calloc(ntext + ncols + 1, sizeof (char *));
+	sp->units = calloc(ntext + ncols + 1, sizeof (char *));
+	sp->values = malloc((ncols? ncols: 1) * COLSTORE_BLOCK *
+		sizeof (double));
+	if (!sp->names || !sp->units || !sp->values)
+		goto fail;
+	for (i = 0; i < ntext + ncols; i++) {
+		sp->names[i] = strdup(names[i]);
+		sp->units[i] = strdup(units[i]? units[i]: "");
+		if (!sp->names[i] || !sp->units[i])
+			goto fail;
+	}
+	return 0;
+
+    fail:
+	status = errno;
+	close(sp->fd);
+	free_names(sp);
+	free(sp->values);
+	sp->values = NULL;
+	errno = status;
+	return -1;
+}
+
+/*
+ * Write the rows so far as a block.
+ */
+static int
+write_block(struct colstore_s *sp)
+{
+	char *block, *p;
+	double *min, *max, *v;
+	size_t length;
+	int c, r, status;
+
+	if (sp->nrows == 0)
+		return 0;
+	length = BLOCK_HEADER + sizeof (double) * sp->ncols *
+		(2 + (size_t)sp->nrows) + ALIGN(sp->text_n);
+	if ((block = calloc(1, length)) == NULL)
+		return -1;
+	put32(block, BLOCK_MAGIC);
+	put32(block + 4, sp->nrows);
+	put32(block + 8, sp->text_n);
+
+	min = (double *)(block + BLOCK_HEADER);
+	max = min + sp->ncols;
+	p = (char *)(max + sp->ncols);
+	for (c = 0; c < sp->ncols; c++) {
+		v = sp->values + (size_t)c * COLSTORE_BLOCK;
+		min[c] = max[c] = v[0];
+		for (r = 1; r < sp->nrows; r++) {
+			/* NaN only if the whole column is */
+			if (v[r] < min[c] || min[c] != min[c])
+				min[c] = v[r];
+			if (v[r] > max[c] || max[c] != max[c])
+				max[c] = v[r];
+		}
+		memcpy(p, v, sp->nrows * sizeof (double));
+		p += sp->nrows * sizeof (double);
+	}
+	memcpy(p, sp->text, sp->text_n);
+	if (!little())
+		swap_doubles(min, sp->ncols * (2 + (size_t)sp->nrows));
+
+	status = -1;
+	if (flock(sp->fd, LOCK_EX) == 0) {
+		status = write_all(sp->fd, block, length);
+		flock(sp->fd, LOCK_UN);
+	}
+	free(block);
+	sp->nrows = 0;
+	sp->text_n = 0;
+	return status;
+}
+
+int
+colstore_row(struct colstore_s *sp, char **text, double *values)
+{
+	size_t n;
+	char *p;
+	int i;
+
+	for (i = 0; i < sp->ntext; i++) {
+		n = strlen(text[i]? text[i]: "") + 1;
+		if (sp->text_n + n > sp->text_size) {
+			p = realloc(sp->text, 2 * (sp->text_size + n));
+			if (!p)
+				return -1;
+			sp->text = p;
+			sp->text_size = 2 * (sp->text_size + n);
+		}
+		memcpy(sp->text + sp->text_n, text[i]? text[i]: "", n);
+		sp->text_n += n;
+	}
+	for (i = 0; i < sp->ncols; i++)
+		sp->values[(size_t)i * COLSTORE_BLOCK + sp->nrows] = values[i];
+	if (++sp->nrows == COLSTORE_BLOCK)
+		return write_block(sp);
+	return 0;
+}
+
+int
+colstore_open(struct colstore_s *sp, char *path)
+{
+	struct stat st;
+	int status;
+
+	memset(sp, 0, sizeof *sp);
+	if ((sp->fd = open(path, O_RDONLY)) < 0)
+		return -1;
+	if (fstat(sp->fd, &st) < 0)
+		goto fail;
+	sp->size = st.st_size;
+	sp->map = sp->size? mmap(NULL, sp->size, PROT_READ, MAP_SHARED,
+		sp->fd, 0): MAP_FAILED;
+	if (sp->map == MAP_FAILED) {
+		sp->map = NULL;
+		errno = sp->size? errno: EINVAL;
+		goto fail;
+	}
+	if ((sp->next = read_header(sp, sp->map, sp->size)) == 0) {
+		errno = EINVAL;
+		goto fail;
+	}
+	return 0;
+
+    fail:
+	status = errno;
+	colstore_close(sp);
+	errno = status;
+	return -1;
+}
+
+int
+colstore_next(struct colstore_s *sp, struct colstore_block_s *bp)
+{
+	size_t length, n;
+	char *p;
+
+	if (sp->next == sp->size)
+		return 0;
+	if ((length = block_length(sp, sp->map, sp->size, sp->next)) == 0)
+		return -1;
+	p = sp->map + sp->next;
+	sp->next += length;
+
+	bp->nrows = get32(p + 4);
+	bp->text_n = get32(p + 8);
+	n = sp->ncols * (2 + (size_t)bp->nrows);
+	p += BLOCK_HEADER;
+	if (!little()) {
+		free(sp->swapped);
+		if ((sp->swapped = malloc(n * sizeof (double) + 1)) == NULL)
+			return -1;
+		memcpy(sp->swapped, p, n * sizeof (double));
+		swap_doubles(sp->swapped, n);
+		bp->min = sp->swapped;
+	} else
+		bp->min = (const double *)p;
+	bp->max = bp->min + sp->ncols;
+	bp->values = bp->max + sp->ncols;
+	bp->text = p + n * sizeof (double);
+	return 1;
+}
+
+char **
+colstore_texts(struct colstore_s *sp, struct colstore_block_s *bp)
+{
+	const char *p, *end;
+	int i, n;
+
+	n = bp->nrows * sp->ntext;
+	free(sp->text_ptrs);
+	if ((sp->text_ptrs = calloc(n + 1, sizeof (char *))) == NULL)
+		return NULL;
+	p = bp->text;
+	end = bp->text + bp->text_n;
+	for (i = 0; i < n; i++) {
+		sp->text_ptrs[i] = p < end? (char *)p: "";
+		if (p < end)
+			p += strnlen(p, end - p) + 1;
+	}
+	return sp->text_ptrs;
+}
+
+int
+colstore_column(struct colstore_s *sp, char *name)
+{
+	int i;
+
+	for (i = 0; i < sp->ntext + sp->ncols; i++)
+		if (strcmp(sp->names[i], name) == 0)
+			return i;
+	return -1;
+}
+
+int
+colstore_close(struct colstore_s *sp)
+{
+	int status;
+
+	status = 0;
+	if (sp->values)
+		status = write_block(sp);
+	if (sp->map)
+		munmap(sp->map, sp->size);
+	if (sp->fd >= 0)
+		close(sp->fd);
+	free_names(sp);
+	free(sp->values);
+	free(sp->text);
+	free(sp->swapped);
+	free(sp->text_ptrs);
+	memset(sp, 0, sizeof *sp);
+	sp->fd = -1;
+	return status;
+}
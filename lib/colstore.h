@@ -0,0 +1,113 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * A columnar store of results: one row for each run of a sweep, with
+ * a few text columns and any number of numeric ones.
+ *
+ * The file starts with a text header naming the columns and their
+ * units, and then holds blocks of up to COLSTORE_BLOCK rows.  A block
+ * keeps each column's values together, so a query reads only the
+ * columns it uses, and starts with the least and greatest value of
+ * each numeric column (its zone map), so a query can pass over a block
+ * that cannot hold a match without looking at its rows.  Numbers are
+ * little-endian doubles, in place on a little-endian host.
+ *
+ * Writers append whole blocks under an exclusive lock, so several
+ * sweeps may add to one store.  A block cut short by a crash is cut
+ * off when the store is next opened for writing.
+ *
+ * Requires stddef.h.
+ */
+
+#define	COLSTORE_BLOCK	4096	/* most rows in a block */
+
+struct colstore_s {
+	int	fd;
+	int	ntext;		/* text columns */
+	int	ncols;		/* numeric columns */
+	char	**names;	/* the text columns, then the numeric ones */
+	char	**units;
+
+	/* writing: the block being filled, a column at a time */
+	int	nrows;
+	double	*values;
+	char	*text;		/* each row's text fields, NUL ended */
+	size_t	text_n, text_size;
+
+	/* reading */
+	char	*map;
+	size_t	size;
+	size_t	next;		/* offset of the next block */
+	double	*swapped;	/* a big-endian host's copy of a block */
+	char	**text_ptrs;
+};
+
+struct colstore_block_s {
+	int	nrows;
+	const double *min;	/* the zone map, one for each column */
+	const double *max;
+	const double *values;	/* column c of row r is values[c*nrows + r] */
+	const char *text;
+	size_t	text_n;
+};
+
+/*
+ * Open a store to append rows to, creating it if need be.
+ * The columns must be the ones it was created with.  Returns 0,
+ * or -1 with errno set; EINVAL if the file is not a store with
+ * these columns.
+ */
+int colstore_create(struct colstore_s *sp, char *path, int ntext, int ncols,
+	char **names, char **units);
+
+/*
+ * Add a row: ntext strings, then ncols values.  The row is written
+ * when its block fills, or at colstore_close().  Returns 0, or -1
+ * if the write failed.
+ */
+int colstore_row(struct colstore_s *sp, char **text, double *values);
+
+/*
+ * Open a store to read.  Returns 0, or -1 with errno set.
+ */
+int colstore_open(struct colstore_s *sp, char *path);
+
+/*
+ * The next block.  Returns 1, 0 at the end of the store, or -1 if the
+ * rest of the store is damaged.
+ */
+int colstore_next(struct colstore_s *sp, struct colstore_block_s *bp);
+
+/*
+ * The text fields of a block's rows: field t of row r is
+ * colstore_texts()[r * ntext + t].  Good until the next block.
+ */
+char **colstore_texts(struct colstore_s *sp, struct colstore_block_s *bp);
+
+/*
+ * The column of that name, numbered as in names: the text columns,
+ * then the numeric ones.  -1 if there is none.
+ */
+int colstore_column(struct colstore_s *sp, char *name);
+
+/*
+ * Finish writing or reading.  Returns 0, or -1 if the last write
+ * failed.
+ */
+int colstore_close(struct colstore_s *sp);
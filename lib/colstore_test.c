@@ -0,0 +1,178 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Writes a store in two sweeps, as two writers would, and reads it
+ * back: every row, the zone maps, a block cut short by a crash, and a
+ * writer with the wrong columns.  Prints the number of mismatches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/stat.h>
+#include "colstore.h"
+
+#define	NTEXT	2
+#define	NCOLS	3
+#define	PATH	"/tmp/colstore_test.store"
+
+static char *names[] = { "id", "fuel", "impulse", "mass", "flag" };
+static char *units[] = { "", "", "newton-seconds", "kg", "" };
+
+static double
+value(int row, int col)
+{
+	if (col == 2)
+		return row % 7 == 0? NAN: row % 2;
+	return col == 0? row * 1.5: 1000. - row;
+}
+
+static int
+write_rows(int first, int n)
+{
+	struct colstore_s store;
+	char id[32], *text[NTEXT];
+	double v[NCOLS];
+	int i, j;
+
+	if (colstore_create(&store, PATH, NTEXT, NCOLS, names, units) < 0) {
+		printf("create: %s\n", strerror(errno));
+		return 1;
+	}
+	for (i = first; i < first + n; i++) {
+		sprintf(id, "run %d", i);
+		text[0] = id;
+		text[1] = i % 3? "pvc": "paraffin";
+		for (j = 0; j < NCOLS; j++)
+			v[j] = value(i, j);
+		if (colstore_row(&store, text, v) < 0) {
+			printf("row %d: %s\n", i, strerror(errno));
+			return 1;
+		}
+	}
+	return colstore_close(&store) < 0;
+}
+
+/*
+ * Read the store back; it should hold rows 0 to n - 1.
+ */
+static int
+read_rows(int n)
+{
+	struct colstore_s store;
+	struct colstore_block_s block;
+	char id[32], **text;
+	double v, lo, hi;
+	int r, c, row, errors, status;
+
+	if (colstore_open(&store, PATH) < 0) {
+		printf("open: %s\n", strerror(errno));
+		return 1;
+	}
+	errors = 0;
+	if (colstore_column(&store, "fuel") != 1 ||
+	    colstore_column(&store, "mass") != 3 ||
+	    colstore_column(&store, "thrust") != -1) {
+		printf("colstore_column is wrong\n");
+		errors++;
+	}
+	row = 0;
+	while ((status = colstore_next(&store, &block)) > 0) {
+		text = colstore_texts(&store, &block);
+		for (r = 0; r < block.nrows; r++, row++) {
+			sprintf(id, "run %d", row);
+			if (strcmp(text[r * NTEXT], id) != 0 ||
+			    strcmp(text[r * NTEXT + 1],
+			    row % 3? "pvc": "paraffin") != 0) {
+				printf("row %d text is %s,%s\n", row,
+					text[r * NTEXT], text[r * NTEXT + 1]);
+				errors++;
+			}
+			for (c = 0; c < NCOLS; c++) {
+				v = block.values[c * block.nrows + r];
+				if (memcmp(&v, &(double){ value(row, c) },
+				    sizeof v) != 0 &&
+				    !(isnan(v) && isnan(value(row, c)))) {
+					printf("row %d column %d is %g\n",
+						row, c, v);
+					errors++;
+				}
+			}
+		}
+		for (c = 0; c < NCOLS; c++) {
+			lo = INFINITY;
+			hi = -INFINITY;
+			for (r = 0; r < block.nrows; r++) {
+				v = block.values[c * block.nrows + r];
+				lo = v < lo? v: lo;
+				hi = v > hi? v: hi;
+			}
+			if (lo != block.min[c] || hi != block.max[c]) {
+				printf("zone map of column %d is %g %g, "
+					"not %g %g\n", c, block.min[c],
+					block.max[c], lo, hi);
+				errors++;
+			}
+		}
+	}
+	if (status < 0 || row != n) {
+		printf("read %d rows of %d, status %d\n", row, n, status);
+		errors++;
+	}
+	colstore_close(&store);
+	return errors;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct colstore_s store;
+	struct stat st;
+	int errors;
+	char *wrong[] = { "id", "fuel", "impulse", "mass", "flags" };
+
+	errors = 0;
+	unlink(PATH);
+
+	/* two sweeps, the first more than a block */
+	errors += write_rows(0, COLSTORE_BLOCK + 100);
+	errors += write_rows(COLSTORE_BLOCK + 100, 50);
+	errors += read_rows(COLSTORE_BLOCK + 150);
+
+	/* a crash in the middle of a block; the next writer cuts it off */
+	errors += write_rows(COLSTORE_BLOCK + 150, 10);
+	if (stat(PATH, &st) < 0 || truncate(PATH, st.st_size - 12) < 0)
+		errors++;
+	errors += write_rows(COLSTORE_BLOCK + 150, 20);
+	errors += read_rows(COLSTORE_BLOCK + 170);
+
+	if (colstore_create(&store, PATH, NTEXT, NCOLS, wrong, units) == 0 ||
+	    errno != EINVAL) {
+		printf("a writer with the wrong columns was let in\n");
+		errors++;
+	}
+
+	unlink(PATH);
+	printf("%d mismatches\n", errors);
+	return errors != 0;
+}
@@ -37,7 +37,7 @@
 #include <string.h>
 #include <strings.h>
 
-char *myname;
+extern char *myname;
 
 int
 csv_read(FILE *input, char *buffer, int size, char **ptrs, int n)
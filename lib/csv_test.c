@@ -20,6 +20,8 @@
 #include <stdio.h>
 #include "rsim.h"
 
+char *myname = "csv_test";
+
 int
 main()
 {
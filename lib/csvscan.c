@@ -0,0 +1,279 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Fast CSV input.  See csvscan.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "csvscan.h"
+
+#define	BLOCK	(1 << 20)	/* read at least this much at a time */
+
+int
+csvscan_open(struct csvscan_s *sp, FILE *input)
+{
+	struct stat st;
+	off_t offset;
+	void *map;
+
+	memset(sp, 0, sizeof *sp);
+	sp->input = input;
+
+	if (fstat(fileno(input), &st) == 0 && S_ISREG(st.st_mode) &&
+	    st.st_size > 0 &&
+	    (offset = lseek(fileno(input), 0, SEEK_CUR)) >= 0) {
+		map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+			fileno(input), 0);
+		if (map != MAP_FAILED) {
+			(void)madvise(map, st.st_size, MADV_SEQUENTIAL);
+			sp->buffer = map;
+			sp->size = sp->end = st.st_size;
+			sp->start = offset < st.st_size? offset: st.st_size;
+			sp->mapped = 1;
+			sp->eof = 1;
+			return 0;
+		}
+	}
+
+	sp->size = BLOCK * 2;
+	sp->buffer = malloc(sp->size);
+	return sp->buffer? 0: -1;
+}
+
+void
+csvscan_close(struct csvscan_s *sp)
+{
+	if (sp->mapped)
+		munmap(sp->buffer, sp->size);
+	else
+		free(sp->buffer);
+	free(sp->line);
+	free(sp->ptrs);
+	sp->buffer = NULL;
+	sp->line = NULL;
+	sp->ptrs = NULL;
+}
+
+/*
+ * Read until there are at least need unread bytes, or the input ends.
+ * Moves the unread bytes to the front, and grows the buffer for a
+ * long line.
+ */
+static void
+fill(struct csvscan_s *sp, size_t need)
+{
+	size_t n;
+	char *p;
+
+	while (sp->end - sp->start < need && !sp->eof) {
+		if (sp->start > 0 && sp->size - sp->end < BLOCK) {
+			memmove(sp->buffer, sp->buffer + sp->start,
+				sp->end - sp->start);
+			sp->end -= sp->start;
+			sp->start = 0;
+		}
+		if (sp->size - sp->end < BLOCK || sp->size < need) {
+			p = realloc(sp->buffer, sp->size * 2 + need);
+			if (!p) {
+				sp->eof = 1;
+				break;
+			}
+			sp->buffer = p;
+			sp->size = sp->size * 2 + need;
+		}
+		n = fread(sp->buffer + sp->end, 1, sp->size - sp->end,
+			sp->input);
+		if (n == 0)
+			sp->eof = 1;
+		sp->end += n;
+	}
+}
+
+char *
+csvscan_line(struct csvscan_s *sp, size_t *length)
+{
+	char *nl, *line;
+	size_t scanned, n;
+
+	scanned = 0;
+	for (;;) {
+		nl = memchr(sp->buffer + sp->start + scanned, '\n',
+			sp->end - sp->start - scanned);
+		if (nl || sp->eof)
+			break;
+		scanned = sp->end - sp->start;
+		fill(sp, scanned + 1);
+	}
+
+	if (sp->start >= sp->end)
+		return NULL;
+	line = sp->buffer + sp->start;
+	if (nl) {
+		n = nl - line;
+		sp->start += n + 1;
+	} else {
+		n = sp->end - sp->start;
+		sp->start = sp->end;
+	}
+	if (n > 0 && line[n - 1] == '\r')
+		n--;
+	*length = n;
+	return line;
+}
+
+unsigned char *
+csvscan_bytes(struct csvscan_s *sp, size_t n)
+{
+	unsigned char *p;
+
+	fill(sp, n);
+	if (sp->end - sp->start < n)
+		return NULL;
+	p = (unsigned char *)sp->buffer + sp->start;
+	sp->start += n;
+	return p;
+}
+
+int
+csvscan_fields(struct csvscan_s *sp, char *line, size_t length,
+	char ***fields)
+{
+	char *p, **q;
+	int i, state, n;
+
+	if (sp->line_size < length + 1) {
+		p = realloc(sp->line, length + 1);
+		if (!p)
+			return 0;
+		sp->line = p;
+		sp->line_size = length + 1;
+	}
+	memcpy(sp->line, line, length);
+	sp->line[length] = '\0';
+
+	i = 0;
+	state = 1;
+	for (p = sp->line; *p; p++) {
+		if (*p == '\n' || *p == '\r' || *p == '#') {
+			*p = '\0';
+			break;
+		}
+		if (state) {
+			if (i >= sp->nptrs) {
+				n = sp->nptrs? sp->nptrs * 2: 32;
+				q = realloc(sp->ptrs, n * sizeof (char *));
+				if (!q)
+					break;
+				sp->ptrs = q;
+				sp->nptrs = n;
+			}
+			sp->ptrs[i++] = p;
+			state = 0;
+		}
+		if (*p == ',') {
+			*p = '\0';
+			state = 1;
+		}
+	}
+	*fields = sp->ptrs;
+	return i;
+}
+
+/*
+ * The exact powers of ten.
+ */
+static const double tens[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+	1e21, 1e22,
+};
+
+/*
+ * atof() of a copy of the field.
+ */
+static double
+slow(const char *p, const char *end)
+{
+	char small[64], *copy;
+	size_t n;
+	double v;
+
+	n = end - p;
+	copy = n < sizeof small? small: malloc(n + 1);
+	if (!copy)
+		return 0.;
+	memcpy(copy, p, n);
+	copy[n] = '\0';
+	v = atof(copy);
+	if (copy != small)
+		free(copy);
+	return v;
+}
+
+/*
+ * Digits, an optional point and more digits.  When there are at most
+ * 18 digits they make an integer m, and when m is at most 2**53 and
+ * there are at most 22 digits after the point, m and the power of ten
+ * are exact doubles, and their quotient is the correctly rounded
+ * value, as strtod() would give.  Anything else goes to atof().
+ */
+double
+csvscan_double(const char *p, const char *end, const char **stop)
+{
+	const char *q, *digits;
+	uint64_t m;
+	int n, scale, negative;
+	double v;
+
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	if (stop)
+		*stop = p;
+	q = p;
+	negative = 0;
+	if (q < end && (*q == '-' || *q == '+'))
+		negative = (*q++ == '-');
+
+	m = 0;
+	for (digits = q; q < end && (unsigned)(*q - '0') < 10; q++)
+		m = m * 10 + (*q - '0');
+	n = q - digits;
+	scale = 0;
+	if (q < end && *q == '.') {
+		for (digits = ++q; q < end && (unsigned)(*q - '0') < 10; q++)
+			m = m * 10 + (*q - '0');
+		scale = q - digits;
+	}
+	if (n + scale == 0 || n + scale > 18 || scale > 22 ||
+	    m > ((uint64_t)1 << 53) || (q < end && (*q == 'e' || *q == 'E')))
+		return slow(p, end);
+
+	if (stop)
+		*stop = q;
+	v = (double)m / tens[scale];
+	return negative? -v: v;
+}
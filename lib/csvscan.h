@@ -0,0 +1,81 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Fast CSV input.
+ *
+ * Reads a whole stream a line at a time, with no limit on the length
+ * of a line or the number of fields.  A regular file is mapped; any
+ * other stream is read in large blocks.  Lines are found with memchr,
+ * which the C library does a vector at a time.
+ *
+ * csvscan_fields() splits a line as csv_read() does.  csvscan_double()
+ * converts one field without copying it; it reads the same double as
+ * atof(), but the fixed point numbers hsim writes take a fast path.
+ * Requires stdio.h and stddef.h.
+ */
+
+struct csvscan_s {
+	FILE *input;
+	char *buffer;		/* the mapping, or the read buffer */
+	size_t size;		/* of the buffer */
+	size_t start;		/* next unread byte */
+	size_t end;		/* bytes in the buffer */
+	int mapped;
+	int eof;
+	char *line;		/* copy for csvscan_fields() */
+	size_t line_size;
+	char **ptrs;
+	int nptrs;
+};
+
+/*
+ * Start reading input.  Returns 0, or -1 if out of memory.
+ */
+int csvscan_open(struct csvscan_s *sp, FILE *input);
+void csvscan_close(struct csvscan_s *sp);
+
+/*
+ * The next line, without its newline and not terminated, with its
+ * length in *length.  NULL at the end of the input.  The line is good
+ * until the next call.
+ */
+char *csvscan_line(struct csvscan_s *sp, size_t *length);
+
+/*
+ * The next n bytes of the input, as for a binary block after a line.
+ * NULL if the input ends first.
+ */
+unsigned char *csvscan_bytes(struct csvscan_s *sp, size_t n);
+
+/*
+ * Split a copy of a line into fields, as csv_read() does: fields are
+ * comma separated and '#' starts a comment.  Sets *fields to the field
+ * pointers and returns how many there are.  Good until the next call.
+ */
+int csvscan_fields(struct csvscan_s *sp, char *line, size_t length,
+	char ***fields);
+
+/*
+ * The value of the number at p, which ends by end.  Leading blanks are
+ * skipped, and the number ends at the first character that is not part
+ * of it, as for atof().  If stop is not NULL, *stop is set to that
+ * character, or to some earlier point in the field.  So a row can be
+ * converted without finding its commas first.
+ */
+double csvscan_double(const char *p, const char *end, const char **stop);
@@ -0,0 +1,149 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Checks csvscan_double() against atof() over numbers written every
+ * way hsim and people write them, and reads long lines back through a
+ * pipe and a file.  Prints the number of mismatches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "csvscan.h"
+
+static char *formats[] = {
+	"%.0f", "%.1f", "%.3f", "%.6f", "%.9f", "%.17g", "%g", "%e",
+	" %f", "%+f", "%.20f", "%f junk",
+};
+
+#define	N_FORMATS	(sizeof (formats) / sizeof (formats[0]))
+
+static int
+check_number(char *text)
+{
+	double fast, slow;
+
+	fast = csvscan_double(text, text + strlen(text), NULL);
+	slow = atof(text);
+	if (memcmp(&fast, &slow, sizeof fast) == 0)
+		return 0;
+	printf("\"%s\": %.17g, atof %.17g\n", text, fast, slow);
+	return 1;
+}
+
+/*
+ * Write lines of n fields, and read them back.
+ */
+static int
+check_lines(FILE *fp, int lines, int n)
+{
+	struct csvscan_s scan;
+	char *line, **fields;
+	size_t length;
+	int i, j, errors;
+
+	errors = 0;
+	csvscan_open(&scan, fp);
+	for (i = 0; i < lines; i++) {
+		if ((line = csvscan_line(&scan, &length)) == NULL) {
+			printf("line %d is missing\n", i);
+			return errors + 1;
+		}
+		if (csvscan_fields(&scan, line, length, &fields) != n) {
+			printf("line %d does not have %d fields\n", i, n);
+			errors++;
+			continue;
+		}
+		for (j = 0; j < n; j++)
+			if (atoi(fields[j]) != i + j) {
+				printf("line %d field %d is %s\n", i, j,
+					fields[j]);
+				errors++;
+				break;
+			}
+	}
+	if (csvscan_line(&scan, &length) != NULL) {
+		printf("extra line\n");
+		errors++;
+	}
+	csvscan_close(&scan);
+	return errors;
+}
+
+static void
+write_lines(FILE *fp, int lines, int n)
+{
+	int i, j;
+
+	for (i = 0; i < lines; i++)
+		for (j = 0; j < n; j++)
+			fprintf(fp, "%d%s", i + j, j < n - 1? ",": "\r\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	int i, k, errors;
+	double v;
+	char text[512];
+	FILE *fp;
+
+	/* the other end of the pipe */
+	if (argc > 1) {
+		write_lines(stdout, 100, 50000);
+		return 0;
+	}
+
+	errors = 0;
+	srand48(1);
+	for (i = 0; i < 200000; i++) {
+		v = ldexp(drand48() - .5, (int)(drand48() * 100) - 50);
+		for (k = 0; k < N_FORMATS; k++) {
+			snprintf(text, sizeof text, formats[k], v);
+			errors += check_number(text);
+		}
+	}
+	errors += check_number("");
+	errors += check_number("-");
+	errors += check_number(".");
+	errors += check_number("nan");
+	errors += check_number("-inf");
+	errors += check_number("9007199254740993");
+	errors += check_number("123456789012345678901234");
+	errors += check_number("0.00000000000000000000000000001");
+
+	/* a file, which is mapped */
+	fp = tmpfile();
+	write_lines(fp, 1000, 20000);
+	rewind(fp);
+	errors += check_lines(fp, 1000, 20000);
+	fclose(fp);
+
+	/* a pipe, which is read in blocks */
+	fp = popen("./csvscan_test -", "r");
+	if (fp) {
+		errors += check_lines(fp, 100, 50000);
+		pclose(fp);
+	}
+
+	printf("%d mismatches\n", errors);
+	return errors != 0;
+}
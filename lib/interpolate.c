@@ -31,6 +31,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include "rsim.h"
 
 extern char *myname;
 
@@ -67,6 +68,28 @@ interpolate_1d_context(double x_array[], double y_array[], int n)
 	return (void *)ip;
 }
 
+/*
+ * Find the segment used for x.
+ */
+static int
+segment(double x, struct i_context_s *ip, int *r)
+{
+	int i;
+
+	*r = 0;
+
+	if (x < ip->x_array[0]) {
+		i = 0;
+		*r = -1;
+	} else if (x > ip->x_array[ip->n-1]) {
+		i = ip->n - 2;
+		*r = -2;
+	} else 
+		for (i = 0;  x >= ip->x_array[i]; i++)
+			;
+	return i;
+}
+
 int
 interpolate_1d(double x, double *y, void *context)
 {
@@ -78,6 +101,62 @@ interpolate_1d(double x, double *y, void *context)
 
 	ip = context;
 
+	i = segment(x, ip, &r);
+
+	/*
+	 * x is in the range (x_array[i], x_array[i+1])
+	 */
+
+	x1 = ip->x_array[i];
+	x2 = ip->x_array[i+1];
+	y1 = ip->y_array[i];
+	y2 = ip->y_array[i+1];
+
+	*y = y1 + (x - x1)/(x2 - x1) * (y2 - y1);
+	return r;
+}
+
+/*
+ * Same, and also returns the slope dy/dx of the segment used.
+ */
+int
+interpolate_1d_slope(double x, double *y, double *slope, void *context)
+{
+	int i;
+	int r;
+	double x1, x2, y1,y2;
+	struct i_context_s *ip;
+
+	ip = context;
+
+	i = segment(x, ip, &r);
+
+	x1 = ip->x_array[i];
+	x2 = ip->x_array[i+1];
+	y1 = ip->y_array[i];
+	y2 = ip->y_array[i+1];
+
+	*y = y1 + (x - x1)/(x2 - x1) * (y2 - y1);
+	*slope = (y2 - y1) / (x2 - x1);
+	return r;
+}
+
+/*
+ * Same as interpolate_1d(), but the search for the segment starts
+ * from *hint, which is updated.  When x moves slowly from call to call
+ * this finds the segment in one or two compares.  Start with *hint = 0.
+ * Tables sharing an x array can share a hint.
+ */
+int
+interpolate_1d_hint(double x, double *y, void *context, int *hint)
+{
+	int i;
+	int r;
+	double x1, x2, y1,y2;
+	struct i_context_s *ip;
+
+	ip = context;
+
 	r = 0;
 
 	if (x < ip->x_array[0]) {
@@ -86,13 +165,17 @@ interpolate_1d(double x, double *y, void *context)
 	} else if (x > ip->x_array[ip->n-1]) {
 		i = ip->n - 2;
 		r = -2;
-	} else 
-		for (i = 0;  x >= ip->x_array[i]; i++)
-			;
-
-	/*
-	 * x is in the range (x_array[i], x_array[i+1])
-	 */
+	} else {
+		/* the first i with x < x_array[i], as the linear search */
+		i = *hint;
+		if (i < 0 || i >= ip->n)
+			i = 0;
+		while (i > 0 && x < ip->x_array[i-1])
+			i--;
+		while (x >= ip->x_array[i])
+			i++;
+		*hint = i;
+	}
 
 	x1 = ip->x_array[i];
 	x2 = ip->x_array[i+1];
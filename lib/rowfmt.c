@@ -0,0 +1,155 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+
+/*
+ * Fast CSV row output.
+ *
+ * Fixed precision: v * 10**precision is rounded to an integer and the
+ * digits are written out.  The product is rounded once, so it is
+ * within half an ulp of the exact product.  That can only change the
+ * result when the product is within an ulp of halfway between two
+ * integers.  Those values, very large values, and NaN and infinity
+ * fall back to snprintf().  Everything else comes out as printf would
+ * write it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rowfmt.h"
+
+#define	FAST_LIMIT	4e15		/* below 2**52 */
+
+static const double powers[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+};
+
+void
+rowfmt_init(struct rowfmt_s *rp, FILE *output, int precision)
+{
+	rp->output = output;
+	rp->precision = precision;
+	if (precision > 9)
+		rp->precision = 9;
+	rp->used = 0;
+}
+
+static int
+shortest(char *buffer, double v)
+{
+	int digits, n;
+
+	for (digits = 15; digits < 17; digits++) {
+		n = snprintf(buffer, ROWFMT_NUMBER, "%.*g", digits, v);
+		if (strtod(buffer, NULL) == v)
+			return n;
+	}
+	return snprintf(buffer, ROWFMT_NUMBER, "%.17g", v);
+}
+
+int
+rowfmt_format(char *buffer, double v, int precision)
+{
+	double a, x, n, f, ulp;
+	unsigned long long m, whole, scale;
+	char digits[24];
+	char *p;
+	int i, k;
+
+	if (precision < 0)
+		return shortest(buffer, v);
+
+	a = fabs(v);
+	x = a * powers[precision];
+	if (!(x < FAST_LIMIT))		/* also NaN */
+		return snprintf(buffer, ROWFMT_NUMBER, "%.*f", precision, v);
+	n = floor(x);
+	f = x - n;
+	ulp = x * (2. / 9007199254740992.);	/* 2**-52 of x */
+	if (fabs(f - .5) <= ulp)
+		return snprintf(buffer, ROWFMT_NUMBER, "%.*f", precision, v);
+	m = (unsigned long long)n + (f > .5);
+
+	scale = (unsigned long long)powers[precision];
+	whole = m / scale;
+	m -= whole * scale;
+
+	p = buffer;
+	if (signbit(v))
+		*p++ = '-';
+	k = 0;
+	do {
+		digits[k++] = '0' + whole % 10;
+		whole /= 10;
+	} while (whole);
+	while (k > 0)
+		*p++ = digits[--k];
+	if (precision > 0) {
+		*p++ = '.';
+		for (i = precision - 1; i >= 0; i--) {
+			p[i] = '0' + m % 10;
+			m /= 10;
+		}
+		p += precision;
+	}
+	*p = '\0';
+	return p - buffer;
+}
+
+static void
+room(struct rowfmt_s *rp, int n)
+{
+	if (rp->used + n > ROWFMT_BUFFER) {
+		fwrite(rp->buffer, 1, rp->used, rp->output);
+		rp->used = 0;
+	}
+}
+
+void
+rowfmt_double(struct rowfmt_s *rp, double v)
+{
+	room(rp, ROWFMT_NUMBER);
+	rp->used += rowfmt_format(rp->buffer + rp->used, v, rp->precision);
+}
+
+void
+rowfmt_text(struct rowfmt_s *rp, char *s)
+{
+	int n;
+
+	n = strlen(s);
+	if (n > ROWFMT_BUFFER) {
+		rowfmt_flush(rp);
+		fputs(s, rp->output);
+		return;
+	}
+	room(rp, n);
+	memcpy(rp->buffer + rp->used, s, n);
+	rp->used += n;
+}
+
+void
+rowfmt_flush(struct rowfmt_s *rp)
+{
+	if (rp->used)
+		fwrite(rp->buffer, 1, rp->used, rp->output);
+	rp->used = 0;
+	fflush(rp->output);
+}
@@ -0,0 +1,60 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Fast CSV row output.
+ *
+ * Rows are built in a large buffer and written to the stream in big
+ * chunks, with numbers formatted without going through printf.
+ *
+ * With a precision of 0 to 9 a value is written as printf's "%.*f"
+ * writes it, byte for byte.  ROWFMT_SHORTEST writes the shortest
+ * text that reads back as the same double, which is slower.
+ * Requires stdio.h.
+ */
+
+#define	ROWFMT_BUFFER	65536
+#define	ROWFMT_NUMBER	352		/* longest number, "%.9f" of 1e308 */
+#define	ROWFMT_SHORTEST	(-1)
+
+struct rowfmt_s {
+	FILE *output;
+	int precision;
+	int used;
+	char buffer[ROWFMT_BUFFER];
+};
+
+void rowfmt_init(struct rowfmt_s *rp, FILE *output, int precision);
+
+/*
+ * Append a number, or a separator or other short text.
+ * The buffer is written out when it fills.
+ */
+void rowfmt_double(struct rowfmt_s *rp, double v);
+void rowfmt_text(struct rowfmt_s *rp, char *s);
+
+/*
+ * Write out whatever is buffered and flush the stream.
+ */
+void rowfmt_flush(struct rowfmt_s *rp);
+
+/*
+ * Format v into buffer, which must hold ROWFMT_NUMBER bytes.
+ * Returns the length.
+ */
+int rowfmt_format(char *buffer, double v, int precision);
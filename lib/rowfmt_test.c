@@ -0,0 +1,72 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Checks rowfmt_format() against printf over values of every size,
+ * including halfway cases, and prints the number of mismatches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rowfmt.h"
+
+static int
+check(double v, int precision)
+{
+	char fast[ROWFMT_NUMBER], slow[ROWFMT_NUMBER];
+
+	rowfmt_format(fast, v, precision);
+	if (precision < 0) {
+		if (strtod(fast, NULL) == v)
+			return 0;
+		printf("shortest %.17g: %s\n", v, fast);
+		return 1;
+	}
+	snprintf(slow, sizeof slow, "%.*f", precision, v);
+	if (strcmp(fast, slow) == 0)
+		return 0;
+	printf("%%.%df %.17g: %s, printf %s\n", precision, v, fast, slow);
+	return 1;
+}
+
+int
+main()
+{
+	int i, precision, errors;
+	double v;
+
+	errors = 0;
+	srand48(1);
+	for (i = 0; i < 2000000; i++) {
+		v = ldexp(drand48() - .5, (int)(drand48() * 80) - 40);
+		for (precision = -1; precision <= 9; precision++)
+			errors += check(v, precision);
+	}
+	for (i = -20000; i <= 20000; i++) {
+		v = i / 2e6;		/* ties at six places */
+		errors += check(v, 6);
+		errors += check(i + .5, 0);
+		errors += check(i * .125, 2);
+	}
+	errors += check(0., 6) + check(-0., 6) + check(-1e-9, 6);
+	errors += check(1e300, 6) + check(NAN, 6) + check(-INFINITY, 6);
+	printf("%d mismatches\n", errors);
+	return errors != 0;
+}
@@ -55,6 +55,8 @@ int csv_read(FILE *input, char *buffer, int size, char **ptrs, int n);
 void *interpolate_1d_context(double x_array[], double y_array[], int n);
 
 int interpolate_1d(double x, double *y, void *context);
+int interpolate_1d_slope(double x, double *y, double *slope, void *context);
+int interpolate_1d_hint(double x, double *y, void *context, int *hint);
 
 /*
  * Dynamic string copy.
@@ -119,11 +119,170 @@ struct unit_s {
 	{0,		 (char *)0, 1.,		0.,	},	/* END MARKER */
 };
 
+#define	N_UNITS	((sizeof unit_defines) / (sizeof unit_defines[0]) - 1)
+
+/*
+ * A perfect hash of a table of names: each name has a slot of its own,
+ * so a lookup is one hash and one strcasecmp.  The table is built by
+ * trying seeds until one puts no two names in a slot.
+ */
+struct phash_s {
+	unsigned seed;
+	unsigned mask;
+	int *slots;		/* index + 1 of the name, 0 if none */
+};
+
 extern char *myname;
 static int n_params;
 static struct scio_input_parameter_s *param_p;
 static int input_errors;
 
+static struct phash_s param_hash, unit_hash;
+static char **param_names;	/* the names param_hash was built on */
+static int param_hash_n;
+
+/*
+ * Case blind FNV-1a, with the unit type mixed in.
+ */
+static unsigned
+fold_hash(unsigned seed, int type, const char *s)
+{
+	unsigned h;
+	int c;
+
+	h = (2166136261u ^ seed) + (unsigned)type * 0x9e3779b9u;
+	while ((c = (unsigned char)*s++)) {
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		h = (h ^ c) * 16777619u;
+	}
+	h ^= h >> 15;
+	h *= 0x2c1b3c6du;
+	h ^= h >> 12;
+	return h;
+}
+
+static char *
+param_key(int i)
+{
+	return param_p[i].name;
+}
+
+static int
+param_key_type(int i)
+{
+	return 0;
+}
+
+static char *
+unit_key(int i)
+{
+	return unit_defines[i].name;
+}
+
+static int
+unit_key_type(int i)
+{
+	return unit_defines[i].type;
+}
+
+/*
+ * Hash n names.  A name that is already in the table is left out,
+ * so the first of them is found, as a linear search would.
+ */
+static void
+phash_build(struct phash_s *hp, int n, char *(*name)(int), int (*type)(int))
+{
+	unsigned size, slot;
+	int i, tries, j;
+
+	for (size = 8; size < 2 * (unsigned)n; size *= 2)
+		;
+	for (tries = 0; ; tries++) {
+		if (tries == 64) {
+			size *= 2;
+			tries = 0;
+		}
+		free(hp->slots);
+		hp->slots = (int *)calloc(size, sizeof (int));
+		if (!hp->slots) {
+			fprintf(stderr, "%s: cannot malloc %ld bytes\n",
+				myname, size * sizeof (int));
+			exit(1);
+		}
+		hp->seed = tries * 0x61c88647u + size;
+		hp->mask = size - 1;
+		for (i = 0; i < n; i++) {
+			slot = fold_hash(hp->seed, type(i), name(i)) & hp->mask;
+			if (hp->slots[slot] == 0) {
+				hp->slots[slot] = i + 1;
+				continue;
+			}
+			j = hp->slots[slot] - 1;
+			if (type(i) != type(j) ||
+			    strcasecmp(name(i), name(j)) != 0)
+				break;
+		}
+		if (i == n)
+			return;
+	}
+}
+
+/*
+ * The index of the name, or -1.
+ */
+static int
+phash_find(struct phash_s *hp, int type, char *s, char *(*name)(int),
+	int (*typef)(int))
+{
+	int i;
+
+	i = hp->slots[fold_hash(hp->seed, type, s) & hp->mask] - 1;
+	if (i < 0 || typef(i) != type || strcasecmp(name(i), s) != 0)
+		return -1;
+	return i;
+}
+
+static struct unit_s *
+find_unit(int type, char *name)
+{
+	int i;
+
+	if (!unit_hash.slots)
+		phash_build(&unit_hash, N_UNITS, unit_key, unit_key_type);
+	i = phash_find(&unit_hash, type, name, unit_key, unit_key_type);
+	return i < 0? NULL: unit_defines + i;
+}
+
+/*
+ * Hash the parameter names, unless this is the table hashed last time.
+ * hsim hands in the same table for every deck it reads.
+ */
+static void
+hash_params()
+{
+	int i;
+
+	if (param_hash_n == n_params) {
+		for (i = 0; i < n_params; i++)
+			if (param_names[i] != param_p[i].name)
+				break;
+		if (i == n_params)
+			return;
+	}
+	param_names = (char **)realloc(param_names,
+		(n_params + 1) * sizeof (char *));
+	if (!param_names) {
+		fprintf(stderr, "%s: cannot malloc %ld bytes\n",
+			myname, (n_params + 1) * sizeof (char *));
+		exit(1);
+	}
+	for (i = 0; i < n_params; i++)
+		param_names[i] = param_p[i].name;
+	param_hash_n = n_params;
+	phash_build(&param_hash, n_params, param_key, param_key_type);
+}
+
 static double
 u_conv(struct unit_s *up, double v)
 {
@@ -186,6 +345,7 @@ scio_init(struct scio_input_parameter_s *sp, int n)
 		}
 		*(sp->nvp) = 0;
 	}
+	hash_params();
 }
 
 /*
@@ -230,16 +390,15 @@ scio_input_line(struct ts_parsed_s *buffer)
 		return;
 
 	/* is the input line one of our parameters ? */
-	for (i = 0, ip = param_p; i < n_params; i++, ip++)
-		if (strcasecmp(buffer->words[0], ip->name) == 0)
-			break;
-
-	if (i >= n_params) {
+	i = phash_find(&param_hash, 0, buffer->words[0], param_key,
+		param_key_type);
+	if (i < 0) {
 		fprintf(stderr, "%s: unknown parameter name: %s\n",
 			myname, buffer->words[0]);
 		input_errors++;
 		return;
 	}
+	ip = param_p + i;
 
 	/* count how many words in the input line. */
 	for (j = 0; buffer->words[j]; j++)
@@ -250,11 +409,8 @@ scio_input_line(struct ts_parsed_s *buffer)
 		up = unit_defines;
 		j++;		/* no unit specified or expected */
 	} else {
-		for (up = unit_defines; up->type; up++)
-			if (ip->unit == up->type &&
-			    strcasecmp(up->name, buffer->words[j-1]) == 0)
-				break;	/* found */
-		if (up->type == 0) {
+		up = find_unit(ip->unit, buffer->words[j-1]);
+		if (up == NULL) {
 			fprintf(stderr, "%s: parameter %s specified in unknown "
 					"or incompatible unit %s\n", 
 				myname, buffer->words[0], buffer->words[j-1]);
@@ -337,12 +493,8 @@ scio_convert(double v, int unit_type, char *unit_name)
 {
 	struct unit_s *up;
 
-	for (up = unit_defines; up->type; up++)
-		if (up->type == unit_type &&
-		    strcasecmp(up->name, unit_name) == 0)
-			break;	/* found */
-
-	if (up->type == 0) {
+	up = find_unit(unit_type, unit_name);
+	if (up == NULL) {
 		fprintf(stderr, "%s: conversion specified in unknown "
 				"unit %s\n", 
 			myname, unit_name);
@@ -360,12 +512,8 @@ scio_f_convert(double v, int unit_type, char *unit_name)
 {
 	struct unit_s *up;
 
-	for (up = unit_defines; up->type; up++)
-		if (up->type == unit_type &&
-		    strcasecmp(up->name, unit_name) == 0)
-			break;	/* found */
-
-	if (up->type == 0) {
+	up = find_unit(unit_type, unit_name);
+	if (up == NULL) {
 		fprintf(stderr, "%s: conversion specified in unknown "
 				"unit %s\n", 
 			myname, unit_name);
@@ -374,3 +522,18 @@ scio_f_convert(double v, int unit_type, char *unit_name)
 
 	return u_conv(up, v);
 }
+
+/*
+ * Likewise, but for input that may be bad: returns -1 if the unit is
+ * unknown, rather than exiting.
+ */
+int
+scio_try_convert(double v, int unit_type, char *unit_name, double *rp)
+{
+	struct unit_s *up;
+
+	if ((up = find_unit(unit_type, unit_name)) == NULL)
+		return -1;
+	*rp = u_conv(up, v);
+	return 0;
+}
@@ -22,6 +22,8 @@
  * The primary function is to manage unit conversions.
  */
 
+struct ts_parsed_s;		/* see ts_parse.h */
+
 /*
  * These are the types of physical quanitites supported.
  */
@@ -100,3 +102,4 @@ scio_term();
  */
 double scio_convert(double v, int unit_type, char *unit_name);
 double scio_f_convert(double v, int unit_type, char *unit_name);
+int scio_try_convert(double v, int unit_type, char *unit_name, double *rp);
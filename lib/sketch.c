@@ -0,0 +1,254 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Streaming statistics: Welford moments and a merging t-digest.
+ *
+ * The t-digest keeps the values as weighted centroids, small near the
+ * tails and larger in the middle, so quantiles near 0 and 1 stay
+ * accurate.  New values are buffered, and the buffer is merged into
+ * the centroids when it fills or when a result is wanted.  The
+ * centroid sizes are bounded by the arcsine scale function, which
+ * holds the number of centroids under SKETCH_CENTROIDS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "sketch.h"
+
+#define	PI	3.14159265358979323846
+
+struct centroid_s {
+	double mean;
+	double weight;
+};
+
+void
+sketch_init(struct sketch_s *sp)
+{
+	sp->count = 0.;
+	sp->mean = 0.;
+	sp->m2 = 0.;
+	sp->min = HUGE_VAL;
+	sp->max = -HUGE_VAL;
+	sp->n_centroids = 0;
+	sp->n_buffered = 0;
+}
+
+static double
+k_scale(double q)
+{
+	if (q > 1.)
+		q = 1.;
+	return SKETCH_COMPRESSION / (2. * PI) * asin(2. * q - 1.);
+}
+
+static int
+compare_centroid(const void *a, const void *b)
+{
+	double x = ((const struct centroid_s *)a)->mean;
+	double y = ((const struct centroid_s *)b)->mean;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Merge the buffer, and any extra centroids, into the centroids.
+ */
+static void
+compress(struct sketch_s *sp, struct centroid_s *extra, int n_extra)
+{
+	struct centroid_s c[2 * SKETCH_CENTROIDS + SKETCH_BUFFER];
+	int i, n, out;
+	double total, so_far, k_low, q, w;
+
+	n = 0;
+	for (i = 0; i < sp->n_centroids; i++, n++) {
+		c[n].mean = sp->centroid_mean[i];
+		c[n].weight = sp->centroid_weight[i];
+	}
+	for (i = 0; i < sp->n_buffered; i++, n++) {
+		c[n].mean = sp->buffer[i];
+		c[n].weight = 1.;
+	}
+	for (i = 0; i < n_extra; i++, n++)
+		c[n] = extra[i];
+	sp->n_buffered = 0;
+	sp->n_centroids = 0;
+	if (n == 0)
+		return;
+
+	qsort(c, n, sizeof c[0], compare_centroid);
+	total = 0.;
+	for (i = 0; i < n; i++)
+		total += c[i].weight;
+
+	/*
+	 * Grow each centroid while it spans no more than
+	 * one unit of the scale function.
+	 */
+	out = 0;
+	so_far = 0.;
+	k_low = k_scale(0.);
+	for (i = 1; i < n; i++) {
+		q = (so_far + c[out].weight + c[i].weight) / total;
+		if (k_scale(q) - k_low <= 1. || out == SKETCH_CENTROIDS - 1) {
+			w = c[out].weight + c[i].weight;
+			c[out].mean += (c[i].mean - c[out].mean) *
+				c[i].weight / w;
+			c[out].weight = w;
+		} else {
+			so_far += c[out].weight;
+			k_low = k_scale(so_far / total);
+			c[++out] = c[i];
+		}
+	}
+
+	sp->n_centroids = out + 1;
+	for (i = 0; i <= out; i++) {
+		sp->centroid_mean[i] = c[i].mean;
+		sp->centroid_weight[i] = c[i].weight;
+	}
+}
+
+void
+sketch_add(struct sketch_s *sp, double x)
+{
+	double delta;
+
+	sp->count += 1.;
+	delta = x - sp->mean;
+	sp->mean += delta / sp->count;
+	sp->m2 += delta * (x - sp->mean);
+	if (x < sp->min)
+		sp->min = x;
+	if (x > sp->max)
+		sp->max = x;
+
+	if (sp->n_buffered == SKETCH_BUFFER)
+		compress(sp, NULL, 0);
+	sp->buffer[sp->n_buffered++] = x;
+}
+
+void
+sketch_merge(struct sketch_s *dst, struct sketch_s *src)
+{
+	struct centroid_s c[SKETCH_CENTROIDS];
+	double n, delta;
+	int i;
+
+	if (src->count == 0.)
+		return;
+
+	n = dst->count + src->count;
+	delta = src->mean - dst->mean;
+	dst->mean += delta * src->count / n;
+	dst->m2 += src->m2 + delta * delta * dst->count * src->count / n;
+	dst->count = n;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+
+	compress(src, NULL, 0);
+	for (i = 0; i < src->n_centroids; i++) {
+		c[i].mean = src->centroid_mean[i];
+		c[i].weight = src->centroid_weight[i];
+	}
+	compress(dst, c, src->n_centroids);
+}
+
+double
+sketch_quantile(struct sketch_s *sp, double q)
+{
+	int i, n;
+	double *m, *w;
+	double target, cum, left, right;
+
+	if (sp->n_buffered)
+		compress(sp, NULL, 0);
+	n = sp->n_centroids;
+	if (n == 0)
+		return 0.;
+	m = sp->centroid_mean;
+	w = sp->centroid_weight;
+	if (n == 1)
+		return m[0];
+
+	/*
+	 * Each centroid sits at the middle of its weight.
+	 * Interpolate between them, and out to min and max at the ends.
+	 */
+	target = q * sp->count;
+	if (target <= w[0] / 2.)
+		return sp->min + (m[0] - sp->min) * target / (w[0] / 2.);
+	cum = 0.;
+	for (i = 0; i < n - 1; i++) {
+		left = cum + w[i] / 2.;
+		right = cum + w[i] + w[i + 1] / 2.;
+		if (target <= right)
+			return m[i] + (m[i + 1] - m[i]) *
+				(target - left) / (right - left);
+		cum += w[i];
+	}
+	left = sp->count - w[n - 1] / 2.;
+	if (target >= sp->count)
+		return sp->max;
+	return m[n - 1] + (sp->max - m[n - 1]) *
+		(target - left) / (w[n - 1] / 2.);
+}
+
+double
+sketch_cdf(struct sketch_s *sp, double x)
+{
+	int i, n;
+	double *m, *w;
+	double cum;
+
+	if (sp->n_buffered)
+		compress(sp, NULL, 0);
+	n = sp->n_centroids;
+	if (n == 0 || x < sp->min)
+		return 0.;
+	if (x >= sp->max)
+		return 1.;
+	m = sp->centroid_mean;
+	w = sp->centroid_weight;
+
+	if (x < m[0])
+		return (x - sp->min) / (m[0] - sp->min) *
+			w[0] / 2. / sp->count;
+	cum = w[0] / 2.;
+	for (i = 0; i < n - 1; i++) {
+		if (x < m[i + 1])
+			return (cum + (x - m[i]) / (m[i + 1] - m[i]) *
+				(w[i] + w[i + 1]) / 2.) / sp->count;
+		cum += (w[i] + w[i + 1]) / 2.;
+	}
+	return (cum + (x - m[n - 1]) / (sp->max - m[n - 1]) *
+		w[n - 1] / 2.) / sp->count;
+}
+
+double
+sketch_sd(struct sketch_s *sp)
+{
+	if (sp->count < 2.)
+		return 0.;
+	return sqrt(sp->m2 / (sp->count - 1.));
+}
@@ -0,0 +1,64 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Streaming statistics in constant memory.
+ *
+ * A sketch keeps the running mean and variance (Welford) and a
+ * merging t-digest for quantiles.  Sketches hold no pointers, so they
+ * may live in memory shared between processes, and two sketches built
+ * separately can be merged into one.
+ */
+
+#define	SKETCH_COMPRESSION	200
+#define	SKETCH_CENTROIDS	(SKETCH_COMPRESSION + 2)
+#define	SKETCH_BUFFER		256
+
+struct sketch_s {
+	double count;		/* values added */
+	double mean;		/* Welford running mean */
+	double m2;		/* sum of squared deviations */
+	double min, max;
+
+	int n_centroids;
+	int n_buffered;
+	double centroid_mean[SKETCH_CENTROIDS];
+	double centroid_weight[SKETCH_CENTROIDS];
+	double buffer[SKETCH_BUFFER];
+};
+
+/*
+ * Must be called before use, even on zeroed memory.
+ */
+void sketch_init(struct sketch_s *sp);
+
+void sketch_add(struct sketch_s *sp, double x);
+
+/*
+ * Adds everything in src to dst.
+ */
+void sketch_merge(struct sketch_s *dst, struct sketch_s *src);
+
+/*
+ * Quantile q in [0, 1], and the fraction of values <= x.
+ * Both return 0 for an empty sketch.
+ */
+double sketch_quantile(struct sketch_s *sp, double q);
+double sketch_cdf(struct sketch_s *sp, double x);
+
+double sketch_sd(struct sketch_s *sp);
@@ -0,0 +1,71 @@
+/*
+  This file is a portion of Hsim 0.4
+ 
+  Hsim is free software; you can redistribute it and/or modify it
+  under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 2 of the License,
+  or (at your option) any later version.
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+  
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+ */
+/*
+ * Reads numbers from stdin, one per line.
+ * Prints the sketch quantiles next to the exact ones, and the
+ * quantiles of two half sketches merged together.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sketch.h"
+
+static int
+compare(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+int
+main()
+{
+	static struct sketch_s all, even, odd;
+	static double v[1000000];
+	static double q[] = { 0., .001, .01, .05, .25, .5, .75, .95, .99,
+				.999, 1. };
+	int i, n;
+
+	sketch_init(&all);
+	sketch_init(&even);
+	sketch_init(&odd);
+	for (n = 0; n < 1000000 && scanf("%lf", v + n) == 1; n++) {
+		sketch_add(&all, v[n]);
+		sketch_add(n & 1? &odd: &even, v[n]);
+	}
+	if (n == 0)
+		return 1;
+	sketch_merge(&even, &odd);
+	qsort(v, n, sizeof v[0], compare);
+
+	printf("%d values, mean %g sd %g, merged mean %g sd %g\n",
+		n, all.mean, sketch_sd(&all), even.mean, sketch_sd(&even));
+	printf("%d centroids, merged %d\n",
+		all.n_centroids, even.n_centroids);
+	printf("q\texact\t\tsketch\t\tmerged\t\tcdf\n");
+	for (i = 0; i < sizeof q / sizeof q[0]; i++)
+		printf("%g\t%-12g\t%-12g\t%-12g\t%g\n", q[i],
+			v[(int)(q[i] * (n - 1))],
+			sketch_quantile(&all, q[i]),
+			sketch_quantile(&even, q[i]),
+			sketch_cdf(&all, v[(int)(q[i] * (n - 1))]));
+	return 0;
+}